@@ -133,28 +133,32 @@ static void on_receive(quicly_stream_t *stream, size_t off, const void *src, siz
     if (quicly_streambuf_ingress_receive(stream, off, src, len) != 0)
         return;
 
-    /* obtain contiguous bytes from the receive buffer */
-    ptls_iovec_t input = quicly_streambuf_ingress_get(stream);
+    /* obtain contiguous bytes from the receive buffer, repeating until all bytes are consumed */
+    ptls_iovec_t input;
+    while ((input = quicly_streambuf_ingress_get(stream)).len != 0) {
+        if (is_server()) {
+            /* server: echo back to the client */
+            if (quicly_sendstate_is_open(&stream->sendstate))
+                quicly_streambuf_egress_write(stream, input.base, input.len);
+        } else {
+            /* client: print to stdout */
+            fwrite(input.base, 1, input.len, stdout);
+            fflush(stdout);
+        }
+        /* remove used bytes from receive buffer */
+        quicly_streambuf_ingress_shift(stream, input.len);
+    }
 
-    if (is_server()) {
-        /* server: echo back to the client */
-        if (quicly_sendstate_is_open(&stream->sendstate) && (input.len > 0)) {
-            quicly_streambuf_egress_write(stream, input.base, input.len);
+    if (quicly_recvstate_transfer_complete(&stream->recvstate)) {
+        if (is_server()) {
             /* shutdown the stream after echoing all data */
-            if (quicly_recvstate_transfer_complete(&stream->recvstate))
+            if (quicly_sendstate_is_open(&stream->sendstate))
                 quicly_streambuf_egress_shutdown(stream);
-        }
-    } else {
-        /* client: print to stdout */
-        fwrite(input.base, 1, input.len, stdout);
-        fflush(stdout);
-        /* initiate connection close after receiving all data */
-        if (quicly_recvstate_transfer_complete(&stream->recvstate))
+        } else {
+            /* initiate connection close after receiving all data */
             quicly_close(stream->conn, 0, "");
+        }
     }
-
-    /* remove used bytes from receive buffer */
-    quicly_streambuf_ingress_shift(stream, input.len);
 }
 
 static void process_msg(int is_client, quicly_conn_t **conns, struct msghdr *msg, size_t dgram_len)
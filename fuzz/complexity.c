@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/bio.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include "picotls.h"
+#include "picotls/openssl.h"
+#include "quicly.h"
+#include "quicly/defaults.h"
+#include "../lib/quicly.c"
+#include "../t/perf_counters.h"
+#include "../t/test_certs.h"
+
+/**
+ * A fuzzer that looks for inputs that are expensive to process rather than for those that crash.
+ *
+ * For each input, a client and a server establish a connection in memory, then the server sends a stream until it has
+ * `QUICLY_FUZZ_SENTMAP_SIZE` packets in flight (none of them being delivered). The input is then encrypted as the payload of a
+ * 1-RTT packet sent by the client, and the CPU cost of the server processing that packet is measured; in instructions if perf
+ * counters are available, otherwise in nanoseconds of thread CPU time. Therefore, ACK frames are applied against a large sentmap,
+ * and STREAM frames open streams and build up their receive state.
+ *
+ * The logarithm of the cost is fed back to libFuzzer as coverage, so that the fuzzer keeps the inputs that are more expensive than
+ * those seen before. When the cost exceeds `QUICLY_FUZZ_BUDGET`, the input is reported and the process aborts, causing libFuzzer
+ * to save the input as a crash. Such inputs can be minimized by running the fuzzer with `-minimize_crash=1 -runs=<n> <input>`.
+ */
+
+#define MAX_DATAGRAM_SIZE 1200
+#define DEFAULT_SENTMAP_SIZE 4096
+#define DEFAULT_BUDGET_INSTRUCTIONS 20000000
+#define DEFAULT_BUDGET_NSEC 10000000
+
+static int64_t now = 1000;
+static quicly_context_t ctx;
+static quicly_cid_plaintext_t next_cid;
+static struct sockaddr_in client_addr, server_addr;
+static struct perf_counters counters;
+static int use_counters;
+static size_t sentmap_size = DEFAULT_SENTMAP_SIZE;
+static uint64_t budget;
+static volatile unsigned cost_sink;
+
+static uint64_t tls_now_cb(ptls_get_time_t *self)
+{
+    return (uint64_t)now;
+}
+
+static int64_t quic_now_cb(quicly_now_t *self)
+{
+    return now;
+}
+
+static void stream_noop_cb(quicly_stream_t *stream, int err)
+{
+}
+
+static void stream_egress_shift_cb(quicly_stream_t *stream, size_t delta)
+{
+}
+
+static void stream_egress_emit_cb(quicly_stream_t *stream, size_t off, void *dst, size_t *len, int *wrote_all)
+{
+    memset(dst, 'A', *len);
+    *wrote_all = 0;
+}
+
+static void stream_on_receive_cb(quicly_stream_t *stream, size_t off, const void *src, size_t len)
+{
+    /* data is left unconsumed, so that the received ranges accumulate */
+}
+
+static int stream_open_cb(quicly_stream_open_t *self, quicly_stream_t *stream)
+{
+    static const quicly_stream_callbacks_t stream_callbacks = {stream_noop_cb,        stream_egress_shift_cb,
+                                                               stream_egress_emit_cb, stream_noop_cb,
+                                                               stream_on_receive_cb,  stream_noop_cb};
+    stream->callbacks = &stream_callbacks;
+    return 0;
+}
+
+/**
+ * sends the packets of `src` to `*dst`, accepting a new connection if `*dst` is NULL; returns the number of packets
+ */
+static size_t transmit(quicly_conn_t *src, quicly_conn_t **dst)
+{
+    quicly_address_t destaddr, srcaddr;
+    struct iovec datagrams[16];
+    uint8_t datagramsbuf[PTLS_ELEMENTSOF(datagrams) * ctx.transport_params.max_udp_payload_size];
+    size_t num_datagrams = PTLS_ELEMENTSOF(datagrams), num_packets = 0, i;
+    int ret;
+
+    if ((ret = quicly_send(src, &destaddr, &srcaddr, datagrams, &num_datagrams, datagramsbuf, sizeof(datagramsbuf))) != 0) {
+        fprintf(stderr, "quicly_send failed:%d\n", ret);
+        abort();
+    }
+
+    for (i = 0; i != num_datagrams; ++i) {
+        size_t off = 0;
+        while (off != datagrams[i].iov_len) {
+            quicly_decoded_packet_t packet;
+            if (quicly_decode_packet(&ctx, &packet, datagrams[i].iov_base, datagrams[i].iov_len, &off) == SIZE_MAX)
+                break;
+            if (*dst == NULL) {
+                ret = quicly_accept(dst, &ctx, &destaddr.sa, &srcaddr.sa, &packet, NULL, &next_cid, NULL, NULL);
+                ++next_cid.master_id;
+            } else {
+                ret = quicly_receive(*dst, &destaddr.sa, &srcaddr.sa, &packet);
+            }
+            if (!(ret == 0 || ret == QUICLY_ERROR_PACKET_IGNORED)) {
+                fprintf(stderr, "failed to receive packet:%d\n", ret);
+                abort();
+            }
+            ++num_packets;
+        }
+    }
+
+    return num_packets;
+}
+
+/**
+ * Establishes a connection, then lets the server fill its sentmap with packets that are never delivered.
+ *
+ * This is done for each input rather than once, as processing an input mutates the connection (e.g., ACK frames shrink the
+ * sentmap, STREAM frames open streams), and the cost has to be independent of the inputs being processed before so that the inputs
+ * being reported can be reproduced. Cloning a connection is not an option either; its state is spread over objects owned by quicly
+ * and picotls (the TLS state, the AEAD contexts, the sentmap chunks, the streams, etc.). The setup is not part of the cost.
+ */
+static void setup_connection(quicly_conn_t **client, quicly_conn_t **server)
+{
+    quicly_stream_t *stream;
+    int ret;
+
+    *server = NULL;
+    if ((ret = quicly_connect(client, &ctx, "example.com", (void *)&server_addr, (void *)&client_addr, &next_cid,
+                              ptls_iovec_init(NULL, 0), NULL, NULL, NULL)) != 0) {
+        fprintf(stderr, "quicly_connect failed:%d\n", ret);
+        abort();
+    }
+    ++next_cid.master_id;
+    while (*server == NULL || !quicly_connection_is_ready(*client) || !quicly_connection_is_ready(*server)) {
+        size_t n = transmit(*client, server);
+        if (*server != NULL)
+            n += transmit(*server, client);
+        if (n == 0) {
+            fprintf(stderr, "handshake stalled\n");
+            abort();
+        }
+    }
+
+    if ((ret = quicly_open_stream(*server, &stream, 1)) != 0 || (ret = quicly_stream_sync_sendbuf(stream, 1)) != 0) {
+        fprintf(stderr, "failed to open stream:%d\n", ret);
+        abort();
+    }
+    while ((*server)->egress.loss.sentmap.num_packets < sentmap_size) {
+        quicly_address_t destaddr, srcaddr;
+        struct iovec datagrams[16];
+        uint8_t datagramsbuf[PTLS_ELEMENTSOF(datagrams) * ctx.transport_params.max_udp_payload_size];
+        size_t num_datagrams = PTLS_ELEMENTSOF(datagrams);
+        if ((ret = quicly_send(*server, &destaddr, &srcaddr, datagrams, &num_datagrams, datagramsbuf, sizeof(datagramsbuf))) !=
+            0) {
+            fprintf(stderr, "quicly_send failed:%d\n", ret);
+            abort();
+        }
+        if (num_datagrams == 0) {
+            fprintf(stderr, "sentmap stalled at %zu packets\n", (*server)->egress.loss.sentmap.num_packets);
+            abort();
+        }
+    }
+}
+
+/**
+ * builds a 1-RTT packet carrying `payload` as if it were sent by `client`, returning the size of the datagram
+ */
+static size_t build_packet(quicly_conn_t *client, uint8_t *datagram, const uint8_t *payload, size_t payload_len)
+{
+    struct st_quicly_cipher_context_t *cipher = &client->application->cipher.egress.key;
+    const quicly_cid_t *dcid = quicly_get_remote_cid(client);
+    uint8_t *dst = datagram;
+    size_t payload_from, max_payload_len;
+    uint64_t pn = client->egress.packet_number++;
+
+    *dst++ = QUICLY_QUIC_BIT | (QUICLY_SEND_PN_SIZE - 1);
+    memcpy(dst, dcid->cid, dcid->len);
+    dst += dcid->len;
+    dst = quicly_encode16(dst, (uint16_t)pn);
+    payload_from = dst - datagram;
+
+    max_payload_len = MAX_DATAGRAM_SIZE - payload_from - cipher->aead->algo->tag_size;
+    if (payload_len > max_payload_len)
+        payload_len = max_payload_len;
+    memcpy(dst, payload, payload_len);
+    dst += payload_len;
+    /* pad so that the pn + payload would be at least 4 bytes, as required for sampling the header protection mask */
+    while (dst - datagram - payload_from < QUICLY_MAX_PN_SIZE - QUICLY_SEND_PN_SIZE)
+        *dst++ = QUICLY_FRAME_TYPE_PADDING;
+    dst += cipher->aead->algo->tag_size;
+
+    quicly_default_crypto_engine.encrypt_packet(&quicly_default_crypto_engine, client, cipher->header_protection, cipher->aead,
+                                                ptls_iovec_init(datagram, dst - datagram), 0, payload_from, pn, 0);
+
+    return dst - datagram;
+}
+
+static uint64_t thread_cputime_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Feeds the logarithm of the cost to libFuzzer as coverage; each branch being taken counts as an edge, therefore an input
+ * costing twice as much as any seen before is considered as new coverage.
+ */
+static __attribute__((noinline)) void record_cost(uint64_t cost)
+{
+    unsigned bucket = cost == 0 ? 0 : 64 - __builtin_clzll(cost);
+
+#define BUCKET(n)                                                                                                                  \
+    if (bucket > n)                                                                                                                \
+    ++cost_sink
+    BUCKET(8);
+    BUCKET(9);
+    BUCKET(10);
+    BUCKET(11);
+    BUCKET(12);
+    BUCKET(13);
+    BUCKET(14);
+    BUCKET(15);
+    BUCKET(16);
+    BUCKET(17);
+    BUCKET(18);
+    BUCKET(19);
+    BUCKET(20);
+    BUCKET(21);
+    BUCKET(22);
+    BUCKET(23);
+    BUCKET(24);
+    BUCKET(25);
+    BUCKET(26);
+    BUCKET(27);
+    BUCKET(28);
+    BUCKET(29);
+    BUCKET(30);
+    BUCKET(31);
+#undef BUCKET
+}
+
+static void report(quicly_conn_t *server, const uint8_t *data, size_t size, uint64_t cost)
+{
+    size_t i;
+
+    fprintf(stderr,
+            "==complexity== processing a packet cost %" PRIu64 " %s, exceeding the budget of %" PRIu64 "\n"
+            "==complexity== sentmap: %zu packets, state after receive: %d\n"
+            "==complexity== payload (%zu bytes):",
+            cost, use_counters ? "instructions" : "nsec", budget, sentmap_size, (int)server->super.state, size);
+    for (i = 0; i != size; ++i)
+        fprintf(stderr, "%s%02x", i % 32 == 0 ? "\n  " : "", data[i]);
+    fprintf(stderr, "\n");
+}
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    const char *env;
+
+    ERR_load_crypto_strings();
+    OpenSSL_add_all_algorithms();
+
+    static ptls_iovec_t cert;
+    {
+        BIO *bio = BIO_new_mem_buf(RSA_CERTIFICATE, strlen(RSA_CERTIFICATE));
+        X509 *x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+        BIO_free(bio);
+        if (x509 == NULL) {
+            fprintf(stderr, "failed to load certificate\n");
+            abort();
+        }
+        cert.len = i2d_X509(x509, &cert.base);
+        X509_free(x509);
+    }
+
+    static ptls_openssl_sign_certificate_t cert_signer;
+    {
+        BIO *bio = BIO_new_mem_buf(RSA_PRIVATE_KEY, strlen(RSA_PRIVATE_KEY));
+        EVP_PKEY *pkey = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+        BIO_free(bio);
+        if (pkey == NULL) {
+            fprintf(stderr, "failed to load private key\n");
+            abort();
+        }
+        ptls_openssl_init_sign_certificate(&cert_signer, pkey);
+        EVP_PKEY_free(pkey);
+    }
+
+    static ptls_get_time_t tls_now = {tls_now_cb};
+    static ptls_context_t tlsctx = {.random_bytes = ptls_openssl_random_bytes,
+                                    .get_time = &tls_now,
+                                    .key_exchanges = ptls_openssl_key_exchanges,
+                                    .cipher_suites = ptls_openssl_cipher_suites,
+                                    .certificates = {&cert, 1},
+                                    .sign_certificate = &cert_signer.super};
+    quicly_amend_ptls_context(&tlsctx);
+
+    if ((env = getenv("QUICLY_FUZZ_SENTMAP_SIZE")) != NULL)
+        sentmap_size = strtoul(env, NULL, 10);
+    use_counters = perf_counters_open(&counters) == 0;
+    if ((env = getenv("QUICLY_FUZZ_BUDGET")) != NULL) {
+        budget = strtoull(env, NULL, 10);
+    } else {
+        budget = use_counters ? DEFAULT_BUDGET_INSTRUCTIONS : DEFAULT_BUDGET_NSEC;
+    }
+
+    static quicly_stream_open_t stream_open = {stream_open_cb};
+    static quicly_now_t quic_now = {quic_now_cb};
+    ctx = quicly_spec_context;
+    ctx.now = &quic_now;
+    ctx.tls = &tlsctx;
+    ctx.stream_open = &stream_open;
+    ctx.initcwnd_packets = sentmap_size + 16;
+    ctx.transport_params.max_streams_uni = 1;
+    ctx.transport_params.max_stream_data.uni = 256 * 1024 * 1024;
+    ctx.transport_params.max_data = 256 * 1024 * 1024;
+
+    client_addr = (struct sockaddr_in){.sin_family = AF_INET, .sin_addr.s_addr = htonl(0x7f000001), .sin_port = htons(10000)};
+    server_addr = (struct sockaddr_in){.sin_family = AF_INET, .sin_addr.s_addr = htonl(0x7f000001), .sin_port = htons(443)};
+
+    fprintf(stderr, "==complexity== sentmap: %zu packets, budget: %" PRIu64 " %s\n", sentmap_size, budget,
+            use_counters ? "instructions" : "nsec");
+
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    quicly_conn_t *client, *server;
+    uint8_t datagram[MAX_DATAGRAM_SIZE];
+    size_t datagram_len, off = 0;
+    quicly_decoded_packet_t packet;
+    uint64_t cost;
+
+    setup_connection(&client, &server);
+
+    datagram_len = build_packet(client, datagram, data, size);
+    if (quicly_decode_packet(&ctx, &packet, datagram, datagram_len, &off) != datagram_len) {
+        fprintf(stderr, "failed to decode the packet being built\n");
+        abort();
+    }
+
+    if (use_counters) {
+        uint64_t cycles;
+        perf_counters_enable(&counters, 1);
+        quicly_receive(server, (void *)&server_addr, (void *)&client_addr, &packet);
+        perf_counters_enable(&counters, 0);
+        perf_counters_read(&counters, &cycles, &cost);
+    } else {
+        uint64_t started_at = thread_cputime_nsec();
+        quicly_receive(server, (void *)&server_addr, (void *)&client_addr, &packet);
+        cost = thread_cputime_nsec() - started_at;
+    }
+
+    record_cost(cost);
+    if (cost > budget) {
+        report(server, data, size, cost);
+        abort();
+    }
+
+    quicly_free(client);
+    quicly_free(server);
+    return 0;
+}
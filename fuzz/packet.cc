@@ -14,9 +14,8 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size)
 
 	ctx = quicly_spec_context;
 
-	ret = quicly_decode_packet(&ctx, &p, Data, Size);
-
-	if (ret != Size)
+	size_t off = 0;
+	if (quicly_decode_packet(&ctx, &p, Data, Size, &off) != Size)
 		return 0;
 	const uint8_t *src = p.octets.base, *end = src + p.octets.len;
 	if (p.octets.len == 0)
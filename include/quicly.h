@@ -34,6 +34,7 @@ extern "C" {
 #include <sys/types.h>
 #include "picotls.h"
 #include "quicly/constants.h"
+#include "quicly/bintrace.h"
 #include "quicly/frame.h"
 #include "quicly/local_cid.h"
 #include "quicly/linklist.h"
@@ -44,6 +45,9 @@ extern "C" {
 #include "quicly/sendstate.h"
 #include "quicly/maxsender.h"
 #include "quicly/cid.h"
+#include "quicly/datagram_queue.h"
+#include "quicly/histogram.h"
+#include "quicly/memory_budget.h"
 #include "quicly/remote_cid.h"
 
 /* invariants! */
@@ -167,6 +171,47 @@ QUICLY_CALLBACK_TYPE(void, update_open_count, ssize_t delta);
  */
 QUICLY_CALLBACK_TYPE(void, async_handshake, ptls_t *tls);
 
+/**
+ * Parameters of the ACK_FREQUENCY frame.
+ */
+typedef struct st_quicly_ack_frequency_params_t {
+    uint32_t packet_tolerance;
+    /**
+     * in microseconds
+     */
+    uint64_t max_ack_delay;
+    int ignore_order;
+} quicly_ack_frequency_params_t;
+
+/**
+ * Properties of the connection that the sender-side ACK frequency policy can refer to.
+ */
+typedef struct st_quicly_ack_frequency_input_t {
+    const quicly_cc_t *cc;
+    const quicly_rtt_t *rtt;
+    uint16_t max_udp_payload_size;
+    /**
+     * number of packets that were acknowledged after being deemed lost since the previous invocation of the callback; i.e., the
+     * amount of reordering exceeding the loss detection thresholds
+     */
+    uint64_t num_late_acked;
+    /**
+     * transport parameters of the peer; in microseconds and milliseconds respectively
+     */
+    uint64_t min_ack_delay_usec;
+    uint16_t max_ack_delay;
+} quicly_ack_frequency_input_t;
+
+/**
+ * Sender-side policy of the ACK frequency extension, invoked roughly once every few PTO periods once the handshake is complete,
+ * if the peer supports the extension. Upon invocation, `params` contains the values sent previously (or the default values, if none
+ * has been sent). When the callback returns true, an ACK_FREQUENCY frame carrying the updated `params` is sent, unless they are
+ * unchanged. The callback is also invoked as soon as the latest frame is deemed lost, in which case the frame is resent
+ * regardless. When the callback is set, `quicly_context_t::ack_frequency` is ignored.
+ */
+QUICLY_CALLBACK_TYPE(int, adjust_ack_frequency, quicly_conn_t *conn, const quicly_ack_frequency_input_t *input,
+                     quicly_ack_frequency_params_t *params);
+
 /**
  * crypto offload API
  */
@@ -271,6 +316,54 @@ typedef struct st_quicly_transport_parameters_t {
     uint16_t max_datagram_frame_size;
 } quicly_transport_parameters_t;
 
+/**
+ * reasons for which the flight recorder of a connection is dumped
+ */
+typedef enum en_quicly_flight_recorder_reason_t {
+    /**
+     * requested by the application by calling `quicly_dump_flight_recorder`
+     */
+    QUICLY_FLIGHT_RECORDER_REASON_APPLICATION,
+    /**
+     * number of consecutive PTOs reached `quicly_flight_recorder_t::pto_threshold`
+     */
+    QUICLY_FLIGHT_RECORDER_REASON_PTO_STORM,
+    /**
+     * the packets being lost span the persistent congestion duration (RFC 9002, Section 7.6), without any packet being acked in
+     * between
+     */
+    QUICLY_FLIGHT_RECORDER_REASON_PERSISTENT_CONGESTION,
+    /**
+     * the handshake did not complete in time
+     */
+    QUICLY_FLIGHT_RECORDER_REASON_HANDSHAKE_TIMEOUT,
+    /**
+     * the connection is being closed due to an error, either locally or by the peer
+     */
+    QUICLY_FLIGHT_RECORDER_REASON_CLOSE_ERROR
+} quicly_flight_recorder_reason_t;
+
+/**
+ * The flight recorder retains the latest events of each connection in a small ring, and dumps them when something unusual happens.
+ * The events are those of the binary tracer (see `quicly/bintrace.h`); the rings are recycled through a per-thread pool.
+ */
+typedef struct st_quicly_flight_recorder_t {
+    /**
+     * size of the ring being allocated for each connection (in bytes)
+     */
+    size_t ring_size;
+    /**
+     * the recorder is dumped when the number of consecutive PTOs reaches this value; 0 disables the trigger
+     */
+    int8_t pto_threshold;
+    /**
+     * Called to dump the events of the connection. The records can be read using `quicly_bintrace_foreach`; the ring is valid only
+     * during the call.
+     */
+    void (*on_dump)(struct st_quicly_flight_recorder_t *self, quicly_conn_t *conn, quicly_flight_recorder_reason_t reason,
+                    quicly_bintrace_ring_t *ring);
+} quicly_flight_recorder_t;
+
 struct st_quicly_context_t {
     /**
      * tls context to use
@@ -378,6 +471,49 @@ struct st_quicly_context_t {
      *
      */
     quicly_async_handshake_t *async_handshake;
+    /**
+     * optional callback for adjusting the ACK frequency of the peer based on the state of the connection
+     */
+    quicly_adjust_ack_frequency_t *adjust_ack_frequency;
+    /**
+     * depth of the per-connection queue of DATAGRAM frames waiting to be sent, and what to do when the queue overflows
+     */
+    struct {
+        size_t max_size;
+        quicly_datagram_drop_policy_t drop_policy;
+    } datagram_frame_queue;
+    /**
+     * Upper bounds of the receive windows. When set above the initial values (i.e., `transport_params.max_stream_data` and
+     * `transport_params.max_data`), a window is doubled each time the peer consumes the credit within two round-trips, similarly to
+     * the receive buffer auto-tuning of Linux. While a window is growing, it is extended once a quarter of it is consumed rather
+     * than half, so that the peer is not blocked while the extension is in flight. Zero disables auto-tuning.
+     */
+    struct {
+        uint64_t max_stream_data;
+        uint64_t max_data;
+    } max_receive_window;
+    /**
+     * Optional memory budget shared by the connections using this context; when the usage approaches the limit, the receive windows
+     * being advertised are throttled. Must be set before creating connections.
+     */
+    quicly_memory_budget_t *memory_budget;
+    /**
+     * optional aggregate into which the connections fold their counters (see `quicly/stats_aggregate.h`)
+     */
+    struct st_quicly_stats_aggregate_t *stats_aggregate;
+    /**
+     * if set, connections record the latency distributions (see `quicly_latency_stats_t`), which are also folded into
+     * `stats_aggregate`; the histograms of each connection (about 2.4KB) are allocated upon the first sample
+     */
+    unsigned collect_latency_stats : 1;
+    /**
+     * optional flight recorder; requires the library to be built with QUICLY_USE_BINTRACE
+     */
+    quicly_flight_recorder_t *flight_recorder;
+    /**
+     * optional qlog writer (see `quicly/qlog.h`); requires the library to be built with QUICLY_USE_BINTRACE
+     */
+    struct st_quicly_qlog_t *qlog;
 };
 
 /**
@@ -503,6 +639,28 @@ struct st_quicly_conn_streamgroup_state_t {
      */                                                                                                                            \
     uint64_t num_initial_handshake_exceeded
 
+/**
+ * Latency distributions, in milliseconds.
+ */
+typedef struct st_quicly_latency_stats_t {
+    /**
+     * RTT samples; one for each ACK frame newly acknowledging an ack-eliciting packet
+     */
+    quicly_histogram_t rtt;
+    /**
+     * time until the handshake is confirmed
+     */
+    quicly_histogram_t handshake;
+    /**
+     * time from the opening of a locally-initiated stream until the first byte is received on that stream
+     */
+    quicly_histogram_t stream_first_byte;
+    /**
+     * time from the opening of a stream until all the data sent on that stream is acknowledged
+     */
+    quicly_histogram_t stream_send_complete;
+} quicly_latency_stats_t;
+
 typedef struct st_quicly_stats_t {
     /**
      * The pre-built fields. This MUST be the first member of `quicly_stats_t` so that we can use `memcpy`.
@@ -532,6 +690,10 @@ typedef struct st_quicly_stats_t {
      * Time took until handshake is confirmed. UINT64_MAX if handshake is not confirmed yet.
      */
     uint64_t handshake_confirmed_msec;
+    /**
+     * Latency distributions; all zero unless `quicly_context_t::collect_latency_stats` is set.
+     */
+    quicly_latency_stats_t latency;
 } quicly_stats_t;
 
 /**
@@ -547,6 +709,34 @@ struct st_quicly_default_scheduler_state_t {
     quicly_linklist_t blocked;
 };
 
+/**
+ * number of urgency levels defined by RFC 9218
+ */
+#define QUICLY_PRIORITY_NUM_URGENCY_LEVELS 8
+/**
+ * default urgency as defined by RFC 9218
+ */
+#define QUICLY_PRIORITY_DEFAULT_URGENCY 3
+
+/**
+ * The state of the priority stream scheduler (`quicly_priority_stream_scheduler`).
+ * Streams for which STREAM frames can be emitted are linked to one of the `active` lists, the slot being determined by the urgency
+ * and the incremental flag of the stream. Streams with smaller urgency values are always served first. Within an urgency level,
+ * non-incremental streams are served one by one in FIFO order before the incremental streams, which are served round-robin.
+ * `blocked` is equivalent to that of `st_quicly_default_scheduler_state_t`.
+ */
+struct st_quicly_priority_scheduler_state_t {
+    /**
+     * `active[urgency][0]` is the non-incremental (FIFO) class, `active[urgency][1]` is the incremental (round-robin) class
+     */
+    quicly_linklist_t active[QUICLY_PRIORITY_NUM_URGENCY_LEVELS][2];
+    quicly_linklist_t blocked;
+    /**
+     * Bit N is set when `active[N]` might be non-empty. Bits can be stale, as streams are unlinked directly when being destroyed.
+     */
+    uint8_t active_urgencies;
+};
+
 typedef void (*quicly_trace_cb)(void *ctx, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
 
 struct _st_quicly_conn_public_t {
@@ -599,12 +789,17 @@ struct _st_quicly_conn_public_t {
      */
     quicly_cid_t original_dcid;
     struct st_quicly_default_scheduler_state_t _default_scheduler;
+    struct st_quicly_priority_scheduler_state_t _priority_scheduler;
     struct {
         QUICLY_STATS_PREBUILT_COUNTERS;
         /**
          * Time took until handshake is confirmed. UINT64_MAX if handshake is not confirmed yet.
          */
         uint64_t handshake_confirmed_msec;
+        /**
+         * latency distributions; allocated upon the first sample when `quicly_context_t::collect_latency_stats` is set
+         */
+        quicly_latency_stats_t *latency;
     } stats;
     uint32_t version;
     void *data;
@@ -700,6 +895,17 @@ struct st_quicly_stream_t {
      *
      */
     unsigned streams_blocked : 1;
+    /**
+     * priority of the stream (RFC 9218), used by `quicly_priority_stream_scheduler`; use `quicly_stream_set_priority` to update
+     */
+    struct {
+        uint8_t urgency;
+        uint8_t incremental;
+    } priority;
+    /**
+     * when the stream was opened; used for collecting `quicly_latency_stats_t`
+     */
+    int64_t _created_at;
     /**
      *
      */
@@ -738,7 +944,7 @@ struct st_quicly_stream_t {
          */
         struct {
             quicly_linklist_t control; /* links to conn_t::control (or to conn_t::streams_blocked if the blocked flag is set) */
-            quicly_linklist_t default_scheduler;
+            quicly_linklist_t default_scheduler; /* also used by the priority scheduler */
         } pending_link;
     } _send_aux;
     /**
@@ -756,6 +962,14 @@ struct st_quicly_stream_t {
          * sent are received.
          */
         uint32_t max_ranges;
+        /**
+         * when the receive window was last extended (zero if never); used for auto-tuning the window size
+         */
+        int64_t window_updated_at;
+        /**
+         * bytes being charged to `quicly_context_t::memory_budget` for the data received but not yet consumed
+         */
+        uint64_t memory_charged;
     } _recv_aux;
 };
 
@@ -904,6 +1118,11 @@ static quicly_state_t quicly_get_state(quicly_conn_t *conn);
  *
  */
 int quicly_connection_is_ready(quicly_conn_t *conn);
+/**
+ * Returns a boolean indicating if the handshake has been confirmed. Servers can use this function for determining if a connection
+ * is half-open.
+ */
+static int quicly_is_handshake_confirmed(quicly_conn_t *conn);
 /**
  *
  */
@@ -940,6 +1159,14 @@ int quicly_get_stats(quicly_conn_t *conn, quicly_stats_t *stats);
  *
  */
 int quicly_get_delivery_rate(quicly_conn_t *conn, quicly_rate_t *delivery_rate);
+/**
+ * dumps the flight recorder of the connection, if any, with the reason set to QUICLY_FLIGHT_RECORDER_REASON_APPLICATION
+ */
+void quicly_dump_flight_recorder(quicly_conn_t *conn);
+/**
+ * returns a short name of the reason (e.g., "pto-storm")
+ */
+const char *quicly_flight_recorder_reason_to_string(quicly_flight_recorder_reason_t reason);
 /**
  *
  */
@@ -1149,6 +1376,13 @@ static int quicly_stop_requested(quicly_stream_t *stream);
  *
  */
 int quicly_stream_sync_sendbuf(quicly_stream_t *stream, int activate);
+/**
+ * Sets the priority of the stream, as defined in RFC 9218. The stream scheduler is notified so that the change takes effect
+ * immediately.
+ * @param urgency value between 0 (most urgent) and 7 (least urgent)
+ * @param incremental if the data of the stream can be processed incrementally by the peer
+ */
+void quicly_stream_set_priority(quicly_stream_t *stream, uint8_t urgency, int incremental);
 /**
  *
  */
@@ -1182,12 +1416,19 @@ static int quicly_stream_has_receive_side(int is_client, quicly_stream_id_t stre
  */
 static int quicly_stream_is_self_initiated(quicly_stream_t *stream);
 /**
- * Sends QUIC DATAGRAM frames. Some of the frames being provided may get dropped.
+ * Sends QUIC DATAGRAM frames. The payloads are copied. Some of the frames being provided may get dropped, according to the
+ * `datagram_frame_queue` settings of the context.
  * Notes:
  * * At the moment, emission of QUIC packets carrying DATAGRAM frames is not congestion controlled.
  * * While the API is designed to look like synchronous, application still has to call `quicly_send` for the time being.
  */
 void quicly_send_datagram_frames(quicly_conn_t *conn, ptls_iovec_t *datagrams, size_t num_datagrams);
+/**
+ * Queues a DATAGRAM frame without copying the payload. The payload must remain valid until `datagram->release` is invoked, which
+ * happens when the frame is sent or dropped (due to the drop policy, `expire_at`, or the connection being freed). Returns 0 if
+ * successful, or PTLS_ERROR_NO_MEMORY (in which case the release callback has already been invoked).
+ */
+int quicly_enqueue_datagram_frame(quicly_conn_t *conn, const quicly_datagram_t *datagram);
 /**
  * Sets CC to the specified type. Returns a boolean indicating if the operation was successful.
  */
@@ -1300,6 +1541,12 @@ inline quicly_state_t quicly_get_state(quicly_conn_t *conn)
     return c->state;
 }
 
+inline int quicly_is_handshake_confirmed(quicly_conn_t *conn)
+{
+    struct _st_quicly_conn_public_t *c = (struct _st_quicly_conn_public_t *)conn;
+    return c->stats.handshake_confirmed_msec != UINT64_MAX;
+}
+
 inline uint32_t quicly_num_streams(quicly_conn_t *conn)
 {
     struct _st_quicly_conn_public_t *c = (struct _st_quicly_conn_public_t *)conn;
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_ack_queue_h
+#define quicly_ack_queue_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include "quicly/ranges.h"
+
+#ifndef QUICLY_ACK_QUEUE_BITMAP_WORDS
+/**
+ * size of the sliding bitmap in 64-bit words
+ */
+#define QUICLY_ACK_QUEUE_BITMAP_WORDS 4
+#endif
+
+#define QUICLY_ACK_QUEUE_BITMAP_BITS (QUICLY_ACK_QUEUE_BITMAP_WORDS * 64)
+
+/**
+ * Set of packet numbers that have been received and are to be acknowledged.
+ *
+ * Packet numbers that fall into the sliding bitmap are recorded by setting a bit, which is the only operation required when
+ * packets arrive in order or with small amount of reordering. As packets with larger packet numbers arrive, the bitmap slides
+ * forward 64 packet numbers at a time, moving the bits that fall off to `ranges`. Packet numbers below the bitmap (i.e. packets
+ * that have been reordered beyond the width of the bitmap) are recorded directly in `ranges`.
+ */
+typedef struct st_quicly_ack_queue_t {
+    /**
+     * packet numbers below `bitmap.base`
+     */
+    quicly_ranges_t ranges;
+    struct {
+        /**
+         * packet number corresponding to the least significant bit of `words[0]`; always a multiple of 64
+         */
+        uint64_t base;
+        uint64_t words[QUICLY_ACK_QUEUE_BITMAP_WORDS];
+    } bitmap;
+    /**
+     * largest packet number being recorded plus one, or zero if the queue is empty
+     */
+    uint64_t end;
+} quicly_ack_queue_t;
+
+/**
+ * initializes the queue
+ */
+static void quicly_ack_queue_init(quicly_ack_queue_t *queue);
+/**
+ * frees the memory being allocated
+ */
+static void quicly_ack_queue_dispose(quicly_ack_queue_t *queue);
+/**
+ *
+ */
+static int quicly_ack_queue_is_empty(quicly_ack_queue_t *queue);
+/**
+ * records given packet number, returns 0 if successful
+ */
+static int quicly_ack_queue_add(quicly_ack_queue_t *queue, uint64_t pn);
+/**
+ * removes packet numbers within [start, end), returns 0 if successful
+ */
+int quicly_ack_queue_subtract(quicly_ack_queue_t *queue, uint64_t start, uint64_t end);
+/**
+ * returns the number of contiguous ranges being recorded
+ */
+size_t quicly_ack_queue_num_ranges(quicly_ack_queue_t *queue);
+/**
+ * drops the oldest ranges so that no more than `max_ranges` ranges remain
+ */
+void quicly_ack_queue_shrink(quicly_ack_queue_t *queue, size_t max_ranges);
+/**
+ * Stores the ranges in ascending order to `ranges`, returning the number of ranges being stored. If the number of ranges exceeds
+ * `capacity`, only the largest ones are stored.
+ */
+size_t quicly_ack_queue_get_ranges(quicly_ack_queue_t *queue, quicly_range_t *ranges, size_t capacity);
+/**
+ * slow path of `quicly_ack_queue_add`
+ */
+int quicly_ack_queue__add_slow(quicly_ack_queue_t *queue, uint64_t pn);
+
+/* inline functions */
+
+inline void quicly_ack_queue_init(quicly_ack_queue_t *queue)
+{
+    quicly_ranges_init(&queue->ranges);
+    queue->bitmap.base = 0;
+    memset(queue->bitmap.words, 0, sizeof(queue->bitmap.words));
+    queue->end = 0;
+}
+
+inline void quicly_ack_queue_dispose(quicly_ack_queue_t *queue)
+{
+    quicly_ranges_clear(&queue->ranges);
+}
+
+inline int quicly_ack_queue_is_empty(quicly_ack_queue_t *queue)
+{
+    return queue->end == 0;
+}
+
+inline int quicly_ack_queue_add(quicly_ack_queue_t *queue, uint64_t pn)
+{
+    uint64_t off = pn - queue->bitmap.base;
+
+    /* fast path; the packet number fits in the bitmap (the subtraction wraps around if pn is below base) */
+    if (off < QUICLY_ACK_QUEUE_BITMAP_BITS) {
+        queue->bitmap.words[off / 64] |= (uint64_t)1 << (off % 64);
+        if (queue->end <= pn)
+            queue->end = pn + 1;
+        return 0;
+    }
+
+    return quicly_ack_queue__add_slow(queue, pn);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
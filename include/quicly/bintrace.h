@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_bintrace_h
+#define quicly_bintrace_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * magic number at the beginning of each ring ("QBINTRC1")
+ */
+#define QUICLY_BINTRACE_MAGIC UINT64_C(0x314352544e494251)
+/**
+ * record type used for filling the space at the end of the ring when a record does not fit
+ */
+#define QUICLY_BINTRACE_EVENT_PADDING 0
+/**
+ * minimum capacity of a ring
+ */
+#define QUICLY_BINTRACE_MIN_CAPACITY 1024
+#ifndef QUICLY_BINTRACE_MAX_STRLEN
+/**
+ * size of the fixed-length buffers into which string arguments of the probes are copied, including the terminating NUL
+ */
+#define QUICLY_BINTRACE_MAX_STRLEN 64
+#endif
+
+/**
+ * Header of each record. Records are aligned to 8 bytes; `size` includes the header and the trailing padding.
+ */
+typedef struct st_quicly_bintrace_record_t {
+    uint32_t type;
+    uint32_t size;
+} quicly_bintrace_record_t;
+
+/**
+ * A single-producer ring of fixed-layout trace records, mapped from a file so that the records can be decoded after the process
+ * exits (or crashes) by `quicly_bintrace_decode`.
+ *
+ * Only the thread to which the ring is attached writes to the ring; therefore no locks or atomic read-modify-write operations are
+ * involved in recording an event. Once the ring becomes full, the oldest records are overwritten. `head` and `tail` increase
+ * monotonically; the offset within `data` is obtained by masking them with `capacity - 1`.
+ */
+typedef struct st_quicly_bintrace_ring_t {
+    uint64_t magic;
+    /**
+     * identifies the layout of the records (i.e. `QUICLY_BINTRACE_SCHEMA_ID` of the generated header)
+     */
+    uint64_t schema_id;
+    /**
+     * size of `data`; a power of two
+     */
+    uint64_t capacity;
+    /**
+     * end of the last record being committed; updated using release stores
+     */
+    uint64_t head;
+    /**
+     * beginning of the oldest record that has not been overwritten
+     */
+    uint64_t tail;
+    uint64_t _reserved[3];
+    uint8_t data[];
+} quicly_bintrace_ring_t;
+
+/**
+ * the ring to which the probes being fired on the calling thread are recorded, or NULL if disabled
+ */
+extern __thread quicly_bintrace_ring_t *quicly_bintrace_ring;
+
+/**
+ * returns the capacity rounded up to a power of two that is no less than QUICLY_BINTRACE_MIN_CAPACITY
+ */
+size_t quicly_bintrace_round_capacity(size_t capacity);
+/**
+ * returns the number of bytes occupied by a ring of given capacity
+ */
+static size_t quicly_bintrace_sizeof(size_t capacity);
+/**
+ * initializes (or resets) a ring on the memory being provided by the caller; `capacity` must be a value returned by
+ * `quicly_bintrace_round_capacity`
+ */
+void quicly_bintrace_init(quicly_bintrace_ring_t *ring, size_t capacity);
+/**
+ * Creates a ring of `capacity` bytes (rounded up by `quicly_bintrace_round_capacity`). If `path` is non-NULL, the ring is backed by
+ * the file, that is created or truncated. Otherwise, anonymous memory is used. Returns NULL on failure, setting errno.
+ */
+quicly_bintrace_ring_t *quicly_bintrace_create(const char *path, size_t capacity);
+/**
+ * maps a ring file being recorded by `quicly_bintrace_create` for reading; returns NULL on failure
+ */
+quicly_bintrace_ring_t *quicly_bintrace_open(const char *path);
+/**
+ * unmaps the ring being created by `quicly_bintrace_create` or `quicly_bintrace_open`
+ */
+void quicly_bintrace_destroy(quicly_bintrace_ring_t *ring);
+/**
+ * Calls `cb` for each record being retained, from the oldest to the newest, skipping the padding. Iteration stops when `cb`
+ * returns non-zero, in which case the value is returned.
+ */
+int quicly_bintrace_foreach(quicly_bintrace_ring_t *ring, int (*cb)(void *cbdata, const quicly_bintrace_record_t *rec),
+                            void *cbdata);
+/**
+ * emits the record as a line of JSON using the same format as the printf-based tracers; returns -1 if the record is malformed
+ */
+int quicly_bintrace_decode(FILE *fp, const quicly_bintrace_record_t *rec);
+/**
+ * Reserves space for a record of given type and size, returning a pointer to the record with the header being filled in. Returns
+ * NULL if the record does not fit in the ring.
+ */
+static void *quicly_bintrace_reserve(quicly_bintrace_ring_t *ring, uint32_t type, size_t size);
+/**
+ * publishes the record being reserved
+ */
+static void quicly_bintrace_commit(quicly_bintrace_ring_t *ring, void *rec);
+/**
+ * copies a string argument to a fixed-length buffer, truncating it if necessary
+ */
+static void quicly_bintrace_copy_str(char *dst, size_t dst_size, const char *src);
+/**
+ * slow path of `quicly_bintrace_reserve`, discarding the oldest records until `end` fits in the ring
+ */
+void quicly_bintrace__discard(quicly_bintrace_ring_t *ring, uint64_t end);
+
+/* inline functions */
+
+inline size_t quicly_bintrace_sizeof(size_t capacity)
+{
+    return offsetof(quicly_bintrace_ring_t, data) + capacity;
+}
+
+inline void *quicly_bintrace_reserve(quicly_bintrace_ring_t *ring, uint32_t type, size_t size)
+{
+    quicly_bintrace_record_t *rec;
+
+    size = (size + 7) & ~(size_t)7;
+    if (size > ring->capacity)
+        return NULL;
+
+    uint64_t head = ring->head, off = head & (ring->capacity - 1);
+
+    /* wrap around, filling the space at the end with a padding record */
+    if (ring->capacity - off < size) {
+        if (head + (ring->capacity - off) - ring->tail > ring->capacity)
+            quicly_bintrace__discard(ring, head + (ring->capacity - off));
+        rec = (quicly_bintrace_record_t *)(ring->data + off);
+        rec->type = QUICLY_BINTRACE_EVENT_PADDING;
+        rec->size = (uint32_t)(ring->capacity - off);
+        head += ring->capacity - off;
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+        off = 0;
+    }
+
+    if (head + size - ring->tail > ring->capacity)
+        quicly_bintrace__discard(ring, head + size);
+
+    rec = (quicly_bintrace_record_t *)(ring->data + off);
+    rec->type = type;
+    rec->size = (uint32_t)size;
+    return rec;
+}
+
+inline void quicly_bintrace_commit(quicly_bintrace_ring_t *ring, void *rec)
+{
+    __atomic_store_n(&ring->head, ring->head + ((quicly_bintrace_record_t *)rec)->size, __ATOMIC_RELEASE);
+}
+
+inline void quicly_bintrace_copy_str(char *dst, size_t dst_size, const char *src)
+{
+    size_t i = 0;
+
+    if (src != NULL) {
+        for (; i < dst_size - 1 && src[i] != '\0'; ++i)
+            dst[i] = src[i];
+    }
+    dst[i] = '\0';
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_datagram_queue_h
+#define quicly_datagram_queue_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "picotls.h"
+
+/**
+ * what to do when a datagram is queued while the queue is full
+ */
+typedef enum en_quicly_datagram_drop_policy_t {
+    /**
+     * discards the oldest datagram in the queue to make room for the new one
+     */
+    QUICLY_DATAGRAM_DROP_OLDEST,
+    /**
+     * discards the datagram being queued
+     */
+    QUICLY_DATAGRAM_DROP_NEWEST
+} quicly_datagram_drop_policy_t;
+
+typedef struct st_quicly_datagram_t quicly_datagram_t;
+
+/**
+ * Called when the queue stops referring to the payload, either because it has been sent or because it has been discarded. The
+ * payload is not copied by the queue; it is the responsibility of the owner of the payload to keep it alive until this callback is
+ * invoked (e.g., by retaining a reference count).
+ */
+typedef void (*quicly_datagram_release_cb)(quicly_datagram_t *datagram, int sent);
+
+struct st_quicly_datagram_t {
+    ptls_iovec_t payload;
+    /**
+     * time at which the datagram is discarded if not yet sent, or INT64_MAX
+     */
+    int64_t expire_at;
+    /**
+     * optional callback
+     */
+    quicly_datagram_release_cb release;
+    void *cbdata;
+};
+
+/**
+ * FIFO queue of datagrams waiting to be sent.
+ */
+typedef struct st_quicly_datagram_queue_t {
+    /**
+     * ring buffer; `entries[(first + i) & (capacity - 1)]` is the i-th datagram
+     */
+    quicly_datagram_t *entries;
+    size_t first, size, capacity;
+    /**
+     * maximum number of datagrams that can be queued
+     */
+    size_t max_size;
+    quicly_datagram_drop_policy_t drop_policy;
+    /**
+     * earliest `expire_at` of the datagrams being queued (may be earlier than the actual value)
+     */
+    int64_t next_expire_at;
+    struct {
+        uint64_t sent;
+        uint64_t dropped;
+        uint64_t expired;
+    } num_datagrams;
+} quicly_datagram_queue_t;
+
+/**
+ * initializes the queue
+ */
+void quicly_datagram_queue_init(quicly_datagram_queue_t *queue, size_t max_size, quicly_datagram_drop_policy_t drop_policy);
+/**
+ * discards all the datagrams being queued and frees the memory
+ */
+void quicly_datagram_queue_dispose(quicly_datagram_queue_t *queue);
+/**
+ * Appends a datagram. The queue assumes the ownership of the payload regardless of the outcome; if the datagram is discarded due
+ * to the drop policy or due to memory allocation failure, the release callback is invoked before this function returns. Returns 0
+ * if successful, or PTLS_ERROR_NO_MEMORY.
+ */
+int quicly_datagram_queue_push(quicly_datagram_queue_t *queue, const quicly_datagram_t *datagram);
+/**
+ * returns the oldest datagram, or NULL if the queue is empty
+ */
+static quicly_datagram_t *quicly_datagram_queue_peek(quicly_datagram_queue_t *queue);
+/**
+ * removes the oldest datagram, calling its release callback
+ */
+void quicly_datagram_queue_shift(quicly_datagram_queue_t *queue, int sent);
+/**
+ * discards the datagrams that expire at or before `now`
+ */
+static void quicly_datagram_queue_expire(quicly_datagram_queue_t *queue, int64_t now);
+/**
+ * slow path of `quicly_datagram_queue_expire`
+ */
+void quicly_datagram_queue__expire(quicly_datagram_queue_t *queue, int64_t now);
+
+/* inline functions */
+
+inline quicly_datagram_t *quicly_datagram_queue_peek(quicly_datagram_queue_t *queue)
+{
+    return queue->size != 0 ? queue->entries + queue->first : NULL;
+}
+
+inline void quicly_datagram_queue_expire(quicly_datagram_queue_t *queue, int64_t now)
+{
+    if (queue->next_expire_at <= now)
+        quicly_datagram_queue__expire(queue, now);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -48,6 +48,11 @@ void quicly_free_default_cid_encryptor(quicly_cid_encryptor_t *self);
  *
  */
 extern quicly_stream_scheduler_t quicly_default_stream_scheduler;
+/**
+ * Stream scheduler that implements the extensible prioritization scheme of RFC 9218, using the urgency and the incremental flag
+ * being set by `quicly_stream_set_priority`.
+ */
+extern quicly_stream_scheduler_t quicly_priority_stream_scheduler;
 /**
  *
  */
@@ -57,6 +62,36 @@ extern quicly_now_t quicly_default_now;
  */
 extern quicly_crypto_engine_t quicly_default_crypto_engine;
 
+/**
+ * The default ACK frequency policy. Once the connection leaves slow start, the packet tolerance is set to a fraction of CWND
+ * (counted in packets), and the max ack delay is set to a fraction of the smoothed RTT, capped by the max_ack_delay transport
+ * parameter of the peer.
+ */
+typedef struct st_quicly_default_adjust_ack_frequency_t {
+    quicly_adjust_ack_frequency_t super;
+    /**
+     * fraction of CWND used as the packet tolerance, multiplied by 1024
+     */
+    uint16_t cwnd_fraction;
+    /**
+     * fraction of the smoothed RTT used as the max ack delay, multiplied by 1024
+     */
+    uint16_t rtt_fraction;
+    /**
+     * upper bound of the packet tolerance
+     */
+    uint32_t max_packet_tolerance;
+    /**
+     * if set, the peer is asked not to send ACKs immediately upon observing out-of-order packets, while reordering is being
+     * observed (i.e. packets have been acked after being deemed lost since the previous invocation)
+     */
+    int ignore_order;
+} quicly_default_adjust_ack_frequency_t;
+/**
+ * Uses 1/8 CWND and 1/4 RTT, with the packet tolerance capped to 16.
+ */
+extern quicly_default_adjust_ack_frequency_t quicly_default_adjust_ack_frequency;
+
 #define quicly_default_cc quicly_cc_type_reno
 #define quicly_default_init_cc quicly_cc_reno_init
 
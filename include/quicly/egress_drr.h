@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_egress_drr_h
+#define quicly_egress_drr_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Deficit round robin scheduler that shares a budget of datagrams among multiple connections, to be used by servers that limit the
+ * number of datagrams being sent per iteration of the event loop. The application keeps an array of connections, each embedding a
+ * `quicly_egress_drr_entry_t`, and sends the datagrams through the callbacks. The scheduler is not thread-safe.
+ */
+typedef struct st_quicly_egress_drr_t {
+    /**
+     * number of datagrams that an entry of weight 1 earns per round; set to the maximum number of datagrams being sent at once
+     * (e.g., by one call to sendmmsg), so that the connections can fully utilize GSO
+     */
+    size_t quantum;
+    /**
+     * index of the entry from which the next invocation of `quicly_egress_drr_run` resumes
+     */
+    size_t next;
+    /**
+     * set when the previous invocation ran out of budget while the entry at `next` was sending, in which case the entry resumes
+     * sending using the credit it has already earned for the round
+     */
+    int in_round;
+} quicly_egress_drr_t;
+
+typedef struct st_quicly_egress_drr_entry_t {
+    /**
+     * share of the budget relative to other entries
+     */
+    uint32_t weight;
+    /**
+     * deficit counter, in datagrams
+     */
+    size_t deficit;
+} quicly_egress_drr_entry_t;
+
+typedef struct st_quicly_egress_drr_callbacks_t {
+    /**
+     * returns the entry at given index
+     */
+    quicly_egress_drr_entry_t *(*get_entry)(void *cbdata, size_t index);
+    /**
+     * Sends up to `*num_datagrams` datagrams of the entry at given index, updating `*num_datagrams` to the number being sent. A
+     * non-zero return value indicates that the entry has been removed (see `quicly_egress_drr_on_remove`).
+     */
+    int (*send)(void *cbdata, size_t index, size_t *num_datagrams);
+} quicly_egress_drr_callbacks_t;
+
+/**
+ * Shares `budget` datagrams among the entries. Each entry being visited earns `weight * quantum` datagrams of credit, and sends up
+ * to the credit in bursts of at most `max_burst` datagrams. An entry that sends less than requested is deemed to have nothing more
+ * to send and forfeits the remaining credit. The function returns when the budget is exhausted, or when all the entries have been
+ * visited in a row without any of them sending a datagram; the next invocation resumes from where the scan stopped. Returns the
+ * number of datagrams being sent.
+ * @param num_entries  points to the number of entries, which is updated by the application when it removes an entry
+ */
+size_t quicly_egress_drr_run(quicly_egress_drr_t *drr, const size_t *num_entries, size_t budget, size_t max_burst,
+                             const quicly_egress_drr_callbacks_t *cb, void *cbdata);
+/**
+ * Notifies the scheduler that the entry at given index has been removed from the array, and that the entries that followed have
+ * been moved down by one.
+ */
+static void quicly_egress_drr_on_remove(quicly_egress_drr_t *drr, size_t index);
+
+/* inline definitions */
+
+inline void quicly_egress_drr_on_remove(quicly_egress_drr_t *drr, size_t index)
+{
+    if (drr->next > index) {
+        --drr->next;
+    } else if (drr->next == index) {
+        drr->in_round = 0;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_freelist_h
+#define quicly_freelist_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * A list of free memory blocks being retained for reuse by a thread. Instances are to be declared as thread-local variables, and
+ * the blocks being retained are freed when the thread exits. The blocks are linked through their first bytes.
+ */
+typedef struct st_quicly_freelist_t {
+    void *head;
+    size_t count;
+    /**
+     * maximum number of blocks to be retained
+     */
+    size_t max_count;
+    /**
+     * if the list has been registered for being disposed of when the thread exits
+     */
+    int _registered;
+    /**
+     * next list registered by the same thread
+     */
+    struct st_quicly_freelist_t *_next;
+} quicly_freelist_t;
+
+#define QUICLY_FREELIST_INITIALIZER(max_count)                                                                                     \
+    {                                                                                                                              \
+        NULL, 0, (max_count)                                                                                                       \
+    }
+
+/**
+ * Takes a block from the list. Returns NULL if the list is empty.
+ */
+static void *quicly_freelist_pop(quicly_freelist_t *fl);
+/**
+ * Returns a block to the list, or frees the block if the list is full.
+ */
+void quicly_freelist_push(quicly_freelist_t *fl, void *block);
+
+/* inline definitions */
+
+inline void *quicly_freelist_pop(quicly_freelist_t *fl)
+{
+    void *block;
+
+    if ((block = fl->head) != NULL) {
+        fl->head = *(void **)block;
+        --fl->count;
+    }
+    return block;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_histogram_h
+#define quicly_histogram_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * number of bits of each power-of-two range being used for indexing the buckets; the relative error is 1/2^N (12.5%)
+ */
+#define QUICLY_HISTOGRAM_SUB_BUCKET_BITS 3
+/**
+ * values at or above 2^N are recorded in the last bucket
+ */
+#define QUICLY_HISTOGRAM_MAX_VALUE_BITS 20
+#define QUICLY_HISTOGRAM_NUM_BUCKETS                                                                                               \
+    ((QUICLY_HISTOGRAM_MAX_VALUE_BITS - QUICLY_HISTOGRAM_SUB_BUCKET_BITS + 1) << QUICLY_HISTOGRAM_SUB_BUCKET_BITS)
+
+/**
+ * Fixed-size log-linear histogram (in the spirit of HdrHistogram). Values below 2^QUICLY_HISTOGRAM_SUB_BUCKET_BITS are recorded
+ * exactly; above that, each power-of-two range is split into 2^QUICLY_HISTOGRAM_SUB_BUCKET_BITS buckets of equal width. The
+ * histogram is unit-agnostic; quicly records latencies in milliseconds, for which the covered range is about 17 minutes. Bucket
+ * counts saturate instead of wrapping around.
+ */
+typedef struct st_quicly_histogram_t {
+    /**
+     * number of values being recorded
+     */
+    uint64_t count;
+    /**
+     * sum of the values being recorded
+     */
+    uint64_t sum;
+    /**
+     * largest value being recorded
+     */
+    uint64_t max;
+    uint32_t buckets[QUICLY_HISTOGRAM_NUM_BUCKETS];
+} quicly_histogram_t;
+
+/**
+ * initializes the histogram
+ */
+static void quicly_histogram_init(quicly_histogram_t *hist);
+/**
+ * records a value
+ */
+static void quicly_histogram_record(quicly_histogram_t *hist, uint64_t value);
+/**
+ * adds the values recorded in `src` to `dst`
+ */
+void quicly_histogram_merge(quicly_histogram_t *dst, const quicly_histogram_t *src);
+/**
+ * Returns an upper bound of the value at given quantile (e.g., 0.99 for p99), or zero if nothing has been recorded. The value is
+ * never above `max`.
+ */
+uint64_t quicly_histogram_get_quantile(const quicly_histogram_t *hist, double quantile);
+/**
+ * returns the index of the bucket that covers the value
+ */
+static size_t quicly_histogram_get_bucket_index(uint64_t value);
+/**
+ * returns the largest value covered by the bucket
+ */
+uint64_t quicly_histogram_get_bucket_upper_bound(size_t index);
+
+/* inline definitions */
+
+inline void quicly_histogram_init(quicly_histogram_t *hist)
+{
+    *hist = (quicly_histogram_t){0};
+}
+
+inline size_t quicly_histogram_get_bucket_index(uint64_t value)
+{
+    if (value < (1 << QUICLY_HISTOGRAM_SUB_BUCKET_BITS))
+        return (size_t)value;
+    if (value >= (uint64_t)1 << QUICLY_HISTOGRAM_MAX_VALUE_BITS)
+        return QUICLY_HISTOGRAM_NUM_BUCKETS - 1;
+
+    unsigned msb = 63 - __builtin_clzll(value);
+    unsigned shift = msb - QUICLY_HISTOGRAM_SUB_BUCKET_BITS;
+    return ((size_t)(shift + 1) << QUICLY_HISTOGRAM_SUB_BUCKET_BITS) +
+           (size_t)((value >> shift) & ((1 << QUICLY_HISTOGRAM_SUB_BUCKET_BITS) - 1));
+}
+
+inline void quicly_histogram_record(quicly_histogram_t *hist, uint64_t value)
+{
+    uint32_t *bucket = hist->buckets + quicly_histogram_get_bucket_index(value);
+
+    ++hist->count;
+    hist->sum += value;
+    if (hist->max < value)
+        hist->max = value;
+    if (*bucket != UINT32_MAX)
+        ++*bucket;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_initial_guard_h
+#define quicly_initial_guard_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include "picotls.h"
+
+#ifndef QUICLY_INITIAL_GUARD_SKETCH_WIDTH
+/**
+ * number of counters in each row of the count-min sketch; must be a power of two
+ */
+#define QUICLY_INITIAL_GUARD_SKETCH_WIDTH 1024
+#endif
+
+#ifndef QUICLY_INITIAL_GUARD_SKETCH_DEPTH
+/**
+ * number of rows (i.e. independent hash functions) of the count-min sketch
+ */
+#define QUICLY_INITIAL_GUARD_SKETCH_DEPTH 4
+#endif
+
+/**
+ * Load-adaptive protection against floods of Initial packets, to be used by servers on the accept path (i.e. when receiving an
+ * Initial packet that does not belong to any existing connection). The guard is not thread-safe; each thread running an event
+ * loop is expected to have its own instance.
+ *
+ * The guard enters "DoS mode" when the number of half-open connections (connections that have been accepted but for which the
+ * handshake has not been confirmed) reaches `config.half_open_threshold`. The number is supplied by the application through
+ * `num_half_open`. While in DoS mode:
+ * - `quicly_initial_guard_require_retry` returns true, so that clients that have not proven the ownership of their addresses are
+ *   sent a stateless Retry instead of being allocated a connection.
+ * - `quicly_initial_guard_admit` rejects Initials from the source address prefixes that have sent more than
+ *   `config.max_initials_per_prefix` Initials within the last `config.decay_interval` milliseconds. The rate is tracked using a
+ *   count-min sketch that is halved every `config.decay_interval`, so that the memory footprint and the cost per packet stay
+ *   constant regardless of the number of sources. Initials carrying a valid address token are neither counted nor rejected, as
+ *   spoofed floods would otherwise crowd out the clients that have proven the ownership of their addresses.
+ */
+typedef struct st_quicly_initial_guard_t {
+    struct {
+        /**
+         * number of half-open connections at which DoS mode is entered; SIZE_MAX to disable
+         */
+        size_t half_open_threshold;
+        /**
+         * maximum number of Initials to be accepted from one source prefix within `decay_interval` while in DoS mode
+         */
+        uint32_t max_initials_per_prefix;
+        /**
+         * interval (in milliseconds) at which the counters of the sketch are halved
+         */
+        int64_t decay_interval;
+        /**
+         * length of the source address prefixes being tracked, in bits
+         */
+        uint8_t ipv4_prefix_len, ipv6_prefix_len;
+    } config;
+    /**
+     * number of half-open connections; to be updated by the application
+     */
+    size_t num_half_open;
+    struct {
+        uint32_t counters[QUICLY_INITIAL_GUARD_SKETCH_DEPTH][QUICLY_INITIAL_GUARD_SKETCH_WIDTH];
+        uint64_t seeds[QUICLY_INITIAL_GUARD_SKETCH_DEPTH];
+        int64_t decay_at;
+    } sketch;
+    /**
+     * AEAD context used for generating the integrity tag of Retry packets, along with the protocol version for which the context
+     * was created
+     */
+    struct {
+        uint32_t version;
+        ptls_aead_context_t *aead;
+    } retry_aead;
+    struct {
+        /**
+         * number of Initials that have been admitted / dropped by `quicly_initial_guard_admit`
+         */
+        uint64_t num_admitted, num_dropped;
+        /**
+         * number of times `quicly_initial_guard_require_retry` returned true
+         */
+        uint64_t num_retry_required;
+    } stats;
+} quicly_initial_guard_t;
+
+/**
+ * Initializes the guard with the default configuration; applications can modify `config` after calling this function.
+ * @param random_bytes  used for generating the seeds of the hash functions, so that remote peers cannot aim at specific counters
+ */
+void quicly_initial_guard_init(quicly_initial_guard_t *guard, void (*random_bytes)(void *, size_t), int64_t now);
+/**
+ *
+ */
+void quicly_initial_guard_dispose(quicly_initial_guard_t *guard);
+/**
+ * Accounts an Initial packet received from `remote`, returning a boolean indicating if the packet should be processed. The function
+ * is designed to be called after validating the address token (which is cheap) but before doing anything expensive (e.g., creating
+ * a connection).
+ * @param address_validated  if the packet carried an address token that has been validated; such packets are always admitted
+ */
+int quicly_initial_guard_admit(quicly_initial_guard_t *guard, int64_t now, struct sockaddr *remote, int address_validated);
+/**
+ * Returns the estimated number of Initials received from the prefix of given address within the last decay interval.
+ */
+uint32_t quicly_initial_guard_estimate(quicly_initial_guard_t *guard, struct sockaddr *remote);
+/**
+ * Returns a boolean indicating if the guard is in DoS mode.
+ */
+static int quicly_initial_guard_is_active(quicly_initial_guard_t *guard);
+/**
+ * Returns a boolean indicating if a Retry should be sent to a client that has not provided a valid address token.
+ */
+int quicly_initial_guard_require_retry(quicly_initial_guard_t *guard);
+/**
+ * Returns the cache to be passed to `quicly_send_retry` as `retry_aead_cache`. The cached AEAD context is discarded if it has been
+ * created for a different protocol version.
+ */
+ptls_aead_context_t **quicly_initial_guard_get_retry_aead_cache(quicly_initial_guard_t *guard, uint32_t protocol_version);
+
+/* inline definitions */
+
+inline int quicly_initial_guard_is_active(quicly_initial_guard_t *guard)
+{
+    return guard->num_half_open >= guard->config.half_open_threshold;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_memory_budget_h
+#define quicly_memory_budget_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * default value of `quicly_memory_budget_t::throttle_threshold`
+ */
+#define QUICLY_MEMORY_BUDGET_DEFAULT_THROTTLE_THRESHOLD 768
+
+/**
+ * Memory accountant shared by all the connections using the same context (see `quicly_context_t::memory_budget`).
+ *
+ * Connections charge the bytes held in stream receive buffers (i.e. bytes received but not yet consumed by the application) and
+ * the sentmap, and `quicly_sendbuf_t` charges the bytes it buffers. As the usage approaches `limit`, the increments of MAX_DATA
+ * and MAX_STREAM_DATA being advertised shrink, until they stop at the limit. The usage is updated atomically, so that one budget
+ * can be shared among threads.
+ */
+typedef struct st_quicly_memory_budget_t {
+    /**
+     * the budget in bytes
+     */
+    size_t limit;
+    /**
+     * usage (in permil (1/1024) of `limit`) above which the receive windows are throttled
+     */
+    uint32_t throttle_threshold;
+    /**
+     * bytes being charged
+     */
+    size_t used;
+} quicly_memory_budget_t;
+
+/**
+ * initializes the budget
+ */
+static void quicly_memory_budget_init(quicly_memory_budget_t *budget, size_t limit);
+/**
+ *
+ */
+static void quicly_memory_budget_charge(quicly_memory_budget_t *budget, size_t bytes);
+/**
+ *
+ */
+static void quicly_memory_budget_release(quicly_memory_budget_t *budget, size_t bytes);
+/**
+ * returns the number of bytes being charged
+ */
+static size_t quicly_memory_budget_get_used(quicly_memory_budget_t *budget);
+/**
+ * Returns the memory pressure in permil (1/1024); zero while the usage is at or below the throttle threshold, rising linearly to
+ * 1024 as the usage reaches the limit. Applications can use the value for deciding to, for example, stop accepting new
+ * connections.
+ */
+static uint32_t quicly_memory_budget_get_pressure(quicly_memory_budget_t *budget);
+/**
+ * returns the size of the window scaled down by the memory pressure
+ */
+static uint64_t quicly_memory_budget_throttle(quicly_memory_budget_t *budget, uint64_t window);
+
+/* inline definitions */
+
+inline void quicly_memory_budget_init(quicly_memory_budget_t *budget, size_t limit)
+{
+    *budget = (quicly_memory_budget_t){.limit = limit, .throttle_threshold = QUICLY_MEMORY_BUDGET_DEFAULT_THROTTLE_THRESHOLD};
+}
+
+inline void quicly_memory_budget_charge(quicly_memory_budget_t *budget, size_t bytes)
+{
+    __atomic_add_fetch(&budget->used, bytes, __ATOMIC_RELAXED);
+}
+
+inline void quicly_memory_budget_release(quicly_memory_budget_t *budget, size_t bytes)
+{
+    __atomic_sub_fetch(&budget->used, bytes, __ATOMIC_RELAXED);
+}
+
+inline size_t quicly_memory_budget_get_used(quicly_memory_budget_t *budget)
+{
+    return __atomic_load_n(&budget->used, __ATOMIC_RELAXED);
+}
+
+inline uint32_t quicly_memory_budget_get_pressure(quicly_memory_budget_t *budget)
+{
+    size_t used = quicly_memory_budget_get_used(budget), threshold = (uint64_t)budget->limit * budget->throttle_threshold / 1024;
+
+    if (used <= threshold)
+        return 0;
+    if (used >= budget->limit)
+        return 1024;
+    return (uint32_t)((uint64_t)(used - threshold) * 1024 / (budget->limit - threshold));
+}
+
+inline uint64_t quicly_memory_budget_throttle(quicly_memory_budget_t *budget, uint64_t window)
+{
+    uint32_t scale = 1024 - quicly_memory_budget_get_pressure(budget);
+
+    /* split the multiplication so that it does not overflow */
+    return window / 1024 * scale + window % 1024 * scale / 1024;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
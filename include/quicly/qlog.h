@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_qlog_h
+#define quicly_qlog_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "picotls.h"
+#include "quicly/bintrace.h"
+
+#define QUICLY_QLOG_CATEGORY_CONNECTIVITY 0x1
+#define QUICLY_QLOG_CATEGORY_TRANSPORT 0x2
+#define QUICLY_QLOG_CATEGORY_RECOVERY 0x4
+#define QUICLY_QLOG_CATEGORY_ALL 0x7
+
+#ifndef QUICLY_QLOG_DEFAULT_BATCH_SIZE
+#define QUICLY_QLOG_DEFAULT_BATCH_SIZE 16384
+#endif
+
+/**
+ * Writes qlog events of the sampled connections to a file descriptor, using the JSON text sequence format (RFC 7464) of qlog
+ * (see `quicly_context_t::qlog`). Requires the library to be built with QUICLY_USE_BINTRACE.
+ *
+ * The events are obtained from the binary trace records of each connection, and are serialized into a per-connection buffer that
+ * is written by a single call to write(2) each time it grows beyond `batch_size`, as well as when the connection is freed. When
+ * the file descriptor is shared by multiple threads, it should be opened with O_APPEND so that the batches do not overwrite each
+ * other.
+ */
+typedef struct st_quicly_qlog_t {
+    /**
+     * file descriptor to which the events are written
+     */
+    int fd;
+    /**
+     * bit-or of QUICLY_QLOG_CATEGORY_* being logged
+     */
+    unsigned categories;
+    /**
+     * one out of every `sampling_rate` connections is logged; zero or one logs every connection
+     */
+    uint32_t sampling_rate;
+    /**
+     * size of the per-connection buffer that triggers a write
+     */
+    size_t batch_size;
+} quicly_qlog_t;
+
+/**
+ * per-connection state of the qlog writer
+ */
+typedef struct st_quicly_qlog_conn_t {
+    quicly_qlog_t *qlog;
+    /**
+     * ring into which the probes are recorded, before being serialized by `quicly_qlog_conn_emit`
+     */
+    quicly_bintrace_ring_t *ring;
+    /**
+     * original destination CID in hex, used as the `group_id` of the events
+     */
+    char group_id[QUICLY_BINTRACE_MAX_STRLEN];
+    /**
+     * serialized events waiting to be written
+     */
+    ptls_buffer_t buf;
+    /**
+     * the packet being built or decoded; frames and other events are buffered until the packet event is complete
+     */
+    struct {
+        enum { QUICLY_QLOG_PACKET_NONE, QUICLY_QLOG_PACKET_SENDING, QUICLY_QLOG_PACKET_RECEIVING } state;
+        int64_t at;
+        uint64_t pn;
+        uint64_t len;
+        uint8_t packet_type;
+        /**
+         * if an ACK frame is being decoded (i.e., ack blocks are being appended to `frames`)
+         */
+        uint8_t in_ack;
+        /**
+         * comma-separated list of frames
+         */
+        ptls_buffer_t frames;
+        /**
+         * events being recorded while the packet is open
+         */
+        ptls_buffer_t deferred;
+    } packet;
+    /**
+     * set when memory allocation fails, after which no more events are logged
+     */
+    unsigned is_broken : 1;
+} quicly_qlog_conn_t;
+
+/**
+ * initializes the writer, with all the categories being enabled and every connection being sampled
+ */
+void quicly_qlog_init(quicly_qlog_t *qlog, int fd);
+/**
+ * parses a comma-separated list of categories (i.e. "connectivity", "transport", "recovery", or "all"); returns 0 if successful
+ */
+int quicly_qlog_parse_categories(const char *list, unsigned *categories);
+/**
+ * Writes the header of the qlog file; `vantage_point` is either "client" or "server". Returns 0 if successful, or -1 with errno
+ * being set.
+ */
+int quicly_qlog_write_header(quicly_qlog_t *qlog, const char *title, const char *vantage_point);
+/**
+ * Returns a new per-connection state, or NULL if the connection is not being sampled (or if memory allocation failed). `random` is
+ * a random number used for sampling. `odcid` is the original destination CID of the connection.
+ */
+quicly_qlog_conn_t *quicly_qlog_conn_create(quicly_qlog_t *qlog, uint32_t random, ptls_iovec_t odcid);
+/**
+ * writes the buffered events and frees the per-connection state
+ */
+void quicly_qlog_conn_destroy(quicly_qlog_conn_t *q);
+/**
+ * serializes the records that have been added to `q->ring`, writing them if the buffer has grown beyond the batch size
+ */
+void quicly_qlog_conn_emit(quicly_qlog_conn_t *q);
+/**
+ * writes the buffered events; the packet being open, if any, is written when the packet is complete
+ */
+void quicly_qlog_conn_flush(quicly_qlog_conn_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -160,6 +160,9 @@ struct st_quicly_sent_t {
         struct {
             uint64_t sequence;
         } retire_connection_id;
+        struct {
+            uint64_t sequence;
+        } ack_frequency;
     } data;
 };
 
@@ -218,6 +221,10 @@ struct st_quicly_sentmap_t {
      * bytes in-flight
      */
     size_t bytes_in_flight;
+    /**
+     * number of blocks being allocated
+     */
+    size_t num_blocks;
     /**
      * is non-NULL between prepare and commit, pointing to the packet header that is being written to
      */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_signer_pool_h
+#define quicly_signer_pool_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "picotls.h"
+
+/**
+ * A pool of worker threads that generates the CertificateVerify signatures off the event loop.
+ *
+ * The pool wraps a synchronous `ptls_sign_certificate_t` (e.g., `ptls_openssl_sign_certificate_t`). When the signer returned by
+ * `quicly_signer_pool_get_sign_certificate` is invoked by picotls, the signing job is queued and `PTLS_ERROR_ASYNC_OPERATION` is
+ * returned. quicly then calls `quicly_context_t::async_handshake`, from which the application is expected to obtain the job by
+ * calling `ptls_get_async_job` and to register a completion callback using `ptls_async_job_t::set_completion_callback`. The
+ * completion callback is invoked on a worker thread (or on the calling thread, if the job has already been completed), at which
+ * point the application should arrange `quicly_resume_handshake` to be called on the thread that owns the connection.
+ *
+ * The wrapped signer is invoked from the worker threads with `async` set to NULL; it must not modify the state of the `ptls_t`
+ * object being supplied.
+ */
+typedef struct st_quicly_signer_pool_t quicly_signer_pool_t;
+
+/**
+ * Counters and gauges of a signer pool.
+ */
+typedef struct st_quicly_signer_pool_stats_t {
+    /**
+     * number of jobs waiting for a worker thread to pick them up
+     */
+    size_t num_queued;
+    /**
+     * maximum value that `num_queued` has reached
+     */
+    size_t max_queued;
+    /**
+     * number of jobs being processed by the worker threads
+     */
+    size_t num_running;
+    /**
+     * total number of jobs that have been submitted / completed
+     */
+    uint64_t num_submitted, num_completed;
+    /**
+     * cumulative time spent by the jobs waiting in the queue, in microseconds
+     */
+    uint64_t total_queue_time_usec;
+} quicly_signer_pool_stats_t;
+
+/**
+ * Creates a signer pool that runs `num_threads` worker threads calling `signer`.
+ */
+quicly_signer_pool_t *quicly_signer_pool_create(ptls_sign_certificate_t *signer, size_t num_threads);
+/**
+ * Stops the worker threads and destroys the pool. The jobs that have already been queued are processed before the threads are
+ * stopped.
+ */
+void quicly_signer_pool_destroy(quicly_signer_pool_t *pool);
+/**
+ * Returns the signer to be set to `ptls_context_t::sign_certificate`.
+ */
+ptls_sign_certificate_t *quicly_signer_pool_get_sign_certificate(quicly_signer_pool_t *pool);
+/**
+ * Obtains the current statistics of the pool. The function does not acquire any lock, and therefore can be called from signal
+ * handlers. The values are read one by one and might be slightly inconsistent with each other.
+ */
+void quicly_signer_pool_get_stats(quicly_signer_pool_t *pool, quicly_signer_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
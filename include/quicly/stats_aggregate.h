@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_stats_aggregate_h
+#define quicly_stats_aggregate_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "quicly.h"
+
+/**
+ * Context-wide aggregate of the per-connection counters (see `quicly_context_t::stats_aggregate`).
+ *
+ * Each connection folds in its counters and latency histograms (if `quicly_context_t::collect_latency_stats` is set) when being
+ * freed. The counters are accumulated in per-thread shards, each of them being updated only by the owning thread, so that updating
+ * them does not require atomic read-modify-write operations. Snapshots are obtained by merging the shards, and therefore can be
+ * taken from any thread.
+ */
+typedef struct st_quicly_stats_aggregate_t quicly_stats_aggregate_t;
+
+/**
+ * The counters being aggregated. All the fields are of type uint64_t.
+ */
+typedef struct st_quicly_aggregated_stats_t {
+    QUICLY_STATS_PREBUILT_COUNTERS;
+    struct {
+        /**
+         * number of connections being created
+         */
+        uint64_t opened;
+        /**
+         * number of connections being freed
+         */
+        uint64_t closed;
+        /**
+         * number of connections closed due to an error; i.e., a CONNECTION_CLOSE frame carrying an error code other than NO_ERROR
+         * being sent or received, or a stateless reset being received
+         */
+        uint64_t errored;
+    } num_conns;
+} quicly_aggregated_stats_t;
+
+/**
+ * Applies `apply(field, name)` to each counter of `quicly_aggregated_stats_t`, `name` being a string literal suitable for naming
+ * the counter when exporting the stats.
+ */
+#define QUICLY_AGGREGATED_STATS_FOREACH(apply)                                                                                     \
+    apply(num_packets.received, "packets_received")                                                                                \
+    apply(num_packets.decryption_failed, "packets_decryption_failed")                                                              \
+    apply(num_packets.sent, "packets_sent")                                                                                        \
+    apply(num_packets.lost, "packets_lost")                                                                                        \
+    apply(num_packets.lost_time_threshold, "packets_lost_time_threshold")                                                          \
+    apply(num_packets.ack_received, "packets_ack_received")                                                                        \
+    apply(num_packets.late_acked, "packets_late_acked")                                                                            \
+    apply(num_packets.initial_handshake_sent, "packets_initial_handshake_sent")                                                    \
+    apply(num_packets.received_out_of_order, "packets_received_out_of_order")                                                      \
+    apply(num_bytes.received, "bytes_received")                                                                                    \
+    apply(num_bytes.sent, "bytes_sent")                                                                                            \
+    apply(num_bytes.lost, "bytes_lost")                                                                                            \
+    apply(num_bytes.ack_received, "bytes_ack_received")                                                                            \
+    apply(num_bytes.stream_data_sent, "bytes_stream_data_sent")                                                                    \
+    apply(num_bytes.stream_data_resent, "bytes_stream_data_resent")                                                                \
+    apply(num_frames_sent.padding, "frames_sent_padding")                                                                          \
+    apply(num_frames_sent.ping, "frames_sent_ping")                                                                                \
+    apply(num_frames_sent.ack, "frames_sent_ack")                                                                                  \
+    apply(num_frames_sent.reset_stream, "frames_sent_reset_stream")                                                                \
+    apply(num_frames_sent.stop_sending, "frames_sent_stop_sending")                                                                \
+    apply(num_frames_sent.crypto, "frames_sent_crypto")                                                                            \
+    apply(num_frames_sent.new_token, "frames_sent_new_token")                                                                      \
+    apply(num_frames_sent.stream, "frames_sent_stream")                                                                            \
+    apply(num_frames_sent.max_data, "frames_sent_max_data")                                                                        \
+    apply(num_frames_sent.max_stream_data, "frames_sent_max_stream_data")                                                          \
+    apply(num_frames_sent.max_streams_bidi, "frames_sent_max_streams_bidi")                                                        \
+    apply(num_frames_sent.max_streams_uni, "frames_sent_max_streams_uni")                                                          \
+    apply(num_frames_sent.data_blocked, "frames_sent_data_blocked")                                                                \
+    apply(num_frames_sent.stream_data_blocked, "frames_sent_stream_data_blocked")                                                  \
+    apply(num_frames_sent.streams_blocked, "frames_sent_streams_blocked")                                                          \
+    apply(num_frames_sent.new_connection_id, "frames_sent_new_connection_id")                                                      \
+    apply(num_frames_sent.retire_connection_id, "frames_sent_retire_connection_id")                                                \
+    apply(num_frames_sent.path_challenge, "frames_sent_path_challenge")                                                            \
+    apply(num_frames_sent.path_response, "frames_sent_path_response")                                                              \
+    apply(num_frames_sent.transport_close, "frames_sent_transport_close")                                                          \
+    apply(num_frames_sent.application_close, "frames_sent_application_close")                                                      \
+    apply(num_frames_sent.handshake_done, "frames_sent_handshake_done")                                                            \
+    apply(num_frames_sent.datagram, "frames_sent_datagram")                                                                        \
+    apply(num_frames_sent.ack_frequency, "frames_sent_ack_frequency")                                                              \
+    apply(num_frames_received.padding, "frames_received_padding")                                                                  \
+    apply(num_frames_received.ping, "frames_received_ping")                                                                        \
+    apply(num_frames_received.ack, "frames_received_ack")                                                                          \
+    apply(num_frames_received.reset_stream, "frames_received_reset_stream")                                                        \
+    apply(num_frames_received.stop_sending, "frames_received_stop_sending")                                                        \
+    apply(num_frames_received.crypto, "frames_received_crypto")                                                                    \
+    apply(num_frames_received.new_token, "frames_received_new_token")                                                              \
+    apply(num_frames_received.stream, "frames_received_stream")                                                                    \
+    apply(num_frames_received.max_data, "frames_received_max_data")                                                                \
+    apply(num_frames_received.max_stream_data, "frames_received_max_stream_data")                                                  \
+    apply(num_frames_received.max_streams_bidi, "frames_received_max_streams_bidi")                                                \
+    apply(num_frames_received.max_streams_uni, "frames_received_max_streams_uni")                                                  \
+    apply(num_frames_received.data_blocked, "frames_received_data_blocked")                                                        \
+    apply(num_frames_received.stream_data_blocked, "frames_received_stream_data_blocked")                                          \
+    apply(num_frames_received.streams_blocked, "frames_received_streams_blocked")                                                  \
+    apply(num_frames_received.new_connection_id, "frames_received_new_connection_id")                                              \
+    apply(num_frames_received.retire_connection_id, "frames_received_retire_connection_id")                                        \
+    apply(num_frames_received.path_challenge, "frames_received_path_challenge")                                                    \
+    apply(num_frames_received.path_response, "frames_received_path_response")                                                      \
+    apply(num_frames_received.transport_close, "frames_received_transport_close")                                                  \
+    apply(num_frames_received.application_close, "frames_received_application_close")                                              \
+    apply(num_frames_received.handshake_done, "frames_received_handshake_done")                                                    \
+    apply(num_frames_received.datagram, "frames_received_datagram")                                                                \
+    apply(num_frames_received.ack_frequency, "frames_received_ack_frequency")                                                      \
+    apply(num_ptos, "ptos")                                                                                                        \
+    apply(num_handshake_timeouts, "handshake_timeouts")                                                                            \
+    apply(num_initial_handshake_exceeded, "initial_handshake_exceeded")                                                            \
+    apply(num_conns.opened, "conns_opened")                                                                                        \
+    apply(num_conns.closed, "conns_closed")                                                                                        \
+    apply(num_conns.errored, "conns_errored")
+
+/**
+ * creates an aggregate
+ */
+quicly_stats_aggregate_t *quicly_stats_aggregate_create(void);
+/**
+ * destroys the aggregate; the context referring to the aggregate must not be used by any thread
+ */
+void quicly_stats_aggregate_destroy(quicly_stats_aggregate_t *aggregate);
+/**
+ * Adds the given counters to the shard of the calling thread. The function is called by quicly when connections are created or
+ * freed, but applications can also call the function for accounting their own connection-like objects.
+ */
+void quicly_stats_aggregate_add(quicly_stats_aggregate_t *aggregate, const quicly_aggregated_stats_t *delta);
+/**
+ * merges the shards into `stats`
+ */
+void quicly_stats_aggregate_snapshot(quicly_stats_aggregate_t *aggregate, quicly_aggregated_stats_t *stats);
+/**
+ * merges the latency histograms into the shard of the calling thread
+ */
+void quicly_stats_aggregate_add_latency(quicly_stats_aggregate_t *aggregate, const quicly_latency_stats_t *latency);
+/**
+ * merges the latency histograms of the shards into `latency`
+ */
+void quicly_stats_aggregate_snapshot_latency(quicly_stats_aggregate_t *aggregate, quicly_latency_stats_t *latency);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -59,16 +59,59 @@ struct st_quicly_sendbuf_vec_t {
     void *cbdata;
 };
 
+#ifndef QUICLY_SENDBUF_CHUNK_SIZE
+/**
+ * maximum size of the chunks into which `quicly_sendbuf_write` coalesces the data being written
+ */
+#define QUICLY_SENDBUF_CHUNK_SIZE 16384
+#endif
+
+#ifndef QUICLY_SENDBUF_MIN_CHUNK_SIZE
+/**
+ * size of the first chunk being allocated by `quicly_sendbuf_write`; the size doubles for each new chunk up to
+ * `QUICLY_SENDBUF_CHUNK_SIZE`
+ */
+#define QUICLY_SENDBUF_MIN_CHUNK_SIZE 256
+#endif
+
+/**
+ * An entry of `quicly_sendbuf_t::vecs`.
+ */
+struct st_quicly_sendbuf_entry_t {
+    quicly_sendbuf_vec_t vec;
+    /**
+     * offset of the vector within the stream
+     */
+    uint64_t off;
+};
+
 /**
  * A simple stream-level send buffer that can be used to store data to be sent.
+ *
+ * The vectors are stored in a ring, each entry being accompanied by the offset of the vector within the stream. Popping the vectors
+ * that have been acknowledged is O(1) per vector. Emitting data at the send frontier is also O(1), as the position where the
+ * previous emission ended is remembered as a cursor. Emitting data at other offsets (i.e. retransmission) uses binary search.
  */
 typedef struct st_quicly_sendbuf_t {
     struct {
-        quicly_sendbuf_vec_t *entries;
-        size_t size, capacity;
+        /**
+         * ring buffer of vectors; `entries[(first + i) % capacity]` is the i-th vector
+         */
+        struct st_quicly_sendbuf_entry_t *entries;
+        size_t first, size, capacity;
     } vecs;
     size_t off_in_first_vec;
     uint64_t bytes_written;
+    /**
+     * index of the vector (relative to `vecs.first`) from which the next call to `quicly_sendbuf_emit` is likely to start
+     */
+    size_t emit_cursor;
+    /**
+     * the memory budget being charged for the bytes buffered (i.e. written but not yet shifted out), or NULL; only the bytes copied
+     * into the chunks owned by the send buffer are charged, as the vectors provided by the application (e.g. those backed by files)
+     * might not be resident in memory
+     */
+    quicly_memory_budget_t *memory_budget;
 } quicly_sendbuf_t;
 
 /**
@@ -89,28 +132,99 @@ void quicly_sendbuf_shift(quicly_stream_t *stream, quicly_sendbuf_t *sb, size_t
  */
 void quicly_sendbuf_emit(quicly_stream_t *stream, quicly_sendbuf_t *sb, size_t off, void *dst, size_t *len, int *wrote_all);
 /**
- * Appends some bytes to the send buffer.  The data being appended is copied.
+ * Appends some bytes to the send buffer.  The data being appended is copied.  Consecutive writes are coalesced into chunks of up to
+ * `QUICLY_SENDBUF_CHUNK_SIZE` bytes, each of which is freed when the vector holding it is shifted out.
  */
 int quicly_sendbuf_write(quicly_stream_t *stream, quicly_sendbuf_t *sb, const void *src, size_t len);
 /**
- * Appends a vector to the send buffer.  Members of the `quicly_sendbuf_vec_t` are copied.
+ * Appends a vector to the send buffer.  Members of the `quicly_sendbuf_vec_t` are copied. The bytes referred to by the vector are
+ * not charged to the memory budget, as their storage is managed by the application.
  */
 int quicly_sendbuf_write_vec(quicly_stream_t *stream, quicly_sendbuf_t *sb, quicly_sendbuf_vec_t *vec);
 
+#ifndef QUICLY_RECVBUF_CHUNK_SIZE
+/**
+ * size of the chunks that constitute `quicly_recvbuf_t`
+ */
+#define QUICLY_RECVBUF_CHUNK_SIZE 16384
+#endif
+
+#ifndef QUICLY_RECVBUF_POOL_SIZE
+/**
+ * maximum number of free chunks being retained by each thread for reuse; they are freed when the thread exits
+ */
+#define QUICLY_RECVBUF_POOL_SIZE 64
+#endif
+
+/**
+ * A simple stream-level receive buffer.
+ *
+ * The buffer is a ring of fixed-sized chunks, each chunk being allocated when data is written to the region it covers. Therefore,
+ * data can be placed at any offset without moving or copying the bytes that have already been received, and popping the bytes at
+ * the front is merely the matter of advancing the read position (and returning the chunks that become empty to the per-thread
+ * pool). All the chunks are returned to the pool when the buffer becomes empty. Only `quicly_recvbuf_get` copies the data, and only
+ * when the bytes being requested span multiple chunks.
+ */
+typedef struct st_quicly_recvbuf_t {
+    /**
+     * ring of the chunks; `entries[(first + i) % capacity]` holds the i-th chunk (or NULL if no data has been written there)
+     */
+    struct {
+        uint8_t **entries;
+        size_t first, size, capacity;
+    } chunks;
+    /**
+     * offset of the first byte (i.e. the byte to be popped next) within the first chunk
+     */
+    size_t off_in_first_chunk;
+    /**
+     * end of the data being written, relative to the first byte
+     */
+    size_t off;
+    /**
+     * contiguous copy of the data spanning multiple chunks, built by `quicly_recvbuf_get`; freed when the buffer becomes empty
+     */
+    struct {
+        uint8_t *base;
+        size_t capacity;
+    } linear;
+} quicly_recvbuf_t;
+
+/**
+ * Initializes the receive buffer.
+ */
+static void quicly_recvbuf_init(quicly_recvbuf_t *rb);
+/**
+ * Disposes of the receive buffer.
+ */
+void quicly_recvbuf_dispose(quicly_recvbuf_t *rb);
+/**
+ * Pops the specified amount of bytes at the beginning of the simple stream-level receive buffer.
+ */
+void quicly_recvbuf_shift(quicly_stream_t *stream, quicly_recvbuf_t *rb, size_t delta);
+/**
+ * Returns an iovec that refers to all the contiguous data available at the beginning of the receive buffer.  Applications are
+ * expected to call `quicly_recvbuf_get` to first peek at the received data, process the bytes they can, then call
+ * `quicly_recvbuf_shift` to pop the bytes that have been processed. When the data spans multiple chunks, it is copied into a
+ * contiguous buffer that remains valid until the receive buffer is modified. Upon failing to allocate that buffer, the stream is
+ * closed and an empty iovec is returned.
+ */
+ptls_iovec_t quicly_recvbuf_get(quicly_stream_t *stream, quicly_recvbuf_t *rb);
 /**
- * Pops the specified amount of bytes at the beginning of the simple stream-level receive buffer (which in fact is `ptls_buffer_t`).
+ * Returns an iovec that refers to the data available at the beginning of the receive buffer, up to the end of the first chunk.
+ * Unlike `quicly_recvbuf_get`, the data is never copied. Applications that can process the input incrementally should repeat
+ * peeking and shifting until the returned iovec becomes empty.
  */
-void quicly_recvbuf_shift(quicly_stream_t *stream, ptls_buffer_t *rb, size_t delta);
+ptls_iovec_t quicly_recvbuf_get_chunk(quicly_stream_t *stream, quicly_recvbuf_t *rb);
 /**
- * Returns an iovec that refers to the data available in the receive buffer.  Applications are expected to call `quicly_recvbuf_get`
- * to first peek at the received data, process the bytes they can, then call `quicly_recvbuf_shift` to pop the bytes that have been
- * processed.
+ * Fills `vecs` with up to `max_vecs` iovecs referring to the data available in the receive buffer, and returns the number of iovecs
+ * being filled.
  */
-ptls_iovec_t quicly_recvbuf_get(quicly_stream_t *stream, ptls_buffer_t *rb);
+size_t quicly_recvbuf_get_vecs(quicly_stream_t *stream, quicly_recvbuf_t *rb, ptls_iovec_t *vecs, size_t max_vecs);
 /**
  * The concrete function for `quicly_stream_callbacks_t::on_receive`.
  */
-int quicly_recvbuf_receive(quicly_stream_t *stream, ptls_buffer_t *rb, size_t off, const void *src, size_t len);
+int quicly_recvbuf_receive(quicly_stream_t *stream, quicly_recvbuf_t *rb, size_t off, const void *src, size_t len);
 
 /**
  * The simple stream buffer.  The API assumes that stream->data points to quicly_streambuf_t.  Applications can extend the structure
@@ -118,7 +232,7 @@ int quicly_recvbuf_receive(quicly_stream_t *stream, ptls_buffer_t *rb, size_t of
  */
 typedef struct st_quicly_streambuf_t {
     quicly_sendbuf_t egress;
-    ptls_buffer_t ingress;
+    quicly_recvbuf_t ingress;
 } quicly_streambuf_t;
 
 int quicly_streambuf_create(quicly_stream_t *stream, size_t sz);
@@ -130,6 +244,8 @@ static int quicly_streambuf_egress_write_vec(quicly_stream_t *stream, quicly_sen
 int quicly_streambuf_egress_shutdown(quicly_stream_t *stream);
 static void quicly_streambuf_ingress_shift(quicly_stream_t *stream, size_t delta);
 static ptls_iovec_t quicly_streambuf_ingress_get(quicly_stream_t *stream);
+static ptls_iovec_t quicly_streambuf_ingress_get_chunk(quicly_stream_t *stream);
+static size_t quicly_streambuf_ingress_get_vecs(quicly_stream_t *stream, ptls_iovec_t *vecs, size_t max_vecs);
 /**
  * Writes given data into `quicly_stream_buf_t::ingress` and returns 0 if successful. Upon failure, `quicly_close` is called
  * automatically, and a non-zero value is returned. Applications can ignore the returned value, or use it to find out if it can use
@@ -144,6 +260,11 @@ inline void quicly_sendbuf_init(quicly_sendbuf_t *sb)
     memset(sb, 0, sizeof(*sb));
 }
 
+inline void quicly_recvbuf_init(quicly_recvbuf_t *rb)
+{
+    memset(rb, 0, sizeof(*rb));
+}
+
 inline void quicly_streambuf_egress_shift(quicly_stream_t *stream, size_t delta)
 {
     quicly_streambuf_t *sbuf = (quicly_streambuf_t *)stream->data;
@@ -174,6 +295,18 @@ inline ptls_iovec_t quicly_streambuf_ingress_get(quicly_stream_t *stream)
     return quicly_recvbuf_get(stream, &sbuf->ingress);
 }
 
+inline ptls_iovec_t quicly_streambuf_ingress_get_chunk(quicly_stream_t *stream)
+{
+    quicly_streambuf_t *sbuf = (quicly_streambuf_t *)stream->data;
+    return quicly_recvbuf_get_chunk(stream, &sbuf->ingress);
+}
+
+inline size_t quicly_streambuf_ingress_get_vecs(quicly_stream_t *stream, ptls_iovec_t *vecs, size_t max_vecs)
+{
+    quicly_streambuf_t *sbuf = (quicly_streambuf_t *)stream->data;
+    return quicly_recvbuf_get_vecs(stream, &sbuf->ingress, vecs, max_vecs);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <assert.h>
+#include "quicly/ack_queue.h"
+
+/**
+ * Finds the next run of set bits at or above bit `*pos`. Returns if found, setting the run to [start, end) and advancing `*pos` to
+ * the end of the run.
+ */
+static int bitmap_next_run(quicly_ack_queue_t *queue, size_t *pos, uint64_t *start, uint64_t *end)
+{
+    size_t i = *pos;
+
+    /* find the first bit being set */
+    while (1) {
+        if (i >= QUICLY_ACK_QUEUE_BITMAP_BITS)
+            return 0;
+        uint64_t bits = queue->bitmap.words[i / 64] >> (i % 64);
+        if (bits != 0) {
+            i += __builtin_ctzll(bits);
+            break;
+        }
+        i = (i / 64 + 1) * 64;
+    }
+    *start = queue->bitmap.base + i;
+
+    /* find the first bit being cleared */
+    while (i < QUICLY_ACK_QUEUE_BITMAP_BITS) {
+        uint64_t bits = ~queue->bitmap.words[i / 64] >> (i % 64);
+        if (bits != 0) {
+            i += __builtin_ctzll(bits);
+            break;
+        }
+        i = (i / 64 + 1) * 64;
+    }
+    *end = queue->bitmap.base + i;
+
+    *pos = i;
+    return 1;
+}
+
+static int bitmap_is_empty(quicly_ack_queue_t *queue)
+{
+    size_t i;
+
+    for (i = 0; i != QUICLY_ACK_QUEUE_BITMAP_WORDS; ++i)
+        if (queue->bitmap.words[i] != 0)
+            return 0;
+    return 1;
+}
+
+/**
+ * returns if the lowest range of the bitmap is adjacent to the highest of `ranges`, in which case the two form one range
+ */
+static int bitmap_is_adjacent(quicly_ack_queue_t *queue)
+{
+    return queue->ranges.num_ranges != 0 && queue->ranges.ranges[queue->ranges.num_ranges - 1].end == queue->bitmap.base &&
+           (queue->bitmap.words[0] & 1) != 0;
+}
+
+static int append_range(quicly_ranges_t *ranges, uint64_t start, uint64_t end)
+{
+    if (ranges->num_ranges != 0 && ranges->ranges[ranges->num_ranges - 1].end == start) {
+        ranges->ranges[ranges->num_ranges - 1].end = end;
+        return 0;
+    }
+    return quicly_ranges_add(ranges, start, end);
+}
+
+/**
+ * slides the bitmap forward so that it starts at `new_base`, moving the bits that fall off to `ranges`
+ */
+static int slide(quicly_ack_queue_t *queue, uint64_t new_base)
+{
+    int ret;
+
+    assert(new_base % 64 == 0);
+
+    while (queue->bitmap.base < new_base) {
+        if (bitmap_is_empty(queue)) {
+            queue->bitmap.base = new_base;
+            break;
+        }
+        /* move the runs of the lowest word to `ranges`, then shift the bitmap by one word */
+        size_t pos = 0;
+        uint64_t start, end;
+        while (pos < 64 && bitmap_next_run(queue, &pos, &start, &end)) {
+            if (start >= queue->bitmap.base + 64)
+                break;
+            if (end > queue->bitmap.base + 64)
+                end = queue->bitmap.base + 64;
+            if ((ret = append_range(&queue->ranges, start, end)) != 0)
+                return ret;
+        }
+        memmove(queue->bitmap.words, queue->bitmap.words + 1, sizeof(queue->bitmap.words[0]) * (QUICLY_ACK_QUEUE_BITMAP_WORDS - 1));
+        queue->bitmap.words[QUICLY_ACK_QUEUE_BITMAP_WORDS - 1] = 0;
+        queue->bitmap.base += 64;
+    }
+
+    return 0;
+}
+
+static void update_end(quicly_ack_queue_t *queue)
+{
+    size_t i;
+
+    for (i = QUICLY_ACK_QUEUE_BITMAP_WORDS; i != 0; --i) {
+        uint64_t bits = queue->bitmap.words[i - 1];
+        if (bits != 0) {
+            queue->end = queue->bitmap.base + (i - 1) * 64 + 64 - __builtin_clzll(bits);
+            return;
+        }
+    }
+
+    queue->end = queue->ranges.num_ranges != 0 ? queue->ranges.ranges[queue->ranges.num_ranges - 1].end : 0;
+}
+
+int quicly_ack_queue__add_slow(quicly_ack_queue_t *queue, uint64_t pn)
+{
+    int ret;
+
+    if (pn < queue->bitmap.base) {
+        /* reordered beyond the width of the bitmap */
+        if ((ret = quicly_ranges_add(&queue->ranges, pn, pn + 1)) != 0)
+            return ret;
+        if (queue->end <= pn)
+            queue->end = pn + 1;
+        return 0;
+    }
+
+    /* slide to the smallest base that covers pn */
+    if ((ret = slide(queue, ((pn - QUICLY_ACK_QUEUE_BITMAP_BITS) & ~(uint64_t)63) + 64)) != 0)
+        return ret;
+
+    return quicly_ack_queue_add(queue, pn);
+}
+
+int quicly_ack_queue_subtract(quicly_ack_queue_t *queue, uint64_t start, uint64_t end)
+{
+    uint64_t bitmap_end = queue->bitmap.base + QUICLY_ACK_QUEUE_BITMAP_BITS;
+    int ret;
+
+    assert(start <= end);
+
+    /* the part below the bitmap */
+    if (start < queue->bitmap.base) {
+        if ((ret = quicly_ranges_subtract(&queue->ranges, start, end < queue->bitmap.base ? end : queue->bitmap.base)) != 0)
+            return ret;
+        start = queue->bitmap.base;
+    }
+
+    /* the part within the bitmap, cleared word by word */
+    if (end > bitmap_end)
+        end = bitmap_end;
+    while (start < end) {
+        uint64_t off = start - queue->bitmap.base, word_end = (off / 64 + 1) * 64 + queue->bitmap.base,
+                 stop = end < word_end ? end : word_end;
+        uint64_t mask = stop - start == 64 ? UINT64_MAX : (((uint64_t)1 << (stop - start)) - 1) << (off % 64);
+        queue->bitmap.words[off / 64] &= ~mask;
+        start = stop;
+    }
+
+    update_end(queue);
+    return 0;
+}
+
+size_t quicly_ack_queue_num_ranges(quicly_ack_queue_t *queue)
+{
+    size_t num_ranges = queue->ranges.num_ranges, pos = 0;
+    uint64_t start, end;
+
+    while (bitmap_next_run(queue, &pos, &start, &end))
+        ++num_ranges;
+    if (bitmap_is_adjacent(queue))
+        --num_ranges;
+
+    return num_ranges;
+}
+
+void quicly_ack_queue_shrink(quicly_ack_queue_t *queue, size_t max_ranges)
+{
+    size_t num_ranges;
+
+    assert(max_ranges != 0);
+
+    while ((num_ranges = quicly_ack_queue_num_ranges(queue)) > max_ranges) {
+        size_t num_drop = num_ranges - max_ranges;
+        if (queue->ranges.num_ranges != 0) {
+            if (num_drop > queue->ranges.num_ranges)
+                num_drop = queue->ranges.num_ranges;
+            quicly_ranges_drop_by_range_indices(&queue->ranges, 0, num_drop);
+        } else {
+            /* clear the lowest run of the bitmap */
+            size_t pos = 0;
+            uint64_t start, end;
+            int found = bitmap_next_run(queue, &pos, &start, &end);
+            assert(found);
+            (void)found;
+            quicly_ack_queue_subtract(queue, start, end); /* never fails, as `ranges` is empty */
+        }
+    }
+}
+
+size_t quicly_ack_queue_get_ranges(quicly_ack_queue_t *queue, quicly_range_t *ranges, size_t capacity)
+{
+    size_t num_ranges = quicly_ack_queue_num_ranges(queue), num_skip = 0, i, pos = 0;
+    int adjacent = bitmap_is_adjacent(queue);
+    uint64_t start, end;
+
+    if (num_ranges > capacity) {
+        num_skip = num_ranges - capacity;
+        num_ranges = capacity;
+    }
+
+    /* copy the ranges below the bitmap, except for the one being adjacent */
+    for (i = 0; i < queue->ranges.num_ranges - adjacent; ++i) {
+        if (num_skip != 0) {
+            --num_skip;
+            continue;
+        }
+        *ranges++ = queue->ranges.ranges[i];
+    }
+
+    /* append the ranges of the bitmap */
+    while (bitmap_next_run(queue, &pos, &start, &end)) {
+        if (adjacent) {
+            start = queue->ranges.ranges[queue->ranges.num_ranges - 1].start;
+            adjacent = 0;
+        }
+        if (num_skip != 0) {
+            --num_skip;
+            continue;
+        }
+        *ranges++ = (quicly_range_t){start, end};
+    }
+
+    return num_ranges;
+}
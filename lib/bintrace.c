@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define QUICLY_BINTRACE_DECODER 1
+#include "quicly-bintrace.h"
+
+__thread quicly_bintrace_ring_t *quicly_bintrace_ring = NULL;
+
+size_t quicly_bintrace_round_capacity(size_t capacity)
+{
+    size_t rounded = QUICLY_BINTRACE_MIN_CAPACITY;
+
+    while (rounded < capacity)
+        rounded *= 2;
+    return rounded;
+}
+
+void quicly_bintrace_init(quicly_bintrace_ring_t *ring, size_t capacity)
+{
+    *ring = (quicly_bintrace_ring_t){.magic = QUICLY_BINTRACE_MAGIC, .schema_id = QUICLY_BINTRACE_SCHEMA_ID, .capacity = capacity};
+}
+
+quicly_bintrace_ring_t *quicly_bintrace_create(const char *path, size_t capacity)
+{
+    quicly_bintrace_ring_t *ring;
+    size_t mapped_size;
+    int fd = -1, saved_errno;
+
+    capacity = quicly_bintrace_round_capacity(capacity);
+    mapped_size = quicly_bintrace_sizeof(capacity);
+
+    if (path != NULL) {
+        if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1)
+            goto Error;
+        if (ftruncate(fd, mapped_size) != 0)
+            goto Error;
+        if ((ring = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+            goto Error;
+        close(fd);
+    } else {
+        if ((ring = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+            goto Error;
+    }
+
+    quicly_bintrace_init(ring, capacity);
+
+    return ring;
+
+Error:
+    saved_errno = errno;
+    if (fd != -1)
+        close(fd);
+    errno = saved_errno;
+    return NULL;
+}
+
+quicly_bintrace_ring_t *quicly_bintrace_open(const char *path)
+{
+    quicly_bintrace_ring_t *ring = MAP_FAILED;
+    struct stat st;
+    int fd, saved_errno;
+
+    if ((fd = open(path, O_RDONLY)) == -1)
+        return NULL;
+    if (fstat(fd, &st) != 0)
+        goto Error;
+    if (st.st_size < (off_t)quicly_bintrace_sizeof(QUICLY_BINTRACE_MIN_CAPACITY)) {
+        errno = EINVAL;
+        goto Error;
+    }
+    if ((ring = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        goto Error;
+    if (ring->magic != QUICLY_BINTRACE_MAGIC || ring->capacity != quicly_bintrace_round_capacity(ring->capacity) ||
+        quicly_bintrace_sizeof(ring->capacity) != (size_t)st.st_size) {
+        errno = EINVAL;
+        goto Error;
+    }
+    if (ring->schema_id != QUICLY_BINTRACE_SCHEMA_ID) {
+        errno = EPROTO;
+        goto Error;
+    }
+    close(fd);
+
+    return ring;
+
+Error:
+    saved_errno = errno;
+    if (ring != MAP_FAILED)
+        munmap(ring, st.st_size);
+    close(fd);
+    errno = saved_errno;
+    return NULL;
+}
+
+void quicly_bintrace_destroy(quicly_bintrace_ring_t *ring)
+{
+    munmap(ring, quicly_bintrace_sizeof(ring->capacity));
+}
+
+void quicly_bintrace__discard(quicly_bintrace_ring_t *ring, uint64_t end)
+{
+    uint64_t tail = ring->tail;
+
+    while (end - tail > ring->capacity)
+        tail += ((quicly_bintrace_record_t *)(ring->data + (tail & (ring->capacity - 1))))->size;
+
+    /* Publish the new tail before the caller overwrites the discarded records; the release fence orders the store to `tail` before
+     * the stores that follow. Readers load `tail` only once before walking the ring and do not re-check it; therefore, a reader
+     * running concurrently with the writer (e.g., bintrace-decode opening a live ring) might see the records being overwritten,
+     * which `quicly_bintrace_foreach` detects only when the record headers become inconsistent. */
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+int quicly_bintrace_foreach(quicly_bintrace_ring_t *ring, int (*cb)(void *cbdata, const quicly_bintrace_record_t *rec),
+                            void *cbdata)
+{
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    int ret;
+
+    if (head - pos > ring->capacity)
+        return -1;
+
+    while (pos != head) {
+        uint64_t off = pos & (ring->capacity - 1);
+        const quicly_bintrace_record_t *rec = (const quicly_bintrace_record_t *)(ring->data + off);
+        if (rec->size < sizeof(*rec) || rec->size % 8 != 0 || rec->size > head - pos || rec->size > ring->capacity - off)
+            return -1;
+        if (rec->type != QUICLY_BINTRACE_EVENT_PADDING && (ret = cb(cbdata, rec)) != 0)
+            return ret;
+        pos += rec->size;
+    }
+
+    return 0;
+}
+
+int quicly_bintrace_decode(FILE *fp, const quicly_bintrace_record_t *rec)
+{
+    return quicly_bintrace__decode(fp, rec);
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include "quicly/datagram_queue.h"
+
+static quicly_datagram_t *get_entry(quicly_datagram_queue_t *queue, size_t index)
+{
+    assert(index < queue->size);
+    return queue->entries + ((queue->first + index) & (queue->capacity - 1));
+}
+
+static void release_datagram(quicly_datagram_t *datagram, int sent)
+{
+    if (datagram->release != NULL)
+        datagram->release(datagram, sent);
+}
+
+static int reserve_entries(quicly_datagram_queue_t *queue)
+{
+    quicly_datagram_t *new_entries;
+    size_t new_capacity = queue->capacity == 0 ? 4 : queue->capacity * 2, i;
+
+    if (queue->size < queue->capacity)
+        return 0;
+
+    if ((new_entries = malloc(new_capacity * sizeof(*new_entries))) == NULL)
+        return PTLS_ERROR_NO_MEMORY;
+    for (i = 0; i != queue->size; ++i)
+        new_entries[i] = *get_entry(queue, i);
+    free(queue->entries);
+    queue->entries = new_entries;
+    queue->first = 0;
+    queue->capacity = new_capacity;
+
+    return 0;
+}
+
+void quicly_datagram_queue_init(quicly_datagram_queue_t *queue, size_t max_size, quicly_datagram_drop_policy_t drop_policy)
+{
+    assert(max_size != 0);
+
+    *queue = (quicly_datagram_queue_t){.max_size = max_size, .drop_policy = drop_policy, .next_expire_at = INT64_MAX};
+}
+
+void quicly_datagram_queue_dispose(quicly_datagram_queue_t *queue)
+{
+    while (queue->size != 0) {
+        ++queue->num_datagrams.dropped;
+        quicly_datagram_queue_shift(queue, 0);
+    }
+    free(queue->entries);
+    queue->entries = NULL;
+    queue->capacity = 0;
+}
+
+int quicly_datagram_queue_push(quicly_datagram_queue_t *queue, const quicly_datagram_t *datagram)
+{
+    quicly_datagram_t copy = *datagram;
+    int ret;
+
+    /* apply the drop policy if full */
+    if (queue->size >= queue->max_size) {
+        ++queue->num_datagrams.dropped;
+        switch (queue->drop_policy) {
+        case QUICLY_DATAGRAM_DROP_OLDEST:
+            quicly_datagram_queue_shift(queue, 0);
+            break;
+        case QUICLY_DATAGRAM_DROP_NEWEST:
+            release_datagram(&copy, 0);
+            return 0;
+        }
+    }
+
+    if ((ret = reserve_entries(queue)) != 0) {
+        ++queue->num_datagrams.dropped;
+        release_datagram(&copy, 0);
+        return ret;
+    }
+    ++queue->size;
+    *get_entry(queue, queue->size - 1) = copy;
+    if (copy.expire_at < queue->next_expire_at)
+        queue->next_expire_at = copy.expire_at;
+
+    return 0;
+}
+
+void quicly_datagram_queue_shift(quicly_datagram_queue_t *queue, int sent)
+{
+    quicly_datagram_t datagram = *get_entry(queue, 0);
+
+    queue->first = (queue->first + 1) & (queue->capacity - 1);
+    if (--queue->size == 0)
+        queue->next_expire_at = INT64_MAX;
+    if (sent)
+        ++queue->num_datagrams.sent;
+    release_datagram(&datagram, sent);
+}
+
+void quicly_datagram_queue__expire(quicly_datagram_queue_t *queue, int64_t now)
+{
+    size_t src, dst = 0, size = queue->size;
+
+    /* compact the ring, releasing the datagrams that have expired */
+    queue->next_expire_at = INT64_MAX;
+    for (src = 0; src != size; ++src) {
+        quicly_datagram_t *datagram = get_entry(queue, src);
+        if (datagram->expire_at <= now) {
+            ++queue->num_datagrams.expired;
+            release_datagram(datagram, 0);
+        } else {
+            if (datagram->expire_at < queue->next_expire_at)
+                queue->next_expire_at = datagram->expire_at;
+            *get_entry(queue, dst++) = *datagram;
+        }
+    }
+    queue->size = dst;
+}
@@ -30,6 +30,7 @@
 #define DEFAULT_PRE_VALIDATION_AMPLIFICATION_LIMIT 3
 #define DEFAULT_HANDSHAKE_TIMEOUT_RTT_MULTIPLIER 400
 #define DEFAULT_MAX_INITIAL_HANDSHAKE_PACKETS 1000
+#define DEFAULT_MAX_QUEUED_DATAGRAM_FRAMES 64
 
 /* profile that employs IETF specified values */
 const quicly_context_t quicly_spec_context = {NULL,                                                 /* tls */
@@ -59,7 +60,17 @@ const quicly_context_t quicly_spec_context = {NULL,
                                               NULL,
                                               NULL,
                                               &quicly_default_crypto_engine,
-                                              &quicly_default_init_cc};
+                                              &quicly_default_init_cc,
+                                              NULL, /* update_open_count */
+                                              NULL, /* async_handshake */
+                                              NULL, /* adjust_ack_frequency */
+                                              {DEFAULT_MAX_QUEUED_DATAGRAM_FRAMES, QUICLY_DATAGRAM_DROP_OLDEST},
+                                              {0, 0}, /* max_receive_window */
+                                              NULL, /* memory_budget */
+                                              NULL, /* stats_aggregate */
+                                              0,    /* collect_latency_stats */
+                                              NULL, /* flight_recorder */
+                                              NULL /* qlog */};
 
 /* profile with a focus on reducing latency for the HTTP use case */
 const quicly_context_t quicly_performant_context = {NULL,                                                 /* tls */
@@ -89,7 +100,17 @@ const quicly_context_t quicly_performant_context = {NULL,
                                                     NULL,
                                                     NULL,
                                                     &quicly_default_crypto_engine,
-                                                    &quicly_default_init_cc};
+                                                    &quicly_default_init_cc,
+                                                    NULL, /* update_open_count */
+                                                    NULL, /* async_handshake */
+                                                    NULL, /* adjust_ack_frequency */
+                                                    {DEFAULT_MAX_QUEUED_DATAGRAM_FRAMES, QUICLY_DATAGRAM_DROP_OLDEST},
+                                                    {0, 0}, /* max_receive_window */
+                                                    NULL, /* memory_budget */
+                                                    NULL, /* stats_aggregate */
+                                                    0,    /* collect_latency_stats */
+                                                    NULL, /* flight_recorder */
+                                                    NULL /* qlog */};
 
 /**
  * The context of the default CID encryptor.  All the contexts being used here are ECB ciphers and therefore stateless - they can be
@@ -352,6 +373,125 @@ static int default_stream_scheduler_update_state(quicly_stream_scheduler_t *self
 quicly_stream_scheduler_t quicly_default_stream_scheduler = {default_stream_scheduler_can_send, default_stream_scheduler_do_send,
                                                              default_stream_scheduler_update_state};
 
+static void priority_link_stream(struct st_quicly_priority_scheduler_state_t *sched, quicly_stream_t *stream, int conn_is_blocked,
+                                 int at_head)
+{
+    quicly_linklist_t *link = &stream->_send_aux.pending_link.default_scheduler, *slot;
+
+    if (quicly_linklist_is_linked(link))
+        return;
+
+    if (conn_is_blocked && !quicly_stream_can_send(stream, 0)) {
+        quicly_linklist_insert(sched->blocked.prev, link);
+    } else {
+        slot = &sched->active[stream->priority.urgency][stream->priority.incremental];
+        quicly_linklist_insert(at_head ? slot : slot->prev, link);
+        sched->active_urgencies |= 1 << stream->priority.urgency;
+    }
+}
+
+/**
+ * moves all the streams in the blocked list to the active lists
+ */
+static void priority_unblock_streams(struct st_quicly_priority_scheduler_state_t *sched)
+{
+    while (quicly_linklist_is_linked(&sched->blocked)) {
+        quicly_stream_t *stream =
+            (void *)((char *)sched->blocked.next - offsetof(quicly_stream_t, _send_aux.pending_link.default_scheduler));
+        quicly_linklist_unlink(&stream->_send_aux.pending_link.default_scheduler);
+        priority_link_stream(sched, stream, 0, 0);
+    }
+}
+
+/**
+ * returns the active stream to be served next, or NULL if there is none
+ */
+static quicly_stream_t *priority_first_stream(struct st_quicly_priority_scheduler_state_t *sched)
+{
+    while (sched->active_urgencies != 0) {
+        unsigned urgency = __builtin_ctz(sched->active_urgencies), incremental;
+        for (incremental = 0; incremental != 2; ++incremental) {
+            quicly_linklist_t *slot = &sched->active[urgency][incremental];
+            if (quicly_linklist_is_linked(slot))
+                return (void *)((char *)slot->next - offsetof(quicly_stream_t, _send_aux.pending_link.default_scheduler));
+        }
+        sched->active_urgencies &= ~(1 << urgency);
+    }
+    return NULL;
+}
+
+/**
+ * See doc-comment of `st_quicly_priority_scheduler_state_t` to understand the logic.
+ */
+static int priority_stream_scheduler_can_send(quicly_stream_scheduler_t *self, quicly_conn_t *conn, int conn_is_saturated)
+{
+    struct st_quicly_priority_scheduler_state_t *sched = &((struct _st_quicly_conn_public_t *)conn)->_priority_scheduler;
+
+    /* like the default scheduler, streams are lazily moved to the blocked list by `do_send` */
+    if (!conn_is_saturated)
+        priority_unblock_streams(sched);
+
+    return priority_first_stream(sched) != NULL;
+}
+
+/**
+ * See doc-comment of `st_quicly_priority_scheduler_state_t` to understand the logic.
+ */
+static int priority_stream_scheduler_do_send(quicly_stream_scheduler_t *self, quicly_conn_t *conn, quicly_send_context_t *s)
+{
+    struct st_quicly_priority_scheduler_state_t *sched = &((struct _st_quicly_conn_public_t *)conn)->_priority_scheduler;
+    quicly_stream_t *stream;
+    int conn_is_blocked = quicly_is_blocked(conn), ret = 0;
+
+    if (!conn_is_blocked)
+        priority_unblock_streams(sched);
+
+    while (quicly_can_send_data(conn, s) && (stream = priority_first_stream(sched)) != NULL) {
+        quicly_linklist_unlink(&stream->_send_aux.pending_link.default_scheduler);
+        /* relink the stream to the blocked list if necessary */
+        if (conn_is_blocked && !quicly_stream_can_send(stream, 0)) {
+            quicly_linklist_insert(sched->blocked.prev, &stream->_send_aux.pending_link.default_scheduler);
+            continue;
+        }
+        /* send! */
+        if ((ret = quicly_send_stream(stream, s)) != 0) {
+            if (ret == QUICLY_ERROR_SENDBUF_FULL) {
+                assert(quicly_stream_can_send(stream, 1));
+                priority_link_stream(sched, stream, conn_is_blocked, !stream->priority.incremental);
+            }
+            break;
+        }
+        /* reschedule; non-incremental streams retain their position, while incremental streams move to the tail */
+        conn_is_blocked = quicly_is_blocked(conn);
+        if (quicly_stream_can_send(stream, 1))
+            priority_link_stream(sched, stream, conn_is_blocked, !stream->priority.incremental);
+    }
+
+    return ret;
+}
+
+/**
+ * See doc-comment of `st_quicly_priority_scheduler_state_t` to understand the logic.
+ */
+static int priority_stream_scheduler_update_state(quicly_stream_scheduler_t *self, quicly_stream_t *stream)
+{
+    struct st_quicly_priority_scheduler_state_t *sched = &((struct _st_quicly_conn_public_t *)stream->conn)->_priority_scheduler;
+
+    if (quicly_stream_can_send(stream, 1)) {
+        /* activate if not */
+        priority_link_stream(sched, stream, quicly_is_blocked(stream->conn), 0);
+    } else {
+        /* deactivate if active */
+        if (quicly_linklist_is_linked(&stream->_send_aux.pending_link.default_scheduler))
+            quicly_linklist_unlink(&stream->_send_aux.pending_link.default_scheduler);
+    }
+
+    return 0;
+}
+
+quicly_stream_scheduler_t quicly_priority_stream_scheduler = {priority_stream_scheduler_can_send, priority_stream_scheduler_do_send,
+                                                              priority_stream_scheduler_update_state};
+
 quicly_stream_t *quicly_default_alloc_stream(quicly_context_t *ctx)
 {
     return malloc(sizeof(quicly_stream_t));
@@ -439,3 +579,34 @@ static void default_finalize_send_packet(quicly_crypto_engine_t *engine, quicly_
 }
 
 quicly_crypto_engine_t quicly_default_crypto_engine = {default_setup_cipher, default_finalize_send_packet};
+
+static int default_adjust_ack_frequency(quicly_adjust_ack_frequency_t *_self, quicly_conn_t *conn,
+                                        const quicly_ack_frequency_input_t *input, quicly_ack_frequency_params_t *params)
+{
+    quicly_default_adjust_ack_frequency_t *self = (void *)_self;
+    uint32_t packet_tolerance = QUICLY_DEFAULT_PACKET_TOLERANCE;
+    uint64_t max_ack_delay;
+
+    /* During slow start, ACKs clock the growth of CWND; therefore, stick to the default until leaving slow start. */
+    if (input->cc->cwnd >= input->cc->ssthresh) {
+        uint64_t cwnd_packets = input->cc->cwnd / input->max_udp_payload_size;
+        uint64_t v = cwnd_packets * self->cwnd_fraction / 1024;
+        if (v > self->max_packet_tolerance)
+            v = self->max_packet_tolerance;
+        if (v > packet_tolerance)
+            packet_tolerance = (uint32_t)v;
+    }
+
+    /* a fraction of RTT, but not exceeding max_ack_delay of the peer, as that is the value used for calculating PTO */
+    max_ack_delay = (uint64_t)input->rtt->smoothed * 1000 * self->rtt_fraction / 1024;
+    if (max_ack_delay > (uint64_t)input->max_ack_delay * 1000)
+        max_ack_delay = (uint64_t)input->max_ack_delay * 1000;
+
+    params->packet_tolerance = packet_tolerance;
+    params->max_ack_delay = max_ack_delay;
+    params->ignore_order = self->ignore_order && input->num_late_acked != 0;
+
+    return 1;
+}
+
+quicly_default_adjust_ack_frequency_t quicly_default_adjust_ack_frequency = {{default_adjust_ack_frequency}, 128, 256, 16, 0};
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "quicly/egress_drr.h"
+
+size_t quicly_egress_drr_run(quicly_egress_drr_t *drr, const size_t *num_entries, size_t budget, size_t max_burst,
+                             const quicly_egress_drr_callbacks_t *cb, void *cbdata)
+{
+    size_t num_sent = 0, num_idle = 0;
+
+    /* Visits that do not send anything are counted, rather than visits of entries lacking credit, as the application might be
+     * unable to send even though it has something to send (e.g., a timer has fired but the CC is blocking). */
+    while (num_sent < budget && num_idle < *num_entries) {
+        if (drr->next >= *num_entries) {
+            drr->next = 0;
+            drr->in_round = 0;
+        }
+        quicly_egress_drr_entry_t *entry = cb->get_entry(cbdata, drr->next);
+        size_t num_sent_by_entry = 0;
+        int drained = 0;
+        if (!drr->in_round)
+            entry->deficit += (size_t)entry->weight * drr->quantum;
+        drr->in_round = 0;
+        while (entry->deficit != 0 && num_sent < budget) {
+            size_t num_datagrams = entry->deficit, requested;
+            if (num_datagrams > budget - num_sent)
+                num_datagrams = budget - num_sent;
+            if (num_datagrams > max_burst)
+                num_datagrams = max_burst;
+            requested = num_datagrams;
+            if (cb->send(cbdata, drr->next, &num_datagrams) != 0) {
+                entry = NULL;
+                break;
+            }
+            entry->deficit -= num_datagrams;
+            num_sent_by_entry += num_datagrams;
+            num_sent += num_datagrams;
+            if (num_datagrams < requested) {
+                drained = 1;
+                break;
+            }
+        }
+        if (entry == NULL)
+            continue; /* `next` now refers to the entry that followed the one being removed */
+        if (drained) {
+            entry->deficit = 0;
+        } else if (entry->deficit != 0) {
+            /* ran out of budget; resume from this entry */
+            drr->in_round = 1;
+            break;
+        }
+        if (num_sent_by_entry != 0) {
+            num_idle = 0;
+        } else {
+            ++num_idle;
+        }
+        ++drr->next;
+    }
+
+    return num_sent;
+}
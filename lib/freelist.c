@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include "quicly/freelist.h"
+
+/**
+ * the value associated to the key is the list of the freelists registered by the thread; the destructor is invoked only when the
+ * value is non-NULL, i.e. only by the threads that have retained blocks
+ */
+static pthread_key_t freelists_key;
+static pthread_once_t freelists_key_once = PTHREAD_ONCE_INIT;
+
+static void dispose_freelists(void *_fl)
+{
+    quicly_freelist_t *fl = _fl;
+
+    while (fl != NULL) {
+        quicly_freelist_t *next = fl->_next;
+        void *block;
+        while ((block = quicly_freelist_pop(fl)) != NULL)
+            free(block);
+        fl->_registered = 0;
+        fl->_next = NULL;
+        fl = next;
+    }
+}
+
+static void init_freelists_key(void)
+{
+    pthread_key_create(&freelists_key, dispose_freelists);
+}
+
+void quicly_freelist_push(quicly_freelist_t *fl, void *block)
+{
+    if (fl->count >= fl->max_count) {
+        free(block);
+        return;
+    }
+
+    if (!fl->_registered) {
+        pthread_once(&freelists_key_once, init_freelists_key);
+        fl->_next = pthread_getspecific(freelists_key);
+        pthread_setspecific(freelists_key, fl);
+        fl->_registered = 1;
+    }
+
+    *(void **)block = fl->head;
+    fl->head = block;
+    ++fl->count;
+}
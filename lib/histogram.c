@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "quicly/histogram.h"
+
+uint64_t quicly_histogram_get_bucket_upper_bound(size_t index)
+{
+    if (index < (1 << QUICLY_HISTOGRAM_SUB_BUCKET_BITS))
+        return index;
+    if (index >= QUICLY_HISTOGRAM_NUM_BUCKETS - 1)
+        return UINT64_MAX;
+
+    unsigned shift = (unsigned)(index >> QUICLY_HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    uint64_t mantissa = (index & ((1 << QUICLY_HISTOGRAM_SUB_BUCKET_BITS) - 1)) | (1 << QUICLY_HISTOGRAM_SUB_BUCKET_BITS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void quicly_histogram_merge(quicly_histogram_t *dst, const quicly_histogram_t *src)
+{
+    size_t i;
+
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (dst->max < src->max)
+        dst->max = src->max;
+    for (i = 0; i != QUICLY_HISTOGRAM_NUM_BUCKETS; ++i) {
+        uint32_t sum = dst->buckets[i] + src->buckets[i];
+        dst->buckets[i] = sum >= dst->buckets[i] ? sum : UINT32_MAX;
+    }
+}
+
+uint64_t quicly_histogram_get_quantile(const quicly_histogram_t *hist, double quantile)
+{
+    uint64_t total = 0, seen = 0, rank;
+    size_t i;
+
+    for (i = 0; i != QUICLY_HISTOGRAM_NUM_BUCKETS; ++i)
+        total += hist->buckets[i];
+    if (total == 0)
+        return 0;
+
+    /* the rank of the value being looked for (i.e. ceil(quantile * total)), starting from 1 */
+    if (quantile >= 1) {
+        rank = total;
+    } else if (quantile <= 0) {
+        rank = 1;
+    } else {
+        double r = quantile * total;
+        if ((rank = (uint64_t)r) < r)
+            ++rank;
+        if (rank == 0)
+            rank = 1;
+    }
+
+    for (i = 0; i != QUICLY_HISTOGRAM_NUM_BUCKETS; ++i) {
+        if ((seen += hist->buckets[i]) >= rank) {
+            uint64_t bound = quicly_histogram_get_bucket_upper_bound(i);
+            return bound < hist->max ? bound : hist->max;
+        }
+    }
+    return hist->max; /* unreachable */
+}
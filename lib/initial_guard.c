@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <assert.h>
+#include <netinet/in.h>
+#include <string.h>
+#include "quicly/initial_guard.h"
+
+#define DEFAULT_HALF_OPEN_THRESHOLD 1024
+#define DEFAULT_MAX_INITIALS_PER_PREFIX 64
+#define DEFAULT_DECAY_INTERVAL 1000
+#define DEFAULT_IPV4_PREFIX_LEN 24
+#define DEFAULT_IPV6_PREFIX_LEN 48
+
+/**
+ * address prefix in a form that can be fed to the hash function
+ */
+struct st_prefix_t {
+    uint64_t words[2];
+    uint64_t family;
+};
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t mask_word(uint64_t word, unsigned bits)
+{
+    if (bits >= 64)
+        return word;
+    if (bits == 0)
+        return 0;
+    return word & ~(UINT64_MAX >> bits);
+}
+
+static uint64_t load_be64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    size_t i;
+    for (i = 0; i != 8; ++i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static void get_ipv4_prefix(quicly_initial_guard_t *guard, const uint8_t *bytes, struct st_prefix_t *prefix)
+{
+    uint64_t word = (uint64_t)bytes[0] << 56 | (uint64_t)bytes[1] << 48 | (uint64_t)bytes[2] << 40 | (uint64_t)bytes[3] << 32;
+
+    prefix->family = AF_INET;
+    prefix->words[0] = mask_word(word, guard->config.ipv4_prefix_len < 32 ? guard->config.ipv4_prefix_len : 32);
+}
+
+static void get_prefix(quicly_initial_guard_t *guard, struct sockaddr *sa, struct st_prefix_t *prefix)
+{
+    static const uint8_t v4mapped_prefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+
+    *prefix = (struct st_prefix_t){{0}};
+
+    switch (sa->sa_family) {
+    case AF_INET:
+        get_ipv4_prefix(guard, (const uint8_t *)&((struct sockaddr_in *)sa)->sin_addr, prefix);
+        break;
+    case AF_INET6: {
+        const uint8_t *bytes = ((struct sockaddr_in6 *)sa)->sin6_addr.s6_addr;
+        unsigned bits = guard->config.ipv6_prefix_len;
+        if (memcmp(bytes, v4mapped_prefix, sizeof(v4mapped_prefix)) == 0) {
+            /* IPv4-mapped address (dual stack socket) */
+            get_ipv4_prefix(guard, bytes + sizeof(v4mapped_prefix), prefix);
+        } else {
+            prefix->family = AF_INET6;
+            prefix->words[0] = mask_word(load_be64(bytes), bits);
+            prefix->words[1] = mask_word(load_be64(bytes + 8), bits > 64 ? bits - 64 : 0);
+        }
+    } break;
+    default:
+        prefix->family = sa->sa_family;
+        break;
+    }
+}
+
+static size_t get_index(quicly_initial_guard_t *guard, size_t row, const struct st_prefix_t *prefix)
+{
+    uint64_t h = mix64(guard->sketch.seeds[row] ^ prefix->family);
+    h = mix64(h ^ prefix->words[0]);
+    h = mix64(h ^ prefix->words[1]);
+    return h & (QUICLY_INITIAL_GUARD_SKETCH_WIDTH - 1);
+}
+
+static void decay(quicly_initial_guard_t *guard, int64_t now)
+{
+    size_t row, col;
+
+    if (now < guard->sketch.decay_at)
+        return;
+
+    uint64_t num_intervals = (now - guard->sketch.decay_at) / guard->config.decay_interval + 1;
+    for (row = 0; row != QUICLY_INITIAL_GUARD_SKETCH_DEPTH; ++row) {
+        for (col = 0; col != QUICLY_INITIAL_GUARD_SKETCH_WIDTH; ++col) {
+            uint32_t *counter = &guard->sketch.counters[row][col];
+            *counter = num_intervals < 32 ? *counter >> num_intervals : 0;
+        }
+    }
+    guard->sketch.decay_at += num_intervals * guard->config.decay_interval;
+}
+
+static uint32_t estimate(quicly_initial_guard_t *guard, const struct st_prefix_t *prefix, size_t *indexes)
+{
+    uint32_t min = UINT32_MAX;
+    size_t row;
+
+    for (row = 0; row != QUICLY_INITIAL_GUARD_SKETCH_DEPTH; ++row) {
+        indexes[row] = get_index(guard, row, prefix);
+        if (guard->sketch.counters[row][indexes[row]] < min)
+            min = guard->sketch.counters[row][indexes[row]];
+    }
+
+    return min;
+}
+
+void quicly_initial_guard_init(quicly_initial_guard_t *guard, void (*random_bytes)(void *, size_t), int64_t now)
+{
+    PTLS_BUILD_ASSERT((QUICLY_INITIAL_GUARD_SKETCH_WIDTH & (QUICLY_INITIAL_GUARD_SKETCH_WIDTH - 1)) == 0);
+
+    memset(guard, 0, sizeof(*guard));
+    guard->config.half_open_threshold = DEFAULT_HALF_OPEN_THRESHOLD;
+    guard->config.max_initials_per_prefix = DEFAULT_MAX_INITIALS_PER_PREFIX;
+    guard->config.decay_interval = DEFAULT_DECAY_INTERVAL;
+    guard->config.ipv4_prefix_len = DEFAULT_IPV4_PREFIX_LEN;
+    guard->config.ipv6_prefix_len = DEFAULT_IPV6_PREFIX_LEN;
+    random_bytes(guard->sketch.seeds, sizeof(guard->sketch.seeds));
+    guard->sketch.decay_at = now + guard->config.decay_interval;
+}
+
+void quicly_initial_guard_dispose(quicly_initial_guard_t *guard)
+{
+    if (guard->retry_aead.aead != NULL)
+        ptls_aead_free(guard->retry_aead.aead);
+    guard->retry_aead.aead = NULL;
+}
+
+int quicly_initial_guard_admit(quicly_initial_guard_t *guard, int64_t now, struct sockaddr *remote, int address_validated)
+{
+    struct st_prefix_t prefix;
+    size_t indexes[QUICLY_INITIAL_GUARD_SKETCH_DEPTH], row;
+    uint32_t count;
+
+    decay(guard, now);
+
+    /* the address has been proven to be owned by the client; it is not a source of a spoofed flood */
+    if (address_validated) {
+        ++guard->stats.num_admitted;
+        return 1;
+    }
+
+    /* account the packet, using conservative update so that the counters of the light hitters are not inflated */
+    get_prefix(guard, remote, &prefix);
+    count = estimate(guard, &prefix, indexes);
+    if (count != UINT32_MAX)
+        ++count;
+    for (row = 0; row != QUICLY_INITIAL_GUARD_SKETCH_DEPTH; ++row) {
+        if (guard->sketch.counters[row][indexes[row]] < count)
+            guard->sketch.counters[row][indexes[row]] = count;
+    }
+
+    if (quicly_initial_guard_is_active(guard) && count > guard->config.max_initials_per_prefix) {
+        ++guard->stats.num_dropped;
+        return 0;
+    }
+
+    ++guard->stats.num_admitted;
+    return 1;
+}
+
+uint32_t quicly_initial_guard_estimate(quicly_initial_guard_t *guard, struct sockaddr *remote)
+{
+    struct st_prefix_t prefix;
+    size_t indexes[QUICLY_INITIAL_GUARD_SKETCH_DEPTH];
+
+    get_prefix(guard, remote, &prefix);
+    return estimate(guard, &prefix, indexes);
+}
+
+int quicly_initial_guard_require_retry(quicly_initial_guard_t *guard)
+{
+    if (!quicly_initial_guard_is_active(guard))
+        return 0;
+    ++guard->stats.num_retry_required;
+    return 1;
+}
+
+ptls_aead_context_t **quicly_initial_guard_get_retry_aead_cache(quicly_initial_guard_t *guard, uint32_t protocol_version)
+{
+    if (guard->retry_aead.aead != NULL && guard->retry_aead.version != protocol_version) {
+        ptls_aead_free(guard->retry_aead.aead);
+        guard->retry_aead.aead = NULL;
+    }
+    guard->retry_aead.version = protocol_version;
+    return &guard->retry_aead.aead;
+}
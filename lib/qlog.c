@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "quicly/qlog.h"
+#include "quicly-bintrace.h"
+
+static const char *packet_type_names[] = {"initial", "0RTT", "handshake", "1RTT"};
+
+static void append(quicly_qlog_conn_t *q, ptls_buffer_t *buf, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+static void append(quicly_qlog_conn_t *q, ptls_buffer_t *buf, const char *fmt, ...)
+{
+    va_list args;
+    int len;
+
+    if (q->is_broken)
+        return;
+
+    va_start(args, fmt);
+    len = vsnprintf((char *)buf->base + buf->off, buf->capacity - buf->off, fmt, args);
+    va_end(args);
+    if (len < 0)
+        goto Broken;
+
+    if ((size_t)len >= buf->capacity - buf->off) {
+        if (ptls_buffer_reserve(buf, len + 1) != 0)
+            goto Broken;
+        va_start(args, fmt);
+        vsnprintf((char *)buf->base + buf->off, buf->capacity - buf->off, fmt, args);
+        va_end(args);
+    }
+    buf->off += len;
+    return;
+
+Broken:
+    q->is_broken = 1;
+}
+
+/**
+ * Appends a string as a JSON string literal. The strings of the records are either hex-encoded or escaped by
+ * `quicly_escape_unsafe_string` (i.e. consist of printable characters), therefore escaping backslashes is sufficient.
+ */
+static void append_str(quicly_qlog_conn_t *q, ptls_buffer_t *buf, const char *s)
+{
+    append(q, buf, "\"");
+    for (; *s != '\0'; ++s) {
+        if (*s == '\\' || *s == '"') {
+            append(q, buf, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            append(q, buf, "\\u%04x", (unsigned char)*s);
+        } else {
+            append(q, buf, "%c", *s);
+        }
+    }
+    append(q, buf, "\"");
+}
+
+static const char *packet_type_name(uint8_t packet_type)
+{
+    return packet_type < PTLS_ELEMENTSOF(packet_type_names) ? packet_type_names[packet_type] : "unknown";
+}
+
+static const char *stream_type_name(int is_unidirectional)
+{
+    return is_unidirectional ? "unidirectional" : "bidirectional";
+}
+
+/**
+ * starts an event, returning the buffer to which the data is to be appended
+ */
+static ptls_buffer_t *begin_event(quicly_qlog_conn_t *q, int64_t at, const char *name)
+{
+    ptls_buffer_t *buf = q->packet.state != QUICLY_QLOG_PACKET_NONE ? &q->packet.deferred : &q->buf;
+
+    append(q, buf, "\x1e{\"time\":%" PRId64 ",\"name\":\"%s\",\"group_id\":\"%s\",\"data\":{", at, name, q->group_id);
+    return buf;
+}
+
+static void end_event(quicly_qlog_conn_t *q, ptls_buffer_t *buf)
+{
+    append(q, buf, "}}\n");
+}
+
+/**
+ * starts a frame, returning the buffer to which the fields are to be appended, or NULL if the frame is not to be logged
+ */
+static ptls_buffer_t *begin_frame(quicly_qlog_conn_t *q, int is_send, const char *frame_type)
+{
+    if (q->packet.state != (is_send ? QUICLY_QLOG_PACKET_SENDING : QUICLY_QLOG_PACKET_RECEIVING))
+        return NULL;
+    if (q->packet.in_ack) {
+        append(q, &q->packet.frames, "]}");
+        q->packet.in_ack = 0;
+    }
+    append(q, &q->packet.frames, "%s{\"frame_type\":\"%s\"", q->packet.frames.off != 0 ? "," : "", frame_type);
+    return &q->packet.frames;
+}
+
+static void close_packet(quicly_qlog_conn_t *q)
+{
+    if (q->packet.state == QUICLY_QLOG_PACKET_NONE)
+        return;
+
+    if (q->packet.in_ack) {
+        append(q, &q->packet.frames, "]}");
+        q->packet.in_ack = 0;
+    }
+
+    append(q, &q->buf,
+           "\x1e{\"time\":%" PRId64 ",\"name\":\"transport:%s\",\"group_id\":\"%s\",\"data\":{\"header\":{\"packet_type\":\"%s\","
+           "\"packet_number\":%" PRIu64 "},\"raw\":{\"length\":%" PRIu64 "},\"frames\":[%.*s]}}\n",
+           q->packet.at, q->packet.state == QUICLY_QLOG_PACKET_SENDING ? "packet_sent" : "packet_received", q->group_id,
+           packet_type_name(q->packet.packet_type), q->packet.pn, q->packet.len, (int)q->packet.frames.off,
+           (const char *)q->packet.frames.base);
+    if (q->packet.deferred.off != 0 && !q->is_broken) {
+        if (ptls_buffer_reserve(&q->buf, q->packet.deferred.off) != 0) {
+            q->is_broken = 1;
+        } else {
+            memcpy(q->buf.base + q->buf.off, q->packet.deferred.base, q->packet.deferred.off);
+            q->buf.off += q->packet.deferred.off;
+        }
+    }
+
+    q->packet.state = QUICLY_QLOG_PACKET_NONE;
+    q->packet.frames.off = 0;
+    q->packet.deferred.off = 0;
+}
+
+static void emit_connectivity(quicly_qlog_conn_t *q, const quicly_bintrace_record_t *rec)
+{
+    ptls_buffer_t *buf;
+
+    switch (rec->type) {
+    case QUICLY_BINTRACE_EVENT_CONNECT: {
+        const struct st_quicly_bintrace_connect_t *r = (const void *)rec;
+        buf = begin_event(q, r->at, "connectivity:connection_started");
+        append(q, buf, "\"version\":\"%" PRIx32 "\"", r->version);
+        end_event(q, buf);
+    } break;
+    case QUICLY_BINTRACE_EVENT_ACCEPT: {
+        const struct st_quicly_bintrace_accept_t *r = (const void *)rec;
+        buf = begin_event(q, r->at, "connectivity:connection_started");
+        append(q, buf, "\"dst_cid\":");
+        append_str(q, buf, r->dcid);
+        end_event(q, buf);
+    } break;
+    case QUICLY_BINTRACE_EVENT_FREE: {
+        const struct st_quicly_bintrace_free_t *r = (const void *)rec;
+        buf = begin_event(q, r->at, "connectivity:connection_closed");
+        end_event(q, buf);
+    } break;
+    default:
+        break;
+    }
+}
+
+static void emit_recovery(quicly_qlog_conn_t *q, const quicly_bintrace_record_t *rec)
+{
+    ptls_buffer_t *buf;
+
+    switch (rec->type) {
+    case QUICLY_BINTRACE_EVENT_PACKET_LOST: {
+        const struct st_quicly_bintrace_packet_lost_t *r = (const void *)rec;
+        buf = begin_event(q, r->at, "recovery:packet_lost");
+        append(q, buf, "\"header\":{\"packet_type\":\"%s\",\"packet_number\":%" PRIu64 "}", packet_type_name(r->packet_type),
+               r->pn);
+        end_event(q, buf);
+    } break;
+    case QUICLY_BINTRACE_EVENT_QUICTRACE_CC_ACK:
+    case QUICLY_BINTRACE_EVENT_QUICTRACE_CC_LOST: {
+        /* the two records share the same layout */
+        const struct st_quicly_bintrace_quictrace_cc_ack_t *r = (const void *)rec;
+        buf = begin_event(q, r->at, "recovery:metrics_updated");
+        append(q, buf,
+               "\"min_rtt\":%" PRIu32 ",\"smoothed_rtt\":%" PRIu32 ",\"latest_rtt\":%" PRIu32 ",\"congestion_window\":%" PRIu32
+               ",\"bytes_in_flight\":%" PRIu64,
+               r->rtt_minimum, r->rtt_smoothed, r->rtt_latest, r->cwnd, r->inflight);
+        end_event(q, buf);
+    } break;
+    case QUICLY_BINTRACE_EVENT_CC_CONGESTION: {
+        const struct st_quicly_bintrace_cc_congestion_t *r = (const void *)rec;
+        buf = begin_event(q, r->at, "recovery:congestion_state_updated");
+        append(q, buf, "\"new\":\"recovery\",\"trigger\":\"packet_lost\"");
+        end_event(q, buf);
+    } break;
+    case QUICLY_BINTRACE_EVENT_PTO: {
+        const struct st_quicly_bintrace_pto_t *r = (const void *)rec;
+        buf = begin_event(q, r->at, "recovery:loss_timer_updated");
+        append(q, buf, "\"timer_type\":\"pto\",\"event_type\":\"expired\",\"pto_count\":%" PRId8, r->pto_count);
+        end_event(q, buf);
+    } break;
+    default:
+        break;
+    }
+}
+
+#define FRAME(label, name, is_send, frame_type, block)                                                                             \
+    case QUICLY_BINTRACE_EVENT_##label: {                                                                                          \
+        const struct st_quicly_bintrace_##name##_t *r = (const void *)rec;                                                        \
+        ptls_buffer_t *buf;                                                                                                        \
+        (void)r;                                                                                                                   \
+        if ((buf = begin_frame(q, (is_send), (frame_type))) != NULL) {                                                             \
+            do {                                                                                                                   \
+                block                                                                                                              \
+            } while (0);                                                                                                           \
+            append(q, buf, "}");                                                                                                   \
+        }                                                                                                                          \
+    } break
+
+/**
+ * handles the transport events; i.e. the packets and the frames carried by them
+ */
+static void emit_transport(quicly_qlog_conn_t *q, const quicly_bintrace_record_t *rec)
+{
+    switch (rec->type) {
+    case QUICLY_BINTRACE_EVENT_PACKET_PREPARE:
+        close_packet(q);
+        q->packet.state = QUICLY_QLOG_PACKET_SENDING;
+        break;
+    case QUICLY_BINTRACE_EVENT_PACKET_SENT: {
+        const struct st_quicly_bintrace_packet_sent_t *r = (const void *)rec;
+        if (q->packet.state != QUICLY_QLOG_PACKET_SENDING)
+            break;
+        q->packet.at = r->at;
+        q->packet.pn = r->pn;
+        q->packet.len = r->len;
+        q->packet.packet_type = r->packet_type;
+        close_packet(q);
+    } break;
+    case QUICLY_BINTRACE_EVENT_PACKET_RECEIVED: {
+        const struct st_quicly_bintrace_packet_received_t *r = (const void *)rec;
+        close_packet(q);
+        q->packet.state = QUICLY_QLOG_PACKET_RECEIVING;
+        q->packet.at = r->at;
+        q->packet.pn = r->pn;
+        q->packet.len = r->decrypted_len;
+        q->packet.packet_type = r->packet_type;
+    } break;
+    case QUICLY_BINTRACE_EVENT_ACK_BLOCK_RECEIVED: {
+        const struct st_quicly_bintrace_ack_block_received_t *r = (const void *)rec;
+        if (q->packet.state != QUICLY_QLOG_PACKET_RECEIVING)
+            break;
+        if (!q->packet.in_ack) {
+            begin_frame(q, 0, "ack");
+            append(q, &q->packet.frames, ",\"acked_ranges\":[");
+            q->packet.in_ack = 1;
+        } else {
+            append(q, &q->packet.frames, ",");
+        }
+        append(q, &q->packet.frames, "[%" PRIu64 ",%" PRIu64 "]", r->ack_block_begin, r->ack_block_end);
+    } break;
+    case QUICLY_BINTRACE_EVENT_ACK_DELAY_RECEIVED:
+        if (q->packet.in_ack) {
+            append(q, &q->packet.frames, "]}");
+            q->packet.in_ack = 0;
+        }
+        break;
+        FRAME(ACK_SEND, ack_send, 1, "ack", { append(q, buf, ",\"acked_ranges\":[[%" PRIu64 "]]", r->largest_acked); });
+        FRAME(STREAM_SEND, stream_send, 1, r->stream >= 0 ? "stream" : "crypto", {
+            append(q, buf, ",\"stream_id\":%" PRId64 ",\"offset\":%" PRIu64 ",\"length\":%" PRIu64 ",\"fin\":%s", r->stream, r->off,
+                   r->len, r->is_fin ? "true" : "false");
+        });
+        FRAME(STREAM_RECEIVE, stream_receive, 0, r->stream >= 0 ? "stream" : "crypto", {
+            append(q, buf, ",\"stream_id\":%" PRId64 ",\"offset\":%" PRIu64 ",\"length\":%" PRIu64, r->stream, r->off, r->len);
+        });
+        FRAME(PING_SEND, ping_send, 1, "ping", {});
+        FRAME(PING_RECEIVE, ping_receive, 0, "ping", {});
+        FRAME(HANDSHAKE_DONE_SEND, handshake_done_send, 1, "handshake_done", {});
+        FRAME(HANDSHAKE_DONE_RECEIVE, handshake_done_receive, 0, "handshake_done", {});
+        FRAME(MAX_DATA_SEND, max_data_send, 1, "max_data", { append(q, buf, ",\"maximum\":%" PRIu64, r->maximum); });
+        FRAME(MAX_DATA_RECEIVE, max_data_receive, 0, "max_data", { append(q, buf, ",\"maximum\":%" PRIu64, r->maximum); });
+        FRAME(MAX_STREAMS_SEND, max_streams_send, 1, "max_streams", {
+            append(q, buf, ",\"stream_type\":\"%s\",\"maximum\":%" PRIu64, stream_type_name(r->is_unidirectional), r->maximum);
+        });
+        FRAME(MAX_STREAMS_RECEIVE, max_streams_receive, 0, "max_streams", {
+            append(q, buf, ",\"stream_type\":\"%s\",\"maximum\":%" PRIu64, stream_type_name(r->is_unidirectional), r->maximum);
+        });
+        FRAME(MAX_STREAM_DATA_SEND, max_stream_data_send, 1, "max_stream_data",
+              { append(q, buf, ",\"stream_id\":%" PRId64 ",\"maximum\":%" PRIu64, r->stream, r->maximum); });
+        FRAME(MAX_STREAM_DATA_RECEIVE, max_stream_data_receive, 0, "max_stream_data",
+              { append(q, buf, ",\"stream_id\":%" PRId64 ",\"maximum\":%" PRIu64, r->stream_id, r->maximum); });
+        FRAME(DATA_BLOCKED_SEND, data_blocked_send, 1, "data_blocked", { append(q, buf, ",\"limit\":%" PRIu64, r->off); });
+        FRAME(DATA_BLOCKED_RECEIVE, data_blocked_receive, 0, "data_blocked", { append(q, buf, ",\"limit\":%" PRIu64, r->off); });
+        FRAME(STREAM_DATA_BLOCKED_SEND, stream_data_blocked_send, 1, "stream_data_blocked",
+              { append(q, buf, ",\"stream_id\":%" PRId64 ",\"limit\":%" PRIu64, r->stream_id, r->maximum); });
+        FRAME(STREAM_DATA_BLOCKED_RECEIVE, stream_data_blocked_receive, 0, "stream_data_blocked",
+              { append(q, buf, ",\"stream_id\":%" PRId64 ",\"limit\":%" PRIu64, r->stream_id, r->maximum); });
+        FRAME(STREAMS_BLOCKED_SEND, streams_blocked_send, 1, "streams_blocked", {
+            append(q, buf, ",\"stream_type\":\"%s\",\"limit\":%" PRIu64, stream_type_name(r->is_unidirectional), r->maximum);
+        });
+        FRAME(STREAMS_BLOCKED_RECEIVE, streams_blocked_receive, 0, "streams_blocked", {
+            append(q, buf, ",\"stream_type\":\"%s\",\"limit\":%" PRIu64, stream_type_name(r->is_unidirectional), r->maximum);
+        });
+        FRAME(RESET_STREAM_SEND, reset_stream_send, 1, "reset_stream", {
+            append(q, buf, ",\"stream_id\":%" PRId64 ",\"error_code\":%" PRIu16 ",\"final_size\":%" PRIu64, r->stream_id,
+                   r->error_code, r->final_size);
+        });
+        FRAME(RESET_STREAM_RECEIVE, reset_stream_receive, 0, "reset_stream", {
+            append(q, buf, ",\"stream_id\":%" PRId64 ",\"error_code\":%" PRIu16 ",\"final_size\":%" PRIu64, r->stream_id,
+                   r->error_code, r->final_size);
+        });
+        FRAME(STOP_SENDING_SEND, stop_sending_send, 1, "stop_sending",
+              { append(q, buf, ",\"stream_id\":%" PRId64 ",\"error_code\":%" PRIu16, r->stream_id, r->error_code); });
+        FRAME(STOP_SENDING_RECEIVE, stop_sending_receive, 0, "stop_sending",
+              { append(q, buf, ",\"stream_id\":%" PRId64 ",\"error_code\":%" PRIu16, r->stream_id, r->error_code); });
+        FRAME(NEW_CONNECTION_ID_SEND, new_connection_id_send, 1, "new_connection_id", {
+            append(q, buf, ",\"sequence_number\":%" PRIu64 ",\"retire_prior_to\":%" PRIu64 ",\"connection_id\":", r->sequence,
+                   r->retire_prior_to);
+            append_str(q, buf, r->cid);
+        });
+        FRAME(NEW_CONNECTION_ID_RECEIVE, new_connection_id_receive, 0, "new_connection_id", {
+            append(q, buf, ",\"sequence_number\":%" PRIu64 ",\"retire_prior_to\":%" PRIu64 ",\"connection_id\":", r->sequence,
+                   r->retire_prior_to);
+            append_str(q, buf, r->cid);
+        });
+        FRAME(RETIRE_CONNECTION_ID_SEND, retire_connection_id_send, 1, "retire_connection_id",
+              { append(q, buf, ",\"sequence_number\":%" PRIu64, r->sequence); });
+        FRAME(RETIRE_CONNECTION_ID_RECEIVE, retire_connection_id_receive, 0, "retire_connection_id",
+              { append(q, buf, ",\"sequence_number\":%" PRIu64, r->sequence); });
+        FRAME(NEW_TOKEN_SEND, new_token_send, 1, "new_token",
+              { append(q, buf, ",\"token\":{\"length\":%" PRIu64 "}", r->token_len); });
+        FRAME(NEW_TOKEN_RECEIVE, new_token_receive, 0, "new_token",
+              { append(q, buf, ",\"token\":{\"length\":%" PRIu64 "}", r->token_len); });
+        FRAME(DATAGRAM_SEND, datagram_send, 1, "datagram",
+              { append(q, buf, ",\"length\":%" PRIu64, r->payload_len); });
+        FRAME(DATAGRAM_RECEIVE, datagram_receive, 0, "datagram",
+              { append(q, buf, ",\"length\":%" PRIu64, r->payload_len); });
+        FRAME(TRANSPORT_CLOSE_SEND, transport_close_send, 1, "connection_close", {
+            append(q, buf, ",\"error_space\":\"transport\",\"error_code\":%" PRIu64 ",\"trigger_frame_type\":%" PRIu64,
+                   r->error_code, r->frame_type);
+            append(q, buf, ",\"reason\":");
+            append_str(q, buf, r->reason_phrase);
+        });
+        FRAME(TRANSPORT_CLOSE_RECEIVE, transport_close_receive, 0, "connection_close", {
+            append(q, buf, ",\"error_space\":\"transport\",\"error_code\":%" PRIu64 ",\"trigger_frame_type\":%" PRIu64,
+                   r->error_code, r->frame_type);
+            append(q, buf, ",\"reason\":");
+            append_str(q, buf, r->reason_phrase);
+        });
+        FRAME(APPLICATION_CLOSE_SEND, application_close_send, 1, "connection_close", {
+            append(q, buf, ",\"error_space\":\"application\",\"error_code\":%" PRIu64 ",\"reason\":", r->error_code);
+            append_str(q, buf, r->reason_phrase);
+        });
+        FRAME(APPLICATION_CLOSE_RECEIVE, application_close_receive, 0, "connection_close", {
+            append(q, buf, ",\"error_space\":\"application\",\"error_code\":%" PRIu64 ",\"reason\":", r->error_code);
+            append_str(q, buf, r->reason_phrase);
+        });
+    default:
+        break;
+    }
+}
+
+#undef FRAME
+
+static int emit_record(void *_q, const quicly_bintrace_record_t *rec)
+{
+    quicly_qlog_conn_t *q = _q;
+    unsigned categories = q->qlog->categories;
+
+    if ((categories & QUICLY_QLOG_CATEGORY_TRANSPORT) != 0)
+        emit_transport(q, rec);
+    if ((categories & QUICLY_QLOG_CATEGORY_RECOVERY) != 0)
+        emit_recovery(q, rec);
+    if ((categories & QUICLY_QLOG_CATEGORY_CONNECTIVITY) != 0) {
+        /* the connection_closed event is the last one; close the packet being decoded if any */
+        if (rec->type == QUICLY_BINTRACE_EVENT_FREE)
+            close_packet(q);
+        emit_connectivity(q, rec);
+    }
+
+    return 0;
+}
+
+static void write_all(int fd, const uint8_t *p, size_t len)
+{
+    while (len != 0) {
+        ssize_t wret;
+        while ((wret = write(fd, p, len)) == -1 && errno == EINTR)
+            ;
+        if (wret <= 0)
+            break;
+        p += wret;
+        len -= wret;
+    }
+}
+
+void quicly_qlog_init(quicly_qlog_t *qlog, int fd)
+{
+    *qlog = (quicly_qlog_t){.fd = fd, .categories = QUICLY_QLOG_CATEGORY_ALL, .batch_size = QUICLY_QLOG_DEFAULT_BATCH_SIZE};
+}
+
+int quicly_qlog_parse_categories(const char *list, unsigned *categories)
+{
+    static const struct {
+        const char *name;
+        unsigned bits;
+    } names[] = {{"connectivity", QUICLY_QLOG_CATEGORY_CONNECTIVITY},
+                 {"transport", QUICLY_QLOG_CATEGORY_TRANSPORT},
+                 {"recovery", QUICLY_QLOG_CATEGORY_RECOVERY},
+                 {"all", QUICLY_QLOG_CATEGORY_ALL}};
+    unsigned parsed = 0;
+
+    while (1) {
+        size_t len = strcspn(list, ","), i;
+        for (i = 0; i != PTLS_ELEMENTSOF(names); ++i)
+            if (strlen(names[i].name) == len && memcmp(names[i].name, list, len) == 0)
+                break;
+        if (i == PTLS_ELEMENTSOF(names))
+            return -1;
+        parsed |= names[i].bits;
+        if (list[len] == '\0')
+            break;
+        list += len + 1;
+    }
+
+    *categories = parsed;
+    return 0;
+}
+
+int quicly_qlog_write_header(quicly_qlog_t *qlog, const char *title, const char *vantage_point)
+{
+    char buf[256];
+    int len;
+
+    len = snprintf(buf, sizeof(buf),
+                   "\x1e{\"qlog_version\":\"0.3\",\"qlog_format\":\"JSON-SEQ\",\"title\":\"%s\",\"trace\":{\"vantage_point\":{"
+                   "\"type\":\"%s\"},\"common_fields\":{\"protocol_type\":[\"QUIC\"],\"time_format\":\"absolute\"}}}\n",
+                   title, vantage_point);
+    if (len < 0 || (size_t)len >= sizeof(buf)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (write(qlog->fd, buf, len) == -1) {
+        if (errno != EINTR)
+            return -1;
+    }
+    return 0;
+}
+
+quicly_qlog_conn_t *quicly_qlog_conn_create(quicly_qlog_t *qlog, uint32_t random, ptls_iovec_t odcid)
+{
+    quicly_qlog_conn_t *q;
+
+    if (qlog->sampling_rate > 1 && random % qlog->sampling_rate != 0)
+        return NULL;
+
+    if ((q = malloc(sizeof(*q))) == NULL)
+        return NULL;
+    *q = (quicly_qlog_conn_t){.qlog = qlog};
+    if ((q->ring = malloc(quicly_bintrace_sizeof(QUICLY_BINTRACE_MIN_CAPACITY))) == NULL) {
+        free(q);
+        return NULL;
+    }
+    quicly_bintrace_init(q->ring, QUICLY_BINTRACE_MIN_CAPACITY);
+    if (odcid.len > (sizeof(q->group_id) - 1) / 2)
+        odcid.len = (sizeof(q->group_id) - 1) / 2;
+    ptls_hexdump(q->group_id, odcid.base, odcid.len);
+    ptls_buffer_init(&q->buf, "", 0);
+    ptls_buffer_init(&q->packet.frames, "", 0);
+    ptls_buffer_init(&q->packet.deferred, "", 0);
+
+    return q;
+}
+
+void quicly_qlog_conn_destroy(quicly_qlog_conn_t *q)
+{
+    close_packet(q);
+    quicly_qlog_conn_flush(q);
+    ptls_buffer_dispose(&q->buf);
+    ptls_buffer_dispose(&q->packet.frames);
+    ptls_buffer_dispose(&q->packet.deferred);
+    free(q->ring);
+    free(q);
+}
+
+void quicly_qlog_conn_emit(quicly_qlog_conn_t *q)
+{
+    quicly_bintrace_foreach(q->ring, emit_record, q);
+    q->ring->tail = q->ring->head;
+
+    if (q->buf.off >= q->qlog->batch_size)
+        quicly_qlog_conn_flush(q);
+}
+
+void quicly_qlog_conn_flush(quicly_qlog_conn_t *q)
+{
+    if (q->buf.off != 0 && !q->is_broken)
+        write_all(q->qlog->fd, q->buf.base, q->buf.off);
+    q->buf.off = 0;
+}
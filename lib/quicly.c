@@ -31,8 +31,12 @@
 #include "khash.h"
 #include "quicly.h"
 #include "quicly/defaults.h"
+#include "quicly/ack_queue.h"
 #include "quicly/sentmap.h"
+#include "quicly/stats_aggregate.h"
+#include "quicly/qlog.h"
 #include "quicly/frame.h"
+#include "quicly/freelist.h"
 #include "quicly/streambuf.h"
 #include "quicly/cc.h"
 #if QUICLY_USE_DTRACE
@@ -71,6 +75,12 @@
  * smaller than QUICLY_MAX_RANGES.
  */
 #define QUICLY_NUM_ACK_BLOCKS_TO_INDUCE_ACKACK 8
+#ifndef QUICLY_FLIGHT_RECORDER_POOL_SIZE
+/**
+ * maximum number of flight recorder rings being retained by each thread for reuse
+ */
+#define QUICLY_FLIGHT_RECORDER_POOL_SIZE 64
+#endif
 
 KHASH_MAP_INIT_INT64(quicly_stream_t, quicly_stream_t *)
 
@@ -80,6 +90,27 @@ KHASH_MAP_INIT_INT64(quicly_stream_t, quicly_stream_t *)
 #define QUICLY_TRACER(...)
 #endif
 
+#if QUICLY_USE_BINTRACE
+/**
+ * Records the event to the ring attached to the calling thread, to the flight recorder of the connection, and to the qlog writer
+ * of the connection. The arguments are evaluated only when any of them is active, as some of them (e.g., QUICLY_PROBE_HEXDUMP) are
+ * expensive.
+ */
+#define QUICLY_BINTRACE(label, conn, ...)                                                                                          \
+    do {                                                                                                                           \
+        if (PTLS_UNLIKELY(quicly_bintrace_ring != NULL) && !ptls_skip_tracing((conn)->crypto.tls))                                 \
+            QUICLY_BINTRACE_##label(quicly_bintrace_ring, conn, __VA_ARGS__);                                                      \
+        if (PTLS_UNLIKELY((conn)->flight_recorder.ring != NULL))                                                                   \
+            QUICLY_BINTRACE_##label((conn)->flight_recorder.ring, conn, __VA_ARGS__);                                              \
+        if (PTLS_UNLIKELY((conn)->qlog != NULL)) {                                                                                 \
+            QUICLY_BINTRACE_##label((conn)->qlog->ring, conn, __VA_ARGS__);                                                        \
+            quicly_qlog_conn_emit((conn)->qlog);                                                                                   \
+        }                                                                                                                          \
+    } while (0)
+#else
+#define QUICLY_BINTRACE(...)
+#endif
+
 #if QUICLY_USE_DTRACE
 #define QUICLY_PROBE(label, conn, ...)                                                                                             \
     do {                                                                                                                           \
@@ -87,9 +118,14 @@ KHASH_MAP_INIT_INT64(quicly_stream_t, quicly_stream_t *)
         if (PTLS_UNLIKELY(QUICLY_##label##_ENABLED()) && !ptls_skip_tracing(_conn->crypto.tls))                                    \
             QUICLY_##label(_conn, __VA_ARGS__);                                                                                    \
         QUICLY_TRACER(label, _conn, __VA_ARGS__);                                                                                  \
+        QUICLY_BINTRACE(label, _conn, __VA_ARGS__);                                                                                \
     } while (0)
 #else
-#define QUICLY_PROBE(label, conn, ...) QUICLY_TRACER(label, conn, __VA_ARGS__)
+#define QUICLY_PROBE(label, conn, ...)                                                                                             \
+    do {                                                                                                                           \
+        QUICLY_TRACER(label, conn, __VA_ARGS__);                                                                                   \
+        QUICLY_BINTRACE(label, conn, __VA_ARGS__);                                                                                 \
+    } while (0)
 #endif
 #define QUICLY_PROBE_HEXDUMP(s, l)                                                                                                 \
     ({                                                                                                                             \
@@ -117,7 +153,7 @@ struct st_quicly_pn_space_t {
     /**
      * acks to be sent to remote peer
      */
-    quicly_ranges_t ack_queue;
+    quicly_ack_queue_t ack_queue;
     /**
      * time at when the largest pn in the ack_queue has been received (or INT64_MAX if none)
      */
@@ -210,7 +246,19 @@ struct st_quicly_conn_t {
         struct {
             uint64_t bytes_consumed;
             quicly_maxsender_t sender;
+            /**
+             * size of the connection-level receive window
+             */
+            uint64_t window;
+            /**
+             * when the window was last extended (zero if never); used for auto-tuning the window size
+             */
+            int64_t window_updated_at;
         } max_data;
+        /**
+         * when the receive windows being throttled due to memory pressure are to be re-examined (INT64_MAX if none is throttled)
+         */
+        int64_t throttled_recheck_at;
         /**
          *
          */
@@ -252,6 +300,11 @@ struct st_quicly_conn_t {
             uint64_t frame_type; /* UINT64_MAX if application close */
             const char *reason_phrase;
             unsigned long num_packets_received;
+            /**
+             * if the connection has been closed due to an error, either locally or by the peer (see
+             * `quicly_aggregated_stats_t::num_conns.errored`)
+             */
+            unsigned is_error : 1;
         } connection_close;
         /**
          *
@@ -289,6 +342,20 @@ struct st_quicly_conn_t {
         struct {
             int64_t update_at;
             uint64_t sequence;
+            /**
+             * parameters sent in the latest ACK_FREQUENCY frame (packet_tolerance is zero if none has been sent yet); only used
+             * when `quicly_context_t::adjust_ack_frequency` is set
+             */
+            quicly_ack_frequency_params_t sent;
+            /**
+             * value of `num_packets.late_acked` when the policy was invoked previously
+             */
+            uint64_t late_acked_at_update;
+            /**
+             * set when the latest ACK_FREQUENCY frame is deemed lost, so that the frame is sent again even if the parameters do not
+             * change
+             */
+            uint8_t lost : 1;
         } ack_frequency;
         /**
          *
@@ -341,12 +408,13 @@ struct st_quicly_conn_t {
          */
         quicly_retire_cid_set_t retire_cid;
         /**
-         * payload of DATAGRAM frames to be sent
+         * DATAGRAM frames to be sent
          */
-        struct {
-            ptls_iovec_t payloads[10];
-            size_t count;
-        } datagram_frame_payloads;
+        quicly_datagram_queue_t datagram_frames;
+        /**
+         * bytes being charged to `quicly_context_t::memory_budget` for the blocks of the sentmap
+         */
+        uint64_t sentmap_memory_charged;
         /**
          * delivery rate estimator
          */
@@ -390,6 +458,23 @@ struct st_quicly_conn_t {
      * records the time when this connection was created
      */
     int64_t created_at;
+    /**
+     * see `quicly_context_t::flight_recorder`
+     */
+    struct {
+        /**
+         * ring retaining the latest events, or NULL if the flight recorder is disabled
+         */
+        quicly_bintrace_ring_t *ring;
+        /**
+         * send time of the earliest packet being deemed lost since an ACK last acknowledged a new packet, or INT64_MAX
+         */
+        int64_t lost_since;
+    } flight_recorder;
+    /**
+     * qlog writer of the connection, or NULL if the connection is not being sampled (see `quicly_context_t::qlog`)
+     */
+    quicly_qlog_conn_t *qlog;
     /**
      * structure to hold various data used internally
      */
@@ -423,6 +508,9 @@ struct st_quicly_conn_t {
 #if QUICLY_USE_TRACER
 #include "quicly-tracer.h"
 #endif
+#if QUICLY_USE_BINTRACE
+#include "quicly-bintrace.h"
+#endif
 
 struct st_quicly_handle_payload_state_t {
     const uint8_t *src, *const end;
@@ -501,12 +589,55 @@ static void lock_now(quicly_conn_t *conn, int is_reentrant)
     ++conn->stash.lock_count;
 }
 
+static void adjust_memory_charge(quicly_memory_budget_t *budget, uint64_t *charged, uint64_t bytes)
+{
+    if (bytes > *charged) {
+        quicly_memory_budget_charge(budget, bytes - *charged);
+    } else {
+        quicly_memory_budget_release(budget, *charged - bytes);
+    }
+    *charged = bytes;
+}
+
+/**
+ * Charges the memory budget for the blocks of the sentmap. As the sentmap might be updated many times during one call to the API,
+ * the charge is updated once when the API returns (i.e., when `now` is being unlocked).
+ */
+static void update_sentmap_memory_charge(quicly_conn_t *conn)
+{
+    adjust_memory_charge(conn->super.ctx->memory_budget, &conn->egress.sentmap_memory_charged,
+                         conn->egress.loss.sentmap.num_blocks * sizeof(struct st_quicly_sent_block_t));
+}
+
+/**
+ * Charges the memory budget for the receive buffer of the stream, which holds the bytes between the first byte not yet consumed by
+ * the application and the last byte being received.
+ */
+static void update_recvbuf_memory_charge(quicly_stream_t *stream, int destroying)
+{
+    uint64_t bytes = 0;
+
+    if (stream->conn->super.ctx->memory_budget == NULL || stream->stream_id < 0)
+        return;
+
+    if (!destroying) {
+        uint64_t end = quicly_recvstate_transfer_complete(&stream->recvstate)
+                           ? stream->recvstate.eos
+                           : stream->recvstate.received.ranges[stream->recvstate.received.num_ranges - 1].end;
+        bytes = end - stream->recvstate.data_off;
+    }
+    adjust_memory_charge(stream->conn->super.ctx->memory_budget, &stream->_recv_aux.memory_charged, bytes);
+}
+
 static void unlock_now(quicly_conn_t *conn)
 {
     assert(conn->stash.now != 0);
 
-    if (--conn->stash.lock_count == 0)
+    if (--conn->stash.lock_count == 0) {
+        if (conn->super.ctx->memory_budget != NULL)
+            update_sentmap_memory_charge(conn);
         conn->stash.now = 0;
+    }
 }
 
 static void set_address(quicly_address_t *addr, struct sockaddr *sa)
@@ -579,13 +710,9 @@ static void dispose_cipher(struct st_quicly_cipher_context_t *ctx)
     ptls_cipher_free(ctx->header_protection);
 }
 
-static void clear_datagram_frame_payloads(quicly_conn_t *conn)
+static void release_copied_datagram_frame(quicly_datagram_t *datagram, int sent)
 {
-    for (size_t i = 0; i != conn->egress.datagram_frame_payloads.count; ++i) {
-        free(conn->egress.datagram_frame_payloads.payloads[i].base);
-        conn->egress.datagram_frame_payloads.payloads[i] = ptls_iovec_init(NULL, 0);
-    }
-    conn->egress.datagram_frame_payloads.count = 0;
+    free(datagram->payload.base);
 }
 
 static int is_retry(quicly_conn_t *conn)
@@ -615,6 +742,70 @@ static void ack_frequency_set_next_update_at(quicly_conn_t *conn)
         conn->egress.ack_frequency.update_at = conn->stash.now + get_sentmap_expiration_time(conn);
 }
 
+static int on_ack_ack_frequency(quicly_sentmap_t *map, const quicly_sent_packet_t *packet, int acked, quicly_sent_t *sent)
+{
+    quicly_conn_t *conn = (quicly_conn_t *)((char *)map - offsetof(quicly_conn_t, egress.loss.sentmap));
+
+    /* When the latest frame is lost, consult the policy and resend the frame along with the next packet. Loss of older frames can
+     * be ignored, as they have been superseded. */
+    if (!acked && packet->frames_in_flight && sent->data.ack_frequency.sequence + 1 == conn->egress.ack_frequency.sequence) {
+        conn->egress.ack_frequency.lost = 1;
+        conn->egress.ack_frequency.update_at = conn->stash.now;
+    }
+
+    return 0;
+}
+
+static int adjust_ack_frequency(quicly_conn_t *conn, uint8_t **dst)
+{
+    quicly_ack_frequency_input_t input = {
+        .cc = &conn->egress.cc,
+        .rtt = &conn->egress.loss.rtt,
+        .max_udp_payload_size = conn->egress.max_udp_payload_size,
+        .num_late_acked = conn->super.stats.num_packets.late_acked - conn->egress.ack_frequency.late_acked_at_update,
+        .min_ack_delay_usec = conn->super.remote.transport_params.min_ack_delay_usec,
+        .max_ack_delay = conn->super.remote.transport_params.max_ack_delay,
+    };
+    quicly_ack_frequency_params_t params = conn->egress.ack_frequency.sent;
+    int lost = conn->egress.ack_frequency.lost;
+    quicly_sent_t *sent;
+
+    conn->egress.ack_frequency.late_acked_at_update = conn->super.stats.num_packets.late_acked;
+    conn->egress.ack_frequency.lost = 0;
+
+    /* the values that the peer uses until it receives an ACK_FREQUENCY frame */
+    if (params.packet_tolerance == 0)
+        params = (quicly_ack_frequency_params_t){QUICLY_DEFAULT_PACKET_TOLERANCE, input.max_ack_delay * 1000, 0};
+
+    if (!conn->super.ctx->adjust_ack_frequency->cb(conn->super.ctx->adjust_ack_frequency, conn, &input, &params)) {
+        if (!lost)
+            return 0;
+        params = conn->egress.ack_frequency.sent;
+    }
+
+    /* sanitize, as "Request Max Ack Delay" below min_ack_delay of the peer is a protocol violation */
+    if (params.packet_tolerance == 0)
+        params.packet_tolerance = 1;
+    if (params.max_ack_delay < input.min_ack_delay_usec)
+        params.max_ack_delay = input.min_ack_delay_usec;
+    params.ignore_order = !!params.ignore_order;
+
+    if (!lost && params.packet_tolerance == conn->egress.ack_frequency.sent.packet_tolerance &&
+        params.max_ack_delay == conn->egress.ack_frequency.sent.max_ack_delay &&
+        params.ignore_order == conn->egress.ack_frequency.sent.ignore_order)
+        return 0;
+
+    if ((sent = quicly_sentmap_allocate(&conn->egress.loss.sentmap, on_ack_ack_frequency)) == NULL)
+        return PTLS_ERROR_NO_MEMORY;
+    sent->data.ack_frequency.sequence = conn->egress.ack_frequency.sequence;
+    *dst = quicly_encode_ack_frequency_frame(*dst, conn->egress.ack_frequency.sequence++, params.packet_tolerance,
+                                             params.max_ack_delay, params.ignore_order);
+    ++conn->super.stats.num_frames_sent.ack_frequency;
+    conn->egress.ack_frequency.sent = params;
+
+    return 0;
+}
+
 size_t quicly_decode_packet(quicly_context_t *ctx, quicly_decoded_packet_t *packet, const uint8_t *datagram, size_t datagram_size,
                             size_t *off)
 {
@@ -863,18 +1054,103 @@ static void resched_stream_data(quicly_stream_t *stream)
     scheduler->update_state(scheduler, stream);
 }
 
+/**
+ * Returns the size of the receive window to be advertised, shrinking `window` as the usage of the memory budget approaches the
+ * limit. When the window is shrunk, the connection schedules the re-examination of its windows.
+ */
+static uint64_t throttle_receive_window(quicly_conn_t *conn, uint64_t window)
+{
+    if (conn->super.ctx->memory_budget == NULL)
+        return window;
+    uint64_t throttled = quicly_memory_budget_throttle(conn->super.ctx->memory_budget, window);
+    if (throttled < window && conn->ingress.throttled_recheck_at == INT64_MAX)
+        conn->ingress.throttled_recheck_at = conn->stash.now + conn->egress.loss.rtt.smoothed;
+    return throttled;
+}
+
+/**
+ * Returns the ratio (in permil) of the window that is left unconsumed when the window is extended. While auto-tuning is growing the
+ * window (i.e., the previous extension happened less than two round-trips ago), the extension is sent earlier, as the peer is
+ * likely to consume the credit before the extension arrives.
+ */
+static uint32_t receive_window_update_ratio(quicly_conn_t *conn, uint64_t window, uint64_t max_window, int64_t updated_at)
+{
+    if (window < max_window && updated_at != 0 && conn->stash.now - updated_at < 2 * (int64_t)conn->egress.loss.rtt.smoothed)
+        return 768;
+    return 512;
+}
+
 static int should_send_max_data(quicly_conn_t *conn)
 {
+    uint64_t window = throttle_receive_window(conn, conn->ingress.max_data.window);
+    if (window == 0 && !conn->ingress.max_data.sender.force_send)
+        return 0;
+    uint32_t ratio = receive_window_update_ratio(conn, window, conn->super.ctx->max_receive_window.max_data,
+                                                 conn->ingress.max_data.window_updated_at);
+    /* unlike the stream-level windows, the connection-level window can exceed 4GB */
+    if (window > UINT32_MAX)
+        window = UINT32_MAX;
     return quicly_maxsender_should_send_max(&conn->ingress.max_data.sender, conn->ingress.max_data.bytes_consumed,
-                                            (uint32_t)conn->super.ctx->transport_params.max_data, 512);
+                                            (uint32_t)window, ratio);
+}
+
+/**
+ * Called when the receive window is about to be extended. If the previous extension happened less than two round-trips ago, the
+ * window is limiting the throughput, therefore the window is doubled, up to `max_window`. Returns the new size of the window.
+ */
+static uint64_t autotune_receive_window(quicly_conn_t *conn, uint64_t window, uint64_t max_window, int64_t *updated_at)
+{
+    int64_t prev = *updated_at;
+
+    *updated_at = conn->stash.now;
+    /* windows are not grown while the memory is under pressure */
+    if (conn->super.ctx->memory_budget != NULL && quicly_memory_budget_get_pressure(conn->super.ctx->memory_budget) != 0)
+        return window;
+    if (prev != 0 && window < max_window && conn->stash.now - prev < 2 * (int64_t)conn->egress.loss.rtt.smoothed) {
+        window *= 2;
+        if (window > max_window)
+            window = max_window;
+    }
+
+    return window;
 }
 
 static int should_send_max_stream_data(quicly_stream_t *stream)
 {
     if (stream->recvstate.eos != UINT64_MAX)
         return 0;
+    uint64_t window = throttle_receive_window(stream->conn, stream->_recv_aux.window);
+    if (window == 0 && !stream->_send_aux.max_stream_data_sender.force_send)
+        return 0;
+    uint32_t ratio = receive_window_update_ratio(stream->conn, window, stream->conn->super.ctx->max_receive_window.max_stream_data,
+                                                 stream->_recv_aux.window_updated_at);
     return quicly_maxsender_should_send_max(&stream->_send_aux.max_stream_data_sender, stream->recvstate.data_off,
-                                            stream->_recv_aux.window, 512);
+                                            (uint32_t)window, ratio);
+}
+
+/**
+ * Once the memory pressure is gone, schedules the MAX_DATA and MAX_STREAM_DATA frames that have been withheld or shrunk. Otherwise,
+ * a peer that has consumed the throttled credit stays blocked, as it sends DATA_BLOCKED only once for each limit and the pressure
+ * might be relieved by other connections sharing the budget. While under pressure, the windows are re-examined every round-trip.
+ */
+static void recheck_throttled_receive_windows(quicly_conn_t *conn)
+{
+    quicly_stream_t *stream;
+
+    if (conn->stash.now < conn->ingress.throttled_recheck_at)
+        return;
+
+    if (quicly_memory_budget_get_pressure(conn->super.ctx->memory_budget) != 0) {
+        conn->ingress.throttled_recheck_at = conn->stash.now + conn->egress.loss.rtt.smoothed;
+        return;
+    }
+
+    conn->ingress.throttled_recheck_at = INT64_MAX;
+    /* MAX_DATA is checked every time `do_send` is invoked */
+    kh_foreach_value(conn->streams, stream, {
+        if (stream->stream_id >= 0 && should_send_max_stream_data(stream))
+            sched_stream_control(stream);
+    });
 }
 
 int quicly_stream_sync_sendbuf(quicly_stream_t *stream, int activate)
@@ -890,9 +1166,24 @@ int quicly_stream_sync_sendbuf(quicly_stream_t *stream, int activate)
     return 0;
 }
 
+void quicly_stream_set_priority(quicly_stream_t *stream, uint8_t urgency, int incremental)
+{
+    assert(urgency < QUICLY_PRIORITY_NUM_URGENCY_LEVELS);
+
+    stream->priority.urgency = urgency;
+    stream->priority.incremental = incremental != 0;
+
+    /* let the scheduler relink the stream, as the slot corresponding to the priority might have changed */
+    if (quicly_linklist_is_linked(&stream->_send_aux.pending_link.default_scheduler)) {
+        quicly_linklist_unlink(&stream->_send_aux.pending_link.default_scheduler);
+        resched_stream_data(stream);
+    }
+}
+
 void quicly_stream_sync_recvbuf(quicly_stream_t *stream, size_t shift_amount)
 {
     stream->recvstate.data_off += shift_amount;
+    update_recvbuf_memory_charge(stream, 0);
     if (stream->stream_id >= 0) {
         if (should_send_max_stream_data(stream))
             sched_stream_control(stream);
@@ -1014,11 +1305,28 @@ Exit:
     ptls_buffer_dispose(&output);
 }
 
-void crypto_stream_receive(quicly_stream_t *stream, size_t off, const void *src, size_t len)
+/**
+ * feeds the data buffered in the crypto stream into TLS, until the buffer becomes empty or the handshake gets suspended
+ */
+static void crypto_stream_feed(quicly_stream_t *stream)
 {
     quicly_conn_t *conn = stream->conn;
     ptls_iovec_t input;
 
+    /* fed chunk by chunk to avoid copying, as TLS can process partial input */
+    while ((input = quicly_streambuf_ingress_get_chunk(stream)).len != 0) {
+        size_t in_epoch = -(1 + stream->stream_id);
+        crypto_handshake(conn, in_epoch, input);
+        quicly_streambuf_ingress_shift(stream, input.len);
+        if (conn->crypto.async_in_progress || conn->super.state >= QUICLY_STATE_CLOSING)
+            break;
+    }
+}
+
+void crypto_stream_receive(quicly_stream_t *stream, size_t off, const void *src, size_t len)
+{
+    quicly_conn_t *conn = stream->conn;
+
     /* store input */
     if (quicly_streambuf_ingress_receive(stream, off, src, len) != 0)
         return;
@@ -1031,11 +1339,7 @@ void crypto_stream_receive(quicly_stream_t *stream, size_t off, const void *src,
     }
 
     /* feed the input into TLS, send result */
-    if ((input = quicly_streambuf_ingress_get(stream)).len != 0) {
-        size_t in_epoch = -(1 + stream->stream_id);
-        crypto_handshake(conn, in_epoch, input);
-        quicly_streambuf_ingress_shift(stream, input.len);
-    }
+    crypto_stream_feed(stream);
 }
 
 quicly_conn_t *quicly_resume_handshake(ptls_t *tls)
@@ -1055,6 +1359,16 @@ quicly_conn_t *quicly_resume_handshake(ptls_t *tls)
         return conn;
 
     crypto_handshake(conn, 0, ptls_iovec_init(NULL, 0));
+
+    /* process the crypto data that arrived along with the message that triggered the async operation */
+    for (size_t epoch = 0; epoch < 4; ++epoch) {
+        if (conn->crypto.async_in_progress || conn->super.state >= QUICLY_STATE_CLOSING)
+            break;
+        quicly_stream_t *stream;
+        if ((stream = quicly_get_stream(conn, -(quicly_stream_id_t)(1 + epoch))) != NULL)
+            crypto_stream_feed(stream);
+    }
+
     return conn;
 }
 
@@ -1074,6 +1388,8 @@ static void init_stream_properties(quicly_stream_t *stream, uint32_t initial_max
         quicly_recvstate_init_closed(&stream->recvstate);
     }
     stream->streams_blocked = 0;
+    stream->priority.urgency = QUICLY_PRIORITY_DEFAULT_URGENCY;
+    stream->priority.incremental = 0;
 
     stream->_send_aux.max_stream_data = initial_max_stream_data_remote;
     stream->_send_aux.stop_sending.sender_state = QUICLY_SENDER_STATE_NONE;
@@ -1086,6 +1402,8 @@ static void init_stream_properties(quicly_stream_t *stream, uint32_t initial_max
     quicly_linklist_init(&stream->_send_aux.pending_link.default_scheduler);
 
     stream->_recv_aux.window = initial_max_stream_data_local;
+    stream->_recv_aux.window_updated_at = 0;
+    stream->_recv_aux.memory_charged = 0;
 
     /* Set the number of max ranges to be capable of handling following case:
      * * every one of the two packets being sent are lost
@@ -1121,6 +1439,8 @@ static quicly_stream_t *open_stream(quicly_conn_t *conn, uint64_t stream_id, uin
     stream->stream_id = stream_id;
     stream->callbacks = NULL;
     stream->data = NULL;
+    /* `now` is not locked when the application opens a stream */
+    stream->_created_at = conn->stash.now != 0 ? conn->stash.now : conn->super.ctx->now->cb(conn->super.ctx->now);
 
     int r;
     khiter_t iter = kh_put(quicly_stream_t, conn->streams, stream_id, &r);
@@ -1194,6 +1514,7 @@ static void destroy_stream(quicly_stream_t *stream, int err)
         --group->num_streams;
     }
 
+    update_recvbuf_memory_charge(stream, 1);
     dispose_stream_properties(stream);
 
     if (conn->application != NULL) {
@@ -1252,10 +1573,22 @@ uint32_t quicly_num_streams_by_group(quicly_conn_t *conn, int uni, int locally_i
     return state->num_streams;
 }
 
+/**
+ * Returns the latency histograms of the connection, allocating them upon the first invocation. Returns NULL if the collection is
+ * disabled or if the allocation failed; in either case, the sample is not recorded.
+ */
+static quicly_latency_stats_t *get_latency_stats(quicly_conn_t *conn)
+{
+    if (conn->super.stats.latency == NULL && conn->super.ctx->collect_latency_stats &&
+        (conn->super.stats.latency = malloc(sizeof(*conn->super.stats.latency))) != NULL)
+        memset(conn->super.stats.latency, 0, sizeof(*conn->super.stats.latency));
+    return conn->super.stats.latency;
+}
+
 int quicly_get_stats(quicly_conn_t *conn, quicly_stats_t *stats)
 {
     /* copy the pre-built stats fields */
-    memcpy(stats, &conn->super.stats, sizeof(conn->super.stats));
+    memcpy(stats, &conn->super.stats, offsetof(quicly_stats_t, rtt));
 
     /* set or generate the non-pre-built stats fields here */
     stats->rtt = conn->egress.loss.rtt;
@@ -1264,6 +1597,11 @@ int quicly_get_stats(quicly_conn_t *conn, quicly_stats_t *stats)
     quicly_ratemeter_report(&conn->egress.ratemeter, &stats->delivery_rate);
     stats->num_sentmap_packets_largest = conn->egress.loss.sentmap.num_packets_largest;
     stats->handshake_confirmed_msec = conn->super.stats.handshake_confirmed_msec;
+    if (conn->super.stats.latency != NULL) {
+        stats->latency = *conn->super.stats.latency;
+    } else {
+        memset(&stats->latency, 0, sizeof(stats->latency));
+    }
 
     return 0;
 }
@@ -1384,7 +1722,7 @@ static struct st_quicly_pn_space_t *alloc_pn_space(size_t sz, uint32_t packet_to
     if ((space = malloc(sz)) == NULL)
         return NULL;
 
-    quicly_ranges_init(&space->ack_queue);
+    quicly_ack_queue_init(&space->ack_queue);
     space->largest_pn_received_at = INT64_MAX;
     space->next_expected_packet_number = 0;
     space->unacked_count = 0;
@@ -1398,30 +1736,22 @@ static struct st_quicly_pn_space_t *alloc_pn_space(size_t sz, uint32_t packet_to
 
 static void do_free_pn_space(struct st_quicly_pn_space_t *space)
 {
-    quicly_ranges_clear(&space->ack_queue);
+    quicly_ack_queue_dispose(&space->ack_queue);
     free(space);
 }
 
-static int record_pn(quicly_ranges_t *ranges, uint64_t pn, int *is_out_of_order)
+static int record_pn(quicly_ack_queue_t *queue, uint64_t pn, int *is_out_of_order)
 {
     int ret;
 
-    *is_out_of_order = 0;
+    *is_out_of_order = !quicly_ack_queue_is_empty(queue) && queue->end != pn;
 
-    if (ranges->num_ranges != 0) {
-        /* fast path that is taken when we receive a packet in-order */
-        if (ranges->ranges[ranges->num_ranges - 1].end == pn) {
-            ranges->ranges[ranges->num_ranges - 1].end = pn + 1;
-            return 0;
-        }
-        *is_out_of_order = 1;
-    }
-
-    /* slow path; we add, then remove the oldest ranges when the number of ranges exceed the maximum */
-    if ((ret = quicly_ranges_add(ranges, pn, pn + 1)) != 0)
+    if ((ret = quicly_ack_queue_add(queue, pn)) != 0)
         return ret;
-    if (ranges->num_ranges > QUICLY_MAX_ACK_BLOCKS)
-        quicly_ranges_drop_by_range_indices(ranges, ranges->num_ranges - QUICLY_MAX_ACK_BLOCKS, ranges->num_ranges);
+
+    /* packets received out-of-order might create new ranges; remove the oldest ones when the number exceeds the maximum */
+    if (*is_out_of_order)
+        quicly_ack_queue_shrink(queue, QUICLY_MAX_ACK_BLOCKS);
 
     return 0;
 }
@@ -1439,7 +1769,7 @@ static int record_receipt(struct st_quicly_pn_space_t *space, uint64_t pn, int i
     ack_now = is_out_of_order && !space->ignore_order && !is_ack_only;
 
     /* update largest_pn_received_at (TODO implement deduplication at an earlier moment?) */
-    if (space->ack_queue.ranges[space->ack_queue.num_ranges - 1].end == pn + 1)
+    if (space->ack_queue.end == pn + 1)
         space->largest_pn_received_at = now;
 
     /* if the received packet is ack-eliciting, update / schedule transmission of ACK */
@@ -1534,6 +1864,9 @@ static int discard_handshake_context(quicly_conn_t *conn, size_t epoch)
     if (epoch == QUICLY_EPOCH_HANDSHAKE) {
         assert(conn->stash.now != 0);
         conn->super.stats.handshake_confirmed_msec = conn->stash.now - conn->created_at;
+        quicly_latency_stats_t *latency;
+        if ((latency = get_latency_stats(conn)) != NULL)
+            quicly_histogram_record(&latency->handshake, conn->super.stats.handshake_confirmed_msec);
     }
     free_handshake_space(epoch == QUICLY_EPOCH_INITIAL ? &conn->initial : &conn->handshake);
 
@@ -1632,6 +1965,127 @@ static int received_key_update(quicly_conn_t *conn, uint64_t newly_decrypted_key
     }
 }
 
+/**
+ * per-thread pool of the rings used by the flight recorders
+ */
+static __thread quicly_freelist_t flight_recorder_pool = QUICLY_FREELIST_INITIALIZER(QUICLY_FLIGHT_RECORDER_POOL_SIZE);
+
+static void init_flight_recorder(quicly_conn_t *conn)
+{
+    conn->flight_recorder.lost_since = INT64_MAX;
+
+#if QUICLY_USE_BINTRACE
+    quicly_flight_recorder_t *recorder = conn->super.ctx->flight_recorder;
+    quicly_bintrace_ring_t *ring;
+
+    if (recorder == NULL)
+        return;
+
+    size_t capacity = quicly_bintrace_round_capacity(recorder->ring_size);
+    /* the pooled rings retain their capacity, as they are linked through the first field (i.e. `magic`) */
+    while ((ring = quicly_freelist_pop(&flight_recorder_pool)) != NULL) {
+        if (ring->capacity == capacity)
+            break;
+        free(ring);
+    }
+    /* upon allocation failure, the connection runs without the recorder */
+    if (ring == NULL && (ring = malloc(quicly_bintrace_sizeof(capacity))) == NULL)
+        return;
+    quicly_bintrace_init(ring, capacity);
+    conn->flight_recorder.ring = ring;
+#endif
+}
+
+static void dispose_flight_recorder(quicly_conn_t *conn)
+{
+    quicly_bintrace_ring_t *ring;
+
+    if ((ring = conn->flight_recorder.ring) == NULL)
+        return;
+    conn->flight_recorder.ring = NULL;
+
+    quicly_freelist_push(&flight_recorder_pool, ring);
+}
+
+static void dump_flight_recorder(quicly_conn_t *conn, quicly_flight_recorder_reason_t reason)
+{
+    if (conn->flight_recorder.ring != NULL)
+        conn->super.ctx->flight_recorder->on_dump(conn->super.ctx->flight_recorder, conn, reason, conn->flight_recorder.ring);
+}
+
+/**
+ * Detects persistent congestion (RFC 9002, Section 7.6) for the purpose of dumping the flight recorder. For simplicity, the period
+ * is reset whenever a new packet is acked, rather than checking the packets being acked against the ones being lost.
+ */
+static void on_loss_detected_persistent_congestion(quicly_conn_t *conn, const quicly_sent_packet_t *lost_packet)
+{
+    if (conn->flight_recorder.ring == NULL || !lost_packet->ack_eliciting || conn->egress.loss.rtt.latest == 0)
+        return;
+
+    if (conn->flight_recorder.lost_since == INT64_MAX) {
+        conn->flight_recorder.lost_since = lost_packet->sent_at;
+        return;
+    }
+
+    quicly_rtt_t *rtt = &conn->egress.loss.rtt;
+    int64_t duration = ((int64_t)rtt->smoothed + (rtt->variance * 4 > 1 ? rtt->variance * 4 : 1) +
+                        conn->super.remote.transport_params.max_ack_delay) *
+                       3;
+    if (lost_packet->sent_at - conn->flight_recorder.lost_since >= duration) {
+        conn->flight_recorder.lost_since = INT64_MAX;
+        dump_flight_recorder(conn, QUICLY_FLIGHT_RECORDER_REASON_PERSISTENT_CONGESTION);
+    }
+}
+
+void quicly_dump_flight_recorder(quicly_conn_t *conn)
+{
+    dump_flight_recorder(conn, QUICLY_FLIGHT_RECORDER_REASON_APPLICATION);
+}
+
+const char *quicly_flight_recorder_reason_to_string(quicly_flight_recorder_reason_t reason)
+{
+    switch (reason) {
+    case QUICLY_FLIGHT_RECORDER_REASON_APPLICATION:
+        return "application";
+    case QUICLY_FLIGHT_RECORDER_REASON_PTO_STORM:
+        return "pto-storm";
+    case QUICLY_FLIGHT_RECORDER_REASON_PERSISTENT_CONGESTION:
+        return "persistent-congestion";
+    case QUICLY_FLIGHT_RECORDER_REASON_HANDSHAKE_TIMEOUT:
+        return "handshake-timeout";
+    case QUICLY_FLIGHT_RECORDER_REASON_CLOSE_ERROR:
+        return "close-error";
+    }
+    return "unknown";
+}
+
+/**
+ * Starts logging the connection using qlog, if sampled. This function is called after the original DCID is determined, as it is
+ * used as the group ID of the events.
+ */
+static void init_qlog(quicly_conn_t *conn)
+{
+#if QUICLY_USE_BINTRACE
+    quicly_qlog_t *qlog = conn->super.ctx->qlog;
+    uint32_t random = 0;
+
+    if (qlog == NULL)
+        return;
+    if (qlog->sampling_rate > 1)
+        conn->super.ctx->tls->random_bytes(&random, sizeof(random));
+    conn->qlog = quicly_qlog_conn_create(qlog, random,
+                                         ptls_iovec_init(conn->super.original_dcid.cid, conn->super.original_dcid.len));
+#endif
+}
+
+static void dispose_qlog(quicly_conn_t *conn)
+{
+    if (conn->qlog == NULL)
+        return;
+    quicly_qlog_conn_destroy(conn->qlog);
+    conn->qlog = NULL;
+}
+
 static inline void update_open_count(quicly_context_t *ctx, ssize_t delta)
 {
     if (ctx->update_open_count != NULL)
@@ -1655,7 +2109,15 @@ void quicly_free(quicly_conn_t *conn)
 #endif
     destroy_all_streams(conn, 0, 1);
     update_open_count(conn->super.ctx, -1);
-    clear_datagram_frame_payloads(conn);
+    if (conn->super.ctx->stats_aggregate != NULL) {
+        quicly_aggregated_stats_t delta = {.num_conns.closed = 1, .num_conns.errored = conn->egress.connection_close.is_error};
+        memcpy(&delta, &conn->super.stats, offsetof(quicly_aggregated_stats_t, num_conns));
+        quicly_stats_aggregate_add(conn->super.ctx->stats_aggregate, &delta);
+        if (conn->super.stats.latency != NULL)
+            quicly_stats_aggregate_add_latency(conn->super.ctx->stats_aggregate, conn->super.stats.latency);
+    }
+    free(conn->super.stats.latency);
+    quicly_datagram_queue_dispose(&conn->egress.datagram_frames);
 
     quicly_maxsender_dispose(&conn->ingress.max_data.sender);
     quicly_maxsender_dispose(&conn->ingress.max_streams.uni);
@@ -1674,6 +2136,11 @@ void quicly_free(quicly_conn_t *conn)
     assert(!quicly_linklist_is_linked(&conn->egress.pending_streams.control));
     assert(!quicly_linklist_is_linked(&conn->super._default_scheduler.active));
     assert(!quicly_linklist_is_linked(&conn->super._default_scheduler.blocked));
+    for (size_t i = 0; i != QUICLY_PRIORITY_NUM_URGENCY_LEVELS; ++i) {
+        assert(!quicly_linklist_is_linked(&conn->super._priority_scheduler.active[i][0]));
+        assert(!quicly_linklist_is_linked(&conn->super._priority_scheduler.active[i][1]));
+    }
+    assert(!quicly_linklist_is_linked(&conn->super._priority_scheduler.blocked));
 
     free_handshake_space(&conn->initial);
     free_handshake_space(&conn->handshake);
@@ -1686,6 +2153,8 @@ void quicly_free(quicly_conn_t *conn)
     } else {
         ptls_free(conn->crypto.tls);
     }
+    dispose_flight_recorder(conn);
+    dispose_qlog(conn);
 
     unlock_now(conn);
 
@@ -1783,6 +2252,12 @@ static int apply_stream_frame(quicly_stream_t *stream, quicly_stream_frame_t *fr
         if (stream->recvstate.received.ranges[stream->recvstate.received.num_ranges - 1].end < max_stream_data) {
             uint64_t newly_received =
                 max_stream_data - stream->recvstate.received.ranges[stream->recvstate.received.num_ranges - 1].end;
+            quicly_latency_stats_t *latency;
+            /* peer-initiated streams are opened upon receiving the first byte, therefore only the locally initiated ones are
+             * measured */
+            if (stream->recvstate.received.ranges[stream->recvstate.received.num_ranges - 1].end == 0 &&
+                quicly_stream_is_self_initiated(stream) && (latency = get_latency_stats(stream->conn)) != NULL)
+                quicly_histogram_record(&latency->stream_first_byte, stream->conn->stash.now - stream->_created_at);
             if (stream->conn->ingress.max_data.bytes_consumed + newly_received >
                 stream->conn->ingress.max_data.sender.max_committed)
                 return QUICLY_TRANSPORT_ERROR_FLOW_CONTROL;
@@ -1800,6 +2275,7 @@ static int apply_stream_frame(quicly_stream_t *stream, quicly_stream_frame_t *fr
     if ((ret = quicly_recvstate_update(&stream->recvstate, frame->offset, &apply_len, frame->is_fin,
                                        stream->_recv_aux.max_ranges)) != 0)
         return ret;
+    update_recvbuf_memory_charge(stream, 0);
 
     if (apply_len != 0 || quicly_recvstate_transfer_complete(&stream->recvstate)) {
         uint64_t buf_offset = frame->offset + frame->data.len - apply_len - stream->recvstate.data_off;
@@ -2197,8 +2673,20 @@ static quicly_conn_t *create_connection(quicly_context_t *ctx, uint32_t protocol
     conn->super.remote.largest_retire_prior_to = 0;
     quicly_linklist_init(&conn->super._default_scheduler.active);
     quicly_linklist_init(&conn->super._default_scheduler.blocked);
+    for (size_t i = 0; i != QUICLY_PRIORITY_NUM_URGENCY_LEVELS; ++i) {
+        quicly_linklist_init(&conn->super._priority_scheduler.active[i][0]);
+        quicly_linklist_init(&conn->super._priority_scheduler.active[i][1]);
+    }
+    quicly_linklist_init(&conn->super._priority_scheduler.blocked);
+    conn->super._priority_scheduler.active_urgencies = 0;
+    quicly_datagram_queue_init(&conn->egress.datagram_frames, conn->super.ctx->datagram_frame_queue.max_size,
+                               conn->super.ctx->datagram_frame_queue.drop_policy);
     conn->streams = kh_init(quicly_stream_t);
     quicly_maxsender_init(&conn->ingress.max_data.sender, conn->super.ctx->transport_params.max_data);
+    conn->ingress.max_data.window = conn->super.ctx->transport_params.max_data;
+    conn->ingress.max_data.window_updated_at = 0;
+    conn->ingress.throttled_recheck_at = INT64_MAX;
+    conn->egress.sentmap_memory_charged = 0;
     quicly_maxsender_init(&conn->ingress.max_streams.uni, conn->super.ctx->transport_params.max_streams_uni);
     quicly_maxsender_init(&conn->ingress.max_streams.bidi, conn->super.ctx->transport_params.max_streams_bidi);
     quicly_loss_init(&conn->egress.loss, &conn->super.ctx->loss,
@@ -2232,10 +2720,15 @@ static quicly_conn_t *create_connection(quicly_context_t *ctx, uint32_t protocol
     conn->idle_timeout.at = INT64_MAX;
     conn->idle_timeout.should_rearm_on_send = 1;
     conn->stash.on_ack_stream.active_acked_cache.stream_id = INT64_MIN;
+    init_flight_recorder(conn);
 
     *ptls_get_data_ptr(tls) = conn;
 
     update_open_count(conn->super.ctx, 1);
+    if (conn->super.ctx->stats_aggregate != NULL) {
+        quicly_aggregated_stats_t delta = {.num_conns.opened = 1};
+        quicly_stats_aggregate_add(conn->super.ctx->stats_aggregate, &delta);
+    }
 
     return conn;
 }
@@ -2357,6 +2850,7 @@ int quicly_connect(quicly_conn_t **_conn, quicly_context_t *ctx, const char *ser
     }
     server_cid = quicly_get_remote_cid(conn);
     conn->super.original_dcid = *server_cid;
+    init_qlog(conn);
 
     QUICLY_PROBE(CONNECT, conn, conn->stash.now, conn->super.version);
     QUICLY_LOG_CONN(connect, conn, { PTLS_LOG_ELEMENT_UNSIGNED(version, conn->super.version); });
@@ -2656,22 +3150,21 @@ static int do_on_ack_ack(quicly_conn_t *conn, const quicly_sent_packet_t *packet
     /* subtract given ACK ranges */
     int ret;
     uint64_t end = start + start_length;
-    if ((ret = quicly_ranges_subtract(&space->ack_queue, start, end)) != 0)
+    if ((ret = quicly_ack_queue_subtract(&space->ack_queue, start, end)) != 0)
         return ret;
     for (size_t i = 0; i < additional_capacity && additional[i].gap != 0; ++i) {
         start = end + additional[i].gap;
         end = start + additional[i].length;
-        if ((ret = quicly_ranges_subtract(&space->ack_queue, start, end)) != 0)
+        if ((ret = quicly_ack_queue_subtract(&space->ack_queue, start, end)) != 0)
             return ret;
     }
 
     /* make adjustments */
-    if (space->ack_queue.num_ranges == 0) {
+    if (quicly_ack_queue_is_empty(&space->ack_queue)) {
         space->largest_pn_received_at = INT64_MAX;
         space->unacked_count = 0;
-    } else if (space->ack_queue.num_ranges > QUICLY_MAX_ACK_BLOCKS) {
-        quicly_ranges_drop_by_range_indices(&space->ack_queue, space->ack_queue.num_ranges - QUICLY_MAX_ACK_BLOCKS,
-                                            space->ack_queue.num_ranges);
+    } else {
+        quicly_ack_queue_shrink(&space->ack_queue, QUICLY_MAX_ACK_BLOCKS);
     }
 
     return 0;
@@ -2708,8 +3201,13 @@ static int on_ack_stream_ack_one(quicly_conn_t *conn, quicly_stream_id_t stream_
         return 0;
 
     size_t bytes_to_shift;
+    int was_complete = quicly_sendstate_transfer_complete(&stream->sendstate);
     if ((ret = quicly_sendstate_acked(&stream->sendstate, sent, &bytes_to_shift)) != 0)
         return ret;
+    quicly_latency_stats_t *latency;
+    if (!was_complete && quicly_sendstate_transfer_complete(&stream->sendstate) && stream->stream_id >= 0 &&
+        stream->_send_aux.reset_stream.sender_state == QUICLY_SENDER_STATE_NONE && (latency = get_latency_stats(conn)) != NULL)
+        quicly_histogram_record(&latency->stream_send_complete, conn->stash.now - stream->_created_at);
     if (bytes_to_shift != 0) {
         QUICLY_PROBE(STREAM_ON_SEND_SHIFT, stream->conn, stream->conn->stash.now, stream, bytes_to_shift);
         stream->callbacks->on_send_shift(stream, bytes_to_shift);
@@ -2987,7 +3485,7 @@ static int on_ack_retire_connection_id(quicly_sentmap_t *map, const quicly_sent_
 
 static int should_send_datagram_frame(quicly_conn_t *conn)
 {
-    if (conn->egress.datagram_frame_payloads.count == 0)
+    if (conn->egress.datagram_frames.size == 0)
         return 0;
     if (conn->application == NULL)
         return 0;
@@ -3073,6 +3571,8 @@ int64_t quicly_get_first_timeout(quicly_conn_t *conn)
         if (conn->egress.send_ack_at < at)
             at = conn->egress.send_ack_at;
     }
+    if (conn->ingress.throttled_recheck_at < at)
+        at = conn->ingress.throttled_recheck_at;
 
     return at;
 }
@@ -3390,8 +3890,11 @@ static int do_allocate_frame(quicly_conn_t *conn, quicly_send_context_t *s, size
         /* adjust ack-frequency */
         if (conn->stash.now >= conn->egress.ack_frequency.update_at) {
             assert(conn->super.remote.transport_params.min_ack_delay_usec != UINT64_MAX);
-            if (conn->egress.cc.num_loss_episodes >= QUICLY_FIRST_ACK_FREQUENCY_LOSS_EPISODE && conn->initial == NULL &&
-                conn->handshake == NULL) {
+            if (conn->super.ctx->adjust_ack_frequency != NULL) {
+                if (conn->initial == NULL && conn->handshake == NULL && (ret = adjust_ack_frequency(conn, &s->dst)) != 0)
+                    return ret;
+            } else if (conn->egress.cc.num_loss_episodes >= QUICLY_FIRST_ACK_FREQUENCY_LOSS_EPISODE && conn->initial == NULL &&
+                       conn->handshake == NULL) {
                 uint32_t fraction_of_cwnd = (uint32_t)((uint64_t)conn->egress.cc.cwnd * conn->super.ctx->ack_frequency / 1024);
                 if (fraction_of_cwnd >= conn->egress.max_udp_payload_size * 3) {
                     uint32_t packet_tolerance = fraction_of_cwnd / conn->egress.max_udp_payload_size;
@@ -3429,12 +3932,17 @@ static int allocate_ack_eliciting_frame(quicly_conn_t *conn, quicly_send_context
 
 static int send_ack(quicly_conn_t *conn, struct st_quicly_pn_space_t *space, quicly_send_context_t *s)
 {
+    quicly_range_t ack_ranges[QUICLY_MAX_ACK_BLOCKS];
+    quicly_ranges_t ranges = {.ranges = ack_ranges, .capacity = PTLS_ELEMENTSOF(ack_ranges)};
     uint64_t ack_delay;
     int ret;
 
-    if (space->ack_queue.num_ranges == 0)
+    if (quicly_ack_queue_is_empty(&space->ack_queue))
         return 0;
 
+    /* materialize the ranges on stack, for encoding the frame and for recording them to the sentmap */
+    ranges.num_ranges = quicly_ack_queue_get_ranges(&space->ack_queue, ack_ranges, PTLS_ELEMENTSOF(ack_ranges));
+
     /* calc ack_delay */
     if (space->largest_pn_received_at < conn->stash.now) {
         /* We underreport ack_delay up to 1 milliseconds assuming that QUICLY_LOCAL_ACK_DELAY_EXPONENT is 10. It's considered a
@@ -3448,7 +3956,7 @@ Emit: /* emit an ACK frame */
     if ((ret = do_allocate_frame(conn, s, QUICLY_ACK_FRAME_CAPACITY, ALLOCATE_FRAME_TYPE_NON_ACK_ELICITING)) != 0)
         return ret;
     uint8_t *dst = s->dst;
-    dst = quicly_encode_ack_frame(dst, s->dst_end, &space->ack_queue, ack_delay);
+    dst = quicly_encode_ack_frame(dst, s->dst_end, &ranges, ack_delay);
 
     /* when there's no space, retry with a new MTU-sized packet */
     if (dst == NULL) {
@@ -3465,14 +3973,14 @@ Emit: /* emit an ACK frame */
     }
 
     ++conn->super.stats.num_frames_sent.ack;
-    QUICLY_PROBE(ACK_SEND, conn, conn->stash.now, space->ack_queue.ranges[space->ack_queue.num_ranges - 1].end - 1, ack_delay);
+    QUICLY_PROBE(ACK_SEND, conn, conn->stash.now, ranges.ranges[ranges.num_ranges - 1].end - 1, ack_delay);
     QUICLY_LOG_CONN(ack_send, conn, {
-        PTLS_LOG_ELEMENT_UNSIGNED(largest_acked, space->ack_queue.ranges[space->ack_queue.num_ranges - 1].end - 1);
+        PTLS_LOG_ELEMENT_UNSIGNED(largest_acked, ranges.ranges[ranges.num_ranges - 1].end - 1);
         PTLS_LOG_ELEMENT_UNSIGNED(ack_delay, ack_delay);
     });
 
     /* when there are no less than QUICLY_NUM_ACK_BLOCKS_TO_INDUCE_ACKACK (8) gaps, bundle PING once every 4 packets being sent */
-    if (space->ack_queue.num_ranges >= QUICLY_NUM_ACK_BLOCKS_TO_INDUCE_ACKACK && conn->egress.packet_number % 4 == 0 &&
+    if (ranges.num_ranges >= QUICLY_NUM_ACK_BLOCKS_TO_INDUCE_ACKACK && conn->egress.packet_number % 4 == 0 &&
         dst < s->dst_end) {
         *dst++ = QUICLY_FRAME_TYPE_PING;
         ++conn->super.stats.num_frames_sent.ping;
@@ -3484,15 +3992,15 @@ Emit: /* emit an ACK frame */
 
     { /* save what's inflight */
         size_t range_index = 0;
-        while (range_index < space->ack_queue.num_ranges) {
+        while (range_index < ranges.num_ranges) {
             quicly_sent_t *sent;
             struct st_quicly_sent_ack_additional_t *additional, *additional_end;
             /* allocate */
             if ((sent = quicly_sentmap_allocate(&conn->egress.loss.sentmap, on_ack_ack_ranges8)) == NULL)
                 return PTLS_ERROR_NO_MEMORY;
             /* store the first range, as well as preparing references to the additional slots */
-            sent->data.ack.start = space->ack_queue.ranges[range_index].start;
-            uint64_t length = space->ack_queue.ranges[range_index].end - space->ack_queue.ranges[range_index].start;
+            sent->data.ack.start = ranges.ranges[range_index].start;
+            uint64_t length = ranges.ranges[range_index].end - ranges.ranges[range_index].start;
             if (length <= UINT8_MAX) {
                 sent->data.ack.ranges8.start_length = length;
                 additional = sent->data.ack.ranges8.additional;
@@ -3504,10 +4012,10 @@ Emit: /* emit an ACK frame */
                 additional_end = additional + PTLS_ELEMENTSOF(sent->data.ack.ranges64.additional);
             }
             /* store additional ranges, if possible */
-            for (++range_index; range_index < space->ack_queue.num_ranges && additional < additional_end;
+            for (++range_index; range_index < ranges.num_ranges && additional < additional_end;
                  ++range_index, ++additional) {
-                uint64_t gap = space->ack_queue.ranges[range_index].start - space->ack_queue.ranges[range_index - 1].end;
-                uint64_t length = space->ack_queue.ranges[range_index].end - space->ack_queue.ranges[range_index].start;
+                uint64_t gap = ranges.ranges[range_index].start - ranges.ranges[range_index - 1].end;
+                uint64_t length = ranges.ranges[range_index].end - ranges.ranges[range_index].start;
                 if (gap > UINT8_MAX || length > UINT8_MAX)
                     break;
                 additional->gap = gap;
@@ -3560,8 +4068,20 @@ static int send_control_frames_of_stream(quicly_stream_t *stream, quicly_send_co
 
     /* send MAX_STREAM_DATA if necessary */
     if (should_send_max_stream_data(stream)) {
-        uint64_t new_value = stream->recvstate.data_off + stream->_recv_aux.window;
         quicly_sent_t *sent;
+        /* auto-tune the window, growing `max_ranges` proportionally (see the doc-comment of `_recv_aux.max_ranges`) */
+        if (stream->conn->super.ctx->max_receive_window.max_stream_data != 0) {
+            uint64_t max_window = stream->conn->super.ctx->max_receive_window.max_stream_data;
+            if (max_window > UINT32_MAX)
+                max_window = UINT32_MAX;
+            stream->_recv_aux.window = (uint32_t)autotune_receive_window(stream->conn, stream->_recv_aux.window, max_window,
+                                                                         &stream->_recv_aux.window_updated_at);
+            if (stream->_recv_aux.max_ranges < stream->_recv_aux.window / 1024)
+                stream->_recv_aux.max_ranges = stream->_recv_aux.window / 1024;
+        }
+        uint64_t new_value = stream->recvstate.data_off + throttle_receive_window(stream->conn, stream->_recv_aux.window);
+        if (new_value < (uint64_t)stream->_send_aux.max_stream_data_sender.max_committed)
+            new_value = stream->_send_aux.max_stream_data_sender.max_committed; /* under pressure; resend the current maximum */
         /* prepare */
         if ((ret = allocate_ack_eliciting_frame(stream->conn, s, QUICLY_MAX_STREAM_DATA_FRAME_CAPACITY, &sent,
                                                 on_ack_max_stream_data)) != 0)
@@ -3946,6 +4466,7 @@ static void on_loss_detected(quicly_loss_t *loss, const quicly_sent_packet_t *lo
     });
     QUICLY_PROBE(QUICTRACE_CC_LOST, conn, conn->stash.now, &conn->egress.loss.rtt, conn->egress.cc.cwnd,
                  conn->egress.loss.sentmap.bytes_in_flight);
+    on_loss_detected_persistent_congestion(conn, lost_packet);
 }
 
 static int send_max_streams(quicly_conn_t *conn, int uni, quicly_send_context_t *s)
@@ -4553,6 +5074,7 @@ static int do_send(quicly_conn_t *conn, quicly_send_context_t *s)
             PTLS_LOG_ELEMENT_UNSIGNED(rtt_smoothed, conn->egress.loss.rtt.smoothed);
         });
         conn->super.stats.num_handshake_timeouts++;
+        dump_flight_recorder(conn, QUICLY_FLIGHT_RECORDER_REASON_HANDSHAKE_TIMEOUT);
         goto CloseNow;
     }
     if (conn->super.stats.num_packets.initial_handshake_sent > conn->super.ctx->max_initial_handshake_packets) {
@@ -4582,6 +5104,9 @@ static int do_send(quicly_conn_t *conn, quicly_send_context_t *s)
                 PTLS_LOG_ELEMENT_SIGNED(pto_count, conn->egress.loss.pto_count);
             });
             ++conn->super.stats.num_ptos;
+            if (conn->flight_recorder.ring != NULL && conn->super.ctx->flight_recorder->pto_threshold != 0 &&
+                conn->egress.loss.pto_count == conn->super.ctx->flight_recorder->pto_threshold)
+                dump_flight_recorder(conn, QUICLY_FLIGHT_RECORDER_REASON_PTO_STORM);
             size_t bytes_to_mark = min_packets_to_send * conn->egress.max_udp_payload_size;
             if (conn->initial != NULL && (ret = mark_frames_on_pto(conn, QUICLY_EPOCH_INITIAL, &bytes_to_mark)) != 0)
                 goto Exit;
@@ -4619,14 +5144,16 @@ static int do_send(quicly_conn_t *conn, quicly_send_context_t *s)
             if ((ret = send_ack(conn, &conn->application->super, s)) != 0)
                 goto Exit;
         }
-        /* DATAGRAM frame. Notes regarding current implementation:
+        /* DATAGRAM frames; as many as possible are coalesced into each packet. Notes regarding current implementation:
          * * Not limited by CC, nor the bytes counted by CC.
+         * * Frames that cannot be sent due to the lack of space in the send buffer remain queued for the next invocation.
          * * When given payload is too large and does not fit into a QUIC packet, a packet containing only PADDING frames is sent.
-         *   This is because we do not have a way to retract the generation of a QUIC packet.
-         * * Does not notify the application that the frame was dropped internally. */
+         *   This is because we do not have a way to retract the generation of a QUIC packet. */
         if (should_send_datagram_frame(conn)) {
-            for (size_t i = 0; i != conn->egress.datagram_frame_payloads.count; ++i) {
-                ptls_iovec_t *payload = conn->egress.datagram_frame_payloads.payloads + i;
+            quicly_datagram_t *datagram;
+            quicly_datagram_queue_expire(&conn->egress.datagram_frames, conn->stash.now);
+            while ((datagram = quicly_datagram_queue_peek(&conn->egress.datagram_frames)) != NULL) {
+                ptls_iovec_t *payload = &datagram->payload;
                 size_t required_space = quicly_datagram_frame_capacity(*payload);
                 if ((ret = do_allocate_frame(conn, s, required_space, ALLOCATE_FRAME_TYPE_ACK_ELICITING_NO_CC)) != 0)
                     goto Exit;
@@ -4635,10 +5162,13 @@ static int do_send(quicly_conn_t *conn, quicly_send_context_t *s)
                     QUICLY_PROBE(DATAGRAM_SEND, conn, conn->stash.now, payload->base, payload->len);
                     QUICLY_LOG_CONN(datagram_send, conn,
                                     { PTLS_LOG_APPDATA_ELEMENT_HEXDUMP(payload, payload->base, payload->len); });
+                    quicly_datagram_queue_shift(&conn->egress.datagram_frames, 1);
                 } else {
                     /* FIXME: At the moment, we add a padding because we do not have a way to reclaim allocated space, and because
                      * it is forbidden to send an empty QUIC packet. */
                     *s->dst++ = QUICLY_FRAME_TYPE_PADDING;
+                    ++conn->egress.datagram_frames.num_datagrams.dropped;
+                    quicly_datagram_queue_shift(&conn->egress.datagram_frames, 0);
                 }
             }
         }
@@ -4695,7 +5225,15 @@ static int do_send(quicly_conn_t *conn, quicly_send_context_t *s)
                     quicly_sent_t *sent;
                     if ((ret = allocate_ack_eliciting_frame(conn, s, QUICLY_MAX_DATA_FRAME_CAPACITY, &sent, on_ack_max_data)) != 0)
                         goto Exit;
-                    uint64_t new_value = conn->ingress.max_data.bytes_consumed + conn->super.ctx->transport_params.max_data;
+                    if (conn->super.ctx->max_receive_window.max_data != 0)
+                        conn->ingress.max_data.window =
+                            autotune_receive_window(conn, conn->ingress.max_data.window,
+                                                    conn->super.ctx->max_receive_window.max_data,
+                                                    &conn->ingress.max_data.window_updated_at);
+                    uint64_t new_value =
+                        conn->ingress.max_data.bytes_consumed + throttle_receive_window(conn, conn->ingress.max_data.window);
+                    if (new_value < (uint64_t)conn->ingress.max_data.sender.max_committed)
+                        new_value = conn->ingress.max_data.sender.max_committed; /* under pressure; resend the current maximum */
                     s->dst = quicly_encode_max_data_frame(s->dst, new_value);
                     quicly_maxsender_record(&conn->ingress.max_data.sender, new_value, &sent->data.max_data.args);
                     ++conn->super.stats.num_frames_sent.max_data;
@@ -4790,17 +5328,21 @@ CloseNow:
 void quicly_send_datagram_frames(quicly_conn_t *conn, ptls_iovec_t *datagrams, size_t num_datagrams)
 {
     for (size_t i = 0; i != num_datagrams; ++i) {
-        if (conn->egress.datagram_frame_payloads.count == PTLS_ELEMENTSOF(conn->egress.datagram_frame_payloads.payloads))
+        quicly_datagram_t datagram = {.expire_at = INT64_MAX, .release = release_copied_datagram_frame};
+        if ((datagram.payload.base = malloc(datagrams[i].len)) == NULL)
             break;
-        void *copied;
-        if ((copied = malloc(datagrams[i].len)) == NULL)
+        memcpy(datagram.payload.base, datagrams[i].base, datagrams[i].len);
+        datagram.payload.len = datagrams[i].len;
+        if (quicly_datagram_queue_push(&conn->egress.datagram_frames, &datagram) != 0)
             break;
-        memcpy(copied, datagrams[i].base, datagrams[i].len);
-        conn->egress.datagram_frame_payloads.payloads[conn->egress.datagram_frame_payloads.count++] =
-            ptls_iovec_init(copied, datagrams[i].len);
     }
 }
 
+int quicly_enqueue_datagram_frame(quicly_conn_t *conn, const quicly_datagram_t *datagram)
+{
+    return quicly_datagram_queue_push(&conn->egress.datagram_frames, datagram);
+}
+
 int quicly_set_cc(quicly_conn_t *conn, quicly_cc_type_t *cc)
 {
     return cc->cc_switch(&conn->egress.cc);
@@ -4863,6 +5405,8 @@ int quicly_send(quicly_conn_t *conn, quicly_address_t *dest, quicly_address_t *s
         goto Exit;
     }
 
+    recheck_throttled_receive_windows(conn);
+
     /* emit packets */
     if ((ret = do_send(conn, &s)) != 0)
         goto Exit;
@@ -4870,7 +5414,6 @@ int quicly_send(quicly_conn_t *conn, quicly_address_t *dest, quicly_address_t *s
     assert_consistency(conn, 1);
 
 Exit:
-    clear_datagram_frame_payloads(conn);
     if (s.num_datagrams != 0) {
         *dest = conn->super.remote.address;
         *src = conn->super.local.address;
@@ -5017,6 +5560,10 @@ int initiate_close(quicly_conn_t *conn, int err, uint64_t frame_type, const char
     conn->egress.connection_close.error_code = quic_error_code;
     conn->egress.connection_close.frame_type = frame_type;
     conn->egress.connection_close.reason_phrase = reason_phrase;
+    conn->egress.connection_close.is_error = !(err == 0 || err == QUICLY_ERROR_FROM_TRANSPORT_ERROR_CODE(0) ||
+                                               err == QUICLY_ERROR_FROM_APPLICATION_ERROR_CODE(0));
+    if (conn->egress.connection_close.is_error)
+        dump_flight_recorder(conn, QUICLY_FLIGHT_RECORDER_REASON_CLOSE_ERROR);
     return enter_close(conn, 1, 0);
 }
 
@@ -5129,6 +5676,7 @@ static int handle_reset_stream_frame(quicly_conn_t *conn, struct st_quicly_handl
         if ((ret = quicly_recvstate_reset(&stream->recvstate, frame.final_size, &bytes_missing)) != 0)
             return ret;
         stream->conn->ingress.max_data.bytes_consumed += bytes_missing;
+        update_recvbuf_memory_charge(stream, 0);
         int err = QUICLY_ERROR_FROM_APPLICATION_ERROR_CODE(frame.app_error_code);
         QUICLY_PROBE(STREAM_ON_RECEIVE_RESET, stream->conn, stream->conn->stash.now, stream, err);
         QUICLY_LOG_CONN(stream_on_receive_reset, stream->conn, {
@@ -5257,11 +5805,18 @@ static int handle_ack_frame(quicly_conn_t *conn, struct st_quicly_handle_payload
 
     /* Update loss detection engine on ack. The function uses ack_delay only when the largest_newly_acked is also the largest acked
      * so far. So, it does not matter if the ack_delay being passed in does not apply to the largest_newly_acked. */
+    int takes_rtt_sample = includes_ack_eliciting && largest_newly_acked.pn != UINT64_MAX &&
+                           conn->egress.loss.largest_acked_packet_plus1[state->epoch] <= largest_newly_acked.pn;
     quicly_loss_on_ack_received(&conn->egress.loss, largest_newly_acked.pn, state->epoch, conn->stash.now,
                                 largest_newly_acked.sent_at, frame.ack_delay,
                                 includes_ack_eliciting ? includes_late_ack ? QUICLY_LOSS_ACK_RECEIVED_KIND_ACK_ELICITING_LATE_ACK
                                                                            : QUICLY_LOSS_ACK_RECEIVED_KIND_ACK_ELICITING
                                                        : QUICLY_LOSS_ACK_RECEIVED_KIND_NON_ACK_ELICITING);
+    quicly_latency_stats_t *latency;
+    if (takes_rtt_sample && (latency = get_latency_stats(conn)) != NULL)
+        quicly_histogram_record(&latency->rtt, conn->egress.loss.rtt.latest);
+    if (largest_newly_acked.pn != UINT64_MAX)
+        conn->flight_recorder.lost_since = INT64_MAX;
 
     /* OnPacketAcked and OnPacketAckedCC */
     if (bytes_acked > 0) {
@@ -5666,6 +6221,11 @@ int handle_close(quicly_conn_t *conn, int err, uint64_t frame_type, ptls_iovec_t
     if (conn->super.state >= QUICLY_STATE_CLOSING)
         return 0;
 
+    conn->egress.connection_close.is_error =
+        !(err == QUICLY_ERROR_FROM_TRANSPORT_ERROR_CODE(0) || err == QUICLY_ERROR_FROM_APPLICATION_ERROR_CODE(0));
+    if (conn->egress.connection_close.is_error)
+        dump_flight_recorder(conn, QUICLY_FLIGHT_RECORDER_REASON_CLOSE_ERROR);
+
     /* switch to closing state, notify the app (at this moment the streams are accessible), then destroy the streams */
     if ((ret = enter_close(conn, 0,
                            !(err == QUICLY_ERROR_RECEIVED_STATELESS_RESET || err == QUICLY_ERROR_NO_COMPATIBLE_VERSION))) != 0)
@@ -6092,6 +6652,7 @@ int quicly_accept(quicly_conn_t **conn, quicly_context_t *ctx, struct sockaddr *
     cipher.alive = 0;
     (*conn)->crypto.handshake_properties.collected_extensions = server_collected_extensions;
     (*conn)->initial->largest_ingress_udp_payload_size = packet->datagram_size;
+    init_qlog(*conn);
 
     QUICLY_PROBE(ACCEPT, *conn, (*conn)->stash.now,
                  QUICLY_PROBE_HEXDUMP(packet->cid.dest.encrypted.base, packet->cid.dest.encrypted.len), address_token);
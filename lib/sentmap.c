@@ -65,6 +65,7 @@ static struct st_quicly_sent_block_t **free_block(quicly_sentmap_t *map, struct
     }
 
     free(block);
+    --map->num_blocks;
     return ref;
 }
 
@@ -90,6 +91,7 @@ void quicly_sentmap_dispose(quicly_sentmap_t *map)
         map->head = block->next;
         free(block);
     }
+    map->num_blocks = 0;
 }
 
 int quicly_sentmap_prepare(quicly_sentmap_t *map, uint64_t packet_number, int64_t now, uint8_t ack_epoch)
@@ -108,6 +110,7 @@ struct st_quicly_sent_block_t *quicly_sentmap__new_block(quicly_sentmap_t *map)
 
     if ((block = malloc(sizeof(*block))) == NULL)
         return NULL;
+    ++map->num_blocks;
 
     block->next = NULL;
     block->num_entries = 0;
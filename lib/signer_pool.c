@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "quicly/linklist.h"
+#include "quicly/signer_pool.h"
+
+struct st_quicly_signer_pool_t {
+    /**
+     * the signer being exposed to picotls; must be the first member
+     */
+    ptls_sign_certificate_t super;
+    /**
+     * the synchronous signer being called by the workers
+     */
+    ptls_sign_certificate_t *signer;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    /**
+     * list of jobs waiting for a worker, in FIFO order
+     */
+    quicly_linklist_t queue;
+    int shutdown;
+    /**
+     * modified while holding `mutex`, but read without the lock using atomic loads (see `quicly_signer_pool_get_stats`)
+     */
+    quicly_signer_pool_stats_t stats;
+    size_t num_threads;
+    pthread_t threads[1];
+};
+
+struct st_quicly_signer_job_t {
+    /**
+     * the async job object being handed to picotls; must be the first member
+     */
+    ptls_async_job_t super;
+    quicly_signer_pool_t *pool;
+    quicly_linklist_t link;
+    enum { QUICLY_SIGNER_JOB_QUEUED, QUICLY_SIGNER_JOB_RUNNING, QUICLY_SIGNER_JOB_COMPLETE } state;
+    /**
+     * set when the job is destroyed while a worker is running it; the worker frees the job
+     */
+    unsigned abandoned : 1;
+    struct {
+        void (*cb)(void *);
+        void *data;
+    } on_complete;
+    uint64_t queued_at;
+    ptls_t *tls;
+    struct {
+        int ret;
+        uint16_t selected_algorithm;
+        ptls_buffer_t output;
+    } result;
+    ptls_iovec_t input;
+    size_t num_algorithms;
+    /**
+     * list of algorithms offered by the peer, followed by the input being signed
+     */
+    uint16_t algorithms[1];
+};
+
+#define STATS_ADD(pool, name, delta) __atomic_add_fetch(&(pool)->stats.name, (delta), __ATOMIC_RELAXED)
+#define STATS_SUB(pool, name, delta) __atomic_sub_fetch(&(pool)->stats.name, (delta), __ATOMIC_RELAXED)
+
+static uint64_t now_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void free_job(struct st_quicly_signer_job_t *job)
+{
+    ptls_buffer_dispose(&job->result.output);
+    free(job);
+}
+
+static void job_destroy(ptls_async_job_t *_job)
+{
+    struct st_quicly_signer_job_t *job = (void *)_job;
+    quicly_signer_pool_t *pool = job->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    switch (job->state) {
+    case QUICLY_SIGNER_JOB_QUEUED:
+        quicly_linklist_unlink(&job->link);
+        STATS_SUB(pool, num_queued, 1);
+        free_job(job);
+        break;
+    case QUICLY_SIGNER_JOB_RUNNING:
+        job->abandoned = 1;
+        break;
+    case QUICLY_SIGNER_JOB_COMPLETE:
+        free_job(job);
+        break;
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void job_set_completion_callback(ptls_async_job_t *_job, void (*cb)(void *), void *cbdata)
+{
+    struct st_quicly_signer_job_t *job = (void *)_job;
+    quicly_signer_pool_t *pool = job->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (job->state == QUICLY_SIGNER_JOB_COMPLETE) {
+        /* the worker has already finished; notify immediately */
+        pthread_mutex_unlock(&pool->mutex);
+        cb(cbdata);
+        return;
+    }
+    job->on_complete.cb = cb;
+    job->on_complete.data = cbdata;
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void *worker_main(void *_pool)
+{
+    quicly_signer_pool_t *pool = _pool;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    while (1) {
+        /* wait for a job */
+        while (!quicly_linklist_is_linked(&pool->queue)) {
+            if (pool->shutdown)
+                goto Exit;
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        }
+        struct st_quicly_signer_job_t *job =
+            (void *)((char *)pool->queue.next - offsetof(struct st_quicly_signer_job_t, link));
+        quicly_linklist_unlink(&job->link);
+        job->state = QUICLY_SIGNER_JOB_RUNNING;
+        STATS_SUB(pool, num_queued, 1);
+        STATS_ADD(pool, num_running, 1);
+        STATS_ADD(pool, total_queue_time_usec, now_usec() - job->queued_at);
+
+        /* sign, without holding the lock */
+        pthread_mutex_unlock(&pool->mutex);
+        job->result.ret = pool->signer->cb(pool->signer, job->tls, NULL, &job->result.selected_algorithm, &job->result.output,
+                                           job->input, job->algorithms, job->num_algorithms);
+        pthread_mutex_lock(&pool->mutex);
+
+        STATS_SUB(pool, num_running, 1);
+        STATS_ADD(pool, num_completed, 1);
+        job->state = QUICLY_SIGNER_JOB_COMPLETE;
+        if (job->abandoned) {
+            free_job(job);
+        } else if (job->on_complete.cb != NULL) {
+            /* the job might be destroyed as soon as the lock is released, hence copy the callback */
+            void (*cb)(void *) = job->on_complete.cb;
+            void *cbdata = job->on_complete.data;
+            pthread_mutex_unlock(&pool->mutex);
+            cb(cbdata);
+            pthread_mutex_lock(&pool->mutex);
+        }
+    }
+
+Exit:
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static int emit_result(struct st_quicly_signer_job_t *job, uint16_t *selected_algorithm, ptls_buffer_t *output)
+{
+    int ret;
+
+    if ((ret = job->result.ret) != 0)
+        goto Exit;
+    *selected_algorithm = job->result.selected_algorithm;
+    ptls_buffer_pushv(output, job->result.output.base, job->result.output.off);
+
+Exit:
+    return ret;
+}
+
+static int sign_certificate(ptls_sign_certificate_t *_self, ptls_t *tls, ptls_async_job_t **async, uint16_t *selected_algorithm,
+                            ptls_buffer_t *output, ptls_iovec_t input, const uint16_t *algorithms, size_t num_algorithms)
+{
+    quicly_signer_pool_t *pool = (void *)_self;
+    struct st_quicly_signer_job_t *job;
+    int ret;
+
+    /* sign synchronously if picotls does not allow the operation to be asynchronous */
+    if (async == NULL)
+        return pool->signer->cb(pool->signer, tls, NULL, selected_algorithm, output, input, algorithms, num_algorithms);
+
+    /* handshake is being resumed; emit the result */
+    if (*async != NULL) {
+        job = (void *)*async;
+        assert(job->state == QUICLY_SIGNER_JOB_COMPLETE);
+        ret = emit_result(job, selected_algorithm, output);
+        job_destroy(&job->super);
+        *async = NULL;
+        return ret;
+    }
+
+    /* create new job and queue it */
+    if ((job = malloc(sizeof(*job) + sizeof(job->algorithms[0]) * num_algorithms + input.len)) == NULL)
+        return PTLS_ERROR_NO_MEMORY;
+    *job = (struct st_quicly_signer_job_t){
+        .super = {.destroy_ = job_destroy, .set_completion_callback = job_set_completion_callback},
+        .pool = pool,
+        .state = QUICLY_SIGNER_JOB_QUEUED,
+        .queued_at = now_usec(),
+        .tls = tls,
+        .num_algorithms = num_algorithms,
+    };
+    quicly_linklist_init(&job->link);
+    ptls_buffer_init(&job->result.output, "", 0);
+    memcpy(job->algorithms, algorithms, sizeof(job->algorithms[0]) * num_algorithms);
+    job->input = ptls_iovec_init(job->algorithms + num_algorithms, input.len);
+    memcpy(job->input.base, input.base, input.len);
+
+    pthread_mutex_lock(&pool->mutex);
+    quicly_linklist_insert(pool->queue.prev, &job->link);
+    STATS_ADD(pool, num_queued, 1);
+    if (pool->stats.num_queued > pool->stats.max_queued)
+        __atomic_store_n(&pool->stats.max_queued, pool->stats.num_queued, __ATOMIC_RELAXED);
+    STATS_ADD(pool, num_submitted, 1);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    *async = &job->super;
+    return PTLS_ERROR_ASYNC_OPERATION;
+}
+
+static void stop_workers(quicly_signer_pool_t *pool, size_t num_threads)
+{
+    size_t i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i != num_threads; ++i)
+        pthread_join(pool->threads[i], NULL);
+}
+
+quicly_signer_pool_t *quicly_signer_pool_create(ptls_sign_certificate_t *signer, size_t num_threads)
+{
+    quicly_signer_pool_t *pool;
+    size_t i;
+
+    assert(num_threads != 0);
+
+    if ((pool = malloc(offsetof(quicly_signer_pool_t, threads) + sizeof(pool->threads[0]) * num_threads)) == NULL)
+        return NULL;
+    *pool = (quicly_signer_pool_t){.super = {sign_certificate}, .signer = signer, .num_threads = num_threads};
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    quicly_linklist_init(&pool->queue);
+
+    for (i = 0; i != num_threads; ++i) {
+        if (pthread_create(pool->threads + i, NULL, worker_main, pool) != 0) {
+            stop_workers(pool, i);
+            pthread_cond_destroy(&pool->cond);
+            pthread_mutex_destroy(&pool->mutex);
+            free(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void quicly_signer_pool_destroy(quicly_signer_pool_t *pool)
+{
+    stop_workers(pool, pool->num_threads);
+    assert(!quicly_linklist_is_linked(&pool->queue));
+    assert(pool->stats.num_running == 0);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+ptls_sign_certificate_t *quicly_signer_pool_get_sign_certificate(quicly_signer_pool_t *pool)
+{
+    return &pool->super;
+}
+
+void quicly_signer_pool_get_stats(quicly_signer_pool_t *pool, quicly_signer_pool_stats_t *stats)
+{
+#define LOAD(name) stats->name = __atomic_load_n(&pool->stats.name, __ATOMIC_RELAXED)
+    LOAD(num_queued);
+    LOAD(max_queued);
+    LOAD(num_running);
+    LOAD(num_submitted);
+    LOAD(num_completed);
+    LOAD(total_queue_time_usec);
+#undef LOAD
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "quicly/stats_aggregate.h"
+
+#define NUM_COUNTERS (sizeof(quicly_aggregated_stats_t) / sizeof(uint64_t))
+
+/**
+ * As each shard is updated only by the owning thread, relaxed loads and stores (that compile to plain moves) are sufficient for
+ * letting other threads read the counters without tearing.
+ */
+#define LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+struct st_quicly_stats_shard_t {
+    /**
+     * the counters; written only by `owner`, read by any thread
+     */
+    uint64_t counters[NUM_COUNTERS];
+    quicly_latency_stats_t latency;
+    pthread_t owner;
+    struct st_quicly_stats_shard_t *next;
+};
+
+struct st_quicly_stats_aggregate_t {
+    /**
+     * unique identifier of the aggregate, used as the key of the per-thread cache
+     */
+    uint64_t id;
+    /**
+     * protects `shards`; the lock is taken only when a thread touches the aggregate for the first time and when taking snapshots
+     */
+    pthread_mutex_t mutex;
+    /**
+     * linked list of shards
+     */
+    struct st_quicly_stats_shard_t *shards;
+};
+
+/**
+ * shard of the aggregate that the calling thread has used most recently
+ */
+static __thread struct {
+    uint64_t aggregate_id;
+    struct st_quicly_stats_shard_t *shard;
+} thread_shard;
+
+quicly_stats_aggregate_t *quicly_stats_aggregate_create(void)
+{
+    static uint64_t next_id = 1;
+    quicly_stats_aggregate_t *aggregate;
+
+    PTLS_BUILD_ASSERT(sizeof(quicly_aggregated_stats_t) % sizeof(uint64_t) == 0);
+
+    if ((aggregate = malloc(sizeof(*aggregate))) == NULL)
+        return NULL;
+    aggregate->id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+    pthread_mutex_init(&aggregate->mutex, NULL);
+    aggregate->shards = NULL;
+
+    return aggregate;
+}
+
+void quicly_stats_aggregate_destroy(quicly_stats_aggregate_t *aggregate)
+{
+    while (aggregate->shards != NULL) {
+        struct st_quicly_stats_shard_t *shard = aggregate->shards;
+        aggregate->shards = shard->next;
+        free(shard);
+    }
+    pthread_mutex_destroy(&aggregate->mutex);
+    free(aggregate);
+}
+
+static struct st_quicly_stats_shard_t *get_thread_shard(quicly_stats_aggregate_t *aggregate)
+{
+    struct st_quicly_stats_shard_t *shard;
+    pthread_t self = pthread_self();
+
+    if (thread_shard.aggregate_id == aggregate->id)
+        return thread_shard.shard;
+
+    pthread_mutex_lock(&aggregate->mutex);
+    for (shard = aggregate->shards; shard != NULL; shard = shard->next)
+        if (pthread_equal(shard->owner, self))
+            break;
+    if (shard == NULL && (shard = malloc(sizeof(*shard))) != NULL) {
+        memset(shard->counters, 0, sizeof(shard->counters));
+        memset(&shard->latency, 0, sizeof(shard->latency));
+        shard->owner = self;
+        shard->next = aggregate->shards;
+        aggregate->shards = shard;
+    }
+    pthread_mutex_unlock(&aggregate->mutex);
+
+    if (shard != NULL) {
+        thread_shard.aggregate_id = aggregate->id;
+        thread_shard.shard = shard;
+    }
+    return shard;
+}
+
+void quicly_stats_aggregate_add(quicly_stats_aggregate_t *aggregate, const quicly_aggregated_stats_t *delta)
+{
+    struct st_quicly_stats_shard_t *shard;
+    const uint64_t *src = (const uint64_t *)delta;
+    size_t i;
+
+    if ((shard = get_thread_shard(aggregate)) == NULL)
+        return;
+
+    for (i = 0; i != NUM_COUNTERS; ++i)
+        if (src[i] != 0)
+            STORE(&shard->counters[i], LOAD(&shard->counters[i]) + src[i]);
+}
+
+/**
+ * merges `src` into `dst` being read concurrently by other threads; see `quicly_stats_aggregate_add`
+ */
+static void merge_histogram_relaxed(quicly_histogram_t *dst, const quicly_histogram_t *src)
+{
+    size_t i;
+
+    if (src->count == 0)
+        return;
+
+    STORE(&dst->count, LOAD(&dst->count) + src->count);
+    STORE(&dst->sum, LOAD(&dst->sum) + src->sum);
+    if (LOAD(&dst->max) < src->max)
+        STORE(&dst->max, src->max);
+    for (i = 0; i != QUICLY_HISTOGRAM_NUM_BUCKETS; ++i) {
+        if (src->buckets[i] != 0) {
+            uint32_t cur = LOAD(&dst->buckets[i]), sum = cur + src->buckets[i];
+            STORE(&dst->buckets[i], sum >= cur ? sum : UINT32_MAX);
+        }
+    }
+}
+
+static void load_histogram_relaxed(quicly_histogram_t *dst, const quicly_histogram_t *src)
+{
+    size_t i;
+
+    dst->count = LOAD(&src->count);
+    dst->sum = LOAD(&src->sum);
+    dst->max = LOAD(&src->max);
+    for (i = 0; i != QUICLY_HISTOGRAM_NUM_BUCKETS; ++i)
+        dst->buckets[i] = LOAD(&src->buckets[i]);
+}
+
+#define FOREACH_LATENCY_HISTOGRAM(apply) apply(rtt) apply(handshake) apply(stream_first_byte) apply(stream_send_complete)
+
+void quicly_stats_aggregate_add_latency(quicly_stats_aggregate_t *aggregate, const quicly_latency_stats_t *latency)
+{
+    struct st_quicly_stats_shard_t *shard;
+
+    if ((shard = get_thread_shard(aggregate)) == NULL)
+        return;
+
+#define MERGE(name) merge_histogram_relaxed(&shard->latency.name, &latency->name);
+    FOREACH_LATENCY_HISTOGRAM(MERGE);
+#undef MERGE
+}
+
+void quicly_stats_aggregate_snapshot_latency(quicly_stats_aggregate_t *aggregate, quicly_latency_stats_t *latency)
+{
+    quicly_histogram_t hist;
+
+    memset(latency, 0, sizeof(*latency));
+
+    pthread_mutex_lock(&aggregate->mutex);
+    for (struct st_quicly_stats_shard_t *shard = aggregate->shards; shard != NULL; shard = shard->next) {
+#define MERGE(name)                                                                                                                \
+    load_histogram_relaxed(&hist, &shard->latency.name);                                                                           \
+    quicly_histogram_merge(&latency->name, &hist);
+        FOREACH_LATENCY_HISTOGRAM(MERGE);
+#undef MERGE
+    }
+    pthread_mutex_unlock(&aggregate->mutex);
+}
+
+void quicly_stats_aggregate_snapshot(quicly_stats_aggregate_t *aggregate, quicly_aggregated_stats_t *stats)
+{
+    uint64_t *dst = (uint64_t *)stats;
+    size_t i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&aggregate->mutex);
+    for (struct st_quicly_stats_shard_t *shard = aggregate->shards; shard != NULL; shard = shard->next)
+        for (i = 0; i != NUM_COUNTERS; ++i)
+            dst[i] += LOAD(&shard->counters[i]);
+    pthread_mutex_unlock(&aggregate->mutex);
+}
@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include "quicly/freelist.h"
 #include "quicly/streambuf.h"
 
 static void convert_error(quicly_stream_t *stream, int err)
@@ -38,57 +39,131 @@ static void convert_error(quicly_stream_t *stream, int err)
     }
 }
 
+static struct st_quicly_sendbuf_entry_t *get_sendbuf_entry(quicly_sendbuf_t *sb, size_t index)
+{
+    assert(index < sb->vecs.size);
+    return sb->vecs.entries + ((sb->vecs.first + index) & (sb->vecs.capacity - 1));
+}
+
+static const quicly_streambuf_sendvec_callbacks_t chunk_callbacks;
+
+/**
+ * returns if the vector refers to a chunk owned by the send buffer, i.e. if the bytes are charged to the memory budget
+ */
+static int sendbuf_vec_is_owned(quicly_sendbuf_vec_t *vec)
+{
+    return vec->cb == &chunk_callbacks;
+}
+
+static void charge_sendbuf(quicly_stream_t *stream, quicly_sendbuf_t *sb, size_t len)
+{
+    if ((sb->memory_budget = quicly_get_context(stream->conn)->memory_budget) != NULL)
+        quicly_memory_budget_charge(sb->memory_budget, len);
+}
+
 void quicly_sendbuf_dispose(quicly_sendbuf_t *sb)
 {
-    size_t i;
+    size_t i, bytes_buffered = 0;
 
     for (i = 0; i != sb->vecs.size; ++i) {
-        quicly_sendbuf_vec_t *vec = sb->vecs.entries + i;
+        quicly_sendbuf_vec_t *vec = &get_sendbuf_entry(sb, i)->vec;
+        if (sendbuf_vec_is_owned(vec))
+            bytes_buffered += vec->len - (i == 0 ? sb->off_in_first_vec : 0);
         if (vec->cb->discard_vec != NULL)
             vec->cb->discard_vec(vec);
     }
     free(sb->vecs.entries);
+
+    if (sb->memory_budget != NULL)
+        quicly_memory_budget_release(sb->memory_budget, bytes_buffered);
 }
 
 void quicly_sendbuf_shift(quicly_stream_t *stream, quicly_sendbuf_t *sb, size_t delta)
 {
-    size_t i;
+    size_t num_popped = 0, bytes_released = 0;
 
-    for (i = 0; delta != 0; ++i) {
-        assert(i < sb->vecs.size);
-        quicly_sendbuf_vec_t *first_vec = sb->vecs.entries + i;
+    while (delta != 0) {
+        assert(sb->vecs.size != 0);
+        quicly_sendbuf_vec_t *first_vec = &get_sendbuf_entry(sb, 0)->vec;
         size_t bytes_in_first_vec = first_vec->len - sb->off_in_first_vec;
         if (delta < bytes_in_first_vec) {
+            if (sendbuf_vec_is_owned(first_vec))
+                bytes_released += delta;
             sb->off_in_first_vec += delta;
             break;
         }
+        if (sendbuf_vec_is_owned(first_vec))
+            bytes_released += bytes_in_first_vec;
         delta -= bytes_in_first_vec;
         if (first_vec->cb->discard_vec != NULL)
             first_vec->cb->discard_vec(first_vec);
         sb->off_in_first_vec = 0;
+        sb->vecs.first = (sb->vecs.first + 1) & (sb->vecs.capacity - 1);
+        --sb->vecs.size;
+        ++num_popped;
     }
-    if (i != 0) {
-        if (sb->vecs.size != i) {
-            memmove(sb->vecs.entries, sb->vecs.entries + i, (sb->vecs.size - i) * sizeof(*sb->vecs.entries));
-            sb->vecs.size -= i;
-        } else {
+    if (num_popped != 0) {
+        sb->emit_cursor = sb->emit_cursor > num_popped ? sb->emit_cursor - num_popped : 0;
+        if (sb->vecs.size == 0) {
             free(sb->vecs.entries);
             sb->vecs.entries = NULL;
-            sb->vecs.size = 0;
+            sb->vecs.first = 0;
             sb->vecs.capacity = 0;
         }
     }
+    if (sb->memory_budget != NULL && bytes_released != 0)
+        quicly_memory_budget_release(sb->memory_budget, bytes_released);
     quicly_stream_sync_sendbuf(stream, 0);
 }
 
+/**
+ * returns the index of the vector that contains the specified offset of the stream
+ */
+static size_t find_sendbuf_vec(quicly_sendbuf_t *sb, uint64_t off)
+{
+    size_t lo, hi;
+
+    /* fast path; emission continues from where the previous one ended, or from the vector preceding it (that might have been
+     * extended by `quicly_sendbuf_write`) */
+    if (sb->emit_cursor < sb->vecs.size) {
+        struct st_quicly_sendbuf_entry_t *entry = get_sendbuf_entry(sb, sb->emit_cursor);
+        if (entry->off <= off && off < entry->off + entry->vec.len)
+            return sb->emit_cursor;
+    }
+    if (sb->emit_cursor != 0 && sb->emit_cursor - 1 < sb->vecs.size) {
+        struct st_quicly_sendbuf_entry_t *entry = get_sendbuf_entry(sb, sb->emit_cursor - 1);
+        if (entry->off <= off && off < entry->off + entry->vec.len)
+            return sb->emit_cursor - 1;
+    }
+
+    /* find the last vector that starts at or before `off` */
+    lo = 0;
+    hi = sb->vecs.size;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (get_sendbuf_entry(sb, mid)->off <= off) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
 void quicly_sendbuf_emit(quicly_stream_t *stream, quicly_sendbuf_t *sb, size_t off, void *dst, size_t *len, int *wrote_all)
 {
-    size_t vec_index, capacity = *len;
+    size_t vec_index = 0, capacity = *len;
     int ret;
 
-    off += sb->off_in_first_vec;
-    for (vec_index = 0; capacity != 0 && vec_index < sb->vecs.size; ++vec_index) {
-        quicly_sendbuf_vec_t *vec = sb->vecs.entries + vec_index;
+    if (sb->vecs.size != 0) {
+        struct st_quicly_sendbuf_entry_t *first = get_sendbuf_entry(sb, 0);
+        uint64_t stream_off = first->off + sb->off_in_first_vec + off;
+        vec_index = find_sendbuf_vec(sb, stream_off);
+        off = stream_off - get_sendbuf_entry(sb, vec_index)->off;
+    }
+    for (; capacity != 0 && vec_index < sb->vecs.size; ++vec_index) {
+        quicly_sendbuf_vec_t *vec = &get_sendbuf_entry(sb, vec_index)->vec;
         if (off < vec->len) {
             size_t bytes_flatten = vec->len - off;
             int partial = 0;
@@ -109,6 +184,7 @@ void quicly_sendbuf_emit(quicly_stream_t *stream, quicly_sendbuf_t *sb, size_t o
             off -= vec->len;
         }
     }
+    sb->emit_cursor = vec_index;
 
     if (capacity == 0 && vec_index < sb->vecs.size) {
         *wrote_all = 0;
@@ -118,37 +194,70 @@ void quicly_sendbuf_emit(quicly_stream_t *stream, quicly_sendbuf_t *sb, size_t o
     }
 }
 
-static int flatten_raw(quicly_sendbuf_vec_t *vec, void *dst, size_t off, size_t len)
+/**
+ * Chunk of the arena into which `quicly_sendbuf_write` copies the data. Each chunk is owned by exactly one vector, that refers to
+ * the chunk through `cbdata`; the vector starts at the beginning of the chunk and `vec.len` is the number of bytes being used.
+ */
+struct st_sendbuf_chunk_t {
+    size_t capacity;
+    uint8_t bytes[1];
+};
+
+static int flatten_chunk(quicly_sendbuf_vec_t *vec, void *dst, size_t off, size_t len)
 {
-    memcpy(dst, (uint8_t *)vec->cbdata + off, len);
+    struct st_sendbuf_chunk_t *chunk = vec->cbdata;
+    memcpy(dst, chunk->bytes + off, len);
     return 0;
 }
 
-static void discard_raw(quicly_sendbuf_vec_t *vec)
+static void discard_chunk(quicly_sendbuf_vec_t *vec)
 {
     free(vec->cbdata);
 }
 
+static const quicly_streambuf_sendvec_callbacks_t chunk_callbacks = {flatten_chunk, discard_chunk};
+
 int quicly_sendbuf_write(quicly_stream_t *stream, quicly_sendbuf_t *sb, const void *src, size_t len)
 {
-    static const quicly_streambuf_sendvec_callbacks_t raw_callbacks = {flatten_raw, discard_raw};
-    quicly_sendbuf_vec_t vec = {&raw_callbacks, len, NULL};
+    struct st_sendbuf_chunk_t *chunk;
+    size_t capacity = QUICLY_SENDBUF_MIN_CHUNK_SIZE;
     int ret;
 
     assert(quicly_sendstate_is_open(&stream->sendstate));
 
-    if ((vec.cbdata = malloc(len)) == NULL) {
-        ret = PTLS_ERROR_NO_MEMORY;
-        goto Error;
+    /* if the last vector is a chunk with enough space, append to it */
+    if (sb->vecs.size != 0) {
+        struct st_quicly_sendbuf_entry_t *tail = get_sendbuf_entry(sb, sb->vecs.size - 1);
+        if (tail->vec.cb == &chunk_callbacks) {
+            chunk = tail->vec.cbdata;
+            if (len <= chunk->capacity - tail->vec.len) {
+                memcpy(chunk->bytes + tail->vec.len, src, len);
+                tail->vec.len += len;
+                sb->bytes_written += len;
+                charge_sendbuf(stream, sb, len);
+                return quicly_stream_sync_sendbuf(stream, 1);
+            }
+            /* the chunks grow exponentially, so that the number of vectors remains small even when small writes continue */
+            capacity = chunk->capacity * 2;
+        }
     }
-    memcpy(vec.cbdata, src, len);
-    if ((ret = quicly_sendbuf_write_vec(stream, sb, &vec)) != 0)
-        goto Error;
-    return 0;
 
-Error:
-    free(vec.cbdata);
-    return ret;
+    /* allocate new chunk */
+    if (capacity > QUICLY_SENDBUF_CHUNK_SIZE)
+        capacity = QUICLY_SENDBUF_CHUNK_SIZE;
+    if (capacity < len)
+        capacity = len;
+    if ((chunk = malloc(offsetof(struct st_sendbuf_chunk_t, bytes) + capacity)) == NULL)
+        return PTLS_ERROR_NO_MEMORY;
+    chunk->capacity = capacity;
+    memcpy(chunk->bytes, src, len);
+
+    quicly_sendbuf_vec_t vec = {&chunk_callbacks, len, chunk};
+    if ((ret = quicly_sendbuf_write_vec(stream, sb, &vec)) != 0) {
+        free(chunk);
+        return ret;
+    }
+    return 0;
 }
 
 int quicly_sendbuf_write_vec(quicly_stream_t *stream, quicly_sendbuf_t *sb, quicly_sendbuf_vec_t *vec)
@@ -156,56 +265,234 @@ int quicly_sendbuf_write_vec(quicly_stream_t *stream, quicly_sendbuf_t *sb, quic
     assert(sb->vecs.size <= sb->vecs.capacity);
 
     if (sb->vecs.size == sb->vecs.capacity) {
-        quicly_sendbuf_vec_t *new_entries;
-        size_t new_capacity = sb->vecs.capacity == 0 ? 4 : sb->vecs.capacity * 2;
-        if ((new_entries = realloc(sb->vecs.entries, new_capacity * sizeof(*sb->vecs.entries))) == NULL)
+        struct st_quicly_sendbuf_entry_t *new_entries;
+        size_t new_capacity = sb->vecs.capacity == 0 ? 4 : sb->vecs.capacity * 2, i;
+        if ((new_entries = malloc(new_capacity * sizeof(*sb->vecs.entries))) == NULL)
             return PTLS_ERROR_NO_MEMORY;
+        for (i = 0; i != sb->vecs.size; ++i)
+            new_entries[i] = *get_sendbuf_entry(sb, i);
+        free(sb->vecs.entries);
         sb->vecs.entries = new_entries;
+        sb->vecs.first = 0;
         sb->vecs.capacity = new_capacity;
     }
-    sb->vecs.entries[sb->vecs.size++] = *vec;
+    ++sb->vecs.size;
+    *get_sendbuf_entry(sb, sb->vecs.size - 1) = (struct st_quicly_sendbuf_entry_t){*vec, sb->bytes_written};
     sb->bytes_written += vec->len;
+    if (sendbuf_vec_is_owned(vec))
+        charge_sendbuf(stream, sb, vec->len);
 
     return quicly_stream_sync_sendbuf(stream, 1);
 }
 
-void quicly_recvbuf_shift(quicly_stream_t *stream, ptls_buffer_t *rb, size_t delta)
+/**
+ * per-thread pool of the chunks used by `quicly_recvbuf_t`
+ */
+static __thread quicly_freelist_t recvbuf_pool = QUICLY_FREELIST_INITIALIZER(QUICLY_RECVBUF_POOL_SIZE);
+
+static uint8_t *alloc_recvbuf_chunk(void)
 {
-    assert(delta <= rb->off);
-    rb->off -= delta;
-    memmove(rb->base, rb->base + delta, rb->off);
+    void *chunk;
 
-    quicly_stream_sync_recvbuf(stream, delta);
+    if ((chunk = quicly_freelist_pop(&recvbuf_pool)) == NULL)
+        chunk = malloc(QUICLY_RECVBUF_CHUNK_SIZE);
+    return chunk;
+}
+
+static void release_recvbuf_chunk(uint8_t *chunk)
+{
+    if (chunk != NULL)
+        quicly_freelist_push(&recvbuf_pool, chunk);
+}
+
+static uint8_t **get_recvbuf_chunk(quicly_recvbuf_t *rb, size_t index)
+{
+    assert(index < rb->chunks.size);
+    return rb->chunks.entries + ((rb->chunks.first + index) & (rb->chunks.capacity - 1));
+}
+
+static void release_all_recvbuf_chunks(quicly_recvbuf_t *rb)
+{
+    size_t i;
+
+    for (i = 0; i != rb->chunks.size; ++i)
+        release_recvbuf_chunk(*get_recvbuf_chunk(rb, i));
+    rb->chunks.first = 0;
+    rb->chunks.size = 0;
 }
 
-ptls_iovec_t quicly_recvbuf_get(quicly_stream_t *stream, ptls_buffer_t *rb)
+/**
+ * makes sure that the ring has at least `size` chunks, extending the capacity (a power of two) as necessary
+ */
+static int reserve_recvbuf_chunks(quicly_recvbuf_t *rb, size_t size)
 {
-    size_t avail;
+    if (size <= rb->chunks.size)
+        return 0;
+
+    if (size > rb->chunks.capacity) {
+        size_t new_capacity = rb->chunks.capacity == 0 ? 4 : rb->chunks.capacity, i;
+        uint8_t **new_entries;
+        while (new_capacity < size)
+            new_capacity *= 2;
+        if ((new_entries = malloc(new_capacity * sizeof(*new_entries))) == NULL)
+            return PTLS_ERROR_NO_MEMORY;
+        for (i = 0; i != rb->chunks.size; ++i)
+            new_entries[i] = *get_recvbuf_chunk(rb, i);
+        free(rb->chunks.entries);
+        rb->chunks.entries = new_entries;
+        rb->chunks.first = 0;
+        rb->chunks.capacity = new_capacity;
+    }
 
+    while (rb->chunks.size < size) {
+        ++rb->chunks.size;
+        *get_recvbuf_chunk(rb, rb->chunks.size - 1) = NULL;
+    }
+
+    return 0;
+}
+
+static size_t get_recvbuf_avail(quicly_stream_t *stream, quicly_recvbuf_t *rb)
+{
     if (quicly_recvstate_transfer_complete(&stream->recvstate)) {
-        avail = rb->off;
+        return rb->off;
     } else if (stream->recvstate.data_off < stream->recvstate.received.ranges[0].end) {
-        avail = stream->recvstate.received.ranges[0].end - stream->recvstate.data_off;
+        return stream->recvstate.received.ranges[0].end - stream->recvstate.data_off;
     } else {
-        avail = 0;
+        return 0;
+    }
+}
+
+void quicly_recvbuf_dispose(quicly_recvbuf_t *rb)
+{
+    release_all_recvbuf_chunks(rb);
+    free(rb->chunks.entries);
+    free(rb->linear.base);
+    quicly_recvbuf_init(rb);
+}
+
+void quicly_recvbuf_shift(quicly_stream_t *stream, quicly_recvbuf_t *rb, size_t delta)
+{
+    assert(delta <= rb->off);
+    rb->off -= delta;
+
+    if (rb->off == 0) {
+        /* the buffer has become empty; return all the chunks to the pool */
+        release_all_recvbuf_chunks(rb);
+        rb->off_in_first_chunk = 0;
+        free(rb->linear.base);
+        rb->linear.base = NULL;
+        rb->linear.capacity = 0;
+    } else {
+        rb->off_in_first_chunk += delta;
+        while (rb->off_in_first_chunk >= QUICLY_RECVBUF_CHUNK_SIZE) {
+            release_recvbuf_chunk(*get_recvbuf_chunk(rb, 0));
+            rb->chunks.first = (rb->chunks.first + 1) & (rb->chunks.capacity - 1);
+            --rb->chunks.size;
+            rb->off_in_first_chunk -= QUICLY_RECVBUF_CHUNK_SIZE;
+        }
+    }
+
+    quicly_stream_sync_recvbuf(stream, delta);
+}
+
+ptls_iovec_t quicly_recvbuf_get(quicly_stream_t *stream, quicly_recvbuf_t *rb)
+{
+    ptls_iovec_t vecs[2];
+    size_t avail, off_in_chunk, copied = 0, i;
+
+    /* return the first chunk as-is, unless the data continues into the next one */
+    switch (quicly_recvbuf_get_vecs(stream, rb, vecs, PTLS_ELEMENTSOF(vecs))) {
+    case 0:
+        return ptls_iovec_init(NULL, 0);
+    case 1:
+        return vecs[0];
+    default:
+        break;
+    }
+
+    /* copy the data into the linear buffer */
+    avail = get_recvbuf_avail(stream, rb);
+    if (rb->linear.capacity < avail) {
+        uint8_t *newp;
+        if ((newp = realloc(rb->linear.base, avail)) == NULL) {
+            convert_error(stream, PTLS_ERROR_NO_MEMORY);
+            return ptls_iovec_init(NULL, 0);
+        }
+        rb->linear.base = newp;
+        rb->linear.capacity = avail;
+    }
+    for (i = 0, off_in_chunk = rb->off_in_first_chunk; copied != avail; ++i, off_in_chunk = 0) {
+        size_t len = QUICLY_RECVBUF_CHUNK_SIZE - off_in_chunk;
+        if (len > avail - copied)
+            len = avail - copied;
+        memcpy(rb->linear.base + copied, *get_recvbuf_chunk(rb, i) + off_in_chunk, len);
+        copied += len;
+    }
+
+    return ptls_iovec_init(rb->linear.base, avail);
+}
+
+ptls_iovec_t quicly_recvbuf_get_chunk(quicly_stream_t *stream, quicly_recvbuf_t *rb)
+{
+    ptls_iovec_t vec;
+
+    if (quicly_recvbuf_get_vecs(stream, rb, &vec, 1) == 0)
+        vec = ptls_iovec_init(NULL, 0);
+    return vec;
+}
+
+size_t quicly_recvbuf_get_vecs(quicly_stream_t *stream, quicly_recvbuf_t *rb, ptls_iovec_t *vecs, size_t max_vecs)
+{
+    size_t avail = get_recvbuf_avail(stream, rb), off_in_chunk = rb->off_in_first_chunk, num_vecs;
+
+    for (num_vecs = 0; avail != 0 && num_vecs < max_vecs; ++num_vecs) {
+        uint8_t *chunk = *get_recvbuf_chunk(rb, num_vecs);
+        size_t len = QUICLY_RECVBUF_CHUNK_SIZE - off_in_chunk;
+        assert(chunk != NULL);
+        if (len > avail)
+            len = avail;
+        vecs[num_vecs] = ptls_iovec_init(chunk + off_in_chunk, len);
+        avail -= len;
+        off_in_chunk = 0;
     }
 
-    return ptls_iovec_init(rb->base, avail);
+    return num_vecs;
 }
 
-int quicly_recvbuf_receive(quicly_stream_t *stream, ptls_buffer_t *rb, size_t off, const void *src, size_t len)
+int quicly_recvbuf_receive(quicly_stream_t *stream, quicly_recvbuf_t *rb, size_t off, const void *src, size_t len)
 {
-    if (len != 0) {
-        int ret;
-        if ((ret = ptls_buffer_reserve(rb, off + len - rb->off)) != 0) {
-            convert_error(stream, ret);
-            return -1;
+    size_t pos = rb->off_in_first_chunk + off, chunk_index = pos / QUICLY_RECVBUF_CHUNK_SIZE, end = off + len;
+    int ret;
+
+    if (len == 0)
+        return 0;
+
+    if ((ret = reserve_recvbuf_chunks(rb, (pos + len - 1) / QUICLY_RECVBUF_CHUNK_SIZE + 1)) != 0)
+        goto Error;
+
+    /* copy the data, allocating chunks as necessary */
+    for (pos %= QUICLY_RECVBUF_CHUNK_SIZE; len != 0; ++chunk_index, pos = 0) {
+        uint8_t **chunk = get_recvbuf_chunk(rb, chunk_index);
+        size_t copysize = QUICLY_RECVBUF_CHUNK_SIZE - pos;
+        if (*chunk == NULL && (*chunk = alloc_recvbuf_chunk()) == NULL) {
+            ret = PTLS_ERROR_NO_MEMORY;
+            goto Error;
         }
-        memcpy(rb->base + off, src, len);
-        if (rb->off < off + len)
-            rb->off = off + len;
+        if (copysize > len)
+            copysize = len;
+        memcpy(*chunk + pos, src, copysize);
+        src = (const uint8_t *)src + copysize;
+        len -= copysize;
     }
+
+    if (rb->off < end)
+        rb->off = end;
     return 0;
+
+Error:
+    convert_error(stream, ret);
+    return -1;
 }
 
 int quicly_streambuf_create(quicly_stream_t *stream, size_t sz)
@@ -218,7 +505,7 @@ int quicly_streambuf_create(quicly_stream_t *stream, size_t sz)
     if ((sbuf = malloc(sz)) == NULL)
         return PTLS_ERROR_NO_MEMORY;
     quicly_sendbuf_init(&sbuf->egress);
-    ptls_buffer_init(&sbuf->ingress, "", 0);
+    quicly_recvbuf_init(&sbuf->ingress);
     if (sz != sizeof(*sbuf))
         memset((char *)sbuf + sizeof(*sbuf), 0, sz - sizeof(*sbuf));
 
@@ -231,7 +518,7 @@ void quicly_streambuf_destroy(quicly_stream_t *stream, int err)
     quicly_streambuf_t *sbuf = stream->data;
 
     quicly_sendbuf_dispose(&sbuf->egress);
-    ptls_buffer_dispose(&sbuf->ingress);
+    quicly_recvbuf_dispose(&sbuf->ingress);
     free(sbuf);
     stream->data = NULL;
 }
@@ -5,6 +5,7 @@ exec perl -x $0 "$@"
 use strict;
 use warnings;
 use Getopt::Long;
+use Digest::MD5 qw(md5_hex);
 
 my $arch = $^O;
 my %tracer_probes = map { uc($_) => 1 } qw(packet_sent packet_received packet_acked packet_lost packet_decryption_failed pto cc_ack_received cc_congestion quictrace_cc_ack quictrace_cc_lost max_data_send max_data_receive max_stream_data_send max_stream_data_receive streams_blocked_send streams_blocked_receive stream_on_open stream_on_destroy);
@@ -39,6 +40,11 @@ my @probes = do {
     } @probes;
 };
 
+if ($arch eq 'bintrace') {
+    emit_bintrace();
+    exit 0;
+}
+
 # emit preamble
 if ($arch eq 'linux') {
     print << 'EOT';
@@ -281,3 +287,160 @@ sub normalize_name {
     $n =~ tr/_/-/;
     $n;
 }
+
+# Emits the binary tracer (see include/quicly/bintrace.h). For each probe, a fixed-layout record, a function that writes the
+# record to the per-thread ring, and the code that decodes the record to the JSON format being emitted by the other tracers are
+# generated.
+sub emit_bintrace {
+    my $schema = join "\n", map { "$_->[0](@{[join ',', map { qq($_->[1] $_->[0]) } @{$_->[1]}]})" } @probes;
+    print << "EOT";
+#ifndef quicly_bintrace_probes_h
+#define quicly_bintrace_probes_h
+
+#include <inttypes.h>
+#include "quicly.h"
+#include "quicly/bintrace.h"
+
+#define QUICLY_BINTRACE_SCHEMA_ID UINT64_C(0x@{[substr md5_hex($schema), 0, 16]})
+
+enum {
+@{[join "", map { "    QUICLY_BINTRACE_EVENT_" . uc($probes[$_]->[0]) . ($_ == 0 ? " = QUICLY_BINTRACE_EVENT_PADDING + 1" : "") . ",\n" } 0..$#probes]}};
+EOT
+
+    my @decoders;
+    for my $probe (@probes) {
+        # list of fields, each being [declaration, assignment, json-format, json-arg, optional-decoder-local-variable]
+        my @fields;
+        for (my $i = 0; $i < @{$probe->[1]}; ++$i) {
+            my ($name, $type) = @{$probe->[1]->[$i]};
+            if ($type eq 'struct st_quicly_conn_t *') {
+                push @fields, ["uint32_t $name",
+                    "rec->$name = arg$i != NULL ? ((struct _st_quicly_conn_public_t *)arg$i)->local.cid_set.plaintext.master_id : 0",
+                    '"conn":%" PRIu32 "', "r->$name"];
+            } elsif ($type eq 'struct st_quicly_stream_t *') {
+                push @fields, ["int64_t $name", "rec->$name = arg${i}->stream_id", '"stream-id":%" PRId64 "', "r->$name"];
+            } elsif ($type eq 'struct quicly_rtt_t *') {
+                push @fields, map {
+                    ["uint32_t ${name}_$_->[0]", "rec->${name}_$_->[0] = arg${i}->$_->[0]", qq("$_->[1]":\%" PRIu32 "),
+                        "r->${name}_$_->[0]"]
+                } (['minimum', 'min-rtt'], ['smoothed', 'smoothed-rtt'], ['latest', 'latest-rtt']);
+            } elsif ($type eq 'struct st_quicly_stats_t *') {
+                my @stats;
+                push @stats, map {["rtt.$_" => 'uint32_t']} qw(minimum smoothed variance);
+                push @stats, map {["cc.$_" => 'uint32_t']} qw(cwnd ssthresh cwnd_initial cwnd_exiting_slow_start cwnd_minimum cwnd_maximum num_loss_episodes);
+                push @stats, map {["num_packets.$_" => 'uint64_t']} qw(sent ack_received lost lost_time_threshold late_acked received decryption_failed);
+                push @stats, map {["num_bytes.$_" => 'uint64_t']} qw(sent received);
+                for my $container (qw(num_frames_sent num_frames_received)) {
+                    push @stats, map{["$container.$_" => 'uint64_t']} qw(padding ping ack reset_stream stop_sending crypto new_token stream max_data max_stream_data max_streams_bidi max_streams_uni data_blocked stream_data_blocked streams_blocked new_connection_id retire_connection_id path_challenge path_response transport_close application_close handshake_done ack_frequency);
+                }
+                push @stats, ["num_ptos" => 'uint64_t'];
+                for my $stat (@stats) {
+                    (my $n = $stat->[0]) =~ tr/./_/;
+                    push @fields, ["$stat->[1] ${name}_$n", "rec->${name}_$n = arg${i}->$stat->[0]",
+                        sprintf('"%s":%%" %s "', $n, $stat->[1] eq 'uint32_t' ? 'PRIu32' : 'PRIu64'), "r->${name}_$n"];
+                }
+                push @fields, ["char ${name}_cc_type[QUICLY_BINTRACE_MAX_STRLEN]",
+                    "quicly_bintrace_copy_str(rec->${name}_cc_type, sizeof(rec->${name}_cc_type), arg${i}->cc.type->name)",
+                    '"cc_type":"%s"',
+                    "quicly_bintrace__escape_str(${name}_cc_type_escaped, r->${name}_cc_type, sizeof(r->${name}_cc_type))",
+                    "char ${name}_cc_type_escaped[sizeof(r->${name}_cc_type) * 4 + 1]"];
+            } else {
+                my $json_name = normalize_name($name eq 'at' ? 'time' : $name);
+                if ($type =~ /^(?:unsigned|uint([0-9]+)_t|size_t)$/) {
+                    my $ctype = $1 ? "uint$1_t" : $type eq 'size_t' ? 'uint64_t' : 'uint32_t';
+                    push @fields, ["$ctype $name", "rec->$name = arg$i", qq("$json_name":\%" PRIu64 "), "(uint64_t)r->$name"];
+                } elsif ($type =~ /^int(?:([0-9]+)_t|)$/) {
+                    my $ctype = $1 ? "int$1_t" : 'int32_t';
+                    push @fields, ["$ctype $name", "rec->$name = arg$i", qq("$json_name":\%" PRId64 "), "(int64_t)r->$name"];
+                } elsif ($type =~ /^const\s+char\s+\*$/) {
+                    push @fields, ["char ${name}[QUICLY_BINTRACE_MAX_STRLEN]",
+                        "quicly_bintrace_copy_str(rec->$name, sizeof(rec->$name), arg$i)", qq("$json_name":"\%s"),
+                        "quicly_bintrace__escape_str(${name}_escaped, r->$name, sizeof(r->$name))",
+                        "char ${name}_escaped[sizeof(r->$name) * 4 + 1]"];
+                } elsif ($type =~ /\s+\*$/) {
+                    # record the address for other pointers
+                    push @fields, ["uint64_t $name", "rec->$name = (uint64_t)(uintptr_t)arg$i", qq("$json_name":"0x\%" PRIx64 "),
+                        "r->$name"];
+                } else {
+                    die "can't handle type: $type";
+                }
+            }
+        }
+        if ($probe->[0] eq 'receive') {
+            splice @fields, -1, 0, ["uint8_t first_octet", "rec->first_octet = *(uint8_t *)arg3", '"first-octet":%" PRIu32 "',
+                "(uint32_t)r->first_octet"];
+        }
+
+        my $uc_name = uc $probe->[0];
+        my $params = join ", ", "quicly_bintrace_ring_t *ring", map { "$probe->[1]->[$_]->[1] arg$_" } 0..$#{$probe->[1]};
+        print << "EOT";
+
+struct st_quicly_bintrace_$probe->[0]_t {
+    quicly_bintrace_record_t header;
+@{[join "", map { "    $_->[0];\n" } @fields]}};
+
+static inline void QUICLY_BINTRACE_$uc_name($params)
+{
+    struct st_quicly_bintrace_$probe->[0]_t *rec;
+    if ((rec = quicly_bintrace_reserve(ring, QUICLY_BINTRACE_EVENT_$uc_name, sizeof(*rec))) == NULL)
+        return;
+@{[join "", map { "    $_->[1];\n" } @fields]}    quicly_bintrace_commit(ring, rec);
+}
+EOT
+
+        my $fmt = join ', ', (sprintf('"type":"%s"', normalize_name($probe->[0])), map { $_->[2] } @fields);
+        $fmt =~ s/\"/\\\"/g;
+        $fmt =~ s/\%\\" ([A-Za-z0-9]+) \\"/\%" $1 "/g; # revert `"` -> `\"` for PRItNN
+        push @decoders, << "EOT";
+    case QUICLY_BINTRACE_EVENT_$uc_name: {
+        const struct st_quicly_bintrace_$probe->[0]_t *r = (const void *)rec;
+@{[join "", map { "        $_->[4];\n" } grep { defined $_->[4] } @fields]}        if (rec->size < sizeof(*r))
+            return -1;
+        fprintf(fp, "{$fmt}\\n", @{[join ', ', map { $_->[3] } @fields]});
+    } break;
+EOT
+    }
+
+    print << "EOT";
+
+#ifdef QUICLY_BINTRACE_DECODER
+
+/**
+ * Escapes a string field the same way as the probes escape unsafe strings (see `QUICLY_PROBE_ESCAPE_UNSAFE_STRING`), so that
+ * quotes, backslashes, and control characters being recorded do not break the JSON lines. The field is not NUL-terminated if the
+ * ring is corrupt. The logic is duplicated from `quicly_escape_unsafe_string`, so that the decoder does not depend on lib/quicly.c.
+ */
+static const char *quicly_bintrace__escape_str(char *buf, const char *s, size_t size)
+{
+    const char *end = s + strnlen(s, size);
+    char *dst = buf;
+
+    for (; s != end; ++s) {
+        if ((0x20 <= *s && *s <= 0x7e) && !(*s == '"' || *s == '\\'' || *s == '\\\\')) {
+            *dst++ = *s;
+        } else {
+            *dst++ = '\\\\';
+            *dst++ = 'x';
+            quicly_byte_to_hex(dst, (uint8_t)*s);
+            dst += 2;
+        }
+    }
+    *dst = '\\0';
+
+    return buf;
+}
+
+static int quicly_bintrace__decode(FILE *fp, const quicly_bintrace_record_t *rec)
+{
+    switch (rec->type) {
+@{[join "", @decoders]}    default:
+        return -1;
+    }
+    return 0;
+}
+
+#endif
+
+#endif
+EOT
+}
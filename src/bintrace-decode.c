@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "quicly/bintrace.h"
+
+static int on_record(void *_num_malformed, const quicly_bintrace_record_t *rec)
+{
+    size_t *num_malformed = _num_malformed;
+
+    if (quicly_bintrace_decode(stdout, rec) != 0)
+        ++*num_malformed;
+    return 0;
+}
+
+static void usage(const char *cmd)
+{
+    printf("Usage: %s ring-file...\n"
+           "\n"
+           "Decodes the rings being recorded by the binary tracer to the JSON format being\n"
+           "emitted by the printf-based tracers, one event per line. The rings are decoded\n"
+           "in the order being specified, each from the oldest event to the newest.\n"
+           "\n",
+           cmd);
+}
+
+int main(int argc, char **argv)
+{
+    int ch, i, ret = 0;
+
+    while ((ch = getopt(argc, argv, "h")) != -1) {
+        switch (ch) {
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (i = optind; i != argc; ++i) {
+        quicly_bintrace_ring_t *ring;
+        size_t num_malformed = 0;
+        if ((ring = quicly_bintrace_open(argv[i])) == NULL) {
+            fprintf(stderr, "failed to open %s:%s\n", argv[i],
+                    errno == EPROTO ? "recorded by a different version of quicly" : strerror(errno));
+            ret = 1;
+            continue;
+        }
+        if (quicly_bintrace_foreach(ring, on_record, &num_malformed) != 0) {
+            fprintf(stderr, "%s:ring is corrupt\n", argv[i]);
+            ret = 1;
+        }
+        if (num_malformed != 0)
+            fprintf(stderr, "%s:skipped %zu malformed records\n", argv[i], num_malformed);
+        quicly_bintrace_destroy(ring);
+    }
+
+    return ret;
+}
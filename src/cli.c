@@ -24,10 +24,14 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
 #include <getopt.h>
+#include <limits.h>
 #include <netinet/udp.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <picotls.h>
@@ -39,7 +43,13 @@
 #include "picotls/fusion.h"
 #endif
 #include "quicly.h"
+#include "quicly/bintrace.h"
+#include "quicly/qlog.h"
 #include "quicly/defaults.h"
+#include "quicly/egress_drr.h"
+#include "quicly/initial_guard.h"
+#include "quicly/signer_pool.h"
+#include "quicly/stats_aggregate.h"
 #include "quicly/streambuf.h"
 #include "../deps/picotls/t/util.h"
 
@@ -49,6 +59,7 @@ FILE *quicly_trace_fp = NULL;
 static unsigned verbosity = 0;
 static int suppress_output = 0, send_datagram_frame = 0;
 static int64_t enqueue_requests_at = 0, request_interval = 0;
+static unsigned udpbufsize = 0;
 
 static void hexdump(const char *title, const uint8_t *p, size_t l)
 {
@@ -75,12 +86,26 @@ static quicly_transport_parameters_t resumed_transport_params;
 static ptls_iovec_t resumption_token;
 static quicly_context_t ctx;
 static quicly_cid_plaintext_t next_cid;
-static struct {
+static uint8_t address_token_secret[PTLS_MAX_DIGEST_SIZE];
+/**
+ * AEAD contexts cannot be used concurrently, therefore each thread instantiates its own (see `setup_address_token_aead`)
+ */
+static __thread struct {
     ptls_aead_context_t *enc, *dec;
 } address_token_aead;
 static ptls_save_ticket_t save_session_ticket = {save_session_ticket_cb};
 static ptls_on_client_hello_t on_client_hello = {on_client_hello_cb};
 static int enforce_retry;
+/**
+ * path of the file to which the binary tracer records the events, or NULL
+ */
+static const char *bintrace_path;
+#define BINTRACE_RING_SIZE (16 * 1024 * 1024)
+/**
+ * path of the qlog file, or NULL
+ */
+static const char *qlog_path;
+static quicly_qlog_t qlog = {.fd = -1, .categories = QUICLY_QLOG_CATEGORY_ALL, .batch_size = QUICLY_QLOG_DEFAULT_BATCH_SIZE};
 
 #if QUICLY_HAVE_FUSION
 static const ptls_cipher_suite_t fusion_aes128gcmsha256 = {PTLS_CIPHER_SUITE_AES_128_GCM_SHA256, &ptls_fusion_aes128gcm,
@@ -143,10 +168,11 @@ static void dump_stats(FILE *fp, quicly_conn_t *conn)
     fprintf(fp,
             "packets-received: %" PRIu64 ", packets-decryption-failed: %" PRIu64 ", packets-sent: %" PRIu64
             ", packets-lost: %" PRIu64 ", ack-received: %" PRIu64 ", late-acked: %" PRIu64 ", bytes-received: %" PRIu64
-            ", bytes-sent: %" PRIu64 ", srtt: %" PRIu32 "\n",
+            ", bytes-sent: %" PRIu64 ", srtt: %" PRIu32 ", rtt-p50: %" PRIu64 ", rtt-p99: %" PRIu64 "\n",
             stats.num_packets.received, stats.num_packets.decryption_failed, stats.num_packets.sent, stats.num_packets.lost,
             stats.num_packets.ack_received, stats.num_packets.late_acked, stats.num_bytes.received, stats.num_bytes.sent,
-            stats.rtt.smoothed);
+            stats.rtt.smoothed, quicly_histogram_get_quantile(&stats.latency.rtt, 0.5),
+            quicly_histogram_get_quantile(&stats.latency.rtt, 0.99));
 }
 
 static int validate_path(const char *path)
@@ -351,7 +377,7 @@ static void client_on_receive(quicly_stream_t *stream, size_t off, const void *s
     if (quicly_streambuf_ingress_receive(stream, off, src, len) != 0)
         return;
 
-    if ((input = quicly_streambuf_ingress_get(stream)).len != 0) {
+    while ((input = quicly_streambuf_ingress_get_chunk(stream)).len != 0) {
         if (!suppress_output) {
             FILE *out = (stream_data->outfp == NULL) ? stdout : stream_data->outfp;
             fwrite(input.base, 1, input.len, out);
@@ -408,6 +434,12 @@ static void on_closed_by_remote(quicly_closed_by_remote_t *self, quicly_conn_t *
 
 static quicly_closed_by_remote_t closed_by_remote = {&on_closed_by_remote};
 
+static void setup_address_token_aead(void)
+{
+    address_token_aead.enc = ptls_aead_new(&ptls_openssl_aes128gcm, &ptls_openssl_sha256, 1, address_token_secret, "");
+    address_token_aead.dec = ptls_aead_new(&ptls_openssl_aes128gcm, &ptls_openssl_sha256, 0, address_token_secret, "");
+}
+
 static int on_generate_resumption_token(quicly_generate_resumption_token_t *self, quicly_conn_t *conn, ptls_buffer_t *buf,
                                         quicly_address_token_plaintext_t *token)
 {
@@ -482,20 +514,30 @@ static void send_one_packet(int fd, struct sockaddr *dest, const void *payload,
     send_packets(fd, dest, &vec, 1);
 }
 
-static int send_pending(int fd, quicly_conn_t *conn)
+/**
+ * sends up to `*num_packets` datagrams (which cannot exceed MAX_BURST_PACKETS), updating `*num_packets` to the number being sent
+ */
+static int send_pending_limited(int fd, quicly_conn_t *conn, size_t *num_packets)
 {
     quicly_address_t dest, src;
     struct iovec packets[MAX_BURST_PACKETS];
     uint8_t buf[MAX_BURST_PACKETS * quicly_get_context(conn)->transport_params.max_udp_payload_size];
-    size_t num_packets = MAX_BURST_PACKETS;
     int ret;
 
-    if ((ret = quicly_send(conn, &dest, &src, packets, &num_packets, buf, sizeof(buf))) == 0 && num_packets != 0)
-        send_packets(fd, &dest.sa, packets, num_packets);
+    assert(*num_packets <= MAX_BURST_PACKETS);
+
+    if ((ret = quicly_send(conn, &dest, &src, packets, num_packets, buf, sizeof(buf))) == 0 && *num_packets != 0)
+        send_packets(fd, &dest.sa, packets, *num_packets);
 
     return ret;
 }
 
+static int send_pending(int fd, quicly_conn_t *conn)
+{
+    size_t num_packets = MAX_BURST_PACKETS;
+    return send_pending_limited(fd, conn, &num_packets);
+}
+
 static void on_receive_datagram_frame(quicly_receive_datagram_frame_t *self, quicly_conn_t *conn, ptls_iovec_t payload)
 {
     printf("DATAGRAM: %.*s\n", (int)payload.len, payload.base);
@@ -531,6 +573,44 @@ static void enqueue_requests(quicly_conn_t *conn)
     enqueue_requests_at = INT64_MAX;
 }
 
+/**
+ * attaches the binary tracer to the calling thread, if enabled; `add_suffix` is set when running multiple server threads
+ */
+static void setup_bintrace(uint32_t thread_id, int add_suffix)
+{
+    char path[PATH_MAX];
+
+    if (bintrace_path == NULL)
+        return;
+
+    /* each thread records to its own ring */
+    if (add_suffix) {
+        snprintf(path, sizeof(path), "%s.%" PRIu32, bintrace_path, thread_id);
+    } else {
+        snprintf(path, sizeof(path), "%s", bintrace_path);
+    }
+    if ((quicly_bintrace_ring = quicly_bintrace_create(path, BINTRACE_RING_SIZE)) == NULL) {
+        fprintf(stderr, "failed to create binary trace file %s:%s\n", path, strerror(errno));
+        exit(1);
+    }
+}
+
+static int dump_flight_record(void *unused, const quicly_bintrace_record_t *rec)
+{
+    quicly_bintrace_decode(stderr, rec);
+    return 0;
+}
+
+static void on_flight_recorder_dump(quicly_flight_recorder_t *self, quicly_conn_t *conn, quicly_flight_recorder_reason_t reason,
+                                    quicly_bintrace_ring_t *ring)
+{
+    fprintf(stderr, "{\"type\":\"flight-recorder-dump\", \"conn\":%" PRIu32 ", \"reason\":\"%s\"}\n",
+            quicly_get_master_id(conn)->master_id, quicly_flight_recorder_reason_to_string(reason));
+    quicly_bintrace_foreach(ring, dump_flight_record, NULL);
+}
+
+static quicly_flight_recorder_t flight_recorder = {.pto_threshold = 3, .on_dump = on_flight_recorder_dump};
+
 static int run_client(int fd, struct sockaddr *sa, const char *host)
 {
     struct sockaddr_in local;
@@ -543,6 +623,7 @@ static int run_client(int fd, struct sockaddr *sa, const char *host)
         perror("bind(2) failed");
         return 1;
     }
+    setup_bintrace(0, 0);
     ret = quicly_connect(&conn, &ctx, host, sa, NULL, &next_cid, resumption_token, &hs_properties, &resumed_transport_params, NULL);
     assert(ret == 0);
     ++next_cid.master_id;
@@ -627,19 +708,513 @@ static int run_client(int fd, struct sockaddr *sa, const char *host)
     }
 }
 
-static quicly_conn_t **conns;
-static size_t num_conns = 0;
+static int create_udp_socket(int family)
+{
+    int fd;
 
-static void on_signal(int signo)
+    if ((fd = socket(family, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
+        perror("socket(2) failed");
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    {
+        int on = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0) {
+            perror("setsockopt(SO_REUSEADDR) failed");
+            goto Error;
+        }
+    }
+    if (udpbufsize != 0) {
+        unsigned arg = udpbufsize;
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &arg, sizeof(arg)) != 0) {
+            perror("setsockopt(SO_RCVBUF) failed");
+            goto Error;
+        }
+        arg = udpbufsize;
+        if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &arg, sizeof(arg)) != 0) {
+            perror("setsockopt(SO_RCVBUF) failed");
+            goto Error;
+        }
+    }
+#if defined(IP_DONTFRAG)
+    {
+        int on = 1;
+        if (setsockopt(fd, IPPROTO_IP, IP_DONTFRAG, &on, sizeof(on)) != 0)
+            perror("Warning: setsockopt(IP_DONTFRAG) failed");
+    }
+#elif defined(IP_PMTUDISC_DO)
+    {
+        int opt = IP_PMTUDISC_DO;
+        if (setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &opt, sizeof(opt)) != 0)
+            perror("Warning: setsockopt(IP_MTU_DISCOVER) failed");
+    }
+#endif
+
+    return fd;
+Error:
+    close(fd);
+    return -1;
+}
+
+/**
+ * Bounded lock-free multi-producer single-consumer ring used for handing over datagrams to the server thread that owns the
+ * connection (i.e. the thread designated by `quicly_cid_plaintext_t::thread_id`). Each slot carries a sequence number; producers
+ * claim a slot by advancing `tail` using CAS, and the consumer (the owning thread) advances `head` without any synchronization.
+ */
+struct st_steer_ring_t {
+    uint8_t *slots;
+    size_t slot_size;
+    size_t mask;
+    size_t head;
+    size_t tail;
+    /**
+     * pipe used for waking up the consumer blocked in select(2)
+     */
+    int notify_fds[2];
+};
+
+struct st_steer_slot_t {
+    size_t seq;
+    quicly_address_t remote;
+    size_t len;
+    uint8_t bytes[1];
+};
+
+#define STEER_RING_CAPACITY 1024
+
+/**
+ * a handshake that has been suspended for generating the signature using the signer pool
+ */
+struct st_async_handshake_t {
+    struct st_async_handshake_t *next;
+    struct st_server_thread_t *thread;
+    ptls_t *tls;
+};
+
+/**
+ * a connection owned by a server thread, along with the state of the egress scheduler
+ */
+struct st_server_conn_t {
+    quicly_conn_t *conn;
+    quicly_egress_drr_entry_t drr;
+};
+
+struct st_conn_weight_rule_t {
+    quicly_address_t address;
+    uint32_t weight;
+};
+
+struct st_server_thread_t {
+    pthread_t tid;
+    uint32_t id;
+    int fd;
+    /**
+     * copy of the global context, with `cid_encryptor` being replaced by an instance owned by the thread
+     */
+    quicly_context_t ctx;
+    quicly_cid_plaintext_t next_cid;
+    struct st_server_conn_t *conns;
+    size_t num_conns;
+    quicly_egress_drr_t egress_drr;
+    struct st_steer_ring_t inbox;
+    /**
+     * number of datagrams handed over to other threads
+     */
+    uint64_t num_steered;
+    quicly_initial_guard_t initial_guard;
+    /**
+     * handshakes for which the signature has been generated, waiting to be resumed by this thread
+     */
+    struct {
+        pthread_mutex_t mutex;
+        struct st_async_handshake_t *completed;
+        int notify_fds[2];
+    } async_handshakes;
+    /**
+     * pipe written to by the signal handler, requesting the thread to dump the statistics of the connections it owns
+     */
+    int signal_fds[2];
+};
+
+static struct st_server_thread_t *server_threads;
+static size_t num_server_threads = 1;
+static __thread struct st_server_thread_t *current_server_thread;
+static size_t num_signer_threads = 0;
+static size_t retry_threshold = SIZE_MAX;
+/**
+ * key used for encrypting the CIDs; as CID encryptors cannot be used concurrently, each server thread instantiates its own
+ */
+static const char *cid_key;
+/**
+ * serializes the use of the session ticket encryptor, which is shared by the server threads but is not thread-safe
+ */
+static struct {
+    ptls_encrypt_ticket_t super;
+    ptls_encrypt_ticket_t *orig;
+    pthread_mutex_t mutex;
+} locked_encrypt_ticket = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+static quicly_signer_pool_t *signer_pool;
+/**
+ * number of datagrams each server thread sends per iteration of the event loop, shared among the connections using deficit round
+ * robin; zero disables the egress scheduler, in which case each connection sends up to MAX_BURST_PACKETS datagrams per iteration
+ */
+static size_t egress_budget = 0;
+static struct {
+    struct st_conn_weight_rule_t *entries;
+    size_t count;
+} conn_weight_rules;
+static quicly_memory_budget_t memory_budget;
+/**
+ * path of the UNIX socket on which the aggregated stats are served in Prometheus text format, or NULL
+ */
+static const char *stats_socket_path;
+
+static uint32_t lookup_conn_weight(struct sockaddr *sa)
 {
     size_t i;
-    for (i = 0; i != num_conns; ++i) {
-        const quicly_cid_plaintext_t *master_id = quicly_get_master_id(conns[i]);
-        fprintf(stderr, "conn:%08" PRIu32 ": ", master_id->master_id);
-        dump_stats(stderr, conns[i]);
+
+    for (i = 0; i != conn_weight_rules.count; ++i) {
+        quicly_address_t *rule = &conn_weight_rules.entries[i].address;
+        int match = 0;
+        switch (sa->sa_family) {
+        case AF_INET:
+            match = rule->sa.sa_family == AF_INET &&
+                    memcmp(&rule->sin.sin_addr, &((struct sockaddr_in *)sa)->sin_addr, sizeof(rule->sin.sin_addr)) == 0;
+            break;
+        case AF_INET6:
+            match = rule->sa.sa_family == AF_INET6 &&
+                    memcmp(&rule->sin6.sin6_addr, &((struct sockaddr_in6 *)sa)->sin6_addr, sizeof(rule->sin6.sin6_addr)) == 0;
+            break;
+        }
+        if (match)
+            return conn_weight_rules.entries[i].weight;
     }
+
+    return 1;
+}
+
+/**
+ * set by the signal handler when the process is to exit once the statistics are dumped
+ */
+static volatile sig_atomic_t exit_requested;
+/**
+ * number of server threads that are yet to dump their statistics; the last one dumps the process-wide ones
+ */
+static size_t num_pending_dumps;
+
+static void on_signal(int signo)
+{
+    int saved_errno = errno;
+    size_t i;
+
+    /* The handler only wakes up the server threads; the connections are owned by the threads and can be inspected only by
+     * them. */
     if (signo == SIGINT)
-        _exit(0);
+        exit_requested = 1;
+    __atomic_add_fetch(&num_pending_dumps, num_server_threads, __ATOMIC_RELEASE);
+    for (i = 0; i != num_server_threads; ++i)
+        while (write(server_threads[i].signal_fds[1], "", 1) == -1 && errno == EINTR)
+            ;
+
+    errno = saved_errno;
+}
+
+static void dump_server_thread_stats(struct st_server_thread_t *thread)
+{
+    size_t i;
+
+    flockfile(stderr);
+    for (i = 0; i != thread->num_conns; ++i) {
+        const quicly_cid_plaintext_t *master_id = quicly_get_master_id(thread->conns[i].conn);
+        fprintf(stderr, "conn:%08" PRIu32 ":%" PRIu32 ": ", master_id->master_id, master_id->thread_id);
+        dump_stats(stderr, thread->conns[i].conn);
+    }
+    fprintf(stderr,
+            "thread:%" PRIu32 ": half-open: %zu, initials-admitted: %" PRIu64 ", initials-dropped: %" PRIu64
+            ", retry-required: %" PRIu64 ", steered: %" PRIu64 "\n",
+            thread->id, thread->initial_guard.num_half_open, thread->initial_guard.stats.num_admitted,
+            thread->initial_guard.stats.num_dropped, thread->initial_guard.stats.num_retry_required, thread->num_steered);
+    funlockfile(stderr);
+}
+
+static void dump_process_stats(void)
+{
+    if (signer_pool != NULL) {
+        quicly_signer_pool_stats_t stats;
+        quicly_signer_pool_get_stats(signer_pool, &stats);
+        fprintf(stderr,
+                "signer-pool: queued: %zu, max-queued: %zu, running: %zu, submitted: %" PRIu64 ", completed: %" PRIu64
+                ", avg-queue-time: %" PRIu64 "us\n",
+                stats.num_queued, stats.max_queued, stats.num_running, stats.num_submitted, stats.num_completed,
+                stats.num_completed != 0 ? stats.total_queue_time_usec / stats.num_completed : 0);
+    }
+    if (ctx.memory_budget != NULL)
+        fprintf(stderr, "memory-budget: used: %zu, limit: %zu, pressure: %" PRIu32 "/1024\n",
+                quicly_memory_budget_get_used(ctx.memory_budget), ctx.memory_budget->limit,
+                quicly_memory_budget_get_pressure(ctx.memory_budget));
+}
+
+/**
+ * Called by each server thread when woken up by `on_signal`.
+ */
+static void handle_signal(struct st_server_thread_t *thread)
+{
+    char drainbuf[256];
+    ssize_t rret;
+    size_t num_signals = 0;
+
+    while ((rret = read(thread->signal_fds[0], drainbuf, sizeof(drainbuf))) > 0)
+        num_signals += rret;
+    if (num_signals == 0)
+        return;
+
+    dump_server_thread_stats(thread);
+    if (__atomic_sub_fetch(&num_pending_dumps, num_signals, __ATOMIC_ACQ_REL) == 0) {
+        dump_process_stats();
+        if (exit_requested)
+            _exit(0);
+    }
+}
+
+static void write_prometheus_summary(FILE *fp, const char *name, const quicly_histogram_t *hist)
+{
+    static const char *quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+    size_t i;
+
+    fprintf(fp, "# TYPE %s summary\n", name);
+    for (i = 0; i != PTLS_ELEMENTSOF(quantiles); ++i)
+        fprintf(fp, "%s{quantile=\"%s\"} %" PRIu64 "\n", name, quantiles[i],
+                quicly_histogram_get_quantile(hist, strtod(quantiles[i], NULL)));
+    fprintf(fp, "%s_sum %" PRIu64 "\n%s_count %" PRIu64 "\n", name, hist->sum, name, hist->count);
+}
+
+static void write_prometheus_stats(FILE *fp, quicly_stats_aggregate_t *aggregate)
+{
+    quicly_aggregated_stats_t stats;
+    quicly_latency_stats_t latency;
+
+    quicly_stats_aggregate_snapshot(aggregate, &stats);
+    quicly_stats_aggregate_snapshot_latency(aggregate, &latency);
+
+    fprintf(fp, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n");
+#define EMIT(field, name) fprintf(fp, "# TYPE quicly_" name "_total counter\nquicly_" name "_total %" PRIu64 "\n", stats.field);
+    QUICLY_AGGREGATED_STATS_FOREACH(EMIT);
+#undef EMIT
+    write_prometheus_summary(fp, "quicly_rtt_milliseconds", &latency.rtt);
+    write_prometheus_summary(fp, "quicly_handshake_milliseconds", &latency.handshake);
+    write_prometheus_summary(fp, "quicly_stream_first_byte_milliseconds", &latency.stream_first_byte);
+    write_prometheus_summary(fp, "quicly_stream_send_complete_milliseconds", &latency.stream_send_complete);
+}
+
+static void *stats_server_main(void *_listen_fd)
+{
+    int listen_fd = (int)(intptr_t)_listen_fd;
+
+    while (1) {
+        char req[4096];
+        FILE *fp;
+        int fd;
+        if ((fd = accept(listen_fd, NULL, NULL)) == -1) {
+            switch (errno) {
+            case EINTR:
+            case ECONNABORTED:
+                break;
+            default:
+                /* back off rather than spinning, as errors like EMFILE persist until resources are released elsewhere */
+                perror("accept(2) failed");
+                sleep(1);
+                break;
+            }
+            continue;
+        }
+        /* the request is read once and ignored; the stats are returned regardless of the path */
+        (void)read(fd, req, sizeof(req));
+        if ((fp = fdopen(fd, "w")) == NULL) {
+            close(fd);
+            continue;
+        }
+        write_prometheus_stats(fp, ctx.stats_aggregate);
+        fclose(fp);
+    }
+
+    return NULL;
+}
+
+/**
+ * starts the thread serving the aggregated stats on the UNIX socket (e.g., `curl --unix-socket <path> http://localhost/metrics`)
+ */
+static int start_stats_server(const char *path)
+{
+    struct sockaddr_un sun = {.sun_family = AF_UNIX};
+    pthread_t tid;
+    int fd, ret;
+
+    if (strlen(path) >= sizeof(sun.sun_path)) {
+        fprintf(stderr, "path of the stats socket is too long:%s\n", path);
+        return -1;
+    }
+    strcpy(sun.sun_path, path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        perror("socket(2) failed");
+        return -1;
+    }
+    { /* remove the socket left by the previous run, but nothing else */
+        struct stat st;
+        if (lstat(path, &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                fprintf(stderr, "refusing to remove %s, as it is not a socket\n", path);
+                goto Error;
+            }
+            unlink(path);
+        }
+    }
+    if (bind(fd, (void *)&sun, sizeof(sun)) != 0) {
+        perror("bind(2) failed");
+        goto Error;
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        perror("listen(2) failed");
+        goto Error;
+    }
+    if ((ret = pthread_create(&tid, NULL, stats_server_main, (void *)(intptr_t)fd)) != 0) {
+        fprintf(stderr, "pthread_create failed:%s\n", strerror(ret));
+        goto Error;
+    }
+    pthread_detach(tid);
+
+    return 0;
+Error:
+    close(fd);
+    return -1;
+}
+
+static struct st_steer_slot_t *steer_ring_get_slot(struct st_steer_ring_t *ring, size_t index)
+{
+    return (struct st_steer_slot_t *)(ring->slots + (index & ring->mask) * ring->slot_size);
+}
+
+static void steer_ring_init(struct st_steer_ring_t *ring, size_t capacity, size_t max_payload_size)
+{
+    size_t i;
+
+    assert((capacity & (capacity - 1)) == 0);
+
+    ring->slot_size = (offsetof(struct st_steer_slot_t, bytes) + max_payload_size + 7) & ~(size_t)7;
+    ring->mask = capacity - 1;
+    ring->slots = malloc(ring->slot_size * capacity);
+    assert(ring->slots != NULL);
+    for (i = 0; i != capacity; ++i)
+        steer_ring_get_slot(ring, i)->seq = i;
+    ring->head = 0;
+    ring->tail = 0;
+
+    if (pipe(ring->notify_fds) != 0) {
+        perror("pipe(2) failed");
+        exit(1);
+    }
+    fcntl(ring->notify_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(ring->notify_fds[1], F_SETFL, O_NONBLOCK);
+}
+
+/**
+ * Copies the datagram into the ring. Returns a boolean indicating if the datagram was queued; when the ring is full, the datagram
+ * is dropped and the loss is left to be recovered by QUIC.
+ */
+static int steer_ring_push(struct st_steer_ring_t *ring, quicly_address_t *remote, const void *bytes, size_t len)
+{
+    struct st_steer_slot_t *slot;
+    size_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    while (1) {
+        slot = steer_ring_get_slot(ring, pos);
+        intptr_t diff = (intptr_t)__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->remote = *remote;
+    slot->len = len;
+    memcpy(slot->bytes, bytes, len);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    /* wake up the consumer; EAGAIN means that there is a notification already pending */
+    while (write(ring->notify_fds[1], "", 1) == -1 && errno == EINTR)
+        ;
+
+    return 1;
+}
+
+static struct st_steer_slot_t *steer_ring_peek(struct st_steer_ring_t *ring)
+{
+    struct st_steer_slot_t *slot = steer_ring_get_slot(ring, ring->head);
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring->head + 1)
+        return NULL;
+    return slot;
+}
+
+static void steer_ring_pop(struct st_steer_ring_t *ring)
+{
+    struct st_steer_slot_t *slot = steer_ring_get_slot(ring, ring->head);
+    __atomic_store_n(&slot->seq, ring->head + ring->mask + 1, __ATOMIC_RELEASE);
+    ++ring->head;
+}
+
+static void on_signature_generated(void *_handshake)
+{
+    struct st_async_handshake_t *handshake = _handshake;
+    struct st_server_thread_t *thread = handshake->thread;
+
+    /* called by a worker thread of the signer pool; hand the handshake over to the thread owning the connection */
+    pthread_mutex_lock(&thread->async_handshakes.mutex);
+    handshake->next = thread->async_handshakes.completed;
+    thread->async_handshakes.completed = handshake;
+    pthread_mutex_unlock(&thread->async_handshakes.mutex);
+
+    while (write(thread->async_handshakes.notify_fds[1], "", 1) == -1 && errno == EINTR)
+        ;
+}
+
+static void on_async_handshake(quicly_async_handshake_t *self, ptls_t *tls)
+{
+    struct st_async_handshake_t *handshake;
+    ptls_async_job_t *job = ptls_get_async_job(tls);
+
+    assert(current_server_thread != NULL);
+    handshake = malloc(sizeof(*handshake));
+    assert(handshake != NULL);
+    *handshake = (struct st_async_handshake_t){NULL, current_server_thread, tls};
+    job->set_completion_callback(job, on_signature_generated, handshake);
+}
+
+static quicly_async_handshake_t async_handshake = {on_async_handshake};
+
+static void resume_async_handshakes(struct st_server_thread_t *thread)
+{
+    struct st_async_handshake_t *handshake;
+    char drainbuf[256];
+
+    while (read(thread->async_handshakes.notify_fds[0], drainbuf, sizeof(drainbuf)) > 0)
+        ;
+
+    pthread_mutex_lock(&thread->async_handshakes.mutex);
+    handshake = thread->async_handshakes.completed;
+    thread->async_handshakes.completed = NULL;
+    pthread_mutex_unlock(&thread->async_handshakes.mutex);
+
+    /* packets generated by the resumed handshakes are sent by the timeout handling of the event loop */
+    while (handshake != NULL) {
+        struct st_async_handshake_t *next = handshake->next;
+        quicly_resume_handshake(handshake->tls);
+        free(handshake);
+        handshake = next;
+    }
 }
 
 static int validate_token(struct sockaddr *remote, ptls_iovec_t client_cid, ptls_iovec_t server_cid,
@@ -712,26 +1287,180 @@ CIDMismatch:
     return 0;
 }
 
-static int run_server(int fd, struct sockaddr *sa, socklen_t salen)
+static void server_handle_datagram(struct st_server_thread_t *thread, quicly_address_t *remote, uint8_t *buf, size_t len)
 {
-    signal(SIGINT, on_signal);
-    signal(SIGHUP, on_signal);
+    size_t off = 0;
+    while (off != len) {
+        quicly_decoded_packet_t packet;
+        if (quicly_decode_packet(&thread->ctx, &packet, buf, len, &off) == SIZE_MAX)
+            break;
+        if (QUICLY_PACKET_IS_LONG_HEADER(packet.octets.base[0])) {
+            if (packet.version != 0 && !quicly_is_supported_version(packet.version)) {
+                uint8_t payload[ctx.transport_params.max_udp_payload_size];
+                size_t payload_len = quicly_send_version_negotiation(&ctx, packet.cid.src, packet.cid.dest.encrypted,
+                                                                     quicly_supported_versions, payload);
+                assert(payload_len != SIZE_MAX);
+                send_one_packet(thread->fd, &remote->sa, payload, payload_len);
+                break;
+            }
+            /* there is no way to send response to these v1 packets */
+            if (packet.cid.dest.encrypted.len > QUICLY_MAX_CID_LEN_V1 || packet.cid.src.len > QUICLY_MAX_CID_LEN_V1)
+                break;
+        }
 
-    if (bind(fd, sa, salen) != 0) {
-        perror("bind(2) failed");
+        /* hand the datagram over to the thread that owns the connection, if the CID designates a different thread */
+        if (num_server_threads != 1 && packet.datagram_size != 0 && !packet.cid.dest.might_be_client_generated &&
+            packet.cid.dest.plaintext.node_id == 0 && packet.cid.dest.plaintext.thread_id != thread->id &&
+            packet.cid.dest.plaintext.thread_id < num_server_threads) {
+            if (steer_ring_push(&server_threads[packet.cid.dest.plaintext.thread_id].inbox, remote, buf, len))
+                ++thread->num_steered;
+            break;
+        }
+
+        quicly_conn_t *conn = NULL;
+        size_t i;
+        for (i = 0; i != thread->num_conns; ++i) {
+            if (quicly_is_destination(thread->conns[i].conn, NULL, &remote->sa, &packet)) {
+                conn = thread->conns[i].conn;
+                break;
+            }
+        }
+        if (conn != NULL) {
+            /* existing connection */
+            quicly_receive(conn, NULL, &remote->sa, &packet);
+        } else if (QUICLY_PACKET_IS_INITIAL(packet.octets.base[0])) {
+            /* long header packet; potentially a new connection */
+            quicly_address_token_plaintext_t *token = NULL, token_buf;
+            const char *err_desc = NULL;
+            int token_ret = 0;
+            if (packet.token.len != 0) {
+                token_ret = quicly_decrypt_address_token(address_token_aead.dec, &token_buf, packet.token.base,
+                                                         packet.token.len, 0, &err_desc);
+                if (token_ret == 0 &&
+                    validate_token(&remote->sa, packet.cid.src, packet.cid.dest.encrypted, &token_buf, &err_desc))
+                    token = &token_buf;
+            }
+            /* the rate limit is applied after validating the token, so that clients having proven the ownership of their
+             * addresses are not crowded out by spoofed floods */
+            if (!quicly_initial_guard_admit(&thread->initial_guard, ctx.now->cb(ctx.now), &remote->sa, token != NULL))
+                break;
+            int require_retry = enforce_retry || quicly_initial_guard_require_retry(&thread->initial_guard);
+            if (require_retry && packet.token.len != 0 && token == NULL &&
+                (token_ret == QUICLY_TRANSPORT_ERROR_INVALID_TOKEN ||
+                 (token_ret == 0 && token_buf.type == QUICLY_ADDRESS_TOKEN_TYPE_RETRY))) {
+                /* Token that looks like retry was unusable, and we require retry. There's no chance of the
+                 * handshake succeeding. Therefore, send close without acquiring state. */
+                uint8_t payload[ctx.transport_params.max_udp_payload_size];
+                size_t payload_len = quicly_send_close_invalid_token(&ctx, packet.version, packet.cid.src,
+                                                                     packet.cid.dest.encrypted, err_desc, payload);
+                assert(payload_len != SIZE_MAX);
+                send_one_packet(thread->fd, &remote->sa, payload, payload_len);
+            }
+            if (require_retry && token == NULL && packet.cid.dest.encrypted.len >= 8) {
+                /* unbound connection; send a retry token unless the client has supplied the correct one, but not too
+                 * many
+                 */
+                uint8_t new_server_cid[8], payload[ctx.transport_params.max_udp_payload_size];
+                memcpy(new_server_cid, packet.cid.dest.encrypted.base, sizeof(new_server_cid));
+                new_server_cid[0] ^= 0xff;
+                size_t payload_len = quicly_send_retry(
+                    &thread->ctx, address_token_aead.enc, packet.version, &remote->sa, packet.cid.src, NULL,
+                    ptls_iovec_init(new_server_cid, sizeof(new_server_cid)), packet.cid.dest.encrypted,
+                    ptls_iovec_init(NULL, 0), ptls_iovec_init(NULL, 0),
+                    quicly_initial_guard_get_retry_aead_cache(&thread->initial_guard, packet.version), payload);
+                assert(payload_len != SIZE_MAX);
+                send_one_packet(thread->fd, &remote->sa, payload, payload_len);
+                break;
+            } else {
+                /* new connection */
+                int ret = quicly_accept(&conn, &thread->ctx, NULL, &remote->sa, &packet, token, &thread->next_cid, NULL, NULL);
+                if (ret == 0) {
+                    assert(conn != NULL);
+                    ++thread->next_cid.master_id;
+                    ++thread->initial_guard.num_half_open;
+                    thread->conns = realloc(thread->conns, sizeof(*thread->conns) * (thread->num_conns + 1));
+                    assert(thread->conns != NULL);
+                    thread->conns[thread->num_conns++] =
+                        (struct st_server_conn_t){.conn = conn, .drr.weight = lookup_conn_weight(&remote->sa)};
+                } else {
+                    assert(conn == NULL);
+                }
+            }
+        } else if (!QUICLY_PACKET_IS_LONG_HEADER(packet.octets.base[0])) {
+            /* short header packet; potentially a dead connection. No need to check the length of the incoming packet,
+             * because loop is prevented by authenticating the CID (by checking node_id and thread_id). If the peer is
+             * also sending a reset, then the next CID is highly likely to contain a non-authenticating CID, ... */
+            if (packet.cid.dest.plaintext.node_id == 0 && packet.cid.dest.plaintext.thread_id == thread->id) {
+                uint8_t payload[ctx.transport_params.max_udp_payload_size];
+                size_t payload_len = quicly_send_stateless_reset(&thread->ctx, packet.cid.dest.encrypted.base, payload);
+                assert(payload_len != SIZE_MAX);
+                send_one_packet(thread->fd, &remote->sa, payload, payload_len);
+            }
+        }
+    }
+}
+
+static void server_close_conn(struct st_server_thread_t *thread, size_t index)
+{
+    dump_stats(stderr, thread->conns[index].conn);
+    quicly_free(thread->conns[index].conn);
+    memmove(thread->conns + index, thread->conns + index + 1, (thread->num_conns - index - 1) * sizeof(*thread->conns));
+    --thread->num_conns;
+    quicly_egress_drr_on_remove(&thread->egress_drr, index);
+}
+
+static quicly_egress_drr_entry_t *drr_get_entry(void *_thread, size_t index)
+{
+    struct st_server_thread_t *thread = _thread;
+    return &thread->conns[index].drr;
+}
+
+static int drr_send(void *_thread, size_t index, size_t *num_datagrams)
+{
+    struct st_server_thread_t *thread = _thread;
+    quicly_conn_t *conn = thread->conns[index].conn;
+
+    if (quicly_get_first_timeout(conn) > ctx.now->cb(ctx.now)) {
+        *num_datagrams = 0;
+        return 0;
+    }
+    if (send_pending_limited(thread->fd, conn, num_datagrams) != 0) {
+        server_close_conn(thread, index);
         return 1;
     }
+    return 0;
+}
+
+/**
+ * Sends the packets of the connections that have something to send, sharing `egress_budget` datagrams among them using deficit
+ * round robin. When the budget runs out, the next iteration of the event loop resumes from where the scan stopped, so that bulk
+ * connections cannot starve the others.
+ */
+static void send_pending_drr(struct st_server_thread_t *thread)
+{
+    static const quicly_egress_drr_callbacks_t callbacks = {drr_get_entry, drr_send};
+    quicly_egress_drr_run(&thread->egress_drr, &thread->num_conns, egress_budget, MAX_BURST_PACKETS, &callbacks, thread);
+}
+
+static void run_server_thread(struct st_server_thread_t *thread)
+{
+    current_server_thread = thread;
+    setup_bintrace(thread->id, num_server_threads != 1);
 
     while (1) {
         fd_set readfds;
         struct timeval *tv, tvbuf;
+        int nfds;
         do {
             int64_t timeout_at = INT64_MAX;
             size_t i;
-            for (i = 0; i != num_conns; ++i) {
-                int64_t conn_to = quicly_get_first_timeout(conns[i]);
+            thread->initial_guard.num_half_open = 0;
+            for (i = 0; i != thread->num_conns; ++i) {
+                int64_t conn_to = quicly_get_first_timeout(thread->conns[i].conn);
                 if (conn_to < timeout_at)
                     timeout_at = conn_to;
+                if (!quicly_is_handshake_confirmed(thread->conns[i].conn))
+                    ++thread->initial_guard.num_half_open;
             }
             if (timeout_at != INT64_MAX) {
                 int64_t delta = timeout_at - ctx.now->cb(ctx.now);
@@ -747,9 +1476,23 @@ static int run_server(int fd, struct sockaddr *sa, socklen_t salen)
                 tv = NULL;
             }
             FD_ZERO(&readfds);
-            FD_SET(fd, &readfds);
-        } while (select(fd + 1, &readfds, NULL, NULL, tv) == -1 && errno == EINTR);
-        if (FD_ISSET(fd, &readfds)) {
+            FD_SET(thread->fd, &readfds);
+            nfds = thread->fd;
+            if (num_server_threads != 1) {
+                FD_SET(thread->inbox.notify_fds[0], &readfds);
+                if (nfds < thread->inbox.notify_fds[0])
+                    nfds = thread->inbox.notify_fds[0];
+            }
+            FD_SET(thread->signal_fds[0], &readfds);
+            if (nfds < thread->signal_fds[0])
+                nfds = thread->signal_fds[0];
+            if (signer_pool != NULL) {
+                FD_SET(thread->async_handshakes.notify_fds[0], &readfds);
+                if (nfds < thread->async_handshakes.notify_fds[0])
+                    nfds = thread->async_handshakes.notify_fds[0];
+            }
+        } while (select(nfds + 1, &readfds, NULL, NULL, tv) == -1 && errno == EINTR);
+        if (FD_ISSET(thread->fd, &readfds)) {
             while (1) {
                 uint8_t buf[ctx.transport_params.max_udp_payload_size];
                 struct msghdr mess;
@@ -763,114 +1506,41 @@ static int run_server(int fd, struct sockaddr *sa, socklen_t salen)
                 mess.msg_iov = &vec;
                 mess.msg_iovlen = 1;
                 ssize_t rret;
-                while ((rret = recvmsg(fd, &mess, 0)) == -1 && errno == EINTR)
+                while ((rret = recvmsg(thread->fd, &mess, 0)) == -1 && errno == EINTR)
                     ;
                 if (rret == -1)
                     break;
                 if (verbosity >= 2)
                     hexdump("recvmsg", buf, rret);
-                size_t off = 0;
-                while (off != rret) {
-                    quicly_decoded_packet_t packet;
-                    if (quicly_decode_packet(&ctx, &packet, buf, rret, &off) == SIZE_MAX)
-                        break;
-                    if (QUICLY_PACKET_IS_LONG_HEADER(packet.octets.base[0])) {
-                        if (packet.version != 0 && !quicly_is_supported_version(packet.version)) {
-                            uint8_t payload[ctx.transport_params.max_udp_payload_size];
-                            size_t payload_len = quicly_send_version_negotiation(&ctx, packet.cid.src, packet.cid.dest.encrypted,
-                                                                                 quicly_supported_versions, payload);
-                            assert(payload_len != SIZE_MAX);
-                            send_one_packet(fd, &remote.sa, payload, payload_len);
-                            break;
-                        }
-                        /* there is no way to send response to these v1 packets */
-                        if (packet.cid.dest.encrypted.len > QUICLY_MAX_CID_LEN_V1 || packet.cid.src.len > QUICLY_MAX_CID_LEN_V1)
-                            break;
-                    }
-
-                    quicly_conn_t *conn = NULL;
-                    size_t i;
-                    for (i = 0; i != num_conns; ++i) {
-                        if (quicly_is_destination(conns[i], NULL, &remote.sa, &packet)) {
-                            conn = conns[i];
-                            break;
-                        }
-                    }
-                    if (conn != NULL) {
-                        /* existing connection */
-                        quicly_receive(conn, NULL, &remote.sa, &packet);
-                    } else if (QUICLY_PACKET_IS_INITIAL(packet.octets.base[0])) {
-                        /* long header packet; potentially a new connection */
-                        quicly_address_token_plaintext_t *token = NULL, token_buf;
-                        if (packet.token.len != 0) {
-                            const char *err_desc = NULL;
-                            int ret = quicly_decrypt_address_token(address_token_aead.dec, &token_buf, packet.token.base,
-                                                                   packet.token.len, 0, &err_desc);
-                            if (ret == 0 &&
-                                validate_token(&remote.sa, packet.cid.src, packet.cid.dest.encrypted, &token_buf, &err_desc)) {
-                                token = &token_buf;
-                            } else if (enforce_retry && (ret == QUICLY_TRANSPORT_ERROR_INVALID_TOKEN ||
-                                                         (ret == 0 && token_buf.type == QUICLY_ADDRESS_TOKEN_TYPE_RETRY))) {
-                                /* Token that looks like retry was unusable, and we require retry. There's no chance of the
-                                 * handshake succeeding. Therefore, send close without acquiring state. */
-                                uint8_t payload[ctx.transport_params.max_udp_payload_size];
-                                size_t payload_len = quicly_send_close_invalid_token(&ctx, packet.version, packet.cid.src,
-                                                                                     packet.cid.dest.encrypted, err_desc, payload);
-                                assert(payload_len != SIZE_MAX);
-                                send_one_packet(fd, &remote.sa, payload, payload_len);
-                            }
-                        }
-                        if (enforce_retry && token == NULL && packet.cid.dest.encrypted.len >= 8) {
-                            /* unbound connection; send a retry token unless the client has supplied the correct one, but not too
-                             * many
-                             */
-                            uint8_t new_server_cid[8], payload[ctx.transport_params.max_udp_payload_size];
-                            memcpy(new_server_cid, packet.cid.dest.encrypted.base, sizeof(new_server_cid));
-                            new_server_cid[0] ^= 0xff;
-                            size_t payload_len = quicly_send_retry(
-                                &ctx, address_token_aead.enc, packet.version, &remote.sa, packet.cid.src, NULL,
-                                ptls_iovec_init(new_server_cid, sizeof(new_server_cid)), packet.cid.dest.encrypted,
-                                ptls_iovec_init(NULL, 0), ptls_iovec_init(NULL, 0), NULL, payload);
-                            assert(payload_len != SIZE_MAX);
-                            send_one_packet(fd, &remote.sa, payload, payload_len);
-                            break;
-                        } else {
-                            /* new connection */
-                            int ret = quicly_accept(&conn, &ctx, NULL, &remote.sa, &packet, token, &next_cid, NULL, NULL);
-                            if (ret == 0) {
-                                assert(conn != NULL);
-                                ++next_cid.master_id;
-                                conns = realloc(conns, sizeof(*conns) * (num_conns + 1));
-                                assert(conns != NULL);
-                                conns[num_conns++] = conn;
-                            } else {
-                                assert(conn == NULL);
-                            }
-                        }
-                    } else if (!QUICLY_PACKET_IS_LONG_HEADER(packet.octets.base[0])) {
-                        /* short header packet; potentially a dead connection. No need to check the length of the incoming packet,
-                         * because loop is prevented by authenticating the CID (by checking node_id and thread_id). If the peer is
-                         * also sending a reset, then the next CID is highly likely to contain a non-authenticating CID, ... */
-                        if (packet.cid.dest.plaintext.node_id == 0 && packet.cid.dest.plaintext.thread_id == 0) {
-                            uint8_t payload[ctx.transport_params.max_udp_payload_size];
-                            size_t payload_len = quicly_send_stateless_reset(&ctx, packet.cid.dest.encrypted.base, payload);
-                            assert(payload_len != SIZE_MAX);
-                            send_one_packet(fd, &remote.sa, payload, payload_len);
-                        }
-                    }
-                }
+                server_handle_datagram(thread, &remote, buf, rret);
             }
         }
-        {
+        if (num_server_threads != 1) {
+            /* process the datagrams handed over by other threads */
+            if (FD_ISSET(thread->inbox.notify_fds[0], &readfds)) {
+                char drainbuf[256];
+                while (read(thread->inbox.notify_fds[0], drainbuf, sizeof(drainbuf)) > 0)
+                    ;
+            }
+            struct st_steer_slot_t *slot;
+            while ((slot = steer_ring_peek(&thread->inbox)) != NULL) {
+                server_handle_datagram(thread, &slot->remote, slot->bytes, slot->len);
+                steer_ring_pop(&thread->inbox);
+            }
+        }
+        if (signer_pool != NULL && FD_ISSET(thread->async_handshakes.notify_fds[0], &readfds))
+            resume_async_handshakes(thread);
+        if (FD_ISSET(thread->signal_fds[0], &readfds))
+            handle_signal(thread);
+        if (egress_budget != 0) {
+            send_pending_drr(thread);
+        } else {
             size_t i;
-            for (i = 0; i != num_conns; ++i) {
-                if (quicly_get_first_timeout(conns[i]) <= ctx.now->cb(ctx.now)) {
-                    if (send_pending(fd, conns[i]) != 0) {
-                        dump_stats(stderr, conns[i]);
-                        quicly_free(conns[i]);
-                        memmove(conns + i, conns + i + 1, (num_conns - i - 1) * sizeof(*conns));
+            for (i = 0; i != thread->num_conns; ++i) {
+                if (quicly_get_first_timeout(thread->conns[i].conn) <= ctx.now->cb(ctx.now)) {
+                    if (send_pending(thread->fd, thread->conns[i].conn) != 0) {
+                        server_close_conn(thread, i);
                         --i;
-                        --num_conns;
                     }
                 }
             }
@@ -878,6 +1548,120 @@ static int run_server(int fd, struct sockaddr *sa, socklen_t salen)
     }
 }
 
+static int on_encrypt_ticket_locked(ptls_encrypt_ticket_t *self, ptls_t *tls, int is_encrypt, ptls_buffer_t *dst,
+                                   ptls_iovec_t src)
+{
+    int ret;
+
+    pthread_mutex_lock(&locked_encrypt_ticket.mutex);
+    ret = locked_encrypt_ticket.orig->cb(locked_encrypt_ticket.orig, tls, is_encrypt, dst, src);
+    pthread_mutex_unlock(&locked_encrypt_ticket.mutex);
+
+    return ret;
+}
+
+static void *server_thread_main(void *_thread)
+{
+    struct st_server_thread_t *thread = _thread;
+
+    setup_address_token_aead();
+    run_server_thread(thread);
+    return NULL;
+}
+
+static int run_server(int fd, struct sockaddr *sa, socklen_t salen)
+{
+    size_t i;
+
+    /* the aggregate has to be set up before the context is copied to each thread */
+    if (stats_socket_path != NULL) {
+        if ((ctx.stats_aggregate = quicly_stats_aggregate_create()) == NULL) {
+            fprintf(stderr, "failed to create stats aggregate\n");
+            return 1;
+        }
+        if (start_stats_server(stats_socket_path) != 0)
+            return 1;
+    }
+
+    /* The TLS context is shared by the threads. Signing is thread-safe (as is the signer pool), but the session cache is not,
+     * therefore the calls to the ticket encryptor are serialized. */
+    if (num_server_threads != 1 && ctx.tls->encrypt_ticket != NULL) {
+        locked_encrypt_ticket.super.cb = on_encrypt_ticket_locked;
+        locked_encrypt_ticket.orig = ctx.tls->encrypt_ticket;
+        ctx.tls->encrypt_ticket = &locked_encrypt_ticket.super;
+    }
+
+    server_threads = calloc(num_server_threads, sizeof(*server_threads));
+    assert(server_threads != NULL);
+
+    /* setup the threads, each having its own socket, context, and connection table */
+    for (i = 0; i != num_server_threads; ++i) {
+        struct st_server_thread_t *thread = server_threads + i;
+        thread->id = (uint32_t)i;
+        thread->ctx = ctx;
+        if (i != 0)
+            thread->ctx.cid_encryptor = quicly_new_default_cid_encryptor(
+                &ptls_openssl_bfecb, &ptls_openssl_aes128ecb, &ptls_openssl_sha256, ptls_iovec_init(cid_key, strlen(cid_key)));
+        thread->next_cid.thread_id = thread->id;
+        thread->egress_drr.quantum = MAX_BURST_PACKETS;
+        quicly_initial_guard_init(&thread->initial_guard, ctx.tls->random_bytes, ctx.now->cb(ctx.now));
+        thread->initial_guard.config.half_open_threshold = retry_threshold;
+        if (i == 0) {
+            thread->fd = fd;
+        } else if ((thread->fd = create_udp_socket(sa->sa_family)) == -1) {
+            return 1;
+        }
+        if (num_server_threads != 1) {
+#ifdef SO_REUSEPORT
+            int on = 1;
+            if (setsockopt(thread->fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+                perror("setsockopt(SO_REUSEPORT) failed");
+                return 1;
+            }
+#else
+            fprintf(stderr, "SO_REUSEPORT is not available on this platform\n");
+            return 1;
+#endif
+            steer_ring_init(&thread->inbox, STEER_RING_CAPACITY, ctx.transport_params.max_udp_payload_size);
+        }
+        if (signer_pool != NULL) {
+            pthread_mutex_init(&thread->async_handshakes.mutex, NULL);
+            if (pipe(thread->async_handshakes.notify_fds) != 0) {
+                perror("pipe(2) failed");
+                return 1;
+            }
+            fcntl(thread->async_handshakes.notify_fds[0], F_SETFL, O_NONBLOCK);
+            fcntl(thread->async_handshakes.notify_fds[1], F_SETFL, O_NONBLOCK);
+        }
+        if (pipe(thread->signal_fds) != 0) {
+            perror("pipe(2) failed");
+            return 1;
+        }
+        fcntl(thread->signal_fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(thread->signal_fds[1], F_SETFL, O_NONBLOCK);
+        if (bind(thread->fd, sa, salen) != 0) {
+            perror("bind(2) failed");
+            return 1;
+        }
+    }
+
+    /* the handler notifies the threads through the pipes, therefore it is installed after the pipes are set up */
+    signal(SIGINT, on_signal);
+    signal(SIGHUP, on_signal);
+
+    /* spawn the threads other than the first one, which runs on the main thread */
+    for (i = 1; i < num_server_threads; ++i) {
+        int ret;
+        if ((ret = pthread_create(&server_threads[i].tid, NULL, server_thread_main, server_threads + i)) != 0) {
+            fprintf(stderr, "pthread_create failed:%s\n", strerror(ret));
+            return 1;
+        }
+    }
+
+    run_server_thread(server_threads);
+    return 0;
+}
+
 static void load_session(void)
 {
     static uint8_t buf[65536];
@@ -1025,14 +1809,42 @@ static void usage(const char *cmd)
            "  -d draft-number           specifies the draft version number to be used (e.g.,\n"
            "                            29)\n"
            "  -e event-log-file         file to log events\n"
+           "  --bintrace <path>         records the events to a binary ring file (suffixed\n"
+           "                            by the thread id when running multiple server\n"
+           "                            threads), to be decoded by bintrace-decode\n"
+           "  --flight-recorder <bytes> retains the latest events of each connection in a\n"
+           "                            ring of specified size, dumping them to stderr\n"
+           "                            upon PTO storms, persistent congestion, handshake\n"
+           "                            timeouts, and closure due to errors\n"
+           "  --qlog <path>             writes the events in qlog (JSON-SEQ) format\n"
+           "  --qlog-sample <n>         logs one out of every n connections (default: 1)\n"
+           "  --qlog-categories <list>  comma-separated list of event categories being\n"
+           "                            logged; connectivity, transport, recovery, or all\n"
+           "                            (default: all)\n"
            "  -E                        expand Client Hello (sends multiple client Initials)\n"
+           "  --egress-budget <num>     number of datagrams each server thread sends per\n"
+           "                            event loop iteration, shared among connections by\n"
+           "                            their weights using deficit round robin (server-\n"
+           "                            only; default: 0, unlimited)\n"
+           "  --conn-weight <addr>=<n>  weight of connections from the address when\n"
+           "                            --egress-budget is used; each unit of weight earns\n"
+           "                            10 datagrams per round (default: 1); can be set\n"
+           "                            multiple times\n"
            "  --ech-config <file>       file that contains ECHConfigList or an empty file to\n"
            "                            grease ECH; will be overwritten when receiving\n"
            "                            retry_configs from the server\n"
            "  --ech-key <file>          ECH private key for each ECH config provided by\n"
            "                            --ech-config\n"
+           "  --signer-threads <num>    number of threads generating the handshake\n"
+           "                            signatures off the event loop (server-only;\n"
+           "                            default: 0, signing on the event loop)\n"
+           "  --stats-socket <path>     serves the counters aggregated across connections in\n"
+           "                            Prometheus text format on the UNIX socket\n"
+           "                            (server-only)\n"
            "  -f fraction               increases the induced ack frequency to specified\n"
-           "                            fraction of CWND (default: 0)\n"
+           "                            fraction of CWND (default: 0); if \"adaptive\" is\n"
+           "                            specified, the ack frequency is adjusted based on\n"
+           "                            CWND and RTT\n"
            "  -G                        enable UDP generic segmentation offload\n"
            "  -i interval               interval to reissue requests (in milliseconds)\n"
            "  -I timeout                idle timeout (in milliseconds; default: 600,000)\n"
@@ -1040,6 +1852,13 @@ static void usage(const char *cmd)
            "  -l log-file               file to log traffic secrets\n"
            "  -M <bytes>                max stream data (in bytes; default: 1MB)\n"
            "  -m <bytes>                max data (in bytes; default: 16MB)\n"
+           "  --max-receive-window <bytes>\n"
+           "                            enables auto-tuning of the stream- and connection-\n"
+           "                            level receive windows (set by -M and -m), allowing\n"
+           "                            them to grow up to the specified size\n"
+           "  --memory-budget <bytes>   throttles the receive windows being advertised as the\n"
+           "                            memory held by all the connections approaches the\n"
+           "                            specified size\n"
            "  -N                        enforce HelloRetryRequest (client-only)\n"
            "  -n                        enforce version negotiation (client-only)\n"
            "  -O                        suppress output\n"
@@ -1047,9 +1866,14 @@ static void usage(const char *cmd)
            "  -P path                   path to request, store response to file (can be set\n"
            "                            multiple times)\n"
            "  -R                        require Retry (server only)\n"
+           "  --retry-threshold <num>   number of half-open connections at which the server\n"
+           "                            starts requiring Retry and rate-limiting Initials\n"
+           "                            per source prefix (default: unlimited)\n"
            "  -r [initial-pto]          initial PTO (in milliseconds)\n"
            "  -S [num-speculative-ptos] number of speculative PTOs\n"
            "  -s session-file           file to load / store the session ticket\n"
+           "  -T num-threads            number of server threads, each bound to the same\n"
+           "                            address using SO_REUSEPORT (default: 1)\n"
            "  -u size                   initial size of UDP datagram payload\n"
            "  -U size                   maximum size of UDP datagram payload\n"
            "  -V                        verify peer using the default certificates\n"
@@ -1080,10 +1904,9 @@ static void push_req(const char *path, int to_file)
 
 int main(int argc, char **argv)
 {
-    const char *cert_file = NULL, *raw_pubkey_file = NULL, *host, *port, *cid_key = NULL;
+    const char *cert_file = NULL, *raw_pubkey_file = NULL, *host, *port;
     struct sockaddr_storage sa;
     socklen_t salen;
-    unsigned udpbufsize = 0;
     int ch, opt_index, fd;
 
     ERR_load_crypto_strings();
@@ -1102,20 +1925,31 @@ int main(int argc, char **argv)
     ctx.closed_by_remote = &closed_by_remote;
     ctx.save_resumption_token = &save_resumption_token;
     ctx.generate_resumption_token = &generate_resumption_token;
+    ctx.collect_latency_stats = 1; /* `dump_stats` reports the RTT distribution */
 
     setup_session_cache(ctx.tls);
     quicly_amend_ptls_context(ctx.tls);
 
-    {
-        uint8_t secret[PTLS_MAX_DIGEST_SIZE];
-        ctx.tls->random_bytes(secret, ptls_openssl_sha256.digest_size);
-        address_token_aead.enc = ptls_aead_new(&ptls_openssl_aes128gcm, &ptls_openssl_sha256, 1, secret, "");
-        address_token_aead.dec = ptls_aead_new(&ptls_openssl_aes128gcm, &ptls_openssl_sha256, 0, secret, "");
-    }
+    ctx.tls->random_bytes(address_token_secret, ptls_openssl_sha256.digest_size);
+    setup_address_token_aead();
 
     static const struct option longopts[] = {
-        {"ech-key", required_argument, NULL, 0}, {"ech-configs", required_argument, NULL, 0}, {NULL}};
-    while ((ch = getopt_long(argc, argv, "a:b:B:c:C:Dd:k:Ee:f:Gi:I:K:l:M:m:NnOp:P:Rr:S:s:u:U:Vvw:W:x:X:y:h", longopts,
+        {"ech-key", required_argument, NULL, 0},
+        {"ech-configs", required_argument, NULL, 0},
+        {"signer-threads", required_argument, NULL, 0},
+        {"stats-socket", required_argument, NULL, 0},
+        {"retry-threshold", required_argument, NULL, 0},
+        {"egress-budget", required_argument, NULL, 0},
+        {"conn-weight", required_argument, NULL, 0},
+        {"max-receive-window", required_argument, NULL, 0},
+        {"memory-budget", required_argument, NULL, 0},
+        {"bintrace", required_argument, NULL, 0},
+        {"flight-recorder", required_argument, NULL, 0},
+        {"qlog", required_argument, NULL, 0},
+        {"qlog-sample", required_argument, NULL, 0},
+        {"qlog-categories", required_argument, NULL, 0},
+        {NULL}};
+    while ((ch = getopt_long(argc, argv, "a:b:B:c:C:Dd:k:Ee:f:Gi:I:K:l:M:m:NnOp:P:Rr:S:s:T:u:U:Vvw:W:x:X:y:h", longopts,
                              &opt_index)) != -1) {
         switch (ch) {
         case 0: /* longopts */
@@ -1123,6 +1957,81 @@ int main(int argc, char **argv)
                 ech_setup_key(&tlsctx, optarg);
             } else if (strcmp(longopts[opt_index].name, "ech-configs") == 0) {
                 ech_setup_configs(optarg);
+            } else if (strcmp(longopts[opt_index].name, "retry-threshold") == 0) {
+                if (sscanf(optarg, "%zu", &retry_threshold) != 1) {
+                    fprintf(stderr, "failed to parse retry threshold: %s\n", optarg);
+                    exit(1);
+                }
+            } else if (strcmp(longopts[opt_index].name, "egress-budget") == 0) {
+                if (sscanf(optarg, "%zu", &egress_budget) != 1) {
+                    fprintf(stderr, "failed to parse egress budget: %s\n", optarg);
+                    exit(1);
+                }
+            } else if (strcmp(longopts[opt_index].name, "conn-weight") == 0) {
+                struct st_conn_weight_rule_t rule = {{{0}}};
+                char addr[INET6_ADDRSTRLEN], *sep;
+                if ((sep = strrchr(optarg, '=')) == NULL || (size_t)(sep - optarg) >= sizeof(addr) ||
+                    sscanf(sep + 1, "%" SCNu32, &rule.weight) != 1 || rule.weight == 0) {
+                    fprintf(stderr, "failed to parse connection weight (expected <address>=<weight>): %s\n", optarg);
+                    exit(1);
+                }
+                memcpy(addr, optarg, sep - optarg);
+                addr[sep - optarg] = '\0';
+                if (inet_pton(AF_INET, addr, &rule.address.sin.sin_addr) == 1) {
+                    rule.address.sin.sin_family = AF_INET;
+                } else if (inet_pton(AF_INET6, addr, &rule.address.sin6.sin6_addr) == 1) {
+                    rule.address.sin6.sin6_family = AF_INET6;
+                } else {
+                    fprintf(stderr, "failed to parse address: %s\n", addr);
+                    exit(1);
+                }
+                conn_weight_rules.entries =
+                    realloc(conn_weight_rules.entries, sizeof(*conn_weight_rules.entries) * (conn_weight_rules.count + 1));
+                assert(conn_weight_rules.entries != NULL);
+                conn_weight_rules.entries[conn_weight_rules.count++] = rule;
+            } else if (strcmp(longopts[opt_index].name, "max-receive-window") == 0) {
+                uint64_t v;
+                if (sscanf(optarg, "%" SCNu64, &v) != 1) {
+                    fprintf(stderr, "failed to parse max receive window: %s\n", optarg);
+                    exit(1);
+                }
+                ctx.max_receive_window.max_stream_data = v;
+                ctx.max_receive_window.max_data = v;
+            } else if (strcmp(longopts[opt_index].name, "memory-budget") == 0) {
+                size_t v;
+                if (sscanf(optarg, "%zu", &v) != 1) {
+                    fprintf(stderr, "failed to parse memory budget: %s\n", optarg);
+                    exit(1);
+                }
+                quicly_memory_budget_init(&memory_budget, v);
+                ctx.memory_budget = &memory_budget;
+            } else if (strcmp(longopts[opt_index].name, "signer-threads") == 0) {
+                if (sscanf(optarg, "%zu", &num_signer_threads) != 1) {
+                    fprintf(stderr, "failed to parse number of signer threads: %s\n", optarg);
+                    exit(1);
+                }
+            } else if (strcmp(longopts[opt_index].name, "stats-socket") == 0) {
+                stats_socket_path = optarg;
+            } else if (strcmp(longopts[opt_index].name, "bintrace") == 0) {
+                bintrace_path = optarg;
+            } else if (strcmp(longopts[opt_index].name, "flight-recorder") == 0) {
+                if (sscanf(optarg, "%zu", &flight_recorder.ring_size) != 1) {
+                    fprintf(stderr, "failed to parse flight recorder size: %s\n", optarg);
+                    exit(1);
+                }
+                ctx.flight_recorder = &flight_recorder;
+            } else if (strcmp(longopts[opt_index].name, "qlog") == 0) {
+                qlog_path = optarg;
+            } else if (strcmp(longopts[opt_index].name, "qlog-sample") == 0) {
+                if (sscanf(optarg, "%" SCNu32, &qlog.sampling_rate) != 1) {
+                    fprintf(stderr, "failed to parse qlog sampling rate: %s\n", optarg);
+                    exit(1);
+                }
+            } else if (strcmp(longopts[opt_index].name, "qlog-categories") == 0) {
+                if (quicly_qlog_parse_categories(optarg, &qlog.categories) != 0) {
+                    fprintf(stderr, "failed to parse qlog categories: %s\n", optarg);
+                    exit(1);
+                }
             } else {
                 assert(!"unexpected longname");
             }
@@ -1191,11 +2100,14 @@ int main(int argc, char **argv)
         } break;
         case 'f': {
             double fraction;
-            if (sscanf(optarg, "%lf", &fraction) != 1) {
+            if (strcmp(optarg, "adaptive") == 0) {
+                ctx.adjust_ack_frequency = &quicly_default_adjust_ack_frequency.super;
+            } else if (sscanf(optarg, "%lf", &fraction) != 1) {
                 fprintf(stderr, "failed to parse ack frequency: %s\n", optarg);
                 exit(1);
+            } else {
+                ctx.ack_frequency = (uint32_t)(fraction * 1024);
             }
-            ctx.ack_frequency = (uint32_t)(fraction * 1024);
         } break;
         case 'i':
             if (sscanf(optarg, "%" SCNd64, &request_interval) != 1) {
@@ -1268,6 +2180,12 @@ int main(int argc, char **argv)
         case 's':
             session_file = optarg;
             break;
+        case 'T':
+            if (sscanf(optarg, "%zu", &num_server_threads) != 1 || num_server_threads == 0) {
+                fprintf(stderr, "invalid argument passed to `-T`\n");
+                exit(1);
+            }
+            break;
         case 'u':
             if (sscanf(optarg, "%" SCNu16, &ctx.initial_egress_max_udp_payload_size) != 1) {
                 fprintf(stderr, "invalid argument passed to `-u`\n");
@@ -1354,6 +2272,13 @@ int main(int argc, char **argv)
     argc -= optind;
     argv += optind;
 
+#if !QUICLY_USE_BINTRACE
+    if (bintrace_path != NULL || ctx.flight_recorder != NULL || qlog_path != NULL) {
+        fprintf(stderr, "--bintrace, --flight-recorder, and --qlog require quicly to be built with WITH_BINTRACE=ON\n");
+        exit(1);
+    }
+#endif
+
     if (reqs[0].path == NULL)
         push_req("/", 0);
 
@@ -1413,6 +2338,14 @@ int main(int argc, char **argv)
         }
         ctx.cid_encryptor = quicly_new_default_cid_encryptor(&ptls_openssl_bfecb, &ptls_openssl_aes128ecb, &ptls_openssl_sha256,
                                                              ptls_iovec_init(cid_key, strlen(cid_key)));
+        if (num_signer_threads != 0) {
+            if ((signer_pool = quicly_signer_pool_create(ctx.tls->sign_certificate, num_signer_threads)) == NULL) {
+                fprintf(stderr, "failed to create the signer pool\n");
+                exit(1);
+            }
+            ctx.tls->sign_certificate = quicly_signer_pool_get_sign_certificate(signer_pool);
+            ctx.async_handshake = &async_handshake;
+        }
     } else {
         /* client */
         if (raw_pubkey_file != NULL) {
@@ -1445,43 +2378,18 @@ int main(int argc, char **argv)
     if (resolve_address((void *)&sa, &salen, host, port, AF_INET, SOCK_DGRAM, IPPROTO_UDP) != 0)
         exit(1);
 
-    if ((fd = socket(sa.ss_family, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
-        perror("socket(2) failed");
+    if ((fd = create_udp_socket(sa.ss_family)) == -1)
         return 1;
-    }
-    fcntl(fd, F_SETFL, O_NONBLOCK);
-    {
-        int on = 1;
-        if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0) {
-            perror("setsockopt(SO_REUSEADDR) failed");
-            return 1;
-        }
-    }
-    if (udpbufsize != 0) {
-        unsigned arg = udpbufsize;
-        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &arg, sizeof(arg)) != 0) {
-            perror("setsockopt(SO_RCVBUF) failed");
-            return 1;
-        }
-        arg = udpbufsize;
-        if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &arg, sizeof(arg)) != 0) {
-            perror("setsockopt(SO_RCVBUF) failed");
-            return 1;
+
+    if (qlog_path != NULL) {
+        /* O_APPEND, as the batches are written by multiple server threads */
+        if ((qlog.fd = open(qlog_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0666)) == -1 ||
+            quicly_qlog_write_header(&qlog, "quicly", ctx.tls->certificates.count != 0 ? "server" : "client") != 0) {
+            fprintf(stderr, "failed to open file:%s:%s\n", qlog_path, strerror(errno));
+            exit(1);
         }
+        ctx.qlog = &qlog;
     }
-#if defined(IP_DONTFRAG)
-    {
-        int on = 1;
-        if (setsockopt(fd, IPPROTO_IP, IP_DONTFRAG, &on, sizeof(on)) != 0)
-            perror("Warning: setsockopt(IP_DONTFRAG) failed");
-    }
-#elif defined(IP_PMTUDISC_DO)
-    {
-        int opt = IP_PMTUDISC_DO;
-        if (setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &opt, sizeof(opt)) != 0)
-            perror("Warning: setsockopt(IP_MTU_DISCOVER) failed");
-    }
-#endif
 
     return ctx.tls->certificates.count != 0 ? run_server(fd, (void *)&sa, salen) : run_client(fd, (void *)&sa, host);
 }
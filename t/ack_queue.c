@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "quicly/ack_queue.h"
+#include "test.h"
+
+#define CHECK(...)                                                                                                                 \
+    do {                                                                                                                           \
+        static const struct st_quicly_range_t expected[] = {__VA_ARGS__};                                                          \
+        quicly_range_t actual[64];                                                                                                 \
+        size_t num_ranges = quicly_ack_queue_get_ranges(&queue, actual, PTLS_ELEMENTSOF(actual)), i;                               \
+        ok(num_ranges == PTLS_ELEMENTSOF(expected));                                                                               \
+        ok(quicly_ack_queue_num_ranges(&queue) == PTLS_ELEMENTSOF(expected));                                                      \
+        for (i = 0; i != num_ranges; ++i) {                                                                                        \
+            ok(actual[i].start == expected[i].start);                                                                              \
+            ok(actual[i].end == expected[i].end);                                                                                  \
+        }                                                                                                                          \
+        ok(queue.end == expected[PTLS_ELEMENTSOF(expected) - 1].end);                                                              \
+    } while (0)
+
+static void test_basic(void)
+{
+    quicly_ack_queue_t queue;
+    uint64_t pn;
+
+    quicly_ack_queue_init(&queue);
+    ok(quicly_ack_queue_is_empty(&queue));
+
+    /* in-order, sliding the bitmap several times */
+    for (pn = 0; pn != 1000; ++pn)
+        ok(quicly_ack_queue_add(&queue, pn) == 0);
+    CHECK({0, 1000});
+    ok(queue.ranges.num_ranges == 1);
+
+    /* small reordering */
+    ok(quicly_ack_queue_add(&queue, 1001) == 0);
+    ok(quicly_ack_queue_add(&queue, 1003) == 0);
+    CHECK({0, 1000}, {1001, 1002}, {1003, 1004});
+    ok(quicly_ack_queue_add(&queue, 1000) == 0);
+    ok(quicly_ack_queue_add(&queue, 1002) == 0);
+    CHECK({0, 1004});
+
+    /* large gap, then reordering beyond the bitmap */
+    ok(quicly_ack_queue_add(&queue, 5000) == 0);
+    CHECK({0, 1004}, {5000, 5001});
+    ok(quicly_ack_queue_add(&queue, 2000) == 0);
+    CHECK({0, 1004}, {2000, 2001}, {5000, 5001});
+    ok(quicly_ack_queue_add(&queue, 1004) == 0);
+    CHECK({0, 1005}, {2000, 2001}, {5000, 5001});
+
+    /* subtract */
+    ok(quicly_ack_queue_subtract(&queue, 0, 2001) == 0);
+    CHECK({5000, 5001});
+    ok(quicly_ack_queue_subtract(&queue, 5000, 5001) == 0);
+    ok(quicly_ack_queue_is_empty(&queue));
+
+    quicly_ack_queue_dispose(&queue);
+}
+
+static void test_boundary(void)
+{
+    quicly_ack_queue_t queue;
+    uint64_t pn;
+
+    quicly_ack_queue_init(&queue);
+
+    /* a range that spans `ranges` and the bitmap is reported as one */
+    for (pn = 200; pn != 500; ++pn)
+        ok(quicly_ack_queue_add(&queue, pn) == 0);
+    ok(queue.bitmap.base == 256);
+    ok(queue.ranges.num_ranges == 1);
+    CHECK({200, 500});
+
+    /* subtract across the boundary */
+    ok(quicly_ack_queue_subtract(&queue, 250, 260) == 0);
+    CHECK({200, 250}, {260, 500});
+    ok(quicly_ack_queue_subtract(&queue, 490, 500) == 0);
+    CHECK({200, 250}, {260, 490});
+
+    quicly_ack_queue_dispose(&queue);
+}
+
+static void test_shrink(void)
+{
+    quicly_ack_queue_t queue;
+    uint64_t pn;
+
+    quicly_ack_queue_init(&queue);
+
+    /* gaps within the bitmap */
+    for (pn = 0; pn < 200; pn += 2)
+        ok(quicly_ack_queue_add(&queue, pn) == 0);
+    ok(quicly_ack_queue_num_ranges(&queue) == 100);
+    quicly_ack_queue_shrink(&queue, 3);
+    CHECK({194, 195}, {196, 197}, {198, 199});
+
+    /* gaps below the bitmap */
+    for (pn = 1000; pn < 2000; pn += 10)
+        ok(quicly_ack_queue_add(&queue, pn) == 0);
+    quicly_ack_queue_shrink(&queue, 2);
+    CHECK({1980, 1981}, {1990, 1991});
+
+    quicly_ack_queue_dispose(&queue);
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return *state >> 8;
+}
+
+/**
+ * compares the queue against quicly_ranges_t, while receiving packets with reordering and acknowledging them
+ */
+static void test_random(void)
+{
+    quicly_ack_queue_t queue;
+    quicly_ranges_t expected;
+    uint32_t random_state = 1;
+    uint64_t next_pn = 0, held[8];
+    size_t num_held = 0, i, num_mismatch = 0;
+
+    quicly_ack_queue_init(&queue);
+    quicly_ranges_init(&expected);
+
+    for (i = 0; i != 100000; ++i) {
+        uint32_t r = next_random(&random_state);
+        uint64_t pn;
+        if (num_held != 0 && r % 4 == 0) {
+            /* deliver one of the delayed packets */
+            size_t slot = r / 4 % num_held;
+            pn = held[slot];
+            held[slot] = held[--num_held];
+        } else {
+            pn = next_pn++;
+            if (r % 31 == 0)
+                next_pn += r % 1000; /* burst loss */
+            if (num_held < PTLS_ELEMENTSOF(held) && r % 7 == 0) {
+                held[num_held++] = pn;
+                continue;
+            }
+        }
+        if (quicly_ack_queue_add(&queue, pn) != 0 || quicly_ranges_add(&expected, pn, pn + 1) != 0)
+            ++num_mismatch;
+        if (r % 64 == 0 && expected.num_ranges != 0) {
+            /* acknowledge everything below some packet number */
+            uint64_t end = expected.ranges[r / 64 % expected.num_ranges].end;
+            if (quicly_ack_queue_subtract(&queue, 0, end) != 0 || quicly_ranges_subtract(&expected, 0, end) != 0)
+                ++num_mismatch;
+        }
+        /* compare */
+        quicly_range_t actual[1024];
+        size_t num_ranges = quicly_ack_queue_get_ranges(&queue, actual, PTLS_ELEMENTSOF(actual));
+        if (num_ranges != expected.num_ranges ||
+            (num_ranges != 0 && memcmp(actual, expected.ranges, sizeof(actual[0]) * num_ranges) != 0) ||
+            queue.end != (expected.num_ranges != 0 ? expected.ranges[expected.num_ranges - 1].end : 0))
+            ++num_mismatch;
+    }
+    ok(num_mismatch == 0);
+
+    quicly_ranges_clear(&expected);
+    quicly_ack_queue_dispose(&queue);
+}
+
+void test_ack_queue(void)
+{
+    subtest("basic", test_basic);
+    subtest("boundary", test_boundary);
+    subtest("shrink", test_shrink);
+    subtest("random", test_random);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_t_alloc_counter_h
+#define quicly_t_alloc_counter_h
+
+/**
+ * Counts the number of calls to malloc, calloc, and realloc by interposing the allocator of glibc. As the functions are defined
+ * without the static keyword, this file MUST be included by exactly one translation unit of an executable. When the counter is
+ * unavailable (e.g., when ASan replaces the allocator), `HAVE_ALLOC_COUNTER` is set to zero and `num_allocs` remains zero.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+static uint64_t num_allocs;
+void *malloc(size_t size)
+{
+    ++num_allocs;
+    return __libc_malloc(size);
+}
+void *calloc(size_t nmemb, size_t size)
+{
+    ++num_allocs;
+    return __libc_calloc(nmemb, size);
+}
+void *realloc(void *ptr, size_t size)
+{
+    ++num_allocs;
+    return __libc_realloc(ptr, size);
+}
+#define HAVE_ALLOC_COUNTER 1
+#else
+static uint64_t num_allocs;
+#define HAVE_ALLOC_COUNTER 0
+#endif
+
+#endif
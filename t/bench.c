@@ -0,0 +1,502 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <openssl/bio.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include "picotls.h"
+#include "picotls/openssl.h"
+#if QUICLY_HAVE_FUSION
+#include "picotls/fusion.h"
+#endif
+#include "quicly.h"
+#include "quicly/cc.h"
+#include "quicly/defaults.h"
+#include "alloc_counter.h"
+#include "perf_counters.h"
+#include "test_certs.h"
+
+/**
+ * An in-memory benchmark of `quicly_send` and `quicly_receive`. A client and a server exchange packets without involving the
+ * network stack, with the clock being advanced only when both endpoints are idle; therefore the numbers reflect the CPU cost of
+ * quicly (and of the AEAD engine).
+ */
+
+#define MAX_STREAMS_IN_FLIGHT 100
+#define MAX_DATAGRAMS_IN_FLIGHT 64
+#define MAX_DATAGRAM_SIZE 1100
+
+enum en_workload_type_t { WORKLOAD_BULK, WORKLOAD_STREAMS, WORKLOAD_DATAGRAM };
+
+static const char *workload_names[] = {"bulk", "streams", "datagram"};
+
+static struct {
+    enum en_workload_type_t type;
+    /**
+     * number of streams or datagrams to be sent
+     */
+    uint64_t count;
+    /**
+     * size of each stream or datagram
+     */
+    uint64_t size;
+    uint64_t num_started, num_in_flight, num_completed, bytes_received;
+} workload;
+
+#if QUICLY_HAVE_FUSION
+static ptls_cipher_suite_t fusion_aes128gcmsha256 = {PTLS_CIPHER_SUITE_AES_128_GCM_SHA256, &ptls_fusion_aes128gcm,
+                                                     &ptls_openssl_sha256};
+#endif
+
+static int64_t now = 1000;
+static quicly_context_t ctx;
+static quicly_cid_plaintext_t next_cid;
+static struct sockaddr_in client_addr, server_addr;
+static uint8_t datagram_payload[MAX_DATAGRAM_SIZE];
+
+static uint64_t tls_now_cb(ptls_get_time_t *self)
+{
+    return (uint64_t)now;
+}
+
+static int64_t quic_now_cb(quicly_now_t *self)
+{
+    return now;
+}
+
+static uint64_t monotonic_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void stream_destroy_cb(quicly_stream_t *stream, int err)
+{
+    if (quicly_is_client(stream->conn))
+        --workload.num_in_flight;
+}
+
+static void stream_egress_shift_cb(quicly_stream_t *stream, size_t delta)
+{
+}
+
+static void stream_egress_emit_cb(quicly_stream_t *stream, size_t off, void *dst, size_t *len, int *wrote_all)
+{
+    uint64_t bytes_left = workload.size - off;
+
+    if (*len >= bytes_left) {
+        *len = bytes_left;
+        *wrote_all = 1;
+    } else {
+        *wrote_all = 0;
+    }
+    memset(dst, 'A', *len);
+}
+
+static void stream_on_stop_sending_cb(quicly_stream_t *stream, int err)
+{
+    assert(!"unexpected");
+}
+
+static void stream_on_receive_cb(quicly_stream_t *stream, size_t off, const void *src, size_t len)
+{
+    size_t bytes_available = stream->recvstate.received.ranges[0].end - stream->recvstate.data_off;
+
+    if (bytes_available != 0) {
+        workload.bytes_received += bytes_available;
+        quicly_stream_sync_recvbuf(stream, bytes_available);
+    }
+    if (quicly_recvstate_transfer_complete(&stream->recvstate))
+        ++workload.num_completed;
+}
+
+static void stream_on_receive_reset_cb(quicly_stream_t *stream, int err)
+{
+    assert(!"unexpected");
+}
+
+static int stream_open_cb(quicly_stream_open_t *self, quicly_stream_t *stream)
+{
+    static const quicly_stream_callbacks_t stream_callbacks = {stream_destroy_cb,     stream_egress_shift_cb,
+                                                               stream_egress_emit_cb, stream_on_stop_sending_cb,
+                                                               stream_on_receive_cb,  stream_on_receive_reset_cb};
+    stream->callbacks = &stream_callbacks;
+    return 0;
+}
+
+static void receive_datagram_frame_cb(quicly_receive_datagram_frame_t *self, quicly_conn_t *conn, ptls_iovec_t payload)
+{
+    workload.bytes_received += payload.len;
+    ++workload.num_completed;
+}
+
+static void on_datagram_release(quicly_datagram_t *datagram, int sent)
+{
+    --workload.num_in_flight;
+}
+
+/**
+ * starts sending streams or datagrams, up to the concurrency limit
+ */
+static void push_work(quicly_conn_t *client)
+{
+    int ret;
+
+    switch (workload.type) {
+    case WORKLOAD_BULK:
+    case WORKLOAD_STREAMS:
+        while (workload.num_started < workload.count && workload.num_in_flight < MAX_STREAMS_IN_FLIGHT) {
+            quicly_stream_t *stream;
+            if ((ret = quicly_open_stream(client, &stream, 1)) != 0 || (ret = quicly_stream_sync_sendbuf(stream, 1)) != 0) {
+                fprintf(stderr, "failed to open stream:%d\n", ret);
+                exit(1);
+            }
+            ++workload.num_started;
+            ++workload.num_in_flight;
+        }
+        break;
+    case WORKLOAD_DATAGRAM:
+        while (workload.num_started < workload.count && workload.num_in_flight < MAX_DATAGRAMS_IN_FLIGHT) {
+            quicly_datagram_t datagram = {.payload = ptls_iovec_init(datagram_payload, workload.size),
+                                          .expire_at = INT64_MAX,
+                                          .release = on_datagram_release};
+            ++workload.num_started;
+            ++workload.num_in_flight;
+            if ((ret = quicly_enqueue_datagram_frame(client, &datagram)) != 0) {
+                fprintf(stderr, "failed to enqueue datagram:%d\n", ret);
+                exit(1);
+            }
+        }
+        break;
+    }
+}
+
+static int workload_is_complete(void)
+{
+    if (workload.type == WORKLOAD_DATAGRAM)
+        return workload.num_started == workload.count && workload.num_in_flight == 0;
+    return workload.num_completed == workload.count;
+}
+
+/**
+ * sends the packets of `src` to `*dst`, accepting a new connection if `*dst` is NULL; returns the number of packets
+ */
+static size_t transmit(quicly_conn_t *src, quicly_conn_t **dst)
+{
+    quicly_address_t destaddr, srcaddr;
+    struct iovec datagrams[16];
+    uint8_t datagramsbuf[PTLS_ELEMENTSOF(datagrams) * ctx.transport_params.max_udp_payload_size];
+    size_t num_datagrams = PTLS_ELEMENTSOF(datagrams), num_packets = 0, i;
+    int ret;
+
+    if ((ret = quicly_send(src, &destaddr, &srcaddr, datagrams, &num_datagrams, datagramsbuf, sizeof(datagramsbuf))) != 0) {
+        fprintf(stderr, "quicly_send failed:%d\n", ret);
+        exit(1);
+    }
+
+    for (i = 0; i != num_datagrams; ++i) {
+        size_t off = 0;
+        while (off != datagrams[i].iov_len) {
+            quicly_decoded_packet_t packet;
+            if (quicly_decode_packet(&ctx, &packet, datagrams[i].iov_base, datagrams[i].iov_len, &off) == SIZE_MAX)
+                break;
+            if (*dst == NULL) {
+                ret = quicly_accept(dst, &ctx, &destaddr.sa, &srcaddr.sa, &packet, NULL, &next_cid, NULL, NULL);
+                ++next_cid.master_id;
+            } else {
+                ret = quicly_receive(*dst, &destaddr.sa, &srcaddr.sa, &packet);
+            }
+            if (!(ret == 0 || ret == QUICLY_ERROR_PACKET_IGNORED)) {
+                fprintf(stderr, "failed to receive packet:%d\n", ret);
+                exit(1);
+            }
+            ++num_packets;
+        }
+    }
+
+    return num_packets;
+}
+
+/**
+ * advances the clock to the earliest timer; called when neither endpoint has anything to send
+ */
+static void advance_clock(quicly_conn_t *client, quicly_conn_t *server)
+{
+    int64_t at = quicly_get_first_timeout(client);
+
+    if (server != NULL && quicly_get_first_timeout(server) < at)
+        at = quicly_get_first_timeout(server);
+    if (at == INT64_MAX) {
+        fprintf(stderr, "stalled\n");
+        exit(1);
+    }
+    if (at > now)
+        now = at;
+}
+
+static void run(quicly_cc_type_t *cc, const char *aead_name, struct perf_counters *counters)
+{
+    quicly_conn_t *client, *server = NULL;
+    uint64_t num_packets = 0, allocs_at_start, started_at, elapsed;
+    int ret;
+
+    ctx.init_cc = cc->cc_init;
+    workload.num_started = 0;
+    workload.num_in_flight = 0;
+    workload.num_completed = 0;
+    workload.bytes_received = 0;
+
+    /* handshake */
+    if ((ret = quicly_connect(&client, &ctx, "example.com", (void *)&server_addr, (void *)&client_addr, &next_cid,
+                              ptls_iovec_init(NULL, 0), NULL, NULL, NULL)) != 0) {
+        fprintf(stderr, "quicly_connect failed:%d\n", ret);
+        exit(1);
+    }
+    ++next_cid.master_id;
+    while (server == NULL || !quicly_connection_is_ready(client) || !quicly_connection_is_ready(server)) {
+        size_t n = transmit(client, &server);
+        if (server != NULL)
+            n += transmit(server, &client);
+        if (n == 0)
+            advance_clock(client, server);
+    }
+
+    /* transfer */
+    allocs_at_start = num_allocs;
+    if (counters != NULL)
+        perf_counters_enable(counters, 1);
+    started_at = monotonic_nsec();
+    while (!workload_is_complete()) {
+        push_work(client);
+        size_t n = transmit(client, &server);
+        n += transmit(server, &client);
+        if (n == 0)
+            advance_clock(client, server);
+        num_packets += n;
+    }
+    elapsed = monotonic_nsec() - started_at;
+    if (counters != NULL)
+        perf_counters_enable(counters, 0);
+
+    printf("workload=%s cc=%s aead=%s bytes=%" PRIu64 " elapsed=%.3f gbps=%.3f packets=%" PRIu64 " pps=%.0f ns-per-packet=%.1f",
+           workload_names[workload.type], cc->name, aead_name, workload.bytes_received, elapsed / 1e9,
+           workload.bytes_received * 8.0 / elapsed, num_packets, num_packets * 1e9 / elapsed, (double)elapsed / num_packets);
+    if (HAVE_ALLOC_COUNTER)
+        printf(" allocs-per-packet=%.3f", (double)(num_allocs - allocs_at_start) / num_packets);
+    if (counters != NULL) {
+        uint64_t cycles, instructions;
+        perf_counters_read(counters, &cycles, &instructions);
+        printf(" cycles-per-packet=%.0f instructions-per-packet=%.0f ipc=%.2f", (double)cycles / num_packets,
+               (double)instructions / num_packets, cycles != 0 ? (double)instructions / cycles : 0);
+    }
+    printf("\n");
+    fflush(stdout);
+
+    quicly_free(client);
+    quicly_free(server);
+}
+
+static void usage(const char *cmd)
+{
+    printf("Usage: %s [options]\n"
+           "\n"
+           "Options:\n"
+           "  -w <workload>  bulk (default), streams, or datagram\n"
+           "  -n <count>     bulk: number of bytes to transfer (default: 1073741824)\n"
+           "                 streams: number of streams (default: 100000)\n"
+           "                 datagram: number of datagrams (default: 1000000)\n"
+           "  -s <size>      size of each stream or datagram (default: 1000)\n"
+           "  -c <cc>        congestion controller; runs each of them if omitted\n"
+           "  -a <aead>      AEAD engine; either openssl or fusion (if available); runs each\n"
+           "                 of them if omitted\n"
+           "  -p             samples CPU cycles and instructions using perf counters\n"
+           "  -h             prints this help\n"
+           "\n",
+           cmd);
+}
+
+int main(int argc, char **argv)
+{
+    ERR_load_crypto_strings();
+    OpenSSL_add_all_algorithms();
+
+    ptls_iovec_t cert = {};
+    {
+        BIO *bio = BIO_new_mem_buf(RSA_CERTIFICATE, strlen(RSA_CERTIFICATE));
+        X509 *x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+        assert(x509 != NULL || !!"failed to load certificate");
+        BIO_free(bio);
+        cert.len = i2d_X509(x509, &cert.base);
+        X509_free(x509);
+    }
+
+    ptls_openssl_sign_certificate_t cert_signer;
+    {
+        BIO *bio = BIO_new_mem_buf(RSA_PRIVATE_KEY, strlen(RSA_PRIVATE_KEY));
+        EVP_PKEY *pkey = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+        assert(pkey != NULL || !"failed to load private key");
+        BIO_free(bio);
+        ptls_openssl_init_sign_certificate(&cert_signer, pkey);
+        EVP_PKEY_free(pkey);
+    }
+
+    static const struct {
+        const char *name;
+        ptls_cipher_suite_t *cipher_suite;
+    } aeads[] = {
+        {"openssl", &ptls_openssl_aes128gcmsha256},
+#if QUICLY_HAVE_FUSION
+        {"fusion", &fusion_aes128gcmsha256},
+#endif
+    };
+    ptls_cipher_suite_t *cipher_suites[2] = {NULL};
+    ptls_get_time_t tls_now = {tls_now_cb};
+    ptls_context_t tlsctx = {.random_bytes = ptls_openssl_random_bytes,
+                             .get_time = &tls_now,
+                             .key_exchanges = ptls_openssl_key_exchanges,
+                             .cipher_suites = cipher_suites,
+                             .certificates = {&cert, 1},
+                             .sign_certificate = &cert_signer.super};
+    quicly_amend_ptls_context(&tlsctx);
+
+    quicly_stream_open_t stream_open = {stream_open_cb};
+    quicly_receive_datagram_frame_t receive_datagram_frame = {receive_datagram_frame_cb};
+    quicly_now_t quic_now = {quic_now_cb};
+    ctx = quicly_spec_context;
+    ctx.now = &quic_now;
+    ctx.tls = &tlsctx;
+    ctx.stream_open = &stream_open;
+    ctx.receive_datagram_frame = &receive_datagram_frame;
+    ctx.transport_params.max_streams_uni = MAX_STREAMS_IN_FLIGHT;
+    ctx.transport_params.max_stream_data.uni = 16 * 1024 * 1024;
+    ctx.transport_params.max_data = 64 * 1024 * 1024;
+    ctx.transport_params.max_datagram_frame_size = 1500;
+    ctx.datagram_frame_queue.max_size = MAX_DATAGRAMS_IN_FLIGHT;
+
+    client_addr = (struct sockaddr_in){.sin_family = AF_INET, .sin_addr.s_addr = htonl(0x7f000001), .sin_port = htons(10000)};
+    server_addr = (struct sockaddr_in){.sin_family = AF_INET, .sin_addr.s_addr = htonl(0x7f000001), .sin_port = htons(443)};
+    memset(datagram_payload, 'A', sizeof(datagram_payload));
+
+    quicly_cc_type_t *cc = NULL;
+    const char *aead_name = NULL;
+    struct perf_counters counters, *counters_ptr = NULL;
+    int ch;
+    while ((ch = getopt(argc, argv, "w:n:s:c:a:ph")) != -1) {
+        switch (ch) {
+        case 'w':
+            for (workload.type = 0; workload.type < PTLS_ELEMENTSOF(workload_names); ++workload.type)
+                if (strcmp(workload_names[workload.type], optarg) == 0)
+                    break;
+            if (workload.type == PTLS_ELEMENTSOF(workload_names)) {
+                fprintf(stderr, "unknown workload: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'n':
+            if (sscanf(optarg, "%" SCNu64, &workload.count) != 1) {
+                fprintf(stderr, "invalid count: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 's':
+            if (sscanf(optarg, "%" SCNu64, &workload.size) != 1 || workload.size == 0) {
+                fprintf(stderr, "invalid size: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'c':
+            for (quicly_cc_type_t **cand = quicly_cc_all_types; *cand != NULL; ++cand)
+                if (strcmp((*cand)->name, optarg) == 0)
+                    cc = *cand;
+            if (cc == NULL) {
+                fprintf(stderr, "unknown congestion controller: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'a':
+            aead_name = optarg;
+            break;
+        case 'p':
+            if (perf_counters_open(&counters) != 0) {
+                fprintf(stderr, "failed to open perf counters\n");
+                exit(1);
+            }
+            counters_ptr = &counters;
+            break;
+        default:
+            usage(argv[0]);
+            exit(0);
+        }
+    }
+
+    /* setup the workload; bulk transfer is a single stream carrying `count` bytes */
+    if (workload.size == 0)
+        workload.size = 1000;
+    switch (workload.type) {
+    case WORKLOAD_BULK:
+        workload.size = workload.count != 0 ? workload.count : 1024 * 1024 * 1024;
+        workload.count = 1;
+        break;
+    case WORKLOAD_STREAMS:
+        if (workload.count == 0)
+            workload.count = 100000;
+        break;
+    case WORKLOAD_DATAGRAM:
+        if (workload.count == 0)
+            workload.count = 1000000;
+        if (workload.size > MAX_DATAGRAM_SIZE) {
+            fprintf(stderr, "datagram size must not exceed %d bytes\n", MAX_DATAGRAM_SIZE);
+            exit(1);
+        }
+        break;
+    }
+
+    size_t aead_index, num_runs = 0;
+    for (aead_index = 0; aead_index != PTLS_ELEMENTSOF(aeads); ++aead_index) {
+        if (aead_name != NULL && strcmp(aeads[aead_index].name, aead_name) != 0)
+            continue;
+        cipher_suites[0] = aeads[aead_index].cipher_suite;
+        for (quicly_cc_type_t **cand = quicly_cc_all_types; *cand != NULL; ++cand) {
+            if (cc != NULL && *cand != cc)
+                continue;
+            run(*cand, aeads[aead_index].name, counters_ptr);
+            ++num_runs;
+        }
+    }
+    if (num_runs == 0) {
+        fprintf(stderr, "unknown AEAD engine: %s\n", aead_name);
+        exit(1);
+    }
+
+    return 0;
+}
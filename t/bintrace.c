@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "quicly-bintrace.h"
+#include "test.h"
+
+#define TEST_EVENT 0xffff
+
+struct st_test_record_t {
+    quicly_bintrace_record_t header;
+    uint64_t seq;
+};
+
+struct st_collected_t {
+    uint64_t seqs[1024];
+    size_t count;
+};
+
+static int collect_seq(void *_collected, const quicly_bintrace_record_t *rec)
+{
+    struct st_collected_t *collected = _collected;
+
+    if (rec->type != TEST_EVENT || collected->count == PTLS_ELEMENTSOF(collected->seqs))
+        return -1;
+    collected->seqs[collected->count++] = ((const struct st_test_record_t *)rec)->seq;
+    return 0;
+}
+
+static int decode_to_file(void *fp, const quicly_bintrace_record_t *rec)
+{
+    return quicly_bintrace_decode(fp, rec);
+}
+
+/**
+ * decodes all the records in the ring, returning a string that has to be freed by the caller
+ */
+static char *decode_ring(quicly_bintrace_ring_t *ring)
+{
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&buf, &len);
+
+    ok(fp != NULL);
+    ok(quicly_bintrace_foreach(ring, decode_to_file, fp) == 0);
+    fclose(fp);
+
+    return buf;
+}
+
+static void test_decode(void)
+{
+    quicly_bintrace_ring_t *ring = quicly_bintrace_create(NULL, 4096);
+    char *decoded, long_str[200];
+
+    ok(ring != NULL);
+
+    memset(long_str, 'a', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = '\0';
+
+    QUICLY_BINTRACE_CONNECT(ring, NULL, 1234, 1);
+    QUICLY_BINTRACE_SEND(ring, NULL, 1235, -1, "0123abcd");
+    QUICLY_BINTRACE_SEND(ring, NULL, 1236, 0, long_str);
+    QUICLY_BINTRACE_SEND(ring, NULL, 1237, 0, NULL);
+    QUICLY_BINTRACE_SEND(ring, NULL, 1238, 0, "a\"b\\c\n");
+
+    decoded = decode_ring(ring);
+    ok(strcmp(decoded, "{\"type\":\"connect\", \"conn\":0, \"time\":1234, \"version\":1}\n"
+                       "{\"type\":\"send\", \"conn\":0, \"time\":1235, \"state\":-1, \"dcid\":\"0123abcd\"}\n"
+                       "{\"type\":\"send\", \"conn\":0, \"time\":1236, \"state\":0, \"dcid\":\""
+                       "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\"}\n"
+                       "{\"type\":\"send\", \"conn\":0, \"time\":1237, \"state\":0, \"dcid\":\"\"}\n"
+                       "{\"type\":\"send\", \"conn\":0, \"time\":1238, \"state\":0, \"dcid\":\"a\\x22b\\x5cc\\x0a\"}\n") == 0);
+    free(decoded);
+
+    quicly_bintrace_destroy(ring);
+}
+
+static void test_wrap(void)
+{
+    quicly_bintrace_ring_t *ring = quicly_bintrace_create(NULL, 4096);
+    struct st_collected_t collected;
+    uint64_t seq;
+    size_t i;
+
+    ok(ring != NULL);
+    ok(ring->capacity == 4096);
+
+    /* write records of various sizes, so that padding records are inserted at the end of the ring */
+    for (seq = 0; seq != 10000; ++seq) {
+        struct st_test_record_t *rec = quicly_bintrace_reserve(ring, TEST_EVENT, sizeof(*rec) + seq % 13 * 8 + seq % 3);
+        rec->seq = seq;
+        quicly_bintrace_commit(ring, rec);
+        if (ring->head - ring->tail > ring->capacity)
+            break;
+    }
+    ok(seq == 10000);
+    ok(ring->head - ring->tail > ring->capacity - 200);
+
+    /* the newest records are retained in order */
+    collected.count = 0;
+    ok(quicly_bintrace_foreach(ring, collect_seq, &collected) == 0);
+    ok(collected.count > 4096 / 128);
+    for (i = 0; i != collected.count; ++i)
+        if (collected.seqs[i] != 10000 - collected.count + i)
+            break;
+    ok(i == collected.count);
+
+    /* records larger than the ring are dropped */
+    ok(quicly_bintrace_reserve(ring, TEST_EVENT, 8192) == NULL);
+
+    quicly_bintrace_destroy(ring);
+}
+
+static void test_file(void)
+{
+    char path[] = "/tmp/quicly-bintrace-test.XXXXXX";
+    quicly_bintrace_ring_t *ring;
+    struct st_collected_t collected;
+    uint64_t seq;
+    int fd;
+
+    fd = mkstemp(path);
+    ok(fd != -1);
+    close(fd);
+
+    /* record */
+    ring = quicly_bintrace_create(path, 5000);
+    ok(ring != NULL);
+    ok(ring->capacity == 8192);
+    for (seq = 0; seq != 10; ++seq) {
+        struct st_test_record_t *rec = quicly_bintrace_reserve(ring, TEST_EVENT, sizeof(*rec));
+        rec->seq = seq;
+        quicly_bintrace_commit(ring, rec);
+    }
+    quicly_bintrace_destroy(ring);
+
+    /* read */
+    ring = quicly_bintrace_open(path);
+    ok(ring != NULL);
+    collected.count = 0;
+    ok(quicly_bintrace_foreach(ring, collect_seq, &collected) == 0);
+    ok(collected.count == 10);
+    ok(collected.seqs[0] == 0);
+    ok(collected.seqs[9] == 9);
+    quicly_bintrace_destroy(ring);
+
+    /* files that are not rings are rejected */
+    fd = open(path, O_WRONLY | O_TRUNC);
+    ok(fd != -1);
+    ok(write(fd, "hello", 5) == 5);
+    close(fd);
+    ok(quicly_bintrace_open(path) == NULL);
+    ok(errno == EINVAL);
+
+    unlink(path);
+}
+
+#if QUICLY_USE_BINTRACE
+
+static void test_conn(void)
+{
+    quicly_bintrace_ring_t *ring = quicly_bintrace_create(NULL, 65536);
+    quicly_conn_t *conn;
+    quicly_address_t dest, src;
+    struct iovec datagram;
+    uint8_t buf[1500];
+    size_t num_datagrams = 1;
+    char *decoded;
+    int ret;
+
+    quicly_bintrace_ring = ring;
+
+    ret = quicly_connect(&conn, &quic_ctx, "example.com", &fake_address.sa, NULL, new_master_id(), ptls_iovec_init(NULL, 0), NULL,
+                         NULL, NULL);
+    ok(ret == 0);
+    ret = quicly_send(conn, &dest, &src, &datagram, &num_datagrams, buf, sizeof(buf));
+    ok(ret == 0);
+    quicly_free(conn);
+
+    quicly_bintrace_ring = NULL;
+
+    decoded = decode_ring(ring);
+    ok(strncmp(decoded, "{\"type\":\"connect\", ", 19) == 0);
+    ok(strstr(decoded, "{\"type\":\"packet-sent\", ") != NULL);
+    ok(strstr(decoded, "{\"type\":\"free\", ") != NULL);
+    free(decoded);
+
+    quicly_bintrace_destroy(ring);
+}
+
+struct st_test_flight_recorder_t {
+    quicly_flight_recorder_t super;
+    quicly_flight_recorder_reason_t reason;
+    size_t num_dumps;
+    quicly_bintrace_ring_t *ring;
+    char *decoded;
+};
+
+static void on_dump(quicly_flight_recorder_t *_self, quicly_conn_t *conn, quicly_flight_recorder_reason_t reason,
+                    quicly_bintrace_ring_t *ring)
+{
+    struct st_test_flight_recorder_t *self = (void *)_self;
+
+    self->reason = reason;
+    ++self->num_dumps;
+    self->ring = ring;
+    free(self->decoded);
+    self->decoded = decode_ring(ring);
+}
+
+static void test_flight_recorder(void)
+{
+    struct st_test_flight_recorder_t recorder = {{1024, 3, on_dump}};
+    quicly_context_t ctx = quic_ctx;
+    quicly_conn_t *conn;
+    quicly_bintrace_ring_t *ring;
+    int ret;
+
+    ctx.flight_recorder = &recorder.super;
+
+    ret = quicly_connect(&conn, &ctx, "example.com", &fake_address.sa, NULL, new_master_id(), ptls_iovec_init(NULL, 0), NULL, NULL,
+                         NULL);
+    ok(ret == 0);
+
+    /* dump upon request */
+    quicly_dump_flight_recorder(conn);
+    ok(recorder.num_dumps == 1);
+    ok(recorder.reason == QUICLY_FLIGHT_RECORDER_REASON_APPLICATION);
+    ok(strncmp(recorder.decoded, "{\"type\":\"connect\", ", 19) == 0);
+    ring = recorder.ring;
+
+    /* dump upon closing due to an error */
+    ret = quicly_close(conn, QUICLY_ERROR_FROM_APPLICATION_ERROR_CODE(1), "");
+    ok(ret == 0);
+    ok(recorder.num_dumps == 2);
+    ok(recorder.reason == QUICLY_FLIGHT_RECORDER_REASON_CLOSE_ERROR);
+    ok(strcmp(quicly_flight_recorder_reason_to_string(recorder.reason), "close-error") == 0);
+    quicly_free(conn);
+
+    /* the ring is reused, starting afresh */
+    ret = quicly_connect(&conn, &ctx, "example.com", &fake_address.sa, NULL, new_master_id(), ptls_iovec_init(NULL, 0), NULL, NULL,
+                         NULL);
+    ok(ret == 0);
+    quicly_dump_flight_recorder(conn);
+    ok(recorder.num_dumps == 3);
+    ok(recorder.ring == ring);
+    ok(strncmp(recorder.decoded, "{\"type\":\"connect\", ", 19) == 0);
+    ok(strstr(recorder.decoded, "\"type\":\"free\"") == NULL);
+
+    /* not dumped when closing without an error */
+    ret = quicly_close(conn, 0, "");
+    ok(ret == 0);
+    ok(recorder.num_dumps == 3);
+    quicly_free(conn);
+
+    free(recorder.decoded);
+}
+
+#endif
+
+void test_bintrace(void)
+{
+    subtest("decode", test_decode);
+    subtest("wrap", test_wrap);
+    subtest("file", test_file);
+#if QUICLY_USE_BINTRACE
+    subtest("conn", test_conn);
+    subtest("flight-recorder", test_flight_recorder);
+#endif
+}
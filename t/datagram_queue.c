@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "quicly/datagram_queue.h"
+#include "test.h"
+
+static struct {
+    char ids[64];
+    size_t num_released, num_sent;
+} released;
+
+static void on_release(quicly_datagram_t *datagram, int sent)
+{
+    released.ids[released.num_released++] = *(const char *)datagram->cbdata;
+    if (sent)
+        ++released.num_sent;
+}
+
+static void push(quicly_datagram_queue_t *queue, const char *id, int64_t expire_at)
+{
+    quicly_datagram_t datagram = {ptls_iovec_init(id, 1), expire_at, on_release, (void *)id};
+    ok(quicly_datagram_queue_push(queue, &datagram) == 0);
+}
+
+/**
+ * sends all the datagrams, returning their IDs
+ */
+static const char *drain(quicly_datagram_queue_t *queue)
+{
+    static char ids[64];
+    quicly_datagram_t *datagram;
+    size_t num_ids = 0;
+
+    while ((datagram = quicly_datagram_queue_peek(queue)) != NULL) {
+        ids[num_ids++] = *(const char *)datagram->payload.base;
+        quicly_datagram_queue_shift(queue, 1);
+    }
+    ids[num_ids] = '\0';
+    return ids;
+}
+
+static void reset_released(void)
+{
+    memset(&released, 0, sizeof(released));
+}
+
+static void test_fifo(void)
+{
+    quicly_datagram_queue_t queue;
+    static const char *ids = "abcdefghijklmnopqrstuvwxyz";
+    size_t i;
+
+    reset_released();
+    quicly_datagram_queue_init(&queue, 100, QUICLY_DATAGRAM_DROP_OLDEST);
+
+    ok(quicly_datagram_queue_peek(&queue) == NULL);
+    /* wrap around the ring, and then grow it */
+    push(&queue, ids + 0, INT64_MAX);
+    push(&queue, ids + 1, INT64_MAX);
+    push(&queue, ids + 2, INT64_MAX);
+    quicly_datagram_queue_shift(&queue, 1);
+    quicly_datagram_queue_shift(&queue, 1);
+    for (i = 3; i != 26; ++i)
+        push(&queue, ids + i, INT64_MAX);
+    ok(strcmp(drain(&queue), "cdefghijklmnopqrstuvwxyz") == 0);
+    ok(released.num_released == 26);
+    ok(released.num_sent == 26);
+    ok(queue.num_datagrams.sent == 26);
+    ok(queue.num_datagrams.dropped == 0);
+
+    quicly_datagram_queue_dispose(&queue);
+}
+
+static void test_drop_policy(void)
+{
+    quicly_datagram_queue_t queue;
+
+    reset_released();
+    quicly_datagram_queue_init(&queue, 3, QUICLY_DATAGRAM_DROP_OLDEST);
+    push(&queue, "a", INT64_MAX);
+    push(&queue, "b", INT64_MAX);
+    push(&queue, "c", INT64_MAX);
+    push(&queue, "d", INT64_MAX);
+    ok(released.num_released == 1);
+    ok(released.ids[0] == 'a');
+    ok(strcmp(drain(&queue), "bcd") == 0);
+    ok(queue.num_datagrams.dropped == 1);
+    quicly_datagram_queue_dispose(&queue);
+
+    reset_released();
+    quicly_datagram_queue_init(&queue, 3, QUICLY_DATAGRAM_DROP_NEWEST);
+    push(&queue, "a", INT64_MAX);
+    push(&queue, "b", INT64_MAX);
+    push(&queue, "c", INT64_MAX);
+    push(&queue, "d", INT64_MAX);
+    ok(released.num_released == 1);
+    ok(released.ids[0] == 'd');
+    ok(strcmp(drain(&queue), "abc") == 0);
+    ok(queue.num_datagrams.dropped == 1);
+    quicly_datagram_queue_dispose(&queue);
+
+    /* disposing releases the datagrams being queued */
+    reset_released();
+    quicly_datagram_queue_init(&queue, 3, QUICLY_DATAGRAM_DROP_OLDEST);
+    push(&queue, "a", INT64_MAX);
+    push(&queue, "b", INT64_MAX);
+    quicly_datagram_queue_dispose(&queue);
+    ok(released.num_released == 2);
+    ok(released.num_sent == 0);
+}
+
+static void test_expire(void)
+{
+    quicly_datagram_queue_t queue;
+
+    reset_released();
+    quicly_datagram_queue_init(&queue, 10, QUICLY_DATAGRAM_DROP_OLDEST);
+
+    push(&queue, "a", 100);
+    push(&queue, "b", INT64_MAX);
+    push(&queue, "c", 50);
+    push(&queue, "d", 200);
+    ok(queue.next_expire_at == 50);
+
+    quicly_datagram_queue_expire(&queue, 49);
+    ok(released.num_released == 0);
+    quicly_datagram_queue_expire(&queue, 100);
+    ok(released.num_released == 2);
+    ok(queue.num_datagrams.expired == 2);
+    ok(queue.next_expire_at == 200);
+    ok(strcmp(drain(&queue), "bd") == 0);
+    ok(queue.next_expire_at == INT64_MAX);
+
+    quicly_datagram_queue_dispose(&queue);
+}
+
+void test_datagram_queue(void)
+{
+    subtest("fifo", test_fifo);
+    subtest("drop-policy", test_drop_policy);
+    subtest("expire", test_expire);
+}
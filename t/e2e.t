@@ -96,6 +96,54 @@ subtest "datagram" => sub {
     like $resp, qr/^DATAGRAM: hello datagram!$/m;
 };
 
+subtest "multi-threaded-server" => sub {
+    plan skip_all => "SO_REUSEPORT load balancing is linux-only"
+        unless $^O eq 'linux';
+    my $guard = spawn_server("-T", "4");
+    for my $i (1..8) {
+        my $resp = `$cli -p /12 127.0.0.1 $port 2> /dev/null`;
+        is $resp, "hello world\n", "connection $i";
+    }
+
+    subtest "steering" => sub {
+        # The forwarder emulates a NAT that rebinds for every datagram being sent by the client. As SO_REUSEPORT dispatches the
+        # datagrams based on the address tuple, most of them arrive at threads that do not own the connection.
+        open my $saved_stderr, ">&", \*STDERR
+            or die "failed to dup STDERR:$!";
+        open STDERR, ">", "$tempdir/server.log"
+            or die "failed to open file:$tempdir/server.log:$!";
+        my ($guard, $server_pid) = spawn_server("-T", "4");
+        open STDERR, ">&", $saved_stderr
+            or die "failed to restore STDERR:$!";
+        my $fw_port = empty_port({
+            host  => "127.0.0.1",
+            proto => "udp",
+        });
+        my $fw_guard = spawn_rebinding_forwarder($fw_port, 32);
+        my $resp = `$cli -p /120000 127.0.0.1 $fw_port 2> /dev/null`;
+        is length($resp), 120000, "response";
+        kill 'HUP', $server_pid;
+        sleep 0.5;
+        my @steered = slurp_file("$tempdir/server.log") =~ /^thread:\d+: .*, steered: (\d+)$/mg;
+        is scalar(@steered), 4, "stats of all threads";
+        cmp_ok +(grep { $_ != 0 } @steered), ">=", 1, "datagrams were handed over to the owning thread";
+    };
+};
+
+subtest "signer-threads" => sub {
+    for my $server_args ([qw(--signer-threads 2)], [qw(--signer-threads 2 -T 2)]) {
+        subtest "@{$server_args}" => sub {
+            plan skip_all => "SO_REUSEPORT load balancing is linux-only"
+                if grep(/^-T$/, @$server_args) && $^O ne 'linux';
+            my $guard = spawn_server(@$server_args);
+            for my $i (1..4) {
+                my $resp = `$cli -p /12 127.0.0.1 $port 2> /dev/null`;
+                is $resp, "hello world\n", "connection $i";
+            }
+        };
+    }
+};
+
 subtest "version-negotiation" => sub {
     my $guard = spawn_server();
     my $resp = `$cli -n -e $tempdir/events -p /12 127.0.0.1 $port 2> /dev/null`;
@@ -125,6 +173,22 @@ subtest "retry" => sub {
     }
 };
 
+subtest "retry-threshold" => sub {
+    # threshold of zero half-open connections puts the server in DoS mode from the start
+    my $guard = spawn_server(qw(--retry-threshold 0));
+    # alternate the versions, as the AEAD context used for protecting Retry is cached
+    for my $version_args ("-d 29", "", "-d 29") {
+        subtest "version: @{[$version_args || 'v1']}" => sub {
+            my $resp = `$cli $version_args -e $tempdir/events -p /12 127.0.0.1 $port 2> /dev/null`;
+            is $resp, "hello world\n";
+            my $events = slurp_file("$tempdir/events");
+            complex $events, sub {
+                $_ =~ qr/"type":"receive",.*"bytes":"([0-9A-Fa-f]{2}).*\n.*"type":"stream_lost",.*"stream_id":-1,.*"off":0,/ and hex($1) >= 240
+            }, "CH deemed lost in response to retry";
+        };
+    }
+};
+
 subtest "large-client-hello" => sub {
     my $guard = spawn_server();
     my $resp = `$cli -E -e $tempdir/events -p /12 127.0.0.1 $port 2> /dev/null`;
@@ -370,6 +434,52 @@ sub spawn_server {
         }
         sleep 0.1;
     }
+    my $guard = scope_guard(sub {
+        kill 9, $pid;
+        while (waitpid($pid, 0) != $pid) {}
+    });
+    return wantarray ? ($guard, $pid) : $guard;
+}
+
+# forwards the datagrams between the client and the server, sending the first `$max_rebinds` datagrams of the client each from a
+# new port
+sub spawn_rebinding_forwarder {
+    my ($listen_port, $max_rebinds) = @_;
+    my $listen = IO::Socket::INET->new(
+        LocalAddr => "127.0.0.1",
+        LocalPort => $listen_port,
+        Proto     => "udp",
+    ) or die "failed to open UDP socket:$!";
+    my $pid = fork;
+    die "fork failed:$!"
+        unless defined $pid;
+    if ($pid == 0) {
+        my (@upstreams, $client_addr);
+        while (1) {
+            my $rin = '';
+            vec($rin, fileno($_), 1) = 1
+                for ($listen, @upstreams);
+            next if select(my $rout = $rin, undef, undef, undef) <= 0;
+            if (vec($rout, fileno($listen), 1)) {
+                $client_addr = $listen->recv(my $buf, 65536);
+                if (@upstreams < $max_rebinds) {
+                    push @upstreams, IO::Socket::INET->new(
+                        PeerAddr => "127.0.0.1",
+                        PeerPort => $port,
+                        Proto    => "udp",
+                    ) or die "failed to open UDP socket:$!";
+                }
+                $upstreams[-1]->send($buf);
+            }
+            for my $upstream (@upstreams) {
+                next unless vec($rout, fileno($upstream), 1);
+                $upstream->recv(my $buf, 65536);
+                $listen->send($buf, 0, $client_addr)
+                    if defined $client_addr;
+            }
+        }
+    }
+    close $listen;
     return scope_guard(sub {
         kill 9, $pid;
         while (waitpid($pid, 0) != $pid) {}
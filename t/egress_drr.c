@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "quicly/egress_drr.h"
+#include "test.h"
+
+#define MAX_ENTRIES 4
+
+struct test_conns_t {
+    quicly_egress_drr_entry_t entries[MAX_ENTRIES];
+    /**
+     * number of datagrams each connection has to send; SIZE_MAX for unlimited
+     */
+    size_t backlog[MAX_ENTRIES];
+    /**
+     * total number of datagrams sent by each connection, and the number of times the send callback has been invoked
+     */
+    size_t num_sent[MAX_ENTRIES], num_calls;
+    size_t num_entries;
+    /**
+     * index of the connection that is removed upon invocation, or SIZE_MAX
+     */
+    size_t close_index;
+};
+
+static quicly_egress_drr_entry_t *get_entry(void *_conns, size_t index)
+{
+    struct test_conns_t *conns = _conns;
+    return conns->entries + index;
+}
+
+static int do_send(void *_conns, size_t index, size_t *num_datagrams)
+{
+    struct test_conns_t *conns = _conns;
+
+    ++conns->num_calls;
+
+    if (index == conns->close_index) {
+        size_t num_following = conns->num_entries - index - 1;
+        memmove(conns->entries + index, conns->entries + index + 1, num_following * sizeof(conns->entries[0]));
+        memmove(conns->backlog + index, conns->backlog + index + 1, num_following * sizeof(conns->backlog[0]));
+        memmove(conns->num_sent + index, conns->num_sent + index + 1, num_following * sizeof(conns->num_sent[0]));
+        --conns->num_entries;
+        conns->close_index = SIZE_MAX;
+        return 1;
+    }
+
+    if (*num_datagrams > conns->backlog[index])
+        *num_datagrams = conns->backlog[index];
+    if (conns->backlog[index] != SIZE_MAX)
+        conns->backlog[index] -= *num_datagrams;
+    conns->num_sent[index] += *num_datagrams;
+    return 0;
+}
+
+static const quicly_egress_drr_callbacks_t callbacks = {get_entry, do_send};
+
+static void init_conns(struct test_conns_t *conns, size_t num_entries)
+{
+    size_t i;
+
+    memset(conns, 0, sizeof(*conns));
+    for (i = 0; i != num_entries; ++i) {
+        conns->entries[i].weight = 1;
+        conns->backlog[i] = SIZE_MAX;
+    }
+    conns->num_entries = num_entries;
+    conns->close_index = SIZE_MAX;
+}
+
+static void test_weighted(void)
+{
+    quicly_egress_drr_t drr = {.quantum = 10};
+    struct test_conns_t conns;
+    size_t i;
+
+    init_conns(&conns, 3);
+    conns.entries[1].weight = 3;
+    conns.entries[2].weight = 2;
+
+    /* budget not being a multiple of the quantum, the scan stops in the middle of a round, and resumes from there */
+    for (i = 0; i != 60; ++i)
+        ok(quicly_egress_drr_run(&drr, &conns.num_entries, 25, 10, &callbacks, &conns) == 25);
+
+    ok(conns.num_sent[0] == 250);
+    ok(conns.num_sent[1] == 750);
+    ok(conns.num_sent[2] == 500);
+
+    /* datagrams are sent in bursts of the quantum */
+    ok(conns.num_calls <= 1500 / 10 + 60);
+}
+
+static void test_idle(void)
+{
+    quicly_egress_drr_t drr = {.quantum = 10};
+    struct test_conns_t conns;
+
+    init_conns(&conns, 3);
+
+    /* the budget not used by connections with little to send is given to others, and the credit is not carried over */
+    conns.backlog[0] = 3;
+    conns.backlog[2] = 0;
+    ok(quicly_egress_drr_run(&drr, &conns.num_entries, 50, 10, &callbacks, &conns) == 50);
+    ok(conns.num_sent[0] == 3);
+    ok(conns.num_sent[1] == 47);
+    ok(conns.num_sent[2] == 0);
+    ok(conns.entries[0].deficit == 0);
+    ok(conns.entries[2].deficit == 0);
+
+    /* terminates when no connection makes progress, even though all of them are visited every time */
+    conns.backlog[1] = 0;
+    conns.num_calls = 0;
+    ok(quicly_egress_drr_run(&drr, &conns.num_entries, 50, 10, &callbacks, &conns) == 0);
+    ok(conns.num_calls == 3);
+    conns.num_calls = 0;
+    ok(quicly_egress_drr_run(&drr, &conns.num_entries, 50, 10, &callbacks, &conns) == 0);
+    ok(conns.num_calls == 3);
+    ok(conns.entries[0].deficit == 0);
+    ok(conns.entries[1].deficit == 0);
+    ok(conns.entries[2].deficit == 0);
+
+    /* terminates when the connections make progress but do not use up the budget */
+    conns.backlog[0] = 15;
+    conns.backlog[1] = 25;
+    ok(quicly_egress_drr_run(&drr, &conns.num_entries, 100, 10, &callbacks, &conns) == 40);
+    ok(conns.backlog[0] == 0);
+    ok(conns.backlog[1] == 0);
+
+    /* no connections */
+    conns.num_entries = 0;
+    ok(quicly_egress_drr_run(&drr, &conns.num_entries, 100, 10, &callbacks, &conns) == 0);
+}
+
+static void test_remove(void)
+{
+    quicly_egress_drr_t drr = {.quantum = 10};
+    struct test_conns_t conns;
+
+    init_conns(&conns, 3);
+
+    /* the connection that followed the one being removed is visited next */
+    conns.close_index = 1;
+    ok(quicly_egress_drr_run(&drr, &conns.num_entries, 20, 10, &callbacks, &conns) == 20);
+    ok(conns.num_entries == 2);
+    ok(conns.num_sent[0] == 10);
+    ok(conns.num_sent[1] == 10);
+
+    /* removal outside of the scheduler */
+    drr.next = 1;
+    quicly_egress_drr_on_remove(&drr, 0);
+    ok(drr.next == 0);
+    quicly_egress_drr_on_remove(&drr, 1);
+    ok(drr.next == 0);
+
+    /* removal of all the connections */
+    conns.num_entries = 1;
+    conns.close_index = 0;
+    ok(quicly_egress_drr_run(&drr, &conns.num_entries, 20, 10, &callbacks, &conns) == 0);
+    ok(conns.num_entries == 0);
+}
+
+void test_egress_drr(void)
+{
+    subtest("weighted", test_weighted);
+    subtest("idle", test_idle);
+    subtest("remove", test_remove);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include "quicly/freelist.h"
+#include "test.h"
+
+static void test_reuse(void)
+{
+    quicly_freelist_t fl = QUICLY_FREELIST_INITIALIZER(2);
+    void *a = malloc(64), *b = malloc(64), *c = malloc(64);
+
+    ok(quicly_freelist_pop(&fl) == NULL);
+
+    /* the blocks are reused in LIFO order, and those exceeding the limit are freed */
+    quicly_freelist_push(&fl, a);
+    quicly_freelist_push(&fl, b);
+    quicly_freelist_push(&fl, c);
+    ok(fl.count == 2);
+    ok(quicly_freelist_pop(&fl) == b);
+    ok(quicly_freelist_pop(&fl) == a);
+    ok(quicly_freelist_pop(&fl) == NULL);
+    ok(fl.count == 0);
+
+    free(a);
+    free(b);
+}
+
+static quicly_freelist_t thread_exit_fl = QUICLY_FREELIST_INITIALIZER(8);
+
+static void *thread_exit_main(void *unused)
+{
+    size_t i;
+
+    for (i = 0; i != 4; ++i)
+        quicly_freelist_push(&thread_exit_fl, malloc(64));
+    return NULL;
+}
+
+static void test_thread_exit(void)
+{
+    pthread_t tid;
+
+    /* the blocks retained by a thread are freed when the thread exits */
+    ok(pthread_create(&tid, NULL, thread_exit_main, NULL) == 0);
+    ok(pthread_join(tid, NULL) == 0);
+    ok(thread_exit_fl.count == 0);
+    ok(thread_exit_fl.head == NULL);
+    ok(!thread_exit_fl._registered);
+}
+
+void test_freelist(void)
+{
+    subtest("reuse", test_reuse);
+    subtest("thread-exit", test_thread_exit);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "quicly/histogram.h"
+#include "test.h"
+
+static void test_buckets(void)
+{
+    uint64_t v;
+    size_t prev_index = 0, num_errors = 0;
+
+    /* small values are recorded exactly */
+    for (v = 0; v != 8; ++v) {
+        ok(quicly_histogram_get_bucket_index(v) == v);
+        ok(quicly_histogram_get_bucket_upper_bound(v) == v);
+    }
+
+    /* buckets are contiguous, and the relative error is bounded */
+    for (v = 0; v < (uint64_t)1 << QUICLY_HISTOGRAM_MAX_VALUE_BITS; ++v) {
+        size_t index = quicly_histogram_get_bucket_index(v);
+        if (index != prev_index && index != prev_index + 1)
+            ++num_errors;
+        if (index != QUICLY_HISTOGRAM_NUM_BUCKETS - 1) {
+            uint64_t upper = quicly_histogram_get_bucket_upper_bound(index);
+            if (!(v <= upper && upper - v <= v >> QUICLY_HISTOGRAM_SUB_BUCKET_BITS))
+                ++num_errors;
+            if (index != 0 && v <= quicly_histogram_get_bucket_upper_bound(index - 1))
+                ++num_errors;
+        }
+        prev_index = index;
+    }
+    ok(num_errors == 0);
+    ok(prev_index == QUICLY_HISTOGRAM_NUM_BUCKETS - 1);
+
+    /* values beyond the range go to the last bucket */
+    ok(quicly_histogram_get_bucket_index(UINT64_MAX) == QUICLY_HISTOGRAM_NUM_BUCKETS - 1);
+}
+
+static void test_quantile(void)
+{
+    quicly_histogram_t hist;
+    uint64_t v;
+
+    quicly_histogram_init(&hist);
+    ok(quicly_histogram_get_quantile(&hist, 0.5) == 0);
+
+    for (v = 1; v <= 1000; ++v)
+        quicly_histogram_record(&hist, v);
+    ok(hist.count == 1000);
+    ok(hist.sum == 500500);
+    ok(hist.max == 1000);
+
+    v = quicly_histogram_get_quantile(&hist, 0.5);
+    ok(500 <= v && v <= 500 + (500 >> QUICLY_HISTOGRAM_SUB_BUCKET_BITS));
+    v = quicly_histogram_get_quantile(&hist, 0.99);
+    ok(990 <= v && v <= 1000);
+    ok(quicly_histogram_get_quantile(&hist, 1) == 1000);
+    ok(quicly_histogram_get_quantile(&hist, 0) == 1);
+
+    /* tail */
+    quicly_histogram_record(&hist, 100000);
+    v = quicly_histogram_get_quantile(&hist, 0.999);
+    ok(1000 <= v && v <= 1000 + (1000 >> QUICLY_HISTOGRAM_SUB_BUCKET_BITS));
+    ok(quicly_histogram_get_quantile(&hist, 1) == 100000);
+}
+
+static void test_merge(void)
+{
+    quicly_histogram_t a, b;
+    size_t i;
+
+    quicly_histogram_init(&a);
+    quicly_histogram_init(&b);
+    for (i = 0; i != 100; ++i)
+        quicly_histogram_record(&a, 10);
+    for (i = 0; i != 100; ++i)
+        quicly_histogram_record(&b, 20000);
+
+    quicly_histogram_merge(&a, &b);
+    ok(a.count == 200);
+    ok(a.sum == 100 * 10 + 100 * 20000);
+    ok(a.max == 20000);
+    ok(quicly_histogram_get_quantile(&a, 0.5) == quicly_histogram_get_bucket_upper_bound(quicly_histogram_get_bucket_index(10)));
+    ok(quicly_histogram_get_quantile(&a, 0.51) == 20000);
+
+    /* bucket counts saturate */
+    a.buckets[0] = UINT32_MAX - 1;
+    b.buckets[0] = 2;
+    quicly_histogram_merge(&a, &b);
+    ok(a.buckets[0] == UINT32_MAX);
+    quicly_histogram_record(&a, 0);
+    ok(a.buckets[0] == UINT32_MAX);
+}
+
+void test_histogram(void)
+{
+    subtest("buckets", test_buckets);
+    subtest("quantile", test_quantile);
+    subtest("merge", test_merge);
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include "quicly/initial_guard.h"
+#include "test.h"
+
+static void fixed_random_bytes(void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    size_t i;
+    for (i = 0; i != len; ++i)
+        p[i] = (uint8_t)(i * 37 + 11);
+}
+
+static struct sockaddr *v4(struct sockaddr_in *sin, const char *addr)
+{
+    memset(sin, 0, sizeof(*sin));
+    sin->sin_family = AF_INET;
+    inet_pton(AF_INET, addr, &sin->sin_addr);
+    return (struct sockaddr *)sin;
+}
+
+static struct sockaddr *v6(struct sockaddr_in6 *sin6, const char *addr)
+{
+    memset(sin6, 0, sizeof(*sin6));
+    sin6->sin6_family = AF_INET6;
+    inet_pton(AF_INET6, addr, &sin6->sin6_addr);
+    return (struct sockaddr *)sin6;
+}
+
+static void test_prefix(void)
+{
+    quicly_initial_guard_t guard;
+    struct sockaddr_in a, b;
+    struct sockaddr_in6 a6, b6;
+    size_t i;
+
+    quicly_initial_guard_init(&guard, fixed_random_bytes, 0);
+
+    for (i = 0; i != 10; ++i)
+        ok(quicly_initial_guard_admit(&guard, 0, v4(&a, "192.0.2.1"), 0));
+    ok(quicly_initial_guard_estimate(&guard, v4(&b, "192.0.2.1")) == 10);
+    ok(quicly_initial_guard_estimate(&guard, v4(&b, "192.0.2.200")) == 10);
+    ok(quicly_initial_guard_estimate(&guard, v4(&b, "198.51.100.1")) == 0);
+    ok(quicly_initial_guard_estimate(&guard, v6(&b6, "::ffff:192.0.2.99")) == 10);
+
+    for (i = 0; i != 5; ++i)
+        ok(quicly_initial_guard_admit(&guard, 0, v6(&a6, "2001:db8:1:2::1"), 0));
+    ok(quicly_initial_guard_estimate(&guard, v6(&b6, "2001:db8:1:ffff::2")) == 5);
+    ok(quicly_initial_guard_estimate(&guard, v6(&b6, "2001:db8:2::1")) == 0);
+
+    ok(guard.stats.num_admitted == 15);
+    ok(guard.stats.num_dropped == 0);
+
+    quicly_initial_guard_dispose(&guard);
+}
+
+static void test_dos_mode(void)
+{
+    quicly_initial_guard_t guard;
+    struct sockaddr_in sin;
+    size_t i;
+
+    quicly_initial_guard_init(&guard, fixed_random_bytes, 0);
+    guard.config.half_open_threshold = 100;
+    guard.config.max_initials_per_prefix = 10;
+
+    /* not rate-limited nor requiring retry unless in DoS mode */
+    for (i = 0; i != 20; ++i)
+        ok(quicly_initial_guard_admit(&guard, 0, v4(&sin, "192.0.2.1"), 0));
+    guard.num_half_open = 99;
+    ok(!quicly_initial_guard_is_active(&guard));
+    ok(!quicly_initial_guard_require_retry(&guard));
+    ok(quicly_initial_guard_admit(&guard, 0, v4(&sin, "192.0.2.1"), 0));
+
+    /* DoS mode; heavy hitters are dropped, others are sent Retry */
+    guard.num_half_open = 100;
+    ok(quicly_initial_guard_is_active(&guard));
+    ok(!quicly_initial_guard_admit(&guard, 0, v4(&sin, "192.0.2.1"), 0));
+    ok(quicly_initial_guard_admit(&guard, 0, v4(&sin, "198.51.100.1"), 0));
+    ok(quicly_initial_guard_require_retry(&guard));
+    ok(guard.stats.num_dropped == 1);
+    ok(guard.stats.num_retry_required == 1);
+
+    /* the counters decay, and the heavy hitter becomes admittable again */
+    ok(quicly_initial_guard_admit(&guard, 1000, v4(&sin, "198.51.100.1"), 0));
+    ok(quicly_initial_guard_estimate(&guard, v4(&sin, "192.0.2.1")) == 11);
+    ok(!quicly_initial_guard_admit(&guard, 1000, v4(&sin, "192.0.2.1"), 0));
+    ok(quicly_initial_guard_admit(&guard, 2500, v4(&sin, "192.0.2.1"), 0));
+    ok(quicly_initial_guard_estimate(&guard, v4(&sin, "192.0.2.1")) == 7);
+    ok(quicly_initial_guard_admit(&guard, 100000, v4(&sin, "192.0.2.1"), 0));
+    ok(quicly_initial_guard_estimate(&guard, v4(&sin, "192.0.2.1")) == 1);
+
+    /* leaving DoS mode */
+    guard.num_half_open = 0;
+    ok(!quicly_initial_guard_require_retry(&guard));
+
+    quicly_initial_guard_dispose(&guard);
+}
+
+static void test_validated_address(void)
+{
+    quicly_initial_guard_t guard;
+    struct sockaddr_in sin;
+    size_t i;
+
+    quicly_initial_guard_init(&guard, fixed_random_bytes, 0);
+    guard.config.half_open_threshold = 100;
+    guard.config.max_initials_per_prefix = 10;
+
+    /* saturate the sketch with spoofed Initials sharing the prefix of a legitimate client */
+    guard.num_half_open = 100;
+    for (i = 0; i != 1000; ++i)
+        quicly_initial_guard_admit(&guard, 0, v4(&sin, "192.0.2.1"), 0);
+    ok(guard.stats.num_dropped == 990);
+    ok(!quicly_initial_guard_admit(&guard, 0, v4(&sin, "192.0.2.2"), 0));
+
+    /* the client that returns a valid token is admitted, without its Initials being counted */
+    ok(quicly_initial_guard_admit(&guard, 0, v4(&sin, "192.0.2.2"), 1));
+    ok(quicly_initial_guard_estimate(&guard, v4(&sin, "192.0.2.2")) == 1001);
+    ok(guard.stats.num_admitted == 11);
+    ok(guard.stats.num_dropped == 991);
+
+    quicly_initial_guard_dispose(&guard);
+}
+
+static void test_retry_aead_cache(void)
+{
+    quicly_initial_guard_t guard;
+    ptls_aead_context_t **cache;
+
+    quicly_initial_guard_init(&guard, fixed_random_bytes, 0);
+
+    cache = quicly_initial_guard_get_retry_aead_cache(&guard, QUICLY_PROTOCOL_VERSION_1);
+    ok(cache == &guard.retry_aead.aead);
+    ok(*cache == NULL);
+    ok(guard.retry_aead.version == QUICLY_PROTOCOL_VERSION_1);
+    cache = quicly_initial_guard_get_retry_aead_cache(&guard, QUICLY_PROTOCOL_VERSION_DRAFT29);
+    ok(*cache == NULL);
+    ok(guard.retry_aead.version == QUICLY_PROTOCOL_VERSION_DRAFT29);
+
+    quicly_initial_guard_dispose(&guard);
+}
+
+void test_initial_guard(void)
+{
+    subtest("prefix", test_prefix);
+    subtest("dos-mode", test_dos_mode);
+    subtest("validated-address", test_validated_address);
+    subtest("retry-aead-cache", test_retry_aead_cache);
+}
@@ -337,7 +337,7 @@ static void loss_core(void)
                 quicly_streambuf_egress_write(client_stream, req, strlen(req));
                 quicly_streambuf_egress_shutdown(client_stream);
             } else if (client_streambuf->is_detached || quicly_recvstate_transfer_complete(&client_stream->recvstate)) {
-                ok(buffer_is(&client_streambuf->super.ingress, resp));
+                ok(recvbuf_is(&client_streambuf->super.ingress, resp));
                 ok(max_data_is_equal(client, server));
                 ptls_buffer_dispose(&transmit_log);
                 return;
@@ -351,7 +351,7 @@ static void loss_core(void)
         if (client_stream != NULL && (server_stream = quicly_get_stream(server, client_stream->stream_id)) != NULL) {
             if (server_streambuf == NULL && quicly_recvstate_transfer_complete(&server_stream->recvstate)) {
                 server_streambuf = server_stream->data;
-                ok(buffer_is(&server_streambuf->super.ingress, req));
+                ok(recvbuf_is(&server_streambuf->super.ingress, req));
                 quicly_streambuf_egress_write(server_stream, resp, strlen(resp));
                 quicly_streambuf_egress_shutdown(server_stream);
             }
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "quicly/memory_budget.h"
+#include "test.h"
+
+static void test_pressure(void)
+{
+    quicly_memory_budget_t budget;
+
+    quicly_memory_budget_init(&budget, 1024 * 1024);
+    ok(budget.throttle_threshold == QUICLY_MEMORY_BUDGET_DEFAULT_THROTTLE_THRESHOLD);
+    ok(quicly_memory_budget_get_used(&budget) == 0);
+    ok(quicly_memory_budget_get_pressure(&budget) == 0);
+
+    /* no pressure up to the threshold */
+    quicly_memory_budget_charge(&budget, 768 * 1024);
+    ok(quicly_memory_budget_get_used(&budget) == 768 * 1024);
+    ok(quicly_memory_budget_get_pressure(&budget) == 0);
+
+    /* rises linearly beyond the threshold */
+    quicly_memory_budget_charge(&budget, 128 * 1024);
+    ok(quicly_memory_budget_get_pressure(&budget) == 512);
+    quicly_memory_budget_charge(&budget, 128 * 1024);
+    ok(quicly_memory_budget_get_pressure(&budget) == 1024);
+
+    /* and saturates */
+    quicly_memory_budget_charge(&budget, 1024 * 1024);
+    ok(quicly_memory_budget_get_pressure(&budget) == 1024);
+
+    quicly_memory_budget_release(&budget, 1024 * 1024 + 256 * 1024);
+    ok(quicly_memory_budget_get_used(&budget) == 768 * 1024);
+    ok(quicly_memory_budget_get_pressure(&budget) == 0);
+    quicly_memory_budget_release(&budget, 768 * 1024);
+    ok(quicly_memory_budget_get_used(&budget) == 0);
+}
+
+static void test_throttle(void)
+{
+    quicly_memory_budget_t budget;
+
+    quicly_memory_budget_init(&budget, 1024 * 1024);
+
+    ok(quicly_memory_budget_throttle(&budget, 16384) == 16384);
+    quicly_memory_budget_charge(&budget, 896 * 1024);
+    ok(quicly_memory_budget_throttle(&budget, 16384) == 8192);
+    ok(quicly_memory_budget_throttle(&budget, 1000) == 500);
+    ok(quicly_memory_budget_throttle(&budget, UINT64_MAX / 2) < UINT64_MAX / 2);
+    quicly_memory_budget_charge(&budget, 128 * 1024);
+    ok(quicly_memory_budget_throttle(&budget, 16384) == 0);
+
+    /* throttling begins immediately when the threshold is zero */
+    quicly_memory_budget_release(&budget, 1024 * 1024);
+    budget.throttle_threshold = 0;
+    ok(quicly_memory_budget_throttle(&budget, 16384) == 16384);
+    quicly_memory_budget_charge(&budget, 256 * 1024);
+    ok(quicly_memory_budget_throttle(&budget, 16384) == 12288);
+}
+
+void test_memory_budget(void)
+{
+    subtest("pressure", test_pressure);
+    subtest("throttle", test_throttle);
+}
@@ -0,0 +1,789 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <assert.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include "picotls.h"
+#include "picotls/openssl.h"
+#include "quicly.h"
+#include "quicly/defaults.h"
+#include "quicly/frame.h"
+#include "quicly/ranges.h"
+#include "quicly/recvstate.h"
+#include "quicly/sendstate.h"
+#include "quicly/sentmap.h"
+#include "quicly/streambuf.h"
+#include "alloc_counter.h"
+#include "perf_counters.h"
+
+/**
+ * Microbenchmarks of the data structures and the decoders used on the hot path, each exercised in a pattern resembling how quicly
+ * uses them when the congestion window is large. Each benchmark is run multiple times, and one line of space-separated key=value
+ * pairs is emitted per benchmark, so that the output of two builds can be compared by a script.
+ */
+
+#define CHECK(expr)                                                                                                                \
+    do {                                                                                                                           \
+        if (!(expr)) {                                                                                                             \
+            fprintf(stderr, "%s:%d:%s failed\n", __FILE__, __LINE__, #expr);                                                       \
+            abort();                                                                                                               \
+        }                                                                                                                          \
+    } while (0)
+
+#define PACKET_SIZE 1200
+/**
+ * one in every LOSS_INTERVAL packets (or frames) is deemed lost
+ */
+#define LOSS_INTERVAL 100
+/**
+ * number of frames among which the order of arrival is shuffled
+ */
+#define REORDER_WINDOW 64
+#define SENDBUF_VEC_SIZE 100
+/**
+ * number of datagrams being synthesized for the decode benchmark
+ */
+#define NUM_SYNTHESIZED_DATAGRAMS 256
+
+#ifndef QUICLY_CORPUS_DIR
+#define QUICLY_CORPUS_DIR "corpus"
+#endif
+
+/**
+ * number of packets in flight
+ */
+static uint64_t window = 10000;
+static uint32_t random_state = 1;
+static const char *corpus_dir = QUICLY_CORPUS_DIR;
+static struct perf_counters *counters;
+
+static struct {
+    uint64_t started_at;
+    uint64_t allocs_at_start;
+    uint64_t elapsed;
+    uint64_t allocs;
+    uint64_t cycles;
+    uint64_t instructions;
+    /**
+     * number of frames being processed, if the benchmark processes frames
+     */
+    uint64_t num_frames;
+} measurement;
+
+static uint64_t monotonic_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * called by each benchmark after the setup, right before entering the loop being measured
+ */
+static void measure_start(void)
+{
+    measurement.num_frames = 0;
+    measurement.allocs_at_start = num_allocs;
+    if (counters != NULL)
+        perf_counters_enable(counters, 1);
+    measurement.started_at = monotonic_nsec();
+}
+
+/**
+ * called by each benchmark when leaving the loop being measured, before cleaning up
+ */
+static void measure_stop(void)
+{
+    measurement.elapsed = monotonic_nsec() - measurement.started_at;
+    if (counters != NULL) {
+        perf_counters_enable(counters, 0);
+        perf_counters_read(counters, &measurement.cycles, &measurement.instructions);
+    }
+    measurement.allocs = num_allocs - measurement.allocs_at_start;
+}
+
+static uint32_t next_random(void)
+{
+    random_state = random_state * 1103515245 + 12345;
+    return random_state >> 8;
+}
+
+/**
+ * fills `order` with 0..REORDER_WINDOW-1 in random order
+ */
+static void shuffle(size_t *order)
+{
+    size_t i;
+
+    for (i = 0; i != REORDER_WINDOW; ++i)
+        order[i] = i;
+    for (i = REORDER_WINDOW - 1; i != 0; --i) {
+        size_t j = next_random() % (i + 1), t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+static int on_sent_acked(quicly_sentmap_t *map, const quicly_sent_packet_t *packet, int acked, quicly_sent_t *sent)
+{
+    return 0;
+}
+
+/**
+ * records a packet carrying two frames (e.g., ACK and STREAM)
+ */
+static void sentmap_send(quicly_sentmap_t *map, uint64_t pn)
+{
+    CHECK(quicly_sentmap_prepare(map, pn, 0, QUICLY_EPOCH_1RTT) == 0);
+    CHECK(quicly_sentmap_allocate(map, on_sent_acked) != NULL);
+    CHECK(quicly_sentmap_allocate(map, on_sent_acked) != NULL);
+    quicly_sentmap_commit(map, PACKET_SIZE);
+}
+
+/**
+ * Each operation sends one packet and processes the acknowledgement of the packet sent `window` packets before. When `with_loss`
+ * is set, some of the packets are deemed lost instead. As is the case with quicly, packets deemed lost are retained until they
+ * expire, and have to be skipped when looking up the packets being acknowledged.
+ */
+static void sentmap_run(uint64_t num_ops, int with_loss)
+{
+    quicly_sentmap_t map;
+    quicly_sentmap_iter_t iter;
+    const quicly_sent_packet_t *sent;
+    uint64_t pn = 0, i;
+
+    quicly_sentmap_init(&map);
+    for (; pn < window; ++pn)
+        sentmap_send(&map, pn);
+
+    measure_start();
+    for (i = 0; i != num_ops; ++i) {
+        uint64_t target = pn - window;
+        sentmap_send(&map, pn++);
+        quicly_sentmap_init_iter(&map, &iter);
+        while ((sent = quicly_sentmap_get(&iter))->packet_number < target) {
+            if (sent->packet_number + window < target) {
+                CHECK(quicly_sentmap_update(&map, &iter, QUICLY_SENTMAP_EVENT_EXPIRED) == 0);
+            } else {
+                quicly_sentmap_skip(&iter);
+            }
+        }
+        assert(sent->packet_number == target);
+        int is_lost = with_loss && target % LOSS_INTERVAL == 0;
+        CHECK(quicly_sentmap_update(&map, &iter, is_lost ? QUICLY_SENTMAP_EVENT_LOST : QUICLY_SENTMAP_EVENT_ACKED) == 0);
+    }
+    measure_stop();
+
+    quicly_sentmap_dispose(&map);
+}
+
+static void bench_sentmap(uint64_t num_ops)
+{
+    sentmap_run(num_ops, 0);
+}
+
+static void bench_sentmap_loss(uint64_t num_ops)
+{
+    sentmap_run(num_ops, 1);
+}
+
+/**
+ * Each operation records one packet number being received, as the receiver of packets does for generating ACK frames. When
+ * `with_reorder` is set, packets arrive out of order within REORDER_WINDOW, and some packets are lost. Packet numbers being
+ * acknowledged `window` packets ago are removed, as it happens when the ACK frames are acknowledged.
+ */
+static void ranges_run(uint64_t num_ops, int with_reorder)
+{
+    quicly_ranges_t ranges;
+    size_t order[REORDER_WINDOW], order_index = REORDER_WINDOW;
+    uint64_t base = 0, pn, i;
+
+    quicly_ranges_init(&ranges);
+
+    measure_start();
+    for (i = 0; i != num_ops; ++i) {
+        if (with_reorder) {
+            if (order_index == REORDER_WINDOW) {
+                shuffle(order);
+                order_index = 0;
+                base += REORDER_WINDOW;
+            }
+            pn = base - REORDER_WINDOW + order[order_index++];
+            if (pn % LOSS_INTERVAL == 0)
+                continue;
+        } else {
+            pn = i;
+        }
+        CHECK(quicly_ranges_add(&ranges, pn, pn + 1) == 0);
+        if (pn % 16 == 0 && pn > window)
+            CHECK(quicly_ranges_subtract(&ranges, 0, pn - window) == 0);
+    }
+    measure_stop();
+
+    quicly_ranges_clear(&ranges);
+}
+
+static void bench_ranges(uint64_t num_ops)
+{
+    ranges_run(num_ops, 0);
+}
+
+static void bench_ranges_reorder(uint64_t num_ops)
+{
+    ranges_run(num_ops, 1);
+}
+
+/**
+ * Each operation receives one STREAM frame. Frames arrive out of order within REORDER_WINDOW, and some are lost and retransmitted
+ * `window` operations later. The application consumes the data as soon as it becomes contiguous.
+ */
+static void bench_recvstate(uint64_t num_ops)
+{
+    quicly_recvstate_t state;
+    size_t order[REORDER_WINDOW], order_index = REORDER_WINDOW;
+    uint64_t base = 0, i, *retransmit = calloc(window, sizeof(*retransmit)); /* frame_index + 1, or zero if none */
+
+    CHECK(retransmit != NULL);
+    quicly_recvstate_init(&state);
+
+    measure_start();
+    for (i = 0; i != num_ops; ++i) {
+        uint64_t *slot = retransmit + i % window, frame_index;
+        if (*slot != 0) {
+            frame_index = *slot - 1;
+            *slot = 0;
+        } else {
+            if (order_index == REORDER_WINDOW) {
+                shuffle(order);
+                order_index = 0;
+                base += REORDER_WINDOW;
+            }
+            frame_index = base - REORDER_WINDOW + order[order_index++];
+            if (frame_index % LOSS_INTERVAL == 0) {
+                *slot = frame_index + 1;
+                continue;
+            }
+        }
+        size_t len = PACKET_SIZE;
+        CHECK(quicly_recvstate_update(&state, frame_index * PACKET_SIZE, &len, 0, SIZE_MAX) == 0);
+        state.data_off = state.received.ranges[0].end;
+    }
+    measure_stop();
+
+    quicly_recvstate_dispose(&state);
+    free(retransmit);
+}
+
+/**
+ * takes a frame of at most PACKET_SIZE bytes from the head of `pending`, as quicly does when sending a STREAM frame
+ */
+static void sendstate_send(quicly_sendstate_t *state, quicly_sendstate_sent_t *sent)
+{
+    sent->start = state->pending.ranges[0].start;
+    sent->end = state->pending.ranges[0].end - sent->start > PACKET_SIZE ? sent->start + PACKET_SIZE : state->pending.ranges[0].end;
+    CHECK(quicly_ranges_subtract(&state->pending, sent->start, sent->end) == 0);
+    if (state->size_inflight < sent->end)
+        state->size_inflight = sent->end;
+}
+
+/**
+ * Each operation processes the acknowledgement (or the loss) of the oldest of `window` STREAM frames in flight, then sends the next
+ * frame. Data being deemed lost is retransmitted first, as it is the case with quicly.
+ */
+static void bench_sendstate(uint64_t num_ops)
+{
+    quicly_sendstate_t state;
+    quicly_sendstate_sent_t *inflight = malloc(sizeof(*inflight) * window);
+    uint64_t i;
+
+    CHECK(inflight != NULL);
+    quicly_sendstate_init(&state);
+    CHECK(quicly_sendstate_activate(&state) == 0);
+    for (i = 0; i != window; ++i)
+        sendstate_send(&state, inflight + i);
+
+    measure_start();
+    for (i = 0; i != num_ops; ++i) {
+        quicly_sendstate_sent_t *sent = inflight + i % window;
+        if (i % LOSS_INTERVAL == 0) {
+            CHECK(quicly_sendstate_lost(&state, sent) == 0);
+        } else {
+            size_t bytes_to_shift;
+            CHECK(quicly_sendstate_acked(&state, sent, &bytes_to_shift) == 0);
+        }
+        sendstate_send(&state, sent);
+    }
+    measure_stop();
+
+    quicly_sendstate_dispose(&state);
+    free(inflight);
+}
+
+static quicly_stream_t *sendbuf_stream;
+
+static int flatten_vec(quicly_sendbuf_vec_t *vec, void *dst, size_t off, size_t len)
+{
+    memset(dst, 'A', len);
+    return 0;
+}
+
+static void sendbuf_write_packet(quicly_sendbuf_t *sb)
+{
+    static const quicly_streambuf_sendvec_callbacks_t callbacks = {flatten_vec};
+    size_t i;
+
+    for (i = 0; i != PACKET_SIZE / SENDBUF_VEC_SIZE; ++i) {
+        quicly_sendbuf_vec_t vec = {&callbacks, SENDBUF_VEC_SIZE};
+        CHECK(quicly_sendbuf_write_vec(sendbuf_stream, sb, &vec) == 0);
+    }
+}
+
+static void sendbuf_emit_packet(quicly_sendbuf_t *sb, uint64_t off)
+{
+    uint8_t buf[PACKET_SIZE];
+    size_t len = sizeof(buf);
+    int wrote_all;
+
+    quicly_sendbuf_emit(sendbuf_stream, sb, off, buf, &len, &wrote_all);
+    assert(len == sizeof(buf));
+}
+
+/**
+ * Data is written as vectors of SENDBUF_VEC_SIZE bytes, with `window` packets being in flight and as many being buffered but not
+ * yet sent. Each operation writes, emits, and shifts out (i.e. sees the acknowledgement of) one packet worth of data. When
+ * `with_retransmit` is set, the packet being emitted is chosen randomly from those in flight rather than from the send frontier.
+ */
+static void sendbuf_run(uint64_t num_ops, int with_retransmit)
+{
+    quicly_sendbuf_t sb;
+    uint64_t i;
+
+    quicly_sendbuf_init(&sb);
+    for (i = 0; i != window * 2; ++i)
+        sendbuf_write_packet(&sb);
+    for (i = 0; i != window; ++i)
+        sendbuf_emit_packet(&sb, i * PACKET_SIZE);
+
+    measure_start();
+    for (i = 0; i != num_ops; ++i) {
+        sendbuf_write_packet(&sb);
+        sendbuf_emit_packet(&sb, (with_retransmit ? next_random() % window : window) * PACKET_SIZE);
+        quicly_sendbuf_shift(sendbuf_stream, &sb, PACKET_SIZE);
+    }
+    measure_stop();
+
+    quicly_sendbuf_dispose(&sb);
+}
+
+static void bench_sendbuf(uint64_t num_ops)
+{
+    sendbuf_run(num_ops, 0);
+}
+
+static void bench_sendbuf_retransmit(uint64_t num_ops)
+{
+    sendbuf_run(num_ops, 1);
+}
+
+static int on_stream_open(quicly_stream_open_t *self, quicly_stream_t *stream)
+{
+    stream->callbacks = &quicly_stream_noop_callbacks;
+    return 0;
+}
+
+/**
+ * opens a stream being used by the sendbuf benchmarks; the connection never sends, therefore the stream remains blocked and the
+ * stream scheduler is not involved
+ */
+static void setup_sendbuf_stream(void)
+{
+    static ptls_key_exchange_algorithm_t *key_exchanges[] = {&ptls_openssl_secp256r1, NULL};
+    static ptls_cipher_suite_t *cipher_suites[] = {&ptls_openssl_aes128gcmsha256, NULL};
+    static ptls_context_t tlsctx = {.random_bytes = ptls_openssl_random_bytes,
+                                    .get_time = &ptls_get_time,
+                                    .key_exchanges = key_exchanges,
+                                    .cipher_suites = cipher_suites};
+    static quicly_stream_open_t stream_open = {on_stream_open};
+    static quicly_context_t ctx;
+    static quicly_cid_plaintext_t next_cid;
+    struct sockaddr_in sin = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(0x7f000001), .sin_port = htons(443)};
+    quicly_conn_t *conn;
+
+    quicly_amend_ptls_context(&tlsctx);
+    ctx = quicly_spec_context;
+    ctx.tls = &tlsctx;
+    ctx.stream_open = &stream_open;
+    int ret = quicly_connect(&conn, &ctx, "example.com", (void *)&sin, NULL, &next_cid, ptls_iovec_init(NULL, 0), NULL, NULL, NULL);
+    CHECK(ret == 0);
+    CHECK(quicly_open_stream(conn, &sendbuf_stream, 0) == 0);
+}
+
+static quicly_context_t decode_ctx;
+static ptls_iovec_t *corpus, synthesized[NUM_SYNTHESIZED_DATAGRAMS];
+static size_t num_corpus;
+/**
+ * accumulates the values being decoded, so that the compiler cannot optimize away the decoders
+ */
+static volatile uint64_t decode_sink;
+
+/**
+ * Decodes the frames in given payload, using the decoders of the frames that are hot or that carry variable number of elements.
+ * Returns the number of frames being decoded; decoding stops at the first frame that is malformed or that is not handled here.
+ */
+static size_t decode_frames(const uint8_t *src, const uint8_t *end)
+{
+    size_t num_frames = 0;
+    uint64_t sink = 0;
+
+    while (src < end) {
+        uint8_t type_flags = *src++;
+        if ((type_flags & ~QUICLY_FRAME_TYPE_STREAM_BITS) == QUICLY_FRAME_TYPE_STREAM_BASE) {
+            quicly_stream_frame_t frame;
+            if (quicly_decode_stream_frame(type_flags, &src, end, &frame) != 0)
+                break;
+            sink += frame.offset + frame.data.len;
+        } else {
+            switch (type_flags) {
+            case QUICLY_FRAME_TYPE_PADDING:
+                continue;
+            case QUICLY_FRAME_TYPE_PING:
+                break;
+            case QUICLY_FRAME_TYPE_ACK:
+            case QUICLY_FRAME_TYPE_ACK_ECN: {
+                quicly_ack_frame_t frame;
+                if (quicly_decode_ack_frame(&src, end, &frame, type_flags == QUICLY_FRAME_TYPE_ACK_ECN) != 0)
+                    goto Exit;
+                sink += frame.largest_acknowledged + frame.num_gaps;
+            } break;
+            case QUICLY_FRAME_TYPE_CRYPTO: {
+                quicly_stream_frame_t frame;
+                if (quicly_decode_crypto_frame(&src, end, &frame) != 0)
+                    goto Exit;
+                sink += frame.offset + frame.data.len;
+            } break;
+            case QUICLY_FRAME_TYPE_MAX_STREAM_DATA: {
+                quicly_max_stream_data_frame_t frame;
+                if (quicly_decode_max_stream_data_frame(&src, end, &frame) != 0)
+                    goto Exit;
+                sink += frame.max_stream_data;
+            } break;
+            case QUICLY_FRAME_TYPE_NEW_CONNECTION_ID: {
+                quicly_new_connection_id_frame_t frame;
+                if (quicly_decode_new_connection_id_frame(&src, end, &frame) != 0)
+                    goto Exit;
+                sink += frame.sequence;
+            } break;
+            default:
+                goto Exit;
+            }
+        }
+        ++num_frames;
+    }
+
+Exit:
+    decode_sink += sink;
+    return num_frames;
+}
+
+/**
+ * Each operation decodes one datagram; i.e., decodes each QUIC packet being coalesced in the datagram, then the frames in the
+ * payload. As the benchmark does not decrypt, the payload is decoded as-is, starting after the packet number field (in the case of
+ * the corpus, that is the same as what the fuzzer does).
+ */
+static void decode_run(uint64_t num_ops, ptls_iovec_t *datagrams, size_t num_datagrams)
+{
+    uint64_t i;
+
+    measure_start();
+    for (i = 0; i != num_ops; ++i) {
+        ptls_iovec_t *datagram = datagrams + i % num_datagrams;
+        quicly_decoded_packet_t packet;
+        size_t off = 0;
+        while (off < datagram->len && quicly_decode_packet(&decode_ctx, &packet, datagram->base, datagram->len, &off) != SIZE_MAX) {
+            size_t payload_off = packet.encrypted_off + (packet.octets.base[0] & 0x3) + 1;
+            if (payload_off < packet.octets.len)
+                measurement.num_frames += decode_frames(packet.octets.base + payload_off, packet.octets.base + packet.octets.len);
+        }
+    }
+    measure_stop();
+}
+
+static void bench_decode(uint64_t num_ops)
+{
+    decode_run(num_ops, synthesized, PTLS_ELEMENTSOF(synthesized));
+}
+
+static int load_corpus(const char *dir)
+{
+    DIR *dp;
+    struct dirent *de;
+    char path[PATH_MAX];
+
+    if ((dp = opendir(dir)) == NULL)
+        return -1;
+    while ((de = readdir(dp)) != NULL) {
+        FILE *fp;
+        uint8_t buf[65536];
+        size_t len;
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        if ((fp = fopen(path, "rb")) == NULL)
+            continue;
+        len = fread(buf, 1, sizeof(buf), fp);
+        fclose(fp);
+        CHECK((corpus = realloc(corpus, sizeof(*corpus) * (num_corpus + 1))) != NULL);
+        CHECK((corpus[num_corpus].base = malloc(len + 1)) != NULL);
+        memcpy(corpus[num_corpus].base, buf, len);
+        corpus[num_corpus++].len = len;
+    }
+    closedir(dp);
+
+    return num_corpus != 0 ? 0 : -1;
+}
+
+static void bench_decode_corpus(uint64_t num_ops)
+{
+    /* the corpus is loaded upon first use, so that the other benchmarks can be run without one */
+    if (num_corpus == 0 && load_corpus(corpus_dir) != 0) {
+        fprintf(stderr, "failed to load corpus from %s\n", corpus_dir);
+        exit(1);
+    }
+    decode_run(num_ops, corpus, num_corpus);
+}
+
+static uint8_t *encode_stream_frame(uint8_t *dst, uint64_t stream_id, uint64_t off, size_t len)
+{
+    *dst++ = QUICLY_FRAME_TYPE_STREAM_BASE | QUICLY_FRAME_TYPE_STREAM_BIT_OFF | QUICLY_FRAME_TYPE_STREAM_BIT_LEN;
+    dst = quicly_encodev(dst, stream_id);
+    dst = quicly_encodev(dst, off);
+    dst = quicly_encodev(dst, len);
+    memset(dst, 'A', len);
+    return dst + len;
+}
+
+/**
+ * Synthesizes 1-RTT packets as they are seen by a server during file transfer; i.e., an ACK frame carrying up to 32 blocks,
+ * followed by either a STREAM frame filling the rest of the packet or small STREAM frames of random sizes.
+ */
+static void setup_synthesized(void)
+{
+    size_t i;
+
+    for (i = 0; i != PTLS_ELEMENTSOF(synthesized); ++i) {
+        uint8_t *buf = malloc(PACKET_SIZE), *dst = buf, *end = buf + PACKET_SIZE;
+        CHECK(buf != NULL);
+
+        /* short header with 2-byte packet number */
+        quicly_cid_plaintext_t cid_plaintext = {.master_id = (uint32_t)i};
+        quicly_cid_t cid;
+        decode_ctx.cid_encryptor->encrypt_cid(decode_ctx.cid_encryptor, &cid, NULL, &cid_plaintext);
+        *dst++ = QUICLY_QUIC_BIT | 0x1;
+        memcpy(dst, cid.cid, cid.len);
+        dst += cid.len;
+        dst = quicly_encode16(dst, (uint16_t)i);
+
+        /* ACK frame */
+        quicly_ranges_t ranges;
+        uint64_t pn_base = 1000000 + i * 100, block;
+        quicly_ranges_init(&ranges);
+        for (block = 0; block <= i % 32; ++block)
+            CHECK(quicly_ranges_add(&ranges, pn_base + block * 10, pn_base + block * 10 + 8) == 0);
+        CHECK((dst = quicly_encode_ack_frame(dst, end, &ranges, 100)) != NULL);
+        quicly_ranges_clear(&ranges);
+
+        /* STREAM frames */
+        uint64_t stream_id = i * 4, stream_off = 1000000;
+        while (end - dst > 32) {
+            size_t len = end - dst - 16;
+            if (i % 2 != 0 && len > 400)
+                len = 16 + next_random() % 384;
+            dst = encode_stream_frame(dst, stream_id, stream_off, len);
+            stream_id += 4;
+        }
+
+        synthesized[i] = ptls_iovec_init(buf, dst - buf);
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*run)(uint64_t num_ops);
+} benchmarks[] = {
+    {"sentmap", bench_sentmap},
+    {"sentmap-loss", bench_sentmap_loss},
+    {"ranges", bench_ranges},
+    {"ranges-reorder", bench_ranges_reorder},
+    {"recvstate", bench_recvstate},
+    {"sendstate", bench_sendstate},
+    {"sendbuf", bench_sendbuf},
+    {"sendbuf-retransmit", bench_sendbuf_retransmit},
+    {"decode", bench_decode},
+    {"decode-corpus", bench_decode_corpus},
+};
+
+static int cmp_u64(const void *_x, const void *_y)
+{
+    uint64_t x = *(const uint64_t *)_x, y = *(const uint64_t *)_y;
+    return x < y ? -1 : x > y;
+}
+
+static void run(size_t index, uint64_t num_ops, size_t num_runs)
+{
+    uint64_t *elapsed = malloc(sizeof(*elapsed) * num_runs), allocs = 0, cycles = 0, instructions = 0, num_frames = 0;
+    size_t i;
+
+    CHECK(elapsed != NULL);
+
+    for (i = 0; i != num_runs; ++i) {
+        random_state = 1;
+        benchmarks[index].run(num_ops);
+        elapsed[i] = measurement.elapsed;
+        allocs += measurement.allocs;
+        cycles += measurement.cycles;
+        instructions += measurement.instructions;
+        num_frames += measurement.num_frames;
+    }
+    qsort(elapsed, num_runs, sizeof(*elapsed), cmp_u64);
+
+    double ns_per_op = (double)elapsed[num_runs / 2] / num_ops, frames_per_op = (double)num_frames / num_runs / num_ops;
+    printf("benchmark=%s window=%" PRIu64 " ops=%" PRIu64 " runs=%zu ns-per-op=%.2f ns-per-op-min=%.2f ns-per-op-max=%.2f",
+           benchmarks[index].name, window, num_ops, num_runs, ns_per_op, (double)elapsed[0] / num_ops,
+           (double)elapsed[num_runs - 1] / num_ops);
+    if (num_frames != 0)
+        printf(" frames-per-op=%.2f ns-per-frame=%.2f", frames_per_op, ns_per_op / frames_per_op);
+    if (HAVE_ALLOC_COUNTER)
+        printf(" allocs-per-op=%.3f", (double)allocs / num_runs / num_ops);
+    if (counters != NULL) {
+        double cycles_per_op = (double)cycles / num_runs / num_ops;
+        printf(" cycles-per-op=%.1f instructions-per-op=%.1f ipc=%.2f", cycles_per_op, (double)instructions / num_runs / num_ops,
+               cycles != 0 ? (double)instructions / cycles : 0);
+        if (num_frames != 0)
+            printf(" cycles-per-frame=%.1f", cycles_per_op / frames_per_op);
+    }
+    printf("\n");
+    fflush(stdout);
+
+    free(elapsed);
+}
+
+static void usage(const char *cmd)
+{
+    printf("Usage: %s [options] [benchmark...]\n"
+           "\n"
+           "Runs the benchmarks being specified, or all of them if none is specified.\n"
+           "\n"
+           "Options:\n"
+           "  -n <ops>       number of operations per run (default: 1000000)\n"
+           "  -r <runs>      number of runs per benchmark; the median is reported as\n"
+           "                 ns-per-op (default: 5)\n"
+           "  -w <packets>   number of packets in flight (default: 10000)\n"
+           "  -c <dir>       directory containing the corpus (default: " QUICLY_CORPUS_DIR ")\n"
+           "  -p             samples CPU cycles and instructions using perf counters\n"
+           "  -l             lists the benchmarks\n"
+           "  -h             prints this help\n"
+           "\n",
+           cmd);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t num_ops = 1000000;
+    size_t num_runs = 5, i;
+    struct perf_counters perf_counters;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "n:r:w:c:plh")) != -1) {
+        switch (ch) {
+        case 'n':
+            if (sscanf(optarg, "%" SCNu64, &num_ops) != 1 || num_ops == 0) {
+                fprintf(stderr, "invalid number of operations: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'r':
+            if (sscanf(optarg, "%zu", &num_runs) != 1 || num_runs == 0) {
+                fprintf(stderr, "invalid number of runs: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'w':
+            if (sscanf(optarg, "%" SCNu64, &window) != 1 || window == 0) {
+                fprintf(stderr, "invalid window: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'c':
+            corpus_dir = optarg;
+            break;
+        case 'p':
+            if (perf_counters_open(&perf_counters) != 0) {
+                fprintf(stderr, "failed to open perf counters\n");
+                exit(1);
+            }
+            counters = &perf_counters;
+            break;
+        case 'l':
+            for (i = 0; i != PTLS_ELEMENTSOF(benchmarks); ++i)
+                printf("%s\n", benchmarks[i].name);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(0);
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    setup_sendbuf_stream();
+    decode_ctx = quicly_spec_context;
+    decode_ctx.cid_encryptor = quicly_new_default_cid_encryptor(&ptls_openssl_bfecb, &ptls_openssl_aes128ecb, &ptls_openssl_sha256,
+                                                                ptls_iovec_init("microbench", 10));
+    setup_synthesized();
+
+    if (argc == 0) {
+        for (i = 0; i != PTLS_ELEMENTSOF(benchmarks); ++i)
+            run(i, num_ops, num_runs);
+    } else {
+        for (; argc != 0; --argc, ++argv) {
+            for (i = 0; i != PTLS_ELEMENTSOF(benchmarks); ++i)
+                if (strcmp(benchmarks[i].name, *argv) == 0)
+                    break;
+            if (i == PTLS_ELEMENTSOF(benchmarks)) {
+                fprintf(stderr, "unknown benchmark: %s\n", *argv);
+                exit(1);
+            }
+            run(i, num_ops, num_runs);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef quicly_t_perf_counters_h
+#define quicly_t_perf_counters_h
+
+/**
+ * Counts the CPU cycles and the instructions retired by the calling thread in user space, using perf_event_open(2). On other
+ * platforms, `perf_counters_open` always fails.
+ */
+
+#include <stdint.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+struct perf_counters {
+    int cycles_fd, instructions_fd;
+};
+
+/**
+ * opens the counters in disabled state, returning 0 if successful
+ */
+static int perf_counters_open(struct perf_counters *counters);
+/**
+ * starts or stops counting
+ */
+static void perf_counters_enable(struct perf_counters *counters, int enable);
+/**
+ * reads the values being counted, then resets the counters
+ */
+static void perf_counters_read(struct perf_counters *counters, uint64_t *cycles, uint64_t *instructions);
+
+#ifdef __linux__
+
+static int perf_counters__open_one(uint64_t config)
+{
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE, .size = sizeof(attr), .config = config, .disabled = 1, .exclude_kernel = 1, .exclude_hv = 1};
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t perf_counters__read_one(int fd)
+{
+    uint64_t value = 0;
+    if (read(fd, &value, sizeof(value)) != sizeof(value))
+        value = 0;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    return value;
+}
+
+inline int perf_counters_open(struct perf_counters *counters)
+{
+    if ((counters->cycles_fd = perf_counters__open_one(PERF_COUNT_HW_CPU_CYCLES)) == -1)
+        return -1;
+    if ((counters->instructions_fd = perf_counters__open_one(PERF_COUNT_HW_INSTRUCTIONS)) == -1) {
+        close(counters->cycles_fd);
+        return -1;
+    }
+    return 0;
+}
+
+inline void perf_counters_enable(struct perf_counters *counters, int enable)
+{
+    unsigned long request = enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE;
+    ioctl(counters->cycles_fd, request, 0);
+    ioctl(counters->instructions_fd, request, 0);
+}
+
+inline void perf_counters_read(struct perf_counters *counters, uint64_t *cycles, uint64_t *instructions)
+{
+    *cycles = perf_counters__read_one(counters->cycles_fd);
+    *instructions = perf_counters__read_one(counters->instructions_fd);
+}
+
+#else
+
+inline int perf_counters_open(struct perf_counters *counters)
+{
+    return -1;
+}
+
+inline void perf_counters_enable(struct perf_counters *counters, int enable)
+{
+}
+
+inline void perf_counters_read(struct perf_counters *counters, uint64_t *cycles, uint64_t *instructions)
+{
+    *cycles = 0;
+    *instructions = 0;
+}
+
+#endif
+
+#endif
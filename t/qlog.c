@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "quicly/qlog.h"
+#include "quicly-bintrace.h"
+#include "test.h"
+
+static char *read_file(FILE *fp)
+{
+    long size;
+    char *buf;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    buf = malloc(size + 1);
+    fseek(fp, 0, SEEK_SET);
+    buf[fread(buf, 1, size, fp)] = '\0';
+    return buf;
+}
+
+/**
+ * returns the number of JSON text sequence records, checking that each of them is terminated by LF
+ */
+static size_t count_records(const char *s)
+{
+    size_t count = 0;
+
+    for (; *s != '\0'; ++s) {
+        if (*s == '\x1e') {
+            if (count != 0 && s[-1] != '\n')
+                return SIZE_MAX;
+            ++count;
+        }
+    }
+    return count;
+}
+
+static void test_categories(void)
+{
+    unsigned categories;
+
+    ok(quicly_qlog_parse_categories("transport", &categories) == 0);
+    ok(categories == QUICLY_QLOG_CATEGORY_TRANSPORT);
+    ok(quicly_qlog_parse_categories("connectivity,recovery", &categories) == 0);
+    ok(categories == (QUICLY_QLOG_CATEGORY_CONNECTIVITY | QUICLY_QLOG_CATEGORY_RECOVERY));
+    ok(quicly_qlog_parse_categories("all", &categories) == 0);
+    ok(categories == QUICLY_QLOG_CATEGORY_ALL);
+    ok(quicly_qlog_parse_categories("transport,", &categories) != 0);
+    ok(quicly_qlog_parse_categories("security", &categories) != 0);
+}
+
+static void test_packets(void)
+{
+    FILE *fp = tmpfile();
+    quicly_qlog_t qlog;
+    quicly_qlog_conn_t *q;
+    quicly_stream_t stream = {NULL};
+    struct quicly_rtt_t rtt = {.minimum = 10, .smoothed = 12, .latest = 11};
+    char *output, *sent, *received, *metrics, *lost;
+
+    quicly_qlog_init(&qlog, fileno(fp));
+    ok(quicly_qlog_write_header(&qlog, "test", "client") == 0);
+    q = quicly_qlog_conn_create(&qlog, 0, ptls_iovec_init("\x01\x02\x03\x04", 4));
+    ok(q != NULL);
+
+    /* a packet being sent; frames precede the packet event */
+    QUICLY_BINTRACE_PACKET_PREPARE(q->ring, NULL, 100, 0xc0, "0102");
+    quicly_qlog_conn_emit(q);
+    stream.stream_id = 4;
+    QUICLY_BINTRACE_STREAM_SEND(q->ring, NULL, 100, &stream, 0, 1000, 1);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_PACKET_SENT(q->ring, NULL, 100, 7, 1200, QUICLY_EPOCH_1RTT, 0);
+    quicly_qlog_conn_emit(q);
+
+    /* a packet being received; frames follow the packet event, other events are deferred until the packet is complete */
+    QUICLY_BINTRACE_PACKET_RECEIVED(q->ring, NULL, 110, 3, NULL, 50, QUICLY_EPOCH_1RTT);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_ACK_BLOCK_RECEIVED(q->ring, NULL, 110, 0, 3);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_ACK_BLOCK_RECEIVED(q->ring, NULL, 110, 5, 7);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_QUICTRACE_CC_ACK(q->ring, NULL, 110, &rtt, 14720, 0);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_ACK_DELAY_RECEIVED(q->ring, NULL, 110, 0);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_PING_RECEIVE(q->ring, NULL, 110);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_PACKET_LOST(q->ring, NULL, 120, 4, QUICLY_EPOCH_1RTT);
+    quicly_qlog_conn_emit(q);
+
+    /* nothing is written until the connection is destroyed, as the output is smaller than the batch size */
+    output = read_file(fp);
+    ok(count_records(output) == 1);
+    free(output);
+
+    quicly_qlog_conn_destroy(q);
+
+    output = read_file(fp);
+    ok(count_records(output) == 5);
+    ok(strncmp(output, "\x1e{\"qlog_version\":\"0.3\",\"qlog_format\":\"JSON-SEQ\",\"title\":\"test\"", 60) == 0);
+    sent = strstr(output, "\x1e{\"time\":100,\"name\":\"transport:packet_sent\",\"group_id\":\"01020304\",\"data\":{\"header\":"
+                          "{\"packet_type\":\"1RTT\",\"packet_number\":7},\"raw\":{\"length\":1200},\"frames\":[{\"frame_type\":"
+                          "\"stream\",\"stream_id\":4,\"offset\":0,\"length\":1000,\"fin\":true}]}}\n");
+    ok(sent != NULL);
+    received = strstr(output, "\x1e{\"time\":110,\"name\":\"transport:packet_received\",\"group_id\":\"01020304\",\"data\":"
+                              "{\"header\":{\"packet_type\":\"1RTT\",\"packet_number\":3},\"raw\":{\"length\":50},\"frames\":[{"
+                              "\"frame_type\":\"ack\",\"acked_ranges\":[[0,3],[5,7]]},{\"frame_type\":\"ping\"}]}}\n");
+    ok(received != NULL);
+    metrics = strstr(output, "\x1e{\"time\":110,\"name\":\"recovery:metrics_updated\",\"group_id\":\"01020304\",\"data\":{"
+                             "\"min_rtt\":10,\"smoothed_rtt\":12,\"latest_rtt\":11,\"congestion_window\":14720,"
+                             "\"bytes_in_flight\":0}}\n");
+    ok(metrics != NULL);
+    lost = strstr(output, "\x1e{\"time\":120,\"name\":\"recovery:packet_lost\",");
+    ok(lost != NULL);
+    ok(sent < received && received < metrics && metrics < lost);
+    free(output);
+
+    fclose(fp);
+}
+
+static void test_filter(void)
+{
+    FILE *fp = tmpfile();
+    quicly_qlog_t qlog;
+    quicly_qlog_conn_t *q;
+    char *output;
+
+    quicly_qlog_init(&qlog, fileno(fp));
+    qlog.categories = QUICLY_QLOG_CATEGORY_RECOVERY;
+    q = quicly_qlog_conn_create(&qlog, 0, ptls_iovec_init(NULL, 0));
+
+    QUICLY_BINTRACE_CONNECT(q->ring, NULL, 100, 1);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_PACKET_PREPARE(q->ring, NULL, 100, 0xc0, "0102");
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_PING_SEND(q->ring, NULL, 100);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_PACKET_SENT(q->ring, NULL, 100, 0, 1200, QUICLY_EPOCH_INITIAL, 0);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_PTO(q->ring, NULL, 1100, 1200, 14720, 1);
+    quicly_qlog_conn_emit(q);
+    QUICLY_BINTRACE_FREE(q->ring, NULL, 1200);
+    quicly_qlog_conn_emit(q);
+    quicly_qlog_conn_destroy(q);
+
+    output = read_file(fp);
+    ok(count_records(output) == 1);
+    ok(strstr(output, "\"name\":\"recovery:loss_timer_updated\"") != NULL);
+    free(output);
+
+    fclose(fp);
+}
+
+static void test_sampling_and_batching(void)
+{
+    FILE *fp = tmpfile();
+    quicly_qlog_t qlog;
+    quicly_qlog_conn_t *q;
+    size_t i;
+    char *output;
+
+    quicly_qlog_init(&qlog, fileno(fp));
+    qlog.sampling_rate = 1000;
+    ok(quicly_qlog_conn_create(&qlog, 1, ptls_iovec_init(NULL, 0)) == NULL);
+    ok(quicly_qlog_conn_create(&qlog, 999, ptls_iovec_init(NULL, 0)) == NULL);
+    q = quicly_qlog_conn_create(&qlog, 2000, ptls_iovec_init(NULL, 0));
+    ok(q != NULL);
+
+    /* the buffer is written once it grows beyond the batch size */
+    qlog.batch_size = 1024;
+    for (i = 0; i != 100; ++i) {
+        QUICLY_BINTRACE_PTO(q->ring, NULL, i, 1200, 14720, 1);
+        quicly_qlog_conn_emit(q);
+        if (q->buf.off == 0)
+            break;
+    }
+    ok(i < 100);
+    output = read_file(fp);
+    ok(count_records(output) == i + 1);
+    ok(strlen(output) >= 1024);
+    free(output);
+
+    quicly_qlog_conn_destroy(q);
+    fclose(fp);
+}
+
+#if QUICLY_USE_BINTRACE
+
+static void test_conn(void)
+{
+    FILE *fp = tmpfile();
+    quicly_qlog_t qlog;
+    quicly_context_t ctx = quic_ctx;
+    quicly_conn_t *conn;
+    quicly_address_t dest, src;
+    struct iovec datagram;
+    uint8_t buf[1500];
+    size_t num_datagrams = 1;
+    char *output;
+    int ret;
+
+    quicly_qlog_init(&qlog, fileno(fp));
+    ctx.qlog = &qlog;
+
+    ret = quicly_connect(&conn, &ctx, "example.com", &fake_address.sa, NULL, new_master_id(), ptls_iovec_init(NULL, 0), NULL, NULL,
+                         NULL);
+    ok(ret == 0);
+    ret = quicly_send(conn, &dest, &src, &datagram, &num_datagrams, buf, sizeof(buf));
+    ok(ret == 0);
+    quicly_free(conn);
+
+    output = read_file(fp);
+    ok(strstr(output, "\"name\":\"connectivity:connection_started\"") != NULL);
+    ok(strstr(output, "\"name\":\"transport:packet_sent\"") != NULL);
+    ok(strstr(output, "{\"frame_type\":\"crypto\",\"stream_id\":-1,\"offset\":0,") != NULL);
+    ok(strstr(output, "\"name\":\"connectivity:connection_closed\"") != NULL);
+    free(output);
+
+    fclose(fp);
+}
+
+#endif
+
+void test_qlog(void)
+{
+    subtest("categories", test_categories);
+    subtest("packets", test_packets);
+    subtest("filter", test_filter);
+    subtest("sampling-and-batching", test_sampling_and_batching);
+#if QUICLY_USE_BINTRACE
+    subtest("conn", test_conn);
+#endif
+}
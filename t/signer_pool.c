@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "quicly/signer_pool.h"
+#include "test.h"
+
+static pthread_mutex_t gate = PTHREAD_MUTEX_INITIALIZER;
+
+static int fake_sign_cb(ptls_sign_certificate_t *self, ptls_t *tls, ptls_async_job_t **async, uint16_t *selected_algorithm,
+                        ptls_buffer_t *output, ptls_iovec_t input, const uint16_t *algorithms, size_t num_algorithms)
+{
+    int ret;
+
+    assert(async == NULL);
+
+    /* blocks while the test holds the gate */
+    pthread_mutex_lock(&gate);
+    pthread_mutex_unlock(&gate);
+
+    *selected_algorithm = algorithms[num_algorithms - 1];
+    ptls_buffer_pushv(output, "sig:", 4);
+    ptls_buffer_pushv(output, input.base, input.len);
+    ret = 0;
+
+Exit:
+    return ret;
+}
+
+static ptls_sign_certificate_t fake_signer = {fake_sign_cb};
+
+static size_t num_notified;
+
+static void on_complete(void *cbdata)
+{
+    __atomic_add_fetch(&num_notified, 1, __ATOMIC_RELEASE);
+}
+
+static int wait_notified(size_t expected)
+{
+    size_t i;
+    for (i = 0; i != 5000; ++i) {
+        if (__atomic_load_n(&num_notified, __ATOMIC_ACQUIRE) == expected)
+            return 1;
+        usleep(1000);
+    }
+    return 0;
+}
+
+static void test_async(void)
+{
+    static const uint16_t algorithms[] = {0x0403, 0x0804};
+    quicly_signer_pool_t *pool = quicly_signer_pool_create(&fake_signer, 2);
+    ptls_sign_certificate_t *signer = quicly_signer_pool_get_sign_certificate(pool);
+    ptls_async_job_t *jobs[10] = {NULL};
+    quicly_signer_pool_stats_t stats;
+    size_t i;
+    int ret;
+
+    num_notified = 0;
+
+    for (i = 0; i != PTLS_ELEMENTSOF(jobs); ++i) {
+        char input[16];
+        uint16_t selected;
+        ptls_buffer_t output;
+        ptls_buffer_init(&output, "", 0);
+        sprintf(input, "job%zu", i);
+        ret = signer->cb(signer, NULL, jobs + i, &selected, &output, ptls_iovec_init(input, strlen(input)), algorithms,
+                         PTLS_ELEMENTSOF(algorithms));
+        ok(ret == PTLS_ERROR_ASYNC_OPERATION);
+        ok(jobs[i] != NULL);
+        ok(output.off == 0);
+        jobs[i]->set_completion_callback(jobs[i], on_complete, NULL);
+        ptls_buffer_dispose(&output);
+    }
+
+    ok(wait_notified(PTLS_ELEMENTSOF(jobs)));
+
+    for (i = 0; i != PTLS_ELEMENTSOF(jobs); ++i) {
+        char expected[16];
+        uint16_t selected = 0;
+        ptls_buffer_t output;
+        ptls_buffer_init(&output, "", 0);
+        sprintf(expected, "sig:job%zu", i);
+        ret = signer->cb(signer, NULL, jobs + i, &selected, &output, ptls_iovec_init(NULL, 0), algorithms,
+                         PTLS_ELEMENTSOF(algorithms));
+        ok(ret == 0);
+        ok(jobs[i] == NULL);
+        ok(selected == 0x0804);
+        ok(buffer_is(&output, expected));
+        ptls_buffer_dispose(&output);
+    }
+
+    quicly_signer_pool_get_stats(pool, &stats);
+    ok(stats.num_queued == 0);
+    ok(stats.num_running == 0);
+    ok(stats.max_queued != 0);
+    ok(stats.num_submitted == PTLS_ELEMENTSOF(jobs));
+    ok(stats.num_completed == PTLS_ELEMENTSOF(jobs));
+
+    /* callback registered after completion is invoked immediately */
+    {
+        ptls_async_job_t *job = NULL;
+        uint16_t selected;
+        ptls_buffer_t output;
+        ptls_buffer_init(&output, "", 0);
+        num_notified = 0;
+        ret = signer->cb(signer, NULL, &job, &selected, &output, ptls_iovec_init("late", 4), algorithms, 1);
+        ok(ret == PTLS_ERROR_ASYNC_OPERATION);
+        while (1) {
+            quicly_signer_pool_get_stats(pool, &stats);
+            if (stats.num_completed == PTLS_ELEMENTSOF(jobs) + 1)
+                break;
+            usleep(1000);
+        }
+        job->set_completion_callback(job, on_complete, NULL);
+        ok(num_notified == 1);
+        job->destroy_(job);
+        ptls_buffer_dispose(&output);
+    }
+
+    quicly_signer_pool_destroy(pool);
+}
+
+static void test_sync(void)
+{
+    static const uint16_t algorithms[] = {0x0403};
+    quicly_signer_pool_t *pool = quicly_signer_pool_create(&fake_signer, 1);
+    ptls_sign_certificate_t *signer = quicly_signer_pool_get_sign_certificate(pool);
+    quicly_signer_pool_stats_t stats;
+    uint16_t selected = 0;
+    ptls_buffer_t output;
+
+    ptls_buffer_init(&output, "", 0);
+    ok(signer->cb(signer, NULL, NULL, &selected, &output, ptls_iovec_init("abc", 3), algorithms, 1) == 0);
+    ok(selected == 0x0403);
+    ok(buffer_is(&output, "sig:abc"));
+    ptls_buffer_dispose(&output);
+
+    quicly_signer_pool_get_stats(pool, &stats);
+    ok(stats.num_submitted == 0);
+
+    quicly_signer_pool_destroy(pool);
+}
+
+static void test_destroy_inflight(void)
+{
+    static const uint16_t algorithms[] = {0x0403};
+    quicly_signer_pool_t *pool = quicly_signer_pool_create(&fake_signer, 1);
+    ptls_sign_certificate_t *signer = quicly_signer_pool_get_sign_certificate(pool);
+    ptls_async_job_t *running = NULL, *queued = NULL;
+    quicly_signer_pool_stats_t stats;
+    uint16_t selected;
+    ptls_buffer_t output;
+
+    ptls_buffer_init(&output, "", 0);
+    pthread_mutex_lock(&gate);
+
+    ok(signer->cb(signer, NULL, &running, &selected, &output, ptls_iovec_init("a", 1), algorithms, 1) ==
+       PTLS_ERROR_ASYNC_OPERATION);
+    while (1) {
+        quicly_signer_pool_get_stats(pool, &stats);
+        if (stats.num_running == 1)
+            break;
+        usleep(1000);
+    }
+    ok(signer->cb(signer, NULL, &queued, &selected, &output, ptls_iovec_init("b", 1), algorithms, 1) ==
+       PTLS_ERROR_ASYNC_OPERATION);
+    quicly_signer_pool_get_stats(pool, &stats);
+    ok(stats.num_queued == 1);
+    ok(stats.max_queued == 1);
+
+    /* destroying a queued job removes it from the queue */
+    queued->destroy_(queued);
+    quicly_signer_pool_get_stats(pool, &stats);
+    ok(stats.num_queued == 0);
+
+    /* destroying a running job lets the worker free it */
+    running->destroy_(running);
+    pthread_mutex_unlock(&gate);
+
+    quicly_signer_pool_destroy(pool);
+    ptls_buffer_dispose(&output);
+}
+
+void test_signer_pool(void)
+{
+    subtest("async", test_async);
+    subtest("sync", test_sync);
+    subtest("destroy-inflight", test_destroy_inflight);
+}
@@ -20,6 +20,7 @@
  * IN THE SOFTWARE.
  */
 #include <string.h>
+#include "quicly/defaults.h"
 #include "quicly/streambuf.h"
 #include "test.h"
 
@@ -133,7 +134,7 @@ static void simple_http(void)
     server_streambuf = server_stream->data;
     ok(quicly_recvstate_transfer_complete(&server_stream->recvstate));
     ok(server_streambuf->error_received.reset_stream == -1);
-    ok(buffer_is(&server_streambuf->super.ingress, req));
+    ok(recvbuf_is(&server_streambuf->super.ingress, req));
     quicly_streambuf_egress_write(server_stream, resp, strlen(resp));
     quicly_streambuf_egress_shutdown(server_stream);
     ok(quicly_num_streams(server) == 1);
@@ -143,7 +144,7 @@ static void simple_http(void)
 
     ok(client_streambuf->is_detached);
     ok(client_streambuf->error_received.reset_stream == -1);
-    ok(buffer_is(&client_streambuf->super.ingress, resp));
+    ok(recvbuf_is(&client_streambuf->super.ingress, resp));
     ok(quicly_num_streams(client) == 0);
     ok(!server_streambuf->is_detached);
 
@@ -154,6 +155,304 @@ static void simple_http(void)
     ok(quicly_num_streams(server) == 0);
 }
 
+/**
+ * delivers the packets in reverse order, so that the stream frames arrive out-of-order
+ */
+static void transmit_reversed(quicly_conn_t *src, quicly_conn_t *dst)
+{
+    quicly_address_t destaddr, srcaddr;
+    struct iovec datagrams[32];
+    uint8_t datagramsbuf[PTLS_ELEMENTSOF(datagrams) * quicly_get_context(src)->transport_params.max_udp_payload_size];
+    size_t num_datagrams = PTLS_ELEMENTSOF(datagrams), num_packets, i;
+    quicly_decoded_packet_t decoded[PTLS_ELEMENTSOF(datagrams) * 2];
+    int ret;
+
+    ret = quicly_send(src, &destaddr, &srcaddr, datagrams, &num_datagrams, datagramsbuf, sizeof(datagramsbuf));
+    ok(ret == 0);
+    num_packets = decode_packets(decoded, datagrams, num_datagrams);
+    for (i = num_packets; i != 0; --i) {
+        ret = quicly_receive(dst, NULL, &fake_address.sa, decoded + i - 1);
+        ok(ret == 0 || ret == QUICLY_ERROR_PACKET_IGNORED);
+    }
+}
+
+static void large_ingress(void)
+{
+    static uint8_t data[100000];
+    quicly_stream_t *client_stream, *server_stream = NULL;
+    test_streambuf_t *server_streambuf = NULL;
+    size_t i, num_read = 0, num_mismatch = 0;
+    int ret;
+
+    for (i = 0; i != sizeof(data); ++i)
+        data[i] = (uint8_t)(i + i / 251);
+
+    ret = quicly_open_stream(client, &client_stream, 0);
+    ok(ret == 0);
+    quicly_streambuf_egress_write(client_stream, data, sizeof(data));
+    quicly_streambuf_egress_shutdown(client_stream);
+
+    for (i = 0; i != 100; ++i) {
+        transmit_reversed(client, server);
+        if (server_stream == NULL && (server_stream = quicly_get_stream(server, client_stream->stream_id)) != NULL)
+            server_streambuf = server_stream->data;
+        if (server_stream != NULL) {
+            /* read everything available, spanning multiple chunks */
+            ptls_iovec_t vecs[4];
+            size_t num_vecs = quicly_streambuf_ingress_get_vecs(server_stream, vecs, PTLS_ELEMENTSOF(vecs)), j, bytes_read = 0;
+            for (j = 0; j != num_vecs; ++j) {
+                if (num_read + bytes_read + vecs[j].len > sizeof(data) ||
+                    memcmp(vecs[j].base, data + num_read + bytes_read, vecs[j].len) != 0)
+                    ++num_mismatch;
+                bytes_read += vecs[j].len;
+            }
+            quicly_streambuf_ingress_shift(server_stream, bytes_read);
+            num_read += bytes_read;
+            if (num_read == sizeof(data))
+                break;
+        }
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+    }
+
+    ok(num_mismatch == 0);
+    ok(num_read == sizeof(data));
+    ok(quicly_recvstate_transfer_complete(&server_stream->recvstate));
+    ok(server_streambuf->super.ingress.chunks.size == 0);
+
+    quicly_streambuf_egress_shutdown(server_stream);
+    transmit(server, client);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client, server);
+    ok(server_streambuf->is_detached);
+}
+
+static void large_request(void)
+{
+    static uint8_t data[QUICLY_RECVBUF_CHUNK_SIZE + 5000];
+    quicly_stream_t *client_stream, *server_stream = NULL;
+    test_streambuf_t *server_streambuf;
+    ptls_iovec_t input;
+    size_t i;
+    int ret;
+
+    for (i = 0; i != sizeof(data); ++i)
+        data[i] = (uint8_t)(i + i / 251);
+
+    ret = quicly_open_stream(client, &client_stream, 0);
+    ok(ret == 0);
+    quicly_streambuf_egress_write(client_stream, data, sizeof(data));
+    quicly_streambuf_egress_shutdown(client_stream);
+
+    /* receive the entire request without consuming it */
+    for (i = 0; i != 10; ++i) {
+        transmit(client, server);
+        if ((server_stream = quicly_get_stream(server, client_stream->stream_id)) != NULL &&
+            quicly_recvstate_transfer_complete(&server_stream->recvstate))
+            break;
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+    }
+    ok(server_stream != NULL);
+    ok(quicly_recvstate_transfer_complete(&server_stream->recvstate));
+    server_streambuf = server_stream->data;
+
+    /* the request spans two chunks; the chunk accessor returns the first, the other returns all as one iovec */
+    input = quicly_streambuf_ingress_get_chunk(server_stream);
+    ok(input.len == QUICLY_RECVBUF_CHUNK_SIZE);
+    input = quicly_streambuf_ingress_get(server_stream);
+    ok(input.len == sizeof(data));
+    ok(memcmp(input.base, data, sizeof(data)) == 0);
+
+    /* the same applies after shifting some bytes */
+    quicly_streambuf_ingress_shift(server_stream, 100);
+    input = quicly_streambuf_ingress_get(server_stream);
+    ok(input.len == sizeof(data) - 100);
+    ok(memcmp(input.base, data + 100, sizeof(data) - 100) == 0);
+
+    /* the copy is released along with the chunks */
+    quicly_streambuf_ingress_shift(server_stream, input.len);
+    ok(server_streambuf->super.ingress.chunks.size == 0);
+    ok(server_streambuf->super.ingress.linear.base == NULL);
+
+    quicly_streambuf_egress_shutdown(server_stream);
+    transmit(server, client);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client, server);
+    ok(server_streambuf->is_detached);
+}
+
+static void many_small_writes(void)
+{
+    static uint8_t data[30000];
+    quicly_stream_t *client_stream, *server_stream = NULL;
+    test_streambuf_t *client_streambuf, *server_streambuf = NULL;
+    size_t i, num_written = 0, num_read = 0, num_mismatch = 0;
+    int ret;
+
+    for (i = 0; i != sizeof(data); ++i)
+        data[i] = (uint8_t)(i * 3 + i / 253);
+
+    ret = quicly_open_stream(client, &client_stream, 0);
+    ok(ret == 0);
+    client_streambuf = client_stream->data;
+    for (i = 0; num_written < sizeof(data); ++i) {
+        size_t len = i % 17;
+        if (len > sizeof(data) - num_written)
+            len = sizeof(data) - num_written;
+        quicly_streambuf_egress_write(client_stream, data + num_written, len);
+        num_written += len;
+    }
+    quicly_streambuf_egress_shutdown(client_stream);
+    /* the writes are coalesced into a handful of chunks */
+    ok(client_streambuf->super.egress.vecs.size <= 7);
+
+    for (i = 0; i != 100 && num_read != sizeof(data); ++i) {
+        transmit(client, server);
+        if (server_stream == NULL && (server_stream = quicly_get_stream(server, client_stream->stream_id)) != NULL)
+            server_streambuf = server_stream->data;
+        if (server_stream != NULL) {
+            ptls_iovec_t input;
+            while ((input = quicly_streambuf_ingress_get(server_stream)).len != 0) {
+                if (num_read + input.len > sizeof(data) || memcmp(input.base, data + num_read, input.len) != 0)
+                    ++num_mismatch;
+                num_read += input.len;
+                quicly_streambuf_ingress_shift(server_stream, input.len);
+            }
+        }
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+    }
+
+    ok(num_mismatch == 0);
+    ok(num_read == sizeof(data));
+    ok(client_streambuf->super.egress.vecs.size == 0);
+
+    quicly_streambuf_egress_shutdown(server_stream);
+    transmit(server, client);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client, server);
+    ok(server_streambuf->is_detached);
+}
+
+static size_t num_bytes_received(quicly_stream_id_t stream_id)
+{
+    quicly_stream_t *stream = quicly_get_stream(server, stream_id);
+    return stream != NULL ? ((test_streambuf_t *)stream->data)->super.ingress.off : 0;
+}
+
+static void priority_scheduler(void)
+{
+    static uint8_t data[50000];
+    quicly_stream_scheduler_t *stream_scheduler_orig = quic_ctx.stream_scheduler;
+    quicly_stream_t *client_streams[5], *server_stream;
+    test_streambuf_t *server_streambufs[5];
+    size_t i, num_violations = 0;
+    int ret;
+
+    quic_ctx.stream_scheduler = &quicly_priority_stream_scheduler;
+    memset(data, 'a', sizeof(data));
+
+    /* open streams in the order of: two bulk streams, two incremental streams, one urgent stream */
+    for (i = 0; i != 5; ++i) {
+        ret = quicly_open_stream(client, &client_streams[i], 0);
+        ok(ret == 0);
+        quicly_streambuf_egress_write(client_streams[i], data, i < 4 ? sizeof(data) : 6);
+        quicly_streambuf_egress_shutdown(client_streams[i]);
+    }
+    quicly_stream_set_priority(client_streams[2], 2, 1);
+    quicly_stream_set_priority(client_streams[3], 2, 1);
+    quicly_stream_set_priority(client_streams[4], 0, 0);
+
+    /* the urgent stream overtakes, the incremental streams share the bandwidth, and the bulk streams wait */
+    transmit(client, server);
+    ok(num_bytes_received(client_streams[4]->stream_id) == 6);
+    ok(num_bytes_received(client_streams[2]->stream_id) != 0);
+    ok(num_bytes_received(client_streams[3]->stream_id) != 0);
+    ok(num_bytes_received(client_streams[0]->stream_id) == 0);
+    ok(num_bytes_received(client_streams[1]->stream_id) == 0);
+
+    /* non-incremental streams of the same urgency are sent one by one */
+    for (i = 0; i != 100 && num_bytes_received(client_streams[1]->stream_id) != sizeof(data); ++i) {
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+        transmit(client, server);
+        if (num_bytes_received(client_streams[1]->stream_id) != 0 &&
+            num_bytes_received(client_streams[0]->stream_id) != sizeof(data))
+            ++num_violations;
+    }
+    ok(num_violations == 0);
+    for (i = 0; i != 4; ++i)
+        ok(num_bytes_received(client_streams[i]->stream_id) == sizeof(data));
+
+    /* close the streams */
+    for (i = 0; i != 5; ++i) {
+        server_stream = quicly_get_stream(server, client_streams[i]->stream_id);
+        server_streambufs[i] = server_stream->data;
+        quicly_streambuf_egress_shutdown(server_stream);
+    }
+    transmit(server, client);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client, server);
+    for (i = 0; i != 5; ++i)
+        ok(server_streambufs[i]->is_detached);
+
+    quic_ctx.stream_scheduler = stream_scheduler_orig;
+}
+
+static void receive_window_autotune(void)
+{
+    static uint8_t data[500000];
+    quicly_max_stream_data_t max_stream_data_orig = quic_ctx.transport_params.max_stream_data;
+    quicly_stream_t *client_stream, *server_stream = NULL;
+    test_streambuf_t *server_streambuf = NULL;
+    size_t i, num_read = 0, num_mismatch = 0;
+    int ret;
+
+    for (i = 0; i != sizeof(data); ++i)
+        data[i] = (uint8_t)(i * 7 + i / 1000);
+    quic_ctx.transport_params.max_stream_data = (quicly_max_stream_data_t){16384, 16384, 16384};
+    quic_ctx.max_receive_window.max_stream_data = 1024 * 1024;
+
+    ret = quicly_open_stream(client, &client_stream, 0);
+    ok(ret == 0);
+    client_stream->_send_aux.max_stream_data = 16384;
+    quicly_streambuf_egress_write(client_stream, data, sizeof(data));
+    quicly_streambuf_egress_shutdown(client_stream);
+
+    for (i = 0; i != 1000 && num_read != sizeof(data); ++i) {
+        transmit(client, server);
+        if (server_stream == NULL && (server_stream = quicly_get_stream(server, client_stream->stream_id)) != NULL)
+            server_streambuf = server_stream->data;
+        if (server_stream != NULL) {
+            ptls_iovec_t input;
+            while ((input = quicly_streambuf_ingress_get(server_stream)).len != 0) {
+                if (num_read + input.len > sizeof(data) || memcmp(input.base, data + num_read, input.len) != 0)
+                    ++num_mismatch;
+                num_read += input.len;
+                quicly_streambuf_ingress_shift(server_stream, input.len);
+            }
+        }
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+    }
+
+    ok(num_mismatch == 0);
+    ok(num_read == sizeof(data));
+    /* the window grows, as the client consumes it every round-trip */
+    ok(server_stream->_recv_aux.window > 16384);
+    ok(server_stream->_recv_aux.window <= 1024 * 1024);
+
+    quicly_streambuf_egress_shutdown(server_stream);
+    transmit(server, client);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client, server);
+    ok(server_streambuf->is_detached);
+
+    quic_ctx.transport_params.max_stream_data = max_stream_data_orig;
+    quic_ctx.max_receive_window.max_stream_data = 0;
+}
+
 static void test_reset_then_close(void)
 {
     quicly_stream_t *client_stream, *server_stream;
@@ -213,7 +512,7 @@ static void test_send_then_close(void)
     server_stream = quicly_get_stream(server, client_stream->stream_id);
     assert(server_stream != NULL);
     server_streambuf = server_stream->data;
-    ok(buffer_is(&server_streambuf->super.ingress, "hello"));
+    ok(recvbuf_is(&server_streambuf->super.ingress, "hello"));
     quicly_streambuf_ingress_shift(server_stream, 5);
 
     quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
@@ -227,7 +526,7 @@ static void test_send_then_close(void)
     transmit(client, server);
 
     ok(quicly_recvstate_transfer_complete(&server_stream->recvstate));
-    ok(buffer_is(&server_streambuf->super.ingress, ""));
+    ok(recvbuf_is(&server_streambuf->super.ingress, ""));
     quicly_streambuf_egress_shutdown(server_stream);
 
     quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
@@ -260,7 +559,7 @@ static void test_reset_after_close(void)
     server_stream = quicly_get_stream(server, client_stream->stream_id);
     assert(server_stream != NULL);
     server_streambuf = server_stream->data;
-    ok(buffer_is(&server_streambuf->super.ingress, "hello"));
+    ok(recvbuf_is(&server_streambuf->super.ingress, "hello"));
     quicly_streambuf_ingress_shift(server_stream, 5);
 
     quicly_streambuf_egress_write(client_stream, "world", 5);
@@ -271,7 +570,7 @@ static void test_reset_after_close(void)
 
     transmit(client, server);
 
-    ok(buffer_is(&server_streambuf->super.ingress, ""));
+    ok(recvbuf_is(&server_streambuf->super.ingress, ""));
     ok(quicly_recvstate_transfer_complete(&server_stream->recvstate));
 
     quicly_streambuf_egress_shutdown(server_stream);
@@ -319,7 +618,7 @@ static void tiny_stream_window(void)
     server_stream = quicly_get_stream(server, client_stream->stream_id);
     ok(server_stream != NULL);
     server_streambuf = server_stream->data;
-    ok(buffer_is(&server_streambuf->super.ingress, "hell"));
+    ok(recvbuf_is(&server_streambuf->super.ingress, "hell"));
     quicly_streambuf_ingress_shift(server_stream, 3);
 
     transmit(server, client);
@@ -328,13 +627,13 @@ static void tiny_stream_window(void)
     quicly_get_stats(client, &stats);
     ok(stats.num_frames_sent.stream_data_blocked == 2);
 
-    ok(buffer_is(&server_streambuf->super.ingress, "lo w"));
+    ok(recvbuf_is(&server_streambuf->super.ingress, "lo w"));
     quicly_streambuf_ingress_shift(server_stream, 4);
 
     transmit(server, client);
     transmit(client, server);
 
-    ok(buffer_is(&server_streambuf->super.ingress, "orld"));
+    ok(recvbuf_is(&server_streambuf->super.ingress, "orld"));
     ok(quicly_recvstate_transfer_complete(&server_stream->recvstate));
 
     quicly_request_stop(client_stream, QUICLY_ERROR_FROM_APPLICATION_ERROR_CODE(12345));
@@ -397,7 +696,7 @@ static void test_reset_during_loss(void)
     server_stream = quicly_get_stream(server, client_stream->stream_id);
     ok(server_stream != NULL);
     server_streambuf = server_stream->data;
-    ok(buffer_is(&server_streambuf->super.ingress, "hell"));
+    ok(recvbuf_is(&server_streambuf->super.ingress, "hell"));
     quicly_streambuf_ingress_shift(server_stream, 4);
 
     /* transmit ack */
@@ -576,13 +875,13 @@ static void tiny_connection_window(void)
     server_stream = quicly_get_stream(server, client_stream->stream_id);
     ok(server_stream != NULL);
     server_streambuf = server_stream->data;
-    ok(buffer_is(&server_streambuf->super.ingress, testdata));
+    ok(recvbuf_is(&server_streambuf->super.ingress, testdata));
     quicly_streambuf_ingress_shift(server_stream, strlen(testdata));
 
     for (i = 1; i < 16; ++i) {
         transmit(server, client);
         transmit(client, server);
-        ok(buffer_is(&server_streambuf->super.ingress, testdata));
+        ok(recvbuf_is(&server_streambuf->super.ingress, testdata));
         quicly_streambuf_ingress_shift(server_stream, strlen(testdata));
     }
 
@@ -594,10 +893,365 @@ static void tiny_connection_window(void)
     quic_ctx.transport_params.max_data = max_data_orig;
 }
 
+static int fixed_ack_frequency(quicly_adjust_ack_frequency_t *self, quicly_conn_t *conn, const quicly_ack_frequency_input_t *input,
+                               quicly_ack_frequency_params_t *params)
+{
+    params->packet_tolerance = 4;
+    return 1;
+}
+
+static void test_ack_frequency_loss(void)
+{
+    static quicly_adjust_ack_frequency_t adjust_ack_frequency = {fixed_ack_frequency};
+    quicly_stream_t *client_stream, *server_stream;
+    quicly_stats_t stats;
+    uint64_t num_sent_at_start;
+    size_t i;
+    int ret;
+
+    quic_ctx.adjust_ack_frequency = &adjust_ack_frequency;
+    quic_now += 1000;
+
+    quicly_get_stats(client, &stats);
+    num_sent_at_start = stats.num_frames_sent.ack_frequency;
+
+    ret = quicly_open_stream(client, &client_stream, 0);
+    ok(ret == 0);
+    quicly_streambuf_egress_write(client_stream, "hello", 5);
+
+    { /* the packet carrying the stream data and ACK_FREQUENCY is lost */
+        quicly_address_t dest, src;
+        struct iovec datagram;
+        uint8_t buf[quic_ctx.transport_params.max_udp_payload_size];
+        size_t cnt = 1;
+        ret = quicly_send(client, &dest, &src, &datagram, &cnt, buf, sizeof(buf));
+        ok(ret == 0);
+        ok(cnt == 1);
+    }
+    quicly_get_stats(client, &stats);
+    ok(stats.num_frames_sent.ack_frequency == num_sent_at_start + 1);
+
+    /* once the loss is detected, the frame is resent, even though the parameters remain the same */
+    for (i = 0; i < 10 && stats.num_frames_sent.ack_frequency == num_sent_at_start + 1; ++i) {
+        if (quic_now < quicly_get_first_timeout(client))
+            quic_now = quicly_get_first_timeout(client);
+        transmit(client, server);
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+        quicly_get_stats(client, &stats);
+    }
+    ok(stats.num_frames_sent.ack_frequency == num_sent_at_start + 2);
+
+    quic_ctx.adjust_ack_frequency = NULL;
+
+    /* the stream data has been retransmitted as well */
+    server_stream = quicly_get_stream(server, client_stream->stream_id);
+    ok(server_stream != NULL);
+    ok(recvbuf_is(&((test_streambuf_t *)server_stream->data)->super.ingress, "hello"));
+}
+
+static struct {
+    ptls_sign_certificate_t super;
+    ptls_sign_certificate_t *orig;
+    ptls_async_job_t job;
+} async_signer;
+
+static ptls_t *async_handshake_tls;
+
+static void async_signer_job_destroy(ptls_async_job_t *job)
+{
+}
+
+/**
+ * suspends the handshake once, then signs using the original signer
+ */
+static int async_signer_sign(ptls_sign_certificate_t *self, ptls_t *tls, ptls_async_job_t **async, uint16_t *selected_algorithm,
+                             ptls_buffer_t *output, ptls_iovec_t input, const uint16_t *algorithms, size_t num_algorithms)
+{
+    if (async != NULL) {
+        if (*async == NULL) {
+            *async = &async_signer.job;
+            return PTLS_ERROR_ASYNC_OPERATION;
+        }
+        *async = NULL;
+    }
+    return async_signer.orig->cb(async_signer.orig, tls, NULL, selected_algorithm, output, input, algorithms, num_algorithms);
+}
+
+static void on_async_handshake(quicly_async_handshake_t *self, ptls_t *tls)
+{
+    async_handshake_tls = tls;
+}
+
+static void test_async_handshake(void)
+{
+    static quicly_async_handshake_t async_handshake = {on_async_handshake};
+    quicly_conn_t *client_conn, *server_conn;
+    int ret;
+
+    async_signer.super.cb = async_signer_sign;
+    async_signer.orig = quic_ctx.tls->sign_certificate;
+    async_signer.job.destroy_ = async_signer_job_destroy;
+    quic_ctx.tls->sign_certificate = &async_signer.super;
+    quic_ctx.async_handshake = &async_handshake;
+    async_handshake_tls = NULL;
+
+    { /* the server receives the entire first flight of the client in one read, and suspends the handshake */
+        quicly_address_t dest, src;
+        struct iovec raw[8];
+        uint8_t rawbuf[PTLS_ELEMENTSOF(raw) * quic_ctx.transport_params.max_udp_payload_size];
+        quicly_decoded_packet_t decoded[PTLS_ELEMENTSOF(raw) * 2];
+        size_t num_datagrams = PTLS_ELEMENTSOF(raw), num_packets, i;
+
+        ret = quicly_connect(&client_conn, &quic_ctx, "example.com", &fake_address.sa, NULL, new_master_id(),
+                             ptls_iovec_init(NULL, 0), NULL, NULL, NULL);
+        ok(ret == 0);
+        ret = quicly_send(client_conn, &dest, &src, raw, &num_datagrams, rawbuf, sizeof(rawbuf));
+        ok(ret == 0);
+        num_packets = decode_packets(decoded, raw, num_datagrams);
+        ok(num_packets != 0);
+        ret = quicly_accept(&server_conn, &quic_ctx, NULL, &fake_address.sa, decoded, NULL, new_master_id(), NULL, NULL);
+        ok(ret == 0);
+        for (i = 1; i < num_packets; ++i) {
+            ret = quicly_receive(server_conn, NULL, &fake_address.sa, decoded + i);
+            ok(ret == 0 || ret == QUICLY_ERROR_PACKET_IGNORED);
+        }
+    }
+    ok(async_handshake_tls != NULL);
+
+    /* the server flight is not sent while the signature is being generated */
+    transmit(server_conn, client_conn);
+    ok(quicly_get_state(client_conn) == QUICLY_STATE_FIRSTFLIGHT);
+
+    /* once resumed, the handshake completes */
+    ok(quicly_resume_handshake(async_handshake_tls) == server_conn);
+    transmit(server_conn, client_conn);
+    ok(quicly_get_state(client_conn) == QUICLY_STATE_CONNECTED);
+    ok(quicly_connection_is_ready(client_conn));
+    transmit(client_conn, server_conn);
+    ok(quicly_get_state(server_conn) == QUICLY_STATE_CONNECTED);
+    ok(quicly_connection_is_ready(server_conn));
+
+    quicly_free(client_conn);
+    quicly_free(server_conn);
+    quic_ctx.tls->sign_certificate = async_signer.orig;
+    quic_ctx.async_handshake = NULL;
+}
+
+/**
+ * consumes all the data buffered in the receive buffer of the stream, returning the number of bytes
+ */
+static size_t read_stream(quicly_conn_t *conn, quicly_stream_id_t stream_id)
+{
+    quicly_stream_t *stream;
+    ptls_iovec_t input;
+    size_t num_read = 0;
+
+    if ((stream = quicly_get_stream(conn, stream_id)) == NULL)
+        return 0;
+    while ((input = quicly_streambuf_ingress_get(stream)).len != 0) {
+        num_read += input.len;
+        quicly_streambuf_ingress_shift(stream, input.len);
+    }
+    return num_read;
+}
+
+static void memory_pressure(void)
+{
+    static uint8_t data[200000];
+    static quicly_memory_budget_t budget;
+    quicly_max_stream_data_t max_stream_data_orig = quic_ctx.transport_params.max_stream_data;
+    quicly_stream_t *client_stream;
+    size_t i, num_read = 0;
+    uint64_t max_stream_data_at_pressure;
+    int ret;
+
+    for (i = 0; i != sizeof(data); ++i)
+        data[i] = (uint8_t)(i * 11 + i / 1000);
+    quic_ctx.transport_params.max_stream_data = (quicly_max_stream_data_t){16384, 16384, 16384};
+    quicly_memory_budget_init(&budget, 16 * 1024 * 1024);
+    quic_ctx.memory_budget = &budget;
+
+    ret = quicly_open_stream(client, &client_stream, 0);
+    ok(ret == 0);
+    client_stream->_send_aux.max_stream_data = 16384;
+    quicly_streambuf_egress_write(client_stream, data, sizeof(data));
+    quicly_streambuf_egress_shutdown(client_stream);
+
+    /* transfer some data, then put the budget under full pressure; the transfer stalls, even though the server reads everything */
+    transmit(client, server);
+    num_read += read_stream(server, client_stream->stream_id);
+    quicly_memory_budget_charge(&budget, budget.limit);
+    for (i = 0; i != 20; ++i) {
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+        transmit(client, server);
+        num_read += read_stream(server, client_stream->stream_id);
+    }
+    max_stream_data_at_pressure = client_stream->_send_aux.max_stream_data;
+    ok(num_read == max_stream_data_at_pressure);
+    ok(num_read < sizeof(data));
+
+    /* once the pressure is gone, the server extends the window on its own */
+    quicly_memory_budget_release(&budget, budget.limit);
+    for (i = 0; i != 10 && client_stream->_send_aux.max_stream_data == max_stream_data_at_pressure; ++i) {
+        if (quic_now < quicly_get_first_timeout(server))
+            quic_now = quicly_get_first_timeout(server);
+        transmit(server, client);
+    }
+    ok(client_stream->_send_aux.max_stream_data > max_stream_data_at_pressure);
+
+    /* and the transfer completes */
+    for (i = 0; i != 1000 && num_read != sizeof(data); ++i) {
+        transmit(client, server);
+        num_read += read_stream(server, client_stream->stream_id);
+        quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+        transmit(server, client);
+    }
+    ok(num_read == sizeof(data));
+
+    quicly_streambuf_egress_shutdown(quicly_get_stream(server, client_stream->stream_id));
+    transmit(server, client);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client, server);
+
+    quic_ctx.memory_budget = NULL;
+    quic_ctx.transport_params.max_stream_data = max_stream_data_orig;
+}
+
+static int flatten_lazy_vec(quicly_sendbuf_vec_t *vec, void *dst, size_t off, size_t len)
+{
+    memset(dst, 'x', len);
+    return 0;
+}
+
+static void memory_budget_vec(void)
+{
+    static const quicly_streambuf_sendvec_callbacks_t lazy_callbacks = {flatten_lazy_vec};
+    static quicly_memory_budget_t budget;
+    quicly_stream_t *client_stream;
+    quicly_sendbuf_vec_t vec = {&lazy_callbacks, 1024 * 1024};
+    size_t used_at_start;
+    int ret;
+
+    quicly_memory_budget_init(&budget, 16 * 1024 * 1024);
+    quic_ctx.memory_budget = &budget;
+
+    /* the bytes being copied are charged, but those of the vector provided by the application are not (the connections charge
+     * the budget for their sentmaps and receive buffers as well, hence the comparison against the usage at start) */
+    ret = quicly_open_stream(client, &client_stream, 0);
+    ok(ret == 0);
+    used_at_start = quicly_memory_budget_get_used(&budget);
+    ret = quicly_streambuf_egress_write_vec(client_stream, &vec);
+    ok(ret == 0);
+    ok(quicly_memory_budget_get_used(&budget) == used_at_start);
+    quicly_streambuf_egress_write(client_stream, "hello", 5);
+    ok(quicly_memory_budget_get_used(&budget) == used_at_start + 5);
+
+    /* discard the stream */
+    quicly_reset_stream(client_stream, QUICLY_ERROR_FROM_APPLICATION_ERROR_CODE(12345));
+    quicly_request_stop(client_stream, QUICLY_ERROR_FROM_APPLICATION_ERROR_CODE(54321));
+    transmit(client, server);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(server, client);
+    ok(quicly_num_streams(client) == 0);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client, server);
+    ok(quicly_num_streams(server) == 0);
+
+    quic_ctx.memory_budget = NULL;
+}
+
+static void latency_stats(void)
+{
+    const char *req = "GET / HTTP/1.0\r\n\r\n", *resp = "HTTP/1.0 200 OK\r\n\r\nhello world";
+    quicly_conn_t *client_conn, *server_conn;
+    quicly_stream_t *client_stream, *server_stream;
+    quicly_stats_t stats;
+    int ret;
+
+    /* nothing is recorded unless being asked to */
+    quicly_get_stats(client, &stats);
+    ok(stats.num_packets.ack_received != 0);
+    ok(stats.latency.rtt.count == 0);
+
+    quic_ctx.collect_latency_stats = 1;
+
+    { /* handshake */
+        quicly_address_t dest, src;
+        struct iovec raw[8];
+        uint8_t rawbuf[PTLS_ELEMENTSOF(raw) * quic_ctx.transport_params.max_udp_payload_size];
+        quicly_decoded_packet_t decoded[PTLS_ELEMENTSOF(raw) * 2];
+        size_t num_datagrams = PTLS_ELEMENTSOF(raw), num_packets, i;
+
+        ret = quicly_connect(&client_conn, &quic_ctx, "example.com", &fake_address.sa, NULL, new_master_id(),
+                             ptls_iovec_init(NULL, 0), NULL, NULL, NULL);
+        ok(ret == 0);
+        ret = quicly_send(client_conn, &dest, &src, raw, &num_datagrams, rawbuf, sizeof(rawbuf));
+        ok(ret == 0);
+        num_packets = decode_packets(decoded, raw, num_datagrams);
+        ok(num_packets != 0);
+        quic_now += 10;
+        ret = quicly_accept(&server_conn, &quic_ctx, NULL, &fake_address.sa, decoded, NULL, new_master_id(), NULL, NULL);
+        ok(ret == 0);
+        for (i = 1; i < num_packets; ++i) {
+            ret = quicly_receive(server_conn, NULL, &fake_address.sa, decoded + i);
+            ok(ret == 0 || ret == QUICLY_ERROR_PACKET_IGNORED);
+        }
+    }
+    transmit(server_conn, client_conn);
+    quic_now += 10;
+    transmit(client_conn, server_conn);
+    quic_now += 10;
+    transmit(server_conn, client_conn);
+    ok(quicly_get_state(client_conn) == QUICLY_STATE_CONNECTED);
+    ok(quicly_get_state(server_conn) == QUICLY_STATE_CONNECTED);
+
+    /* request and response; the response arrives one round-trip after the request is sent */
+    ret = quicly_open_stream(client_conn, &client_stream, 0);
+    ok(ret == 0);
+    quicly_streambuf_egress_write(client_stream, req, strlen(req));
+    quicly_streambuf_egress_shutdown(client_stream);
+    quic_now += 10;
+    transmit(client_conn, server_conn);
+    server_stream = quicly_get_stream(server_conn, client_stream->stream_id);
+    ok(server_stream != NULL);
+    quicly_streambuf_egress_write(server_stream, resp, strlen(resp));
+    quicly_streambuf_egress_shutdown(server_stream);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(server_conn, client_conn);
+    quic_now += QUICLY_DELAYED_ACK_TIMEOUT;
+    transmit(client_conn, server_conn);
+
+    /* each endpoint has recorded the samples */
+    quicly_get_stats(client_conn, &stats);
+    ok(stats.latency.rtt.count != 0);
+    ok(stats.latency.handshake.count == 1);
+    ok(stats.latency.handshake.max == stats.handshake_confirmed_msec);
+    ok(stats.latency.stream_first_byte.count == 1);
+    ok(stats.latency.stream_first_byte.sum == 10 + QUICLY_DELAYED_ACK_TIMEOUT);
+    ok(stats.latency.stream_first_byte.sum >= stats.rtt.minimum);
+    ok(stats.latency.stream_send_complete.count == 1);
+    quicly_get_stats(server_conn, &stats);
+    ok(stats.latency.rtt.count != 0);
+    ok(stats.latency.handshake.count == 1);
+    ok(stats.latency.stream_first_byte.count == 0); /* the stream was opened by the peer */
+    ok(stats.latency.stream_send_complete.count == 1);
+
+    quicly_free(client_conn);
+    quicly_free(server_conn);
+    quic_ctx.collect_latency_stats = 0;
+}
+
 void test_simple(void)
 {
     subtest("handshake", test_handshake);
     subtest("simple-http", simple_http);
+    subtest("large-ingress", large_ingress);
+    subtest("large-request", large_request);
+    subtest("many-small-writes", many_small_writes);
+    subtest("priority-scheduler", priority_scheduler);
+    subtest("receive-window-autotune", receive_window_autotune);
     subtest("reset-then-close", test_reset_then_close);
     subtest("send-then-close", test_send_then_close);
     subtest("reset-after-close", test_reset_after_close);
@@ -605,4 +1259,9 @@ void test_simple(void)
     subtest("reset-during-loss", test_reset_during_loss);
     subtest("close", test_close);
     subtest("tiny-connection-window", tiny_connection_window);
+    subtest("ack-frequency-loss", test_ack_frequency_loss);
+    subtest("async-handshake", test_async_handshake);
+    subtest("memory-pressure", memory_pressure);
+    subtest("memory-budget-vec", memory_budget_vec);
+    subtest("latency-stats", latency_stats);
 }
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2026 Fastly, Kazuho Oku
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include <pthread.h>
+#include "quicly/stats_aggregate.h"
+#include "test.h"
+
+#define NUM_THREADS 4
+#define NUM_ADDS_PER_THREAD 10000
+
+static void test_foreach(void)
+{
+    size_t num_counters = 0;
+
+#define COUNT(field, name) ++num_counters;
+    QUICLY_AGGREGATED_STATS_FOREACH(COUNT);
+#undef COUNT
+
+    /* every counter is covered */
+    ok(num_counters * sizeof(uint64_t) == sizeof(quicly_aggregated_stats_t));
+}
+
+static void *adder_main(void *_aggregate)
+{
+    quicly_stats_aggregate_t *aggregate = _aggregate;
+    quicly_aggregated_stats_t delta = {.num_packets.sent = 2, .num_conns.closed = 1};
+    size_t i;
+
+    for (i = 0; i != NUM_ADDS_PER_THREAD; ++i)
+        quicly_stats_aggregate_add(aggregate, &delta);
+    return NULL;
+}
+
+static void test_shards(void)
+{
+    quicly_stats_aggregate_t *aggregate = quicly_stats_aggregate_create();
+    quicly_aggregated_stats_t stats;
+    pthread_t threads[NUM_THREADS];
+    size_t i;
+
+    quicly_stats_aggregate_snapshot(aggregate, &stats);
+    ok(stats.num_packets.sent == 0);
+    ok(stats.num_conns.closed == 0);
+
+    for (i = 0; i != NUM_THREADS; ++i)
+        pthread_create(threads + i, NULL, adder_main, aggregate);
+    adder_main(aggregate);
+    for (i = 0; i != NUM_THREADS; ++i)
+        pthread_join(threads[i], NULL);
+
+    quicly_stats_aggregate_snapshot(aggregate, &stats);
+    ok(stats.num_packets.sent == 2 * NUM_ADDS_PER_THREAD * (NUM_THREADS + 1));
+    ok(stats.num_conns.closed == NUM_ADDS_PER_THREAD * (NUM_THREADS + 1));
+    ok(stats.num_packets.received == 0);
+
+    quicly_stats_aggregate_destroy(aggregate);
+
+    /* the per-thread cache does not refer to the aggregate being destroyed */
+    aggregate = quicly_stats_aggregate_create();
+    adder_main(aggregate);
+    quicly_stats_aggregate_snapshot(aggregate, &stats);
+    ok(stats.num_conns.closed == NUM_ADDS_PER_THREAD);
+    quicly_stats_aggregate_destroy(aggregate);
+}
+
+static void test_latency(void)
+{
+    quicly_stats_aggregate_t *aggregate = quicly_stats_aggregate_create();
+    quicly_latency_stats_t latency = {}, merged;
+
+    quicly_histogram_record(&latency.rtt, 10);
+    quicly_histogram_record(&latency.rtt, 200);
+    quicly_histogram_record(&latency.handshake, 30);
+    quicly_stats_aggregate_add_latency(aggregate, &latency);
+    quicly_stats_aggregate_add_latency(aggregate, &latency);
+
+    quicly_stats_aggregate_snapshot_latency(aggregate, &merged);
+    ok(merged.rtt.count == 4);
+    ok(merged.rtt.sum == 420);
+    ok(merged.rtt.max == 200);
+    ok(merged.handshake.count == 2);
+    ok(merged.stream_first_byte.count == 0);
+    ok(quicly_histogram_get_quantile(&merged.rtt, 0.5) == 10);
+
+    quicly_stats_aggregate_destroy(aggregate);
+}
+
+static void test_conn(void)
+{
+    quicly_stats_aggregate_t *aggregate = quicly_stats_aggregate_create();
+    quicly_aggregated_stats_t stats;
+    quicly_conn_t *conn;
+    quicly_address_t dest, src;
+    struct iovec datagram;
+    uint8_t buf[1500];
+    size_t num_datagrams = 1;
+    int ret;
+
+    quic_ctx.stats_aggregate = aggregate;
+
+    ret = quicly_connect(&conn, &quic_ctx, "example.com", &fake_address.sa, NULL, new_master_id(), ptls_iovec_init(NULL, 0), NULL,
+                         NULL, NULL);
+    ok(ret == 0);
+    quicly_stats_aggregate_snapshot(aggregate, &stats);
+    ok(stats.num_conns.opened == 1);
+    ok(stats.num_conns.closed == 0);
+
+    ret = quicly_send(conn, &dest, &src, &datagram, &num_datagrams, buf, sizeof(buf));
+    ok(ret == 0);
+    ok(num_datagrams == 1);
+    quicly_free(conn);
+
+    quicly_stats_aggregate_snapshot(aggregate, &stats);
+    ok(stats.num_conns.opened == 1);
+    ok(stats.num_conns.closed == 1);
+    ok(stats.num_conns.errored == 0);
+    ok(stats.num_packets.sent == 1);
+    ok(stats.num_frames_sent.crypto == 1);
+
+    quic_ctx.stats_aggregate = NULL;
+    quicly_stats_aggregate_destroy(aggregate);
+}
+
+void test_stats_aggregate(void)
+{
+    subtest("foreach", test_foreach);
+    subtest("shards", test_shards);
+    subtest("latency", test_latency);
+    subtest("conn", test_conn);
+}
@@ -45,12 +45,20 @@ const quicly_cid_plaintext_t *new_master_id(void);
 extern quicly_stream_open_t stream_open;
 size_t decode_packets(quicly_decoded_packet_t *decoded, struct iovec *raw, size_t cnt);
 int buffer_is(ptls_buffer_t *buf, const char *s);
+int recvbuf_is(quicly_recvbuf_t *rb, const char *s);
 size_t transmit(quicly_conn_t *src, quicly_conn_t *dst);
 int max_data_is_equal(quicly_conn_t *client, quicly_conn_t *server);
 
 void test_ranges(void);
+void test_ack_queue(void);
+void test_bintrace(void);
+void test_qlog(void);
+void test_datagram_queue(void);
+void test_memory_budget(void);
+void test_freelist(void);
 void test_rate(void);
 void test_frame(void);
+void test_histogram(void);
 void test_maxsender(void);
 void test_sentmap(void);
 void test_loss(void);
@@ -60,5 +68,9 @@ void test_stream_concurrency(void);
 void test_received_cid(void);
 void test_local_cid(void);
 void test_retire_cid(void);
+void test_signer_pool(void);
+void test_stats_aggregate(void);
+void test_initial_guard(void);
+void test_egress_drr(void);
 
 #endif